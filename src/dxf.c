@@ -4,9 +4,24 @@
 
 #include "dbgprint.h"
 
+#define DXF_LAYER_INDEX_MIN_SIZE 16
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 static unsigned int str_hash(const char **psz);
 static int str_cmp(const char **psz1, const char **psz2);
 static int init_entity(struct dxf_entity* const entity);
+static int init_header(struct dxf* const dxf);
+static int init_document(struct dxf* const dxf);
+static void count_pool_bytes(struct dxf* const dxf, size_t size);
+static void index_layer(struct dxf* const dxf, struct dxf_layer* const layer);
+static int compare_layers(const void *p1, const void *p2);
+static int is_relinked(struct dxf_layer** const layers, size_t number_of_layers,
+                        const struct dxf_layer* const layer);
+static int entity_iter_match(const struct dxf_entity_iter* const iter,
+                            const struct dxf_entity* const entity);
 
 static unsigned int str_hash(const char **psz) 
 {
@@ -25,6 +40,22 @@ static int str_cmp(const char **psz1, const char **psz2)
     return strcmp(*psz1, *psz2);
 }
 
+static void init_extrusion(double extrusion[3])
+{
+    extrusion[0] = extrusion[1] = 0.0;
+    extrusion[2] = 1.0;
+}
+
+static void init_insert(struct dxf_insert* const insert)
+{
+    insert->x = insert->y = insert->z = insert->angle = 0.0;
+    insert->x_scale = insert->y_scale = insert->z_scale = 1.0;
+    insert->column_count = insert->row_count = 1;
+    insert->column_spacing = insert->row_spacing = 0.0; 
+    insert->block_ref = NULL;
+    init_extrusion(insert->extrusion);
+}
+
 static int init_entity(struct dxf_entity* const entity)
 {
     struct dxf_point *point = (struct dxf_point*)entity;
@@ -33,6 +64,13 @@ static int init_entity(struct dxf_entity* const entity)
     struct dxf_lwpolyline *lwpolyline = (struct dxf_lwpolyline*)entity;
     struct dxf_arc *arc = (struct dxf_arc*)entity;
     struct dxf_insert *insert = (struct dxf_insert*)entity;
+    struct dxf_spline *spline = (struct dxf_spline*)entity;
+    struct dxf_ellipse *ellipse = (struct dxf_ellipse*)entity;
+    struct dxf_polyline *polyline = (struct dxf_polyline*)entity;
+    struct dxf_hatch *hatch = (struct dxf_hatch*)entity;
+    struct dxf_text *text = (struct dxf_text*)entity;
+    struct dxf_mtext *mtext = (struct dxf_mtext*)entity;
+    struct dxf_solid *solid = (struct dxf_solid*)entity;
 
     switch (entity->type) {
         case DXF_POINT:
@@ -44,50 +82,156 @@ static int init_entity(struct dxf_entity* const entity)
             return 0;
         case DXF_CIRCLE:
             circle->x = circle->y = circle->z = circle->r = 0.0;
+            init_extrusion(circle->extrusion);
             return 0;
         case DXF_LWPOLYLINE:
             lwpolyline->flag = DXF_LWPOLYLINE_FLAG_DEFAULT;
             lwpolyline->number_of_vertices = 0;
             lwpolyline->vertices = NULL;
             lwpolyline->tail_vertex = NULL;
+            init_extrusion(lwpolyline->extrusion);
             return 0;
         case DXF_ARC:
             arc->x = arc->y = arc->z = arc->r = 0.0;
             arc->angle_start = arc->angle_end = 0.0;
+            init_extrusion(arc->extrusion);
             return 0;
         case DXF_INSERT:
-            insert->x = insert->y = insert->z = insert->angle = 0.0;
-            insert->x_scale = insert->y_scale = insert->z_scale = 1.0;
-            insert->column_count = insert->row_count = 1;
-            insert->column_spacing = insert->row_spacing = 0.0; 
+            init_insert(insert);
+            return 0;
+        case DXF_DIMENSION:
+            init_insert(insert);
+            memset((char*)entity + sizeof(struct dxf_insert), 0,
+                    sizeof(struct dxf_dimension) - sizeof(struct dxf_insert));
+            return 0;
+        case DXF_SPLINE:
+            spline->flag = 0;
+            spline->degree = 3;
+            spline->number_of_knots = spline->number_of_control_points = 0;
+            spline->number_of_fit_points = 0;
+            spline->knots = spline->control_points = NULL;
+            spline->weights = spline->fit_points = NULL;
+            return 0;
+        case DXF_ELLIPSE:
+            ellipse->x = ellipse->y = ellipse->z = 0.0;
+            ellipse->major[0] = 1.0;
+            ellipse->major[1] = ellipse->major[2] = 0.0;
+            ellipse->ratio = 1.0;
+            ellipse->param_start = 0.0;
+            ellipse->param_end = 2.0 * M_PI;
+            init_extrusion(ellipse->extrusion);
+            return 0;
+        case DXF_POLYLINE:
+            polyline->flag = 0;
+            polyline->elevation = 0.0;
+            polyline->m_count = polyline->n_count = 0;
+            polyline->number_of_vertices = polyline->number_of_faces = 0;
+            polyline->vertices = NULL;
+            polyline->faces = NULL;
+            init_extrusion(polyline->extrusion);
+            return 0;
+        case DXF_HATCH:
+            memset((char*)hatch + sizeof(struct dxf_entity), 0,
+                    sizeof(struct dxf_hatch) - sizeof(struct dxf_entity));
+            hatch->pattern_scale = 1.0;
+            init_extrusion(hatch->extrusion);
+            return 0;
+        case DXF_SOLID:
+            memset(solid->corners, 0, sizeof(solid->corners));
+            init_extrusion(solid->extrusion);
+            return 0;
+        case DXF_TEXTSTRING:
+            memset((char*)text + sizeof(struct dxf_entity), 0,
+                    sizeof(struct dxf_text) - sizeof(struct dxf_entity));
+            text->x_scale = 1.0;
+            init_extrusion(text->extrusion);
+            return 0;
+        case DXF_MTEXT:
+            memset((char*)mtext + sizeof(struct dxf_entity), 0,
+                    sizeof(struct dxf_mtext) - sizeof(struct dxf_entity));
+            mtext->direction[0] = 1.0;
+            mtext->line_spacing = 1.0;
+            mtext->attachment = 1;
+            mtext->drawing_direction = 1;
+            init_extrusion(mtext->extrusion);
             return 0;
         default:
             return -1;
     }
 }
 
+static int init_header(struct dxf* const dxf)
+{
+    return hashtable_create(&(dxf->header), 37, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)str_hash, (pfn_keycmp_t)str_cmp, NULL);
+}
+
+static void count_pool_bytes(struct dxf* const dxf, size_t size)
+{
+    dxf->stats.pool_bytes_used += size;
+    if (dxf->stats.pool_bytes_used > dxf->stats.pool_bytes_peak) {
+        dxf->stats.pool_bytes_peak = dxf->stats.pool_bytes_used;
+    }
+}
+
+static int init_document(struct dxf* const dxf)
+{
+    size_t pool_bytes_peak = dxf->stats.pool_bytes_peak;
+
+    dxf->layers = NULL;
+    dxf->last_accessed_layer = NULL;
+    dxf->layer_index = NULL;
+    dxf->layer_index_size = 0;
+    dxf->blocks = NULL;
+    dxf->last_accessed_block = NULL;
+    dxf->first_entity = NULL;
+    dxf->last_entity = NULL;
+    dxf->number_of_entities = 0;
+    memset(&(dxf->stats), 0, sizeof(struct dxf_stats));
+    dxf->stats.pool_bytes_peak = pool_bytes_peak;
+
+    /* Anything cached before a reset is gone with the pool. */
+    if (++(dxf->bounds_generation) == 0) {
+        dxf->bounds_generation = 1;
+    }
+    dxf->document_bounds_generation = 0;
+    dxf->bounds_cache = NULL;
+    dxf->bounds_cache_size = 0;
+    dxf->has_extents_hint = 0;
+    dxf->thumbnail = NULL;
+    dxf->thumbnail_size = 0;
+
+    if (dxf_add_layer(dxf, "0") == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
 int dxf_init(struct dxf* const dxf, size_t pool_size)
 {
-    if (hashtable_create(&(dxf->header), 37, 0, 0, HASHTABLE_COPY_VALUE,
-        HASHTABLE_COPY_VALUE, (pfn_hash_t)str_hash, (pfn_keycmp_t)str_cmp, NULL) != 0) 
-    {
+    return dxf_init_ex(dxf, pool_size, DXF_POOL_DEFAULT);
+}
+
+int dxf_init_ex(struct dxf* const dxf, size_t pool_size, int pool_flags)
+{
+    if (init_header(dxf) != 0) {
         errprint("dxf: dxf_init(): Failed to create header. \n");
         return -1;
     }
     
-    if ((dxf->pool = crapool_create(pool_size, NULL)) == NULL) {
+    if ((dxf->pool = dxf_arena_create(pool_size, pool_flags)) == NULL) {
         errprint("dxf: dxf_init(): Memory pool creation failed. \n");
         return -1;
     }
 
-    dxf->layers = NULL;
-    dxf->last_accessed_layer = NULL;
-    dxf->blocks = NULL;
-    dxf->last_accessed_block = NULL;
+    dxf->pool_size = pool_size;
+    dxf->stats.pool_bytes_peak = 0;
+    dxf->bounds_generation = 0;
 
-    if (dxf_add_layer(dxf, "0") == NULL) {
+    if (init_document(dxf) != 0) {
         errprint("dxf: dxf_init(): Failed to add default layer 0. \n");
-        crapool_destroy(dxf->pool);
+        dxf_arena_destroy(dxf->pool);
         return -1;
     }
     
@@ -100,19 +244,70 @@ int dxf_init(struct dxf* const dxf, size_t pool_size)
 int dxf_free(struct dxf* const dxf)
 {
     if (dxf->pool != NULL) {
-        crapool_destroy(dxf->pool);
+        dxf_arena_destroy(dxf->pool);
     }
 
     hashtable_destroy(&(dxf->header));
     
     dxf->pool = NULL;
+    dxf->pool_size = 0;
+    memset(&(dxf->stats), 0, sizeof(struct dxf_stats));
     dxf->layers = NULL;
     dxf->last_accessed_layer = NULL;
+    dxf->layer_index = NULL;
+    dxf->layer_index_size = 0;
     dxf->blocks = NULL;
     dxf->last_accessed_block = NULL;
+    dxf->first_entity = NULL;
+    dxf->last_entity = NULL;
+    dxf->number_of_entities = 0;
+    dxf->thumbnail = NULL;
+    dxf->thumbnail_size = 0;
     return 0;
 }
 
+/* Empties the document so that the struct can take the next file. The
+ * pool keeps its chunks, so parsing a run of files does not go back to
+ * the system allocator once the pool has grown to fit the largest one.
+ * A non-zero pool_size additionally makes sure that much is reserved.
+ */
+int dxf_reset(struct dxf* const dxf, size_t pool_size)
+{
+    hashtable_destroy(&(dxf->header));
+    if (init_header(dxf) != 0) {
+        errprint("dxf: dxf_reset(): Failed to create header. \n");
+        return -1;
+    }
+
+    dxf_arena_reset(dxf->pool);
+
+    if ((pool_size > 0) && (dxf_arena_reserve(dxf->pool, pool_size) != 0)) {
+        errprint("dxf: dxf_reset(): Failed to reserve pool space. \n");
+        return -1;
+    }
+
+    if (pool_size > dxf->pool_size) {
+        dxf->pool_size = pool_size;
+    }
+
+    if (init_document(dxf) != 0) {
+        errprint("dxf: dxf_reset(): Failed to add default layer 0. \n");
+        return -1;
+    }
+
+    dbgprint("dxf: dxf_reset(): Reset dxf struct @0x%lx, pool_size=%zu. \n",
+            (unsigned long)dxf, pool_size);
+
+    return 0;
+}
+
+size_t dxf_estimate_pool_size(size_t input_len)
+{
+    size_t size = input_len / DXF_POOL_TEXT_BYTES_PER_ENTITY * DXF_POOL_BYTES_PER_ENTITY;
+
+    return size < DXF_POOL_MIN_SIZE ? DXF_POOL_MIN_SIZE : size;
+}
+
 struct dxf_container* dxf_add_container(struct dxf* const dxf, const char *name, 
                                         struct dxf_layer* parent_layer, int type)
 {
@@ -136,18 +331,25 @@ struct dxf_container* dxf_add_container(struct dxf* const dxf, const char *name,
         return NULL;
     }
 
-    if ((container = (struct dxf_container*)crapool_alloc(dxf->pool, sizeof(struct dxf_container))) == NULL) {
+    if ((container = (struct dxf_container*)dxf_arena_alloc(dxf->pool, sizeof(struct dxf_container))) == NULL) {
         errprint("dxf: dxf_add_container(): Failed to allocate pool space for " \
                 "storing container struct. \n");
         return NULL;
     }
     
     memset(&(container->entities), 0, DXF_ENTITY_TYPES_COUNT * sizeof(struct dxf_entity*));
+    memset(&(container->entities_tail), 0, DXF_ENTITY_TYPES_COUNT * sizeof(struct dxf_entity*));
     memcpy(container_name, name, len + 1);
     container->type = type;
     *((char**)(&(container->name))) = container_name;
     container->flag = 0;
     container->x = container->y = container->z = 0.0;
+    container->bounds_generation = 0;
+    container->color = DXF_LAYER_DEFAULT_COLOR;
+    container->linetype = NULL;
+    container->handle = NULL;
+    count_pool_bytes(dxf, sizeof(struct dxf_container));
+    dxf->stats.container_bytes += sizeof(struct dxf_container);
 
     switch (type) {
         case DXF_LAYER:
@@ -156,6 +358,19 @@ struct dxf_container* dxf_add_container(struct dxf* const dxf, const char *name,
             dxf->layers = container;
             dxf->last_accessed_layer = container;
             container->parent = NULL;
+            ++(dxf->stats.number_of_layers);
+            if (dxf->layer_index == NULL) {
+                break;
+            }
+            if ((2 * dxf->stats.number_of_layers > dxf->layer_index_size)
+                && (dxf_reserve_layers(dxf, 0) != 0))
+            {
+                /* Lookups fall back to the list. */
+                dxf->layer_index = NULL;
+                dxf->layer_index_size = 0;
+                break;
+            }
+            index_layer(dxf, container);
             break;
         case DXF_BLOCK:
             head_old = dxf->blocks;
@@ -163,6 +378,7 @@ struct dxf_container* dxf_add_container(struct dxf* const dxf, const char *name,
             dxf->blocks = container;
             dxf->last_accessed_block = container;
             container->parent = (struct dxf_container*)parent_layer;
+            ++(dxf->stats.number_of_blocks);
             break;
         default:
             errprint("dxf: dxf_add_container(): Bad container type %d. Control flow was messed up. \n", type);
@@ -181,6 +397,8 @@ struct dxf_container* dxf_get_container(struct dxf* const dxf, const char *name,
     struct dxf_container *container;
     struct dxf_container *head;
     struct dxf_container **specific_last_accessed_container;
+    size_t mask;
+    size_t i;
 
     switch (type) {
         case DXF_LAYER:
@@ -208,6 +426,18 @@ struct dxf_container* dxf_get_container(struct dxf* const dxf, const char *name,
         return container;
     }
 
+    if ((type == DXF_LAYER) && (dxf->layer_index != NULL)) {
+        mask = dxf->layer_index_size - 1;
+        for (i = str_hash(&name) & mask; dxf->layer_index[i] != NULL; i = (i + 1) & mask) {
+            if (strcmp(dxf->layer_index[i]->name, name) == 0) {
+                dxf->last_accessed_layer = dxf->layer_index[i];
+                return dxf->layer_index[i];
+            }
+        }
+        dbgprint("dxf: dxf_get_container(): Layer %s not in the index. \n", name);
+        return NULL;
+    }
+
     for (container = head; container != NULL; container = container->next) {
         if (strcmp(container->name, name) == 0) {
             *specific_last_accessed_container = container;
@@ -223,6 +453,58 @@ struct dxf_container* dxf_get_container(struct dxf* const dxf, const char *name,
     return NULL;
 }
 
+/* Linear probing; the index is kept at most half full. Indexing a layer
+ * twice leaves it in once.
+ */
+static void index_layer(struct dxf* const dxf, struct dxf_layer* const layer)
+{
+    const size_t mask = dxf->layer_index_size - 1;
+    const char *name = layer->name;
+    size_t i;
+
+    for (i = str_hash(&name) & mask; dxf->layer_index[i] != NULL; i = (i + 1) & mask) {
+        if (dxf->layer_index[i] == layer) {
+            return;
+        }
+    }
+    dxf->layer_index[i] = layer;
+}
+
+/* Sizes the layer index for count more layers than there are, e.g. from
+ * the LAYER table header, and from then on finds layers by name through
+ * it. The index grows by itself as layers are added.
+ */
+int dxf_reserve_layers(struct dxf* const dxf, size_t count)
+{
+    struct dxf_layer **index;
+    struct dxf_layer *layer;
+    size_t size = DXF_LAYER_INDEX_MIN_SIZE;
+
+    count += dxf->stats.number_of_layers;
+    while (size < 2 * count) {
+        size *= 2;
+    }
+    if (size <= dxf->layer_index_size) {
+        return 0;
+    }
+
+    if ((index = (struct dxf_layer**)dxf_arena_calloc(dxf->pool, size, sizeof(struct dxf_layer*))) == NULL) {
+        errprint("dxf: dxf_reserve_layers(): Failed to allocate an index of %lu layers. \n",
+                (unsigned long)size);
+        return -1;
+    }
+    count_pool_bytes(dxf, size * sizeof(struct dxf_layer*));
+    dxf->stats.container_bytes += size * sizeof(struct dxf_layer*);
+
+    dxf->layer_index = index;
+    dxf->layer_index_size = size;
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        index_layer(dxf, layer);
+    }
+
+    return 0;
+}
+
 int dxf_add_entity(struct dxf* const dxf, const char* container_name,
                     struct dxf_entity* entity, int behaviour)
 {
@@ -266,9 +548,15 @@ int dxf_add_entity(struct dxf* const dxf, const char* container_name,
 
     switch (behaviour) {
         case DXF_ADD_ENTITY_TO_LAYER:
+            if (entity->layer == container) {
+                return 0;
+            }
             entity->layer = container;
             break;
         case DXF_ADD_ENTITY_TO_BLOCK:
+            if (entity->block == container) {
+                return 0;
+            }
             entity->block = container;
             break;
         default:
@@ -276,8 +564,39 @@ int dxf_add_entity(struct dxf* const dxf, const char* container_name,
             return -1;
     }
 
-    entity->next = container->entities[entity_type];
-    container->entities[entity_type] = entity;
+    /* Append so that per-container lists keep file order. Block lists
+     * have their own link since block entities are on a layer list too.
+     */
+    if (container_type == DXF_BLOCK) {
+        entity->next_in_block = NULL;
+        if (container->entities_tail[entity_type] != NULL) {
+            container->entities_tail[entity_type]->next_in_block = entity;
+        }
+        else {
+            container->entities[entity_type] = entity;
+        }
+    }
+    else {
+        entity->next = NULL;
+        if (container->entities_tail[entity_type] != NULL) {
+            container->entities_tail[entity_type]->next = entity;
+        }
+        else {
+            container->entities[entity_type] = entity;
+        }
+    }
+    container->entities_tail[entity_type] = entity;
+
+    if (entity->seq == 0) {
+        entity->seq = ++(dxf->number_of_entities);
+        if (dxf->last_entity != NULL) {
+            dxf->last_entity->next_in_file = entity;
+        }
+        else {
+            dxf->first_entity = entity;
+        }
+        dxf->last_entity = entity;
+    }
     
     dbgprint("dxf: dxf_add_entity(): Added entity @0x%lx (type=%d) to " \
                 "container @0x%lx (name=%s, type=%d). \n",
@@ -287,24 +606,147 @@ int dxf_add_entity(struct dxf* const dxf, const char* container_name,
     return 0;
 }
 
+static int compare_layers(const void *p1, const void *p2)
+{
+    const struct dxf_layer *l1 = *(const struct dxf_layer* const*)p1;
+    const struct dxf_layer *l2 = *(const struct dxf_layer* const*)p2;
+
+    return (l1 < l2) ? -1 : (l1 > l2);
+}
+
+static int is_relinked(struct dxf_layer** const layers, size_t number_of_layers,
+                        const struct dxf_layer* const layer)
+{
+    return (layers == NULL)
+        || (bsearch(&layer, layers, number_of_layers, sizeof(struct dxf_layer*), compare_layers) != NULL);
+}
+
+/* Rebuilds file order after keep (from the start if keep is NULL) out of
+ * entities[], and the per-type lists of the given layers to match; all
+ * layers if layers is NULL, which is sorted in place otherwise. Lists of
+ * other layers must already be in file order. Entities left out are only
+ * unlinked; their pool space is not reclaimed. Entities up to keep and
+ * block contents are not touched.
+ */
+int dxf_relink_entities(struct dxf* const dxf, struct dxf_entity* const keep,
+                        struct dxf_entity** const entities, size_t count,
+                        struct dxf_layer** const layers, size_t number_of_layers)
+{
+    struct dxf_layer *layer;
+    struct dxf_entity *entity;
+    struct dxf_entity *tail;
+    size_t keep_seq = (keep != NULL) ? keep->seq : 0;
+    size_t i;
+    int type;
+
+    /* Cached bounds are indexed by seq, which is about to change. */
+    if (++(dxf->bounds_generation) == 0) {
+        dxf->bounds_generation = 1;
+    }
+
+    if (layers != NULL) {
+        qsort(layers, number_of_layers, sizeof(struct dxf_layer*), compare_layers);
+    }
+
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        if (!is_relinked(layers, number_of_layers, layer)) {
+            continue;
+        }
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            tail = NULL;
+            for (entity = layer->entities[type];
+                (entity != NULL) && (entity->seq != 0) && (entity->seq <= keep_seq);
+                entity = entity->next)
+            {
+                tail = entity;
+            }
+            layer->entities_tail[type] = tail;
+            if (tail == NULL) {
+                layer->entities[type] = NULL;
+            }
+            else {
+                tail->next = NULL;
+            }
+        }
+    }
+
+    if (keep != NULL) {
+        keep->next_in_file = NULL;
+        dxf->last_entity = keep;
+    }
+    else {
+        dxf->first_entity = NULL;
+        dxf->last_entity = NULL;
+    }
+    dxf->number_of_entities = keep_seq;
+
+    for (i = 0; i < count; ++i) {
+        entity = entities[i];
+        entity->seq = ++(dxf->number_of_entities);
+        entity->next_in_file = NULL;
+        if (dxf->last_entity != NULL) {
+            dxf->last_entity->next_in_file = entity;
+        }
+        else {
+            dxf->first_entity = entity;
+        }
+        dxf->last_entity = entity;
+
+        if (((layer = entity->layer) != NULL) && is_relinked(layers, number_of_layers, layer)) {
+            type = entity->type;
+            entity->next = NULL;
+            if (layer->entities_tail[type] != NULL) {
+                layer->entities_tail[type]->next = entity;
+            }
+            else {
+                layer->entities[type] = entity;
+            }
+            layer->entities_tail[type] = entity;
+        }
+    }
+
+    return 0;
+}
+
+int dxf_get_stats(struct dxf* const dxf, struct dxf_stats* const stats)
+{
+    struct dxf_arena_stats arena_stats;
+
+    memcpy(stats, &(dxf->stats), sizeof(struct dxf_stats));
+
+    if ((dxf->pool != NULL) && (dxf_arena_get_stats(dxf->pool, &arena_stats) == 0)) {
+        stats->pool_bytes_reserved = arena_stats.bytes_reserved;
+    }
+
+    return 0;
+}
+
 void* dxf_alloc_binary(struct dxf* const dxf, size_t size)
 {
-    void *buf = crapool_alloc(dxf->pool, size);
+    void *buf = dxf_arena_alloc(dxf->pool, size);
 
     if (buf == NULL) {
         errprint("dxf: dxf_alloc_binary(): Allocation failed. size=%zu \n", size);
     }
+    else {
+        count_pool_bytes(dxf, size);
+        dxf->stats.binary_bytes += size;
+    }
 
     return buf;
 }
 
 char* dxf_alloc_string(struct dxf* const dxf, size_t len)
 {
-    char *str = crapool_calloc(dxf->pool, 1, len + 2);
+    char *str = dxf_arena_calloc(dxf->pool, 1, len + 2);
 
     if (str == NULL) {
         errprint("dxf: dxf_alloc_string(): String buffer allocation failed. size=%zu \n", len);
     }
+    else {
+        count_pool_bytes(dxf, len + 2);
+        dxf->stats.string_bytes += len + 2;
+    }
 
     return str;
 }
@@ -333,18 +775,49 @@ struct dxf_entity* dxf_alloc_entity(struct dxf* const dxf, int entity_type)
         case DXF_INSERT:
             size = sizeof(struct dxf_insert);
             break;
+        case DXF_SPLINE:
+            size = sizeof(struct dxf_spline);
+            break;
+        case DXF_ELLIPSE:
+            size = sizeof(struct dxf_ellipse);
+            break;
+        case DXF_POLYLINE:
+            size = sizeof(struct dxf_polyline);
+            break;
+        case DXF_HATCH:
+            size = sizeof(struct dxf_hatch);
+            break;
+        case DXF_SOLID:
+            size = sizeof(struct dxf_solid);
+            break;
+        case DXF_DIMENSION:
+            size = sizeof(struct dxf_dimension);
+            break;
+        case DXF_TEXTSTRING:
+            size = sizeof(struct dxf_text);
+            break;
+        case DXF_MTEXT:
+            size = sizeof(struct dxf_mtext);
+            break;
         default:
             errprint("dxf: dxf_alloc_entity(): Could not allocate space " \
                     "for entity type %d. \n", entity_type);
             return NULL;
     }
     
-    if ((entity = (struct dxf_entity*)crapool_alloc(dxf->pool, size)) != NULL) {
+    if ((entity = (struct dxf_entity*)dxf_arena_alloc(dxf->pool, size)) != NULL) {
+        count_pool_bytes(dxf, size);
+        ++(dxf->stats.entity_counts[entity_type]);
+        dxf->stats.entity_bytes[entity_type] += size;
         *((int*)(&(entity->type))) = entity_type;
         *((size_t*)(&(entity->size))) = size;
         entity->layer = NULL;
         entity->block = NULL;
         entity->next = NULL;
+        entity->next_in_block = NULL;
+        entity->next_in_file = NULL;
+        entity->seq = 0;
+        entity->xdata = NULL;
         entity->user_data = NULL;
         init_entity(entity);
     }
@@ -354,3 +827,90 @@ struct dxf_entity* dxf_alloc_entity(struct dxf* const dxf, int entity_type)
                 (unsigned long)entity, entity_type, entity->size);
     return entity;
 }
+
+static int entity_iter_match(const struct dxf_entity_iter* const iter,
+                            const struct dxf_entity* const entity)
+{
+    if ((iter->type_mask & DXF_ENTITY_TYPE_BIT(entity->type)) == 0) {
+        return 0;
+    }
+
+    if ((iter->layer != NULL) && (entity->layer != iter->layer)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+int dxf_entity_iter_init(struct dxf_entity_iter* const iter, struct dxf* const dxf,
+                        const char *layer_name, unsigned int type_mask)
+{
+    int type;
+
+    iter->cur = NULL;
+    iter->layer = NULL;
+    iter->type_mask = type_mask & DXF_ALL_ENTITY_TYPES;
+    iter->per_container = 0;
+
+    if (layer_name != NULL) {
+        if ((iter->layer = dxf_get_layer(dxf, layer_name)) == NULL) {
+            dbgprint("dxf: dxf_entity_iter_init(): Layer %s not found. \n", layer_name);
+            return -1;
+        }
+    }
+
+    /* One layer and one type: the container list already holds exactly
+     * those entities in file order, no need to walk the whole document.
+     */
+    if ((iter->layer != NULL) && (iter->type_mask != 0) 
+        && ((iter->type_mask & (iter->type_mask - 1)) == 0))
+    {
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            if (iter->type_mask == DXF_ENTITY_TYPE_BIT(type)) {
+                iter->cur = iter->layer->entities[type];
+                iter->per_container = 1;
+                return 0;
+            }
+        }
+    }
+
+    iter->cur = dxf->first_entity;
+    return 0;
+}
+
+struct dxf_entity* dxf_entity_iter_next(struct dxf_entity_iter* const iter)
+{
+    struct dxf_entity *entity;
+
+    if (iter->per_container != 0) {
+        while ((entity = iter->cur) != NULL) {
+            iter->cur = entity->next;
+            if (entity_iter_match(iter, entity)) {
+                return entity;
+            }
+        }
+        return NULL;
+    }
+
+    while ((entity = iter->cur) != NULL) {
+        iter->cur = entity->next_in_file;
+        if (entity_iter_match(iter, entity)) {
+            return entity;
+        }
+    }
+
+    return NULL;
+}
+
+size_t dxf_entity_iter_next_chunk(struct dxf_entity_iter* const iter,
+                        struct dxf_entity **chunk, size_t max_count)
+{
+    size_t count = 0;
+    struct dxf_entity *entity;
+
+    while ((count < max_count) && ((entity = dxf_entity_iter_next(iter)) != NULL)) {
+        chunk[count++] = entity;
+    }
+
+    return count;
+}
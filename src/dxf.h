@@ -2,7 +2,7 @@
 #define __DXF_H__
 
 #include "hashtab.h"
-#include "crapool.h"
+#include "dxfarena.h"
 
 #define DXF_LAYER 0
 #define DXF_BLOCK 1
@@ -27,15 +27,71 @@
 #define DXF_ENTITY_TYPE_END 15
 #define DXF_ENTITY_TYPES_COUNT (DXF_ENTITY_TYPE_END + 1)
 
+#define DXF_ENTITY_TYPE_BIT(type) (1u << (type))
+#define DXF_ALL_ENTITY_TYPES ((1u << DXF_ENTITY_TYPES_COUNT) - 1)
+
 #define DXF_LWPOLYLINE_FLAG_DEFAULT 0
 #define DXF_LWPOLYLINE_FLAG_CLOSED 1
 #define DXF_LWPOLYLINE_FLAG_PLINEGEN 128
 
+#define DXF_POLYLINE_FLAG_CLOSED 1
+#define DXF_POLYLINE_FLAG_CURVE_FIT 2
+#define DXF_POLYLINE_FLAG_SPLINE_FIT 4
+#define DXF_POLYLINE_FLAG_3D 8
+#define DXF_POLYLINE_FLAG_MESH 16
+#define DXF_POLYLINE_FLAG_MESH_CLOSED_N 32
+#define DXF_POLYLINE_FLAG_POLYFACE 64
+#define DXF_POLYLINE_FLAG_PLINEGEN 128
+
+#define DXF_VERTEX_FLAG_CURVE_FIT 1
+#define DXF_VERTEX_FLAG_TANGENT 2
+#define DXF_VERTEX_FLAG_SPLINE_FIT 8
+#define DXF_VERTEX_FLAG_SPLINE_FRAME 16
+#define DXF_VERTEX_FLAG_3D 32
+#define DXF_VERTEX_FLAG_MESH 64
+#define DXF_VERTEX_FLAG_POLYFACE 128
+
+#define DXF_HATCH_LOOP_FLAG_EXTERNAL 1
+#define DXF_HATCH_LOOP_FLAG_POLYLINE 2
+#define DXF_HATCH_LOOP_FLAG_DERIVED 4
+#define DXF_HATCH_LOOP_FLAG_TEXTBOX 8
+#define DXF_HATCH_LOOP_FLAG_OUTERMOST 16
+
+#define DXF_HATCH_EDGE_LINE 1
+#define DXF_HATCH_EDGE_ARC 2
+#define DXF_HATCH_EDGE_ELLIPSE 3
+#define DXF_HATCH_EDGE_SPLINE 4
+
 #define DXF_ADD_ENTITY_TO_LAYER 0
 #define DXF_ADD_ENTITY_TO_BLOCK 1
 
+/* LAYER table flags (group 70). A layer is off when its color is negative. */
+#define DXF_LAYER_FROZEN 1
+#define DXF_LAYER_LOCKED 4
+
+#define DXF_LAYER_DEFAULT_COLOR 7
+
+/* Pool pre-sizing heuristic: an entity takes roughly this many bytes of
+ * DXF text and this many bytes of pool space once parsed.
+ */
+#define DXF_POOL_TEXT_BYTES_PER_ENTITY 160
+#define DXF_POOL_BYTES_PER_ENTITY 112
+#define DXF_POOL_MIN_SIZE 4096
+
+/* Pool flags */
+#define DXF_POOL_DEFAULT DXF_ARENA_DEFAULT
+#define DXF_POOL_HUGE_PAGES DXF_ARENA_HUGE_PAGES
+
 struct dxf_entity;
 struct dxf_container;
+struct dxf_bounds_entry;
+struct dxf_xdata;
+
+/* Axis aligned box. Empty when min is above max (see dxfbounds.h). */
+struct dxf_bounds {
+    double min[3];
+    double max[3];
+};
 
 struct dxf_container {
     int type;
@@ -45,20 +101,76 @@ struct dxf_container {
     double y;
     double z;
     struct dxf_entity *entities[DXF_ENTITY_TYPES_COUNT];
+    struct dxf_entity *entities_tail[DXF_ENTITY_TYPES_COUNT];
     struct dxf_container *parent;
     struct dxf_container *next;
+    struct dxf_bounds bounds;
+    unsigned int bounds_generation;     /* Cached bounds valid if equal to the document's. */
+
+    /* Layers only, as read from the LAYER table. Layers that are only
+     * named by entities keep the defaults: DXF_LAYER_DEFAULT_COLOR and no
+     * linetype or handle.
+     */
+    int color;
+    const char *linetype;
+    const char *handle;
 };
 
 #define dxf_layer dxf_container
 #define dxf_block dxf_container
 
+/* Memory accounting of a document. Counters are bumped by the
+ * dxf_alloc_*() functions, dxf_get_stats() fills in the pool figures.
+ */
+struct dxf_stats {
+    size_t pool_bytes_reserved;
+    size_t pool_bytes_used;
+    size_t pool_bytes_peak;     /* Highest pool_bytes_used since dxf_init(). */
+    size_t entity_counts[DXF_ENTITY_TYPES_COUNT];
+    size_t entity_bytes[DXF_ENTITY_TYPES_COUNT];
+    size_t binary_bytes;        /* Vertices and other dxf_alloc_binary() data. */
+    size_t vertex_bytes;        /* Of that, LWPOLYLINE, POLYLINE and HATCH vertices. */
+    size_t string_bytes;
+    size_t container_bytes;
+    size_t number_of_layers;
+    size_t number_of_blocks;
+};
+
 struct dxf {
     struct hashtable header;
     struct dxf_layer *layers;
     struct dxf_layer *last_accessed_layer;
+    struct dxf_layer **layer_index;     /* Open addressed by name, NULL until dxf_reserve_layers(). */
+    size_t layer_index_size;
     struct dxf_block *blocks;
     struct dxf_block *last_accessed_block;
-    struct crapool_desc *pool;
+    struct dxf_arena *pool;
+    size_t pool_size;
+    struct dxf_stats stats;
+
+    /* All entities in the order they were added, i.e. file order when
+     * filled by the parser. Linked through dxf_entity::next_in_file.
+     */
+    struct dxf_entity *first_entity;
+    struct dxf_entity *last_entity;
+    size_t number_of_entities;
+
+    /* Cached bounds, see dxfbounds.h. Bumping bounds_generation drops
+     * every cached value at once.
+     */
+    unsigned int bounds_generation;
+    unsigned int document_bounds_generation;
+    struct dxf_bounds bounds;
+    struct dxf_bounds_entry *bounds_cache;  /* Indexed by entity seq, in the pool. */
+    size_t bounds_cache_size;
+    struct dxf_bounds extents_hint;         /* $EXTMIN/$EXTMAX as read, unchecked. */
+    int has_extents_hint;
+
+    /* The THUMBNAILIMAGE section decoded, a BMP or PNG file. NULL if the
+     * drawing has no preview.
+     */
+    const unsigned char *thumbnail;
+    size_t thumbnail_size;
 };
 
 struct dxf_entity {
@@ -67,9 +179,24 @@ struct dxf_entity {
     struct dxf_layer *layer;
     struct dxf_block *block;
     struct dxf_entity *next;
+    struct dxf_entity *next_in_block;
+    struct dxf_entity *next_in_file;
+    size_t seq;     /* 1-based position in file order, 0 if not added yet. */
+    struct dxf_xdata *xdata;    /* NULL without XDATA or an extension dictionary. */
     void *user_data;
 };
 
+/* Walks entities in file order, optionally restricted to one layer and
+ * a set of entity types (see DXF_ENTITY_TYPE_BIT()). The iterator lives
+ * on the caller's stack and never allocates.
+ */
+struct dxf_entity_iter {
+    struct dxf_entity *cur;
+    const struct dxf_layer *layer;
+    unsigned int type_mask;
+    int per_container;
+};
+
 struct dxf_point {
     struct dxf_entity header;
     double x;
@@ -77,13 +204,38 @@ struct dxf_point {
     double z;
 };
 
-struct dxf_vertex;
-struct dxf_vertex {
-    struct dxf_entity header;
+/* One VERTEX of a POLYLINE. Vertices are not entities of their own;
+ * each polyline keeps them in one array.
+ */
+struct dxf_polyline_vertex {
     double x;
     double y;
     double z;
-    struct dxf_vertex *next;
+    double bulge;               /* See struct dxf_lwpolyline_vertex. */
+    int flag;
+};
+
+/* A polyface mesh face: 1-based vertex indices, 0 where unused. A
+ * negative index hides the edge that starts at that vertex.
+ */
+struct dxf_polyline_face {
+    int vertices[4];
+};
+
+/* 2D polylines lie in their OCS at the given elevation, and every vertex
+ * z is set to it. 3D polylines and meshes are in world coordinates.
+ */
+struct dxf_polyline {
+    struct dxf_entity header;
+    int flag;
+    double elevation;
+    int m_count;                /* Group 71: mesh M size, or polyface vertex count. */
+    int n_count;                /* Group 72: mesh N size, or polyface face count. */
+    size_t number_of_vertices;
+    struct dxf_polyline_vertex *vertices;
+    size_t number_of_faces;
+    struct dxf_polyline_face *faces;
+    double extrusion[3];
 };
 
 struct dxf_line {
@@ -102,6 +254,7 @@ struct dxf_circle {
     double y;
     double z;
     double r;
+    double extrusion[3];    /* Normal of the OCS, see dxfocs.h. */
 };
 
 struct dxf_lwpolyline_vertex;
@@ -123,6 +276,7 @@ struct dxf_lwpolyline {
     struct dxf_entity header;
     size_t number_of_vertices;
     int flag;
+    double extrusion[3];
     struct dxf_lwpolyline_vertex *vertices;
     struct dxf_lwpolyline_vertex *tail_vertex;
 };
@@ -135,6 +289,196 @@ struct dxf_arc {
     double r;
     double angle_start;
     double angle_end;
+    double extrusion[3];
+};
+
+/* Unlike CIRCLE and ARC, the centre and the major axis are in world
+ * coordinates; the extrusion direction only orients the minor axis.
+ * Parameters are in radians, not angles: the point at t is centre +
+ * major * cos(t) + minor * sin(t).
+ */
+struct dxf_ellipse {
+    struct dxf_entity header;
+    double x;
+    double y;
+    double z;
+    double major[3];            /* End of the major axis, from the centre. */
+    double ratio;               /* Minor to major axis length. */
+    double param_start;
+    double param_end;
+    double extrusion[3];
+};
+
+/* HATCH boundaries are kept in a few flat arrays shared by all loops of
+ * the hatch. A polyline loop is vertices[first] up to first + count, any
+ * other loop edges[first] up to first + count. Everything lies in the
+ * OCS at the hatch elevation.
+ */
+struct dxf_hatch_loop {
+    int flag;
+    int closed;                 /* Polyline loops only. */
+    size_t first;
+    size_t count;
+};
+
+struct dxf_hatch_vertex {
+    double x;
+    double y;
+    double bulge;
+};
+
+struct dxf_hatch_edge {
+    int type;
+    int flag;                   /* Arcs, ellipses: counter-clockwise. Splines: rational. */
+    double x;                   /* Line start; arc or ellipse centre. */
+    double y;
+    double x2;                  /* Line end; ellipse major axis end, from the centre. */
+    double y2;
+    double r;                   /* Arc radius; ellipse minor to major ratio. */
+    double angle_start;         /* Degrees */
+    double angle_end;
+    int degree;                 /* Splines: knots[first_knot] on, and */
+    size_t first_knot;          /* control_points[first_control_point] on. */
+    size_t number_of_knots;
+    size_t first_control_point;
+    size_t number_of_control_points;
+};
+
+struct dxf_hatch_pattern_line {
+    double angle;
+    double x;
+    double y;
+    double dx;
+    double dy;
+    size_t first_dash;
+    size_t number_of_dashes;
+};
+
+struct dxf_hatch {
+    struct dxf_entity header;
+    const char *pattern_name;
+    int solid_fill;
+    int style;
+    int pattern_type;
+    double pattern_angle;
+    double pattern_scale;
+    double elevation;
+    double extrusion[3];
+    size_t number_of_loops;
+    struct dxf_hatch_loop *loops;
+    size_t number_of_vertices;
+    struct dxf_hatch_vertex *vertices;
+    size_t number_of_edges;
+    struct dxf_hatch_edge *edges;
+    size_t number_of_knots;
+    double *knots;
+    size_t number_of_control_points;
+    double *control_points;     /* x, y, weight triples */
+    size_t number_of_pattern_lines;     /* 0 when patterns are skipped. */
+    struct dxf_hatch_pattern_line *pattern_lines;
+    size_t number_of_dashes;
+    double *dashes;
+    size_t number_of_seeds;
+    double *seeds;              /* x, y pairs */
+};
+
+/* Corners in groups 10 to 13, in the OCS. The outline runs 0, 1, 3, 2;
+ * a triangle repeats its third corner.
+ */
+struct dxf_solid {
+    struct dxf_entity header;
+    double corners[4][3];
+    double extrusion[3];
+};
+
+/* One value of decoded XDATA. Points (1010-1013) take their 1020s and
+ * 1030s along; 1070 and 1071 are integers, 1040-1042 and the remaining
+ * coordinates floats, 1004 bytes and everything else a string.
+ */
+struct dxf_xdata_item {
+    unsigned int group_code;
+    union {
+        const char *str;
+        double f;
+        long i;
+        double point[3];
+        struct {
+            const unsigned char *data;  /* NULL if the chunk was not hex. */
+            size_t size;
+        } bin;
+    } value;
+};
+
+/* The items from one 1001 group up to the next, in xdata->items. */
+struct dxf_xdata_app {
+    const char *name;
+    size_t first;
+    size_t count;
+};
+
+/* XDATA runs from the first 1001 group to the end of the entity and is
+ * kept as that stretch of DXF text until dxfxdata.h decodes it.
+ */
+struct dxf_xdata {
+    const char *str;            /* Into the input unless copied, not NUL terminated. */
+    size_t length;
+    int copied;
+    const char *dictionary;     /* ACAD_XDICTIONARY handle, NULL if none. */
+    struct dxf_xdata_app *apps; /* NULL until decoded. */
+    size_t number_of_apps;
+    struct dxf_xdata_item *items;
+    size_t number_of_items;
+};
+
+/* Text bodies are kept as the raw group 3 chunks and group 1 value, in
+ * file order, pointing into the input. They are joined and decoded into
+ * string the first time it is asked for; see dxftext.h.
+ */
+struct dxf_text_span {
+    const char *str;            /* Not NUL terminated. */
+    size_t length;
+    struct dxf_text_span *next;
+};
+
+struct dxf_text_body {
+    struct dxf_text_span *spans;
+    size_t length;              /* Of all spans together. */
+    const char *string;         /* NULL until decoded. */
+};
+
+struct dxf_text {
+    struct dxf_entity header;
+    double x;
+    double y;
+    double z;
+    double height;
+    double angle;               /* Degrees */
+    double x_scale;
+    double oblique;             /* Degrees */
+    double x2;                  /* Alignment point, used unless both */
+    double y2;                  /* justifications are 0. */
+    double z2;
+    int generation;
+    int horizontal_justification;
+    int vertical_justification;
+    double extrusion[3];
+    struct dxf_text_body body;
+};
+
+struct dxf_mtext {
+    struct dxf_entity header;
+    double x;
+    double y;
+    double z;
+    double height;
+    double width;               /* Of the reference rectangle. */
+    double angle;               /* Degrees, unless direction is given. */
+    double direction[3];        /* X axis, WCS. */
+    double line_spacing;
+    int attachment;
+    int drawing_direction;
+    double extrusion[3];
+    struct dxf_text_body body;
 };
 
 struct dxf_insert {
@@ -150,6 +494,45 @@ struct dxf_insert {
     int row_count;
     double column_spacing;
     double row_spacing;
+    double extrusion[3];
+    struct dxf_block *block_ref;    /* Inserted block, header.block may be the owner. */
+};
+
+/* A DIMENSION draws the anonymous block named in group 2 at the origin,
+ * so it starts as an INSERT of that block and anything that expands or
+ * bounds INSERTs renders it as well. header.block is only ever the owner.
+ */
+struct dxf_dimension {
+    struct dxf_insert insert;
+    int type;                       /* Group 70 */
+    double definition[3];           /* WCS */
+    double text_midpoint[3];        /* OCS */
+    double points[4][3];            /* Groups 13 to 16, WCS */
+    double measurement;
+    double angle;                   /* Degrees, rotated linear dimensions. */
+};
+
+/* Spline flags */
+#define DXF_SPLINE_FLAG_CLOSED 1
+#define DXF_SPLINE_FLAG_PERIODIC 2
+#define DXF_SPLINE_FLAG_RATIONAL 4
+#define DXF_SPLINE_FLAG_PLANAR 8
+
+/* Arrays are sized from the counts in groups 72 to 74; the number_of_*
+ * members count what was actually read, never more than announced.
+ * Points are stored as x, y, z triples.
+ */
+struct dxf_spline {
+    struct dxf_entity header;
+    int flag;
+    int degree;
+    size_t number_of_knots;
+    size_t number_of_control_points;
+    size_t number_of_fit_points;
+    double *knots;
+    double *control_points;
+    double *weights;            /* NULL unless the file gives weights. */
+    double *fit_points;
 };
 
 #ifdef __cplusplus
@@ -157,21 +540,36 @@ extern "C" {
 #endif
     
 int dxf_init(struct dxf* const dxf, size_t pool_size);
+int dxf_init_ex(struct dxf* const dxf, size_t pool_size, int pool_flags);
 int dxf_free(struct dxf* const dxf);
+int dxf_reset(struct dxf* const dxf, size_t pool_size);
+size_t dxf_estimate_pool_size(size_t input_len);
 struct dxf_container* dxf_add_container(struct dxf* const dxf, const char *name, 
                                         struct dxf_layer* parent_layer, int type);
 struct dxf_container* dxf_get_container(struct dxf* const dxf, const char *name, int type);
+int dxf_reserve_layers(struct dxf* const dxf, size_t count);
 
 int dxf_add_entity(struct dxf* const dxf, const char* container_name,
                     struct dxf_entity* entity, int behaviour);
+int dxf_relink_entities(struct dxf* const dxf, struct dxf_entity* const keep,
+                        struct dxf_entity** const entities, size_t count,
+                        struct dxf_layer** const layers, size_t number_of_layers);
 void* dxf_alloc_binary(struct dxf* const dxf, size_t size);
 char* dxf_alloc_string(struct dxf* const dxf, size_t len);
 struct dxf_entity* dxf_alloc_entity(struct dxf* const dxf, int entity_type);
+int dxf_get_stats(struct dxf* const dxf, struct dxf_stats* const stats);
+
+int dxf_entity_iter_init(struct dxf_entity_iter* const iter, struct dxf* const dxf,
+                        const char *layer_name, unsigned int type_mask);
+struct dxf_entity* dxf_entity_iter_next(struct dxf_entity_iter* const iter);
+size_t dxf_entity_iter_next_chunk(struct dxf_entity_iter* const iter,
+                        struct dxf_entity **chunk, size_t max_count);
 
 #define dxf_add_layer(dxf, name) dxf_add_container(dxf, name, NULL, DXF_LAYER)
 #define dxf_add_block(dxf, name, layer) dxf_add_container(dxf, name, layer, DXF_BLOCK)
 #define dxf_get_layer(dxf, name) dxf_get_container(dxf, name, DXF_LAYER)
 #define dxf_get_block(dxf, name) dxf_get_container(dxf, name, DXF_BLOCK)
+#define dxf_layer_is_hidden(layer) ((((layer)->flag & DXF_LAYER_FROZEN) != 0) || ((layer)->color < 0))
 
 #ifdef __cplusplus
 }
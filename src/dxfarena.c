@@ -0,0 +1,528 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dxfarena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#if defined(USE_PTHREAD)
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include "dbgprint.h"
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#endif
+
+#if defined(USE_PTHREAD)
+typedef pthread_mutex_t arena_lock_t;
+#define arena_lock_init(lock) pthread_mutex_init((lock), NULL)
+#define arena_lock_destroy(lock) pthread_mutex_destroy(lock)
+#define arena_lock(lock) pthread_mutex_lock(lock)
+#define arena_unlock(lock) pthread_mutex_unlock(lock)
+#elif defined(_WIN32)
+typedef CRITICAL_SECTION arena_lock_t;
+#define arena_lock_init(lock) InitializeCriticalSection(lock)
+#define arena_lock_destroy(lock) DeleteCriticalSection(lock)
+#define arena_lock(lock) EnterCriticalSection(lock)
+#define arena_unlock(lock) LeaveCriticalSection(lock)
+#else
+typedef int arena_lock_t;
+#define arena_lock_init(lock) ((void)(lock))
+#define arena_lock_destroy(lock) ((void)(lock))
+#define arena_lock(lock) ((void)(lock))
+#define arena_unlock(lock) ((void)(lock))
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define CHUNK_DATA_ALIGNMENT 16
+#define SHARED_SLOT DXF_ARENA_MAX_THREADS
+
+#define ALIGN_UP(n, a) (((n) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+#define CHUNK_HEADER_SIZE ALIGN_UP(sizeof(struct arena_chunk), CHUNK_DATA_ALIGNMENT)
+
+/* Chunk kinds. Either kind is cut from a reservation when one has room,
+ * else malloc'ed; both are kept across resets.
+ */
+#define CHUNK_STANDARD 1    /* Regions of small blocks. */
+#define CHUNK_DEDICATED 2   /* One large block, kept by size. */
+
+struct arena_chunk;
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    int kind;
+    int carved;             /* Part of a reservation, not malloc'ed. */
+    char *data;
+};
+
+struct arena_reservation;
+struct arena_reservation {
+    struct arena_reservation *next;
+    char *base;
+    size_t size;
+    size_t used;
+    int mapped;
+};
+
+struct arena_region {
+    char *cur;
+    char *end;
+};
+
+struct arena_slot {
+    const void *owner;      /* Thread marker of the thread using it, or NULL. */
+    struct arena_region regions[DXF_ARENA_CLASS_COUNT];
+    size_t counts[DXF_ARENA_CLASS_COUNT];
+    size_t bytes[DXF_ARENA_CLASS_COUNT];
+};
+
+struct dxf_arena {
+    int flags;
+    size_t chunk_size;
+    size_t bytes_reserved;
+    size_t number_of_chunks;
+    struct arena_chunk *chunks;
+    struct arena_chunk *free_chunks;
+    struct arena_chunk *free_blocks;        /* Dedicated chunks, smallest first. */
+    struct arena_reservation *reservations;
+    arena_lock_t lock;
+
+    /* One slot per thread so that the hot path never takes the lock,
+     * plus a locked slot shared by every thread that has no slot. Slots
+     * are claimed by threads of this arena and given up on reset.
+     */
+    struct arena_slot slots[DXF_ARENA_MAX_THREADS + 1];
+};
+
+#ifdef THREAD_LOCAL
+/* Its address tells threads apart. The slot last used is remembered
+ * along with its arena so the lookup is one compare on the hot path.
+ */
+static THREAD_LOCAL char thread_marker;
+static THREAD_LOCAL struct dxf_arena *thread_arena = NULL;
+static THREAD_LOCAL int thread_slot = SHARED_SLOT;
+#endif
+
+static int get_thread_slot(struct dxf_arena* const arena);
+static struct arena_reservation* reserve_memory(size_t size, int flags);
+static void release_reservation(struct arena_reservation* const reservation);
+static struct arena_chunk* carve_chunk(struct dxf_arena* const arena, size_t size);
+static struct arena_chunk* get_chunk(struct dxf_arena* const arena, size_t size, int kind);
+static void* slot_alloc(struct dxf_arena* const arena, struct arena_slot* const slot,
+                        size_t cls, size_t size, int locked);
+
+static int get_thread_slot(struct dxf_arena* const arena)
+{
+#ifdef THREAD_LOCAL
+    const void *marker = &thread_marker;
+    int i;
+
+    if ((thread_arena == arena) && (arena->slots[thread_slot].owner == marker)) {
+        return thread_slot;
+    }
+
+    /* The slot this thread had, else the first free one. */
+    arena_lock(&(arena->lock));
+    for (i = 0; i < DXF_ARENA_MAX_THREADS; ++i) {
+        if (arena->slots[i].owner == marker) {
+            break;
+        }
+    }
+    if (i == DXF_ARENA_MAX_THREADS) {
+        i = 0;
+        while ((i < DXF_ARENA_MAX_THREADS) && (arena->slots[i].owner != NULL)) {
+            ++i;
+        }
+        if (i < DXF_ARENA_MAX_THREADS) {
+            arena->slots[i].owner = marker;
+        }
+    }
+    arena_unlock(&(arena->lock));
+
+    thread_arena = arena;
+    thread_slot = i < DXF_ARENA_MAX_THREADS ? i : SHARED_SLOT;
+
+    return thread_slot;
+#else
+    (void)arena;
+    return SHARED_SLOT;
+#endif
+}
+
+static struct arena_reservation* reserve_memory(size_t size, int flags)
+{
+    struct arena_reservation *reservation;
+    void *base = NULL;
+
+    if ((reservation = (struct arena_reservation*)malloc(sizeof(struct arena_reservation))) == NULL) {
+        return NULL;
+    }
+
+    reservation->next = NULL;
+    reservation->used = 0;
+    reservation->mapped = 0;
+
+#ifdef __linux__
+    if ((flags & DXF_ARENA_HUGE_PAGES) != 0) {
+        size = ALIGN_UP(size, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            base = NULL;
+        }
+#endif
+        if (base == NULL) {
+            /* No pre-allocated huge pages, ask for transparent ones. */
+            base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED) {
+                base = NULL;
+            }
+#ifdef MADV_HUGEPAGE
+            else {
+                madvise(base, size, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        reservation->mapped = base != NULL ? 1 : 0;
+    }
+#endif
+
+    if ((base == NULL) && ((base = malloc(size)) == NULL)) {
+        free(reservation);
+        return NULL;
+    }
+
+    reservation->base = (char*)base;
+    reservation->size = size;
+
+    dbgprint("dxfarena: reserve_memory(): Reserved %zu bytes @0x%lx, mapped=%d. \n",
+            size, (unsigned long)base, reservation->mapped);
+
+    return reservation;
+}
+
+static void release_reservation(struct arena_reservation* const reservation)
+{
+#ifdef __linux__
+    if (reservation->mapped != 0) {
+        munmap(reservation->base, reservation->size);
+        free(reservation);
+        return;
+    }
+#endif
+
+    free(reservation->base);
+    free(reservation);
+}
+
+/* From the first reservation with room for it, NULL if none has. */
+static struct arena_chunk* carve_chunk(struct dxf_arena* const arena, size_t size)
+{
+    struct arena_chunk *chunk;
+    struct arena_reservation *reservation;
+    size_t total = CHUNK_HEADER_SIZE + size;
+
+    for (reservation = arena->reservations; reservation != NULL; reservation = reservation->next) {
+        if (reservation->size - reservation->used >= total) {
+            chunk = (struct arena_chunk*)(reservation->base + reservation->used);
+            reservation->used += total;
+            chunk->size = size;
+            chunk->carved = 1;
+            return chunk;
+        }
+    }
+
+    return NULL;
+}
+
+/* Must be called with the arena lock held. */
+static struct arena_chunk* get_chunk(struct dxf_arena* const arena, size_t size, int kind)
+{
+    struct arena_chunk *chunk = NULL;
+    struct arena_chunk **link;
+    size_t total = CHUNK_HEADER_SIZE + size;
+
+    if (kind == CHUNK_STANDARD) {
+        if ((chunk = arena->free_chunks) != NULL) {
+            arena->free_chunks = chunk->next;
+        }
+    }
+    else {
+        /* A kept block up to twice the size will do. */
+        for (link = &(arena->free_blocks); *link != NULL; link = &((*link)->next)) {
+            if ((*link)->size >= size) {
+                if ((*link)->size <= 2 * size) {
+                    chunk = *link;
+                    *link = chunk->next;
+                }
+                break;
+            }
+        }
+    }
+
+    if ((chunk == NULL) && ((chunk = carve_chunk(arena, size)) == NULL)) {
+        if ((chunk = (struct arena_chunk*)malloc(total)) == NULL) {
+            errprint("dxfarena: get_chunk(): Failed to allocate chunk of %zu bytes. \n", size);
+            return NULL;
+        }
+        chunk->size = size;
+        chunk->carved = 0;
+        arena->bytes_reserved += total;
+    }
+
+    chunk->kind = kind;
+    chunk->data = (char*)chunk + CHUNK_HEADER_SIZE;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    ++(arena->number_of_chunks);
+
+    return chunk;
+}
+
+static void* slot_alloc(struct dxf_arena* const arena, struct arena_slot* const slot,
+                        size_t cls, size_t size, int locked)
+{
+    struct arena_region *region = &(slot->regions[cls]);
+    struct arena_chunk *chunk;
+    char *ptr;
+
+    if ((size_t)(region->end - region->cur) < size) {
+        if (!locked) {
+            arena_lock(&(arena->lock));
+        }
+        if (size > arena->chunk_size / 4) {
+            chunk = get_chunk(arena, size, CHUNK_DEDICATED);
+            if (!locked) {
+                arena_unlock(&(arena->lock));
+            }
+            if (chunk == NULL) {
+                return NULL;
+            }
+            ++(slot->counts[cls]);
+            slot->bytes[cls] += size;
+            return chunk->data;
+        }
+        chunk = get_chunk(arena, arena->chunk_size, CHUNK_STANDARD);
+        if (!locked) {
+            arena_unlock(&(arena->lock));
+        }
+        if (chunk == NULL) {
+            return NULL;
+        }
+        region->cur = chunk->data;
+        region->end = chunk->data + chunk->size;
+    }
+
+    ptr = region->cur;
+    region->cur += size;
+    ++(slot->counts[cls]);
+    slot->bytes[cls] += size;
+
+    return ptr;
+}
+
+struct dxf_arena* dxf_arena_create(size_t reserve_size, int flags)
+{
+    struct dxf_arena *arena;
+
+    if ((arena = (struct dxf_arena*)malloc(sizeof(struct dxf_arena))) == NULL) {
+        errprint("dxfarena: dxf_arena_create(): Failed to allocate arena. \n");
+        return NULL;
+    }
+
+    memset(arena, 0, sizeof(struct dxf_arena));
+    arena->flags = flags;
+    arena->chunk_size = DXF_ARENA_CHUNK_SIZE;
+    arena_lock_init(&(arena->lock));
+
+    if ((reserve_size > 0) && (dxf_arena_reserve(arena, reserve_size) != 0)) {
+        dxf_arena_destroy(arena);
+        return NULL;
+    }
+
+    return arena;
+}
+
+void dxf_arena_destroy(struct dxf_arena* const arena)
+{
+    struct arena_chunk *chunk;
+    struct arena_chunk *next_chunk;
+    struct arena_reservation *reservation;
+    struct arena_reservation *next_reservation;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    dxf_arena_reset(arena);
+
+    for (chunk = arena->free_chunks; chunk != NULL; chunk = next_chunk) {
+        next_chunk = chunk->next;
+        if (!chunk->carved) {
+            free(chunk);
+        }
+    }
+    for (chunk = arena->free_blocks; chunk != NULL; chunk = next_chunk) {
+        next_chunk = chunk->next;
+        if (!chunk->carved) {
+            free(chunk);
+        }
+    }
+
+    for (reservation = arena->reservations; reservation != NULL; reservation = next_reservation) {
+        next_reservation = reservation->next;
+        release_reservation(reservation);
+    }
+
+    arena_lock_destroy(&(arena->lock));
+    free(arena);
+}
+
+/* Forgets every allocation but keeps the chunks for the next document.
+ * Blocks that got a chunk of their own are kept by size, so that the
+ * large arrays of the next document land in them again. Threads give up
+ * their slots. No other thread may use the arena while it is being reset.
+ */
+int dxf_arena_reset(struct dxf_arena* const arena)
+{
+    struct arena_chunk *chunk;
+    struct arena_chunk *next_chunk;
+    struct arena_chunk **link;
+
+    arena_lock(&(arena->lock));
+
+    for (chunk = arena->chunks; chunk != NULL; chunk = next_chunk) {
+        next_chunk = chunk->next;
+        if (chunk->kind == CHUNK_DEDICATED) {
+            link = &(arena->free_blocks);
+            while ((*link != NULL) && ((*link)->size < chunk->size)) {
+                link = &((*link)->next);
+            }
+            chunk->next = *link;
+            *link = chunk;
+        }
+        else {
+            chunk->next = arena->free_chunks;
+            arena->free_chunks = chunk;
+        }
+    }
+
+    arena->chunks = NULL;
+    arena->number_of_chunks = 0;
+    memset(arena->slots, 0, sizeof(arena->slots));
+
+    arena_unlock(&(arena->lock));
+    return 0;
+}
+
+/* Reserves whole chunks. Only space that chunks can still be cut from
+ * counts as available, as do chunks freed by a reset, else every reset
+ * would reserve anew.
+ */
+int dxf_arena_reserve(struct dxf_arena* const arena, size_t reserve_size)
+{
+    struct arena_reservation *reservation;
+    struct arena_chunk *chunk;
+    size_t total = CHUNK_HEADER_SIZE + arena->chunk_size;
+    size_t available = 0;
+    size_t size;
+
+    arena_lock(&(arena->lock));
+
+    for (reservation = arena->reservations; reservation != NULL; reservation = reservation->next) {
+        available += (reservation->size - reservation->used) / total * total;
+    }
+    for (chunk = arena->free_chunks; chunk != NULL; chunk = chunk->next) {
+        available += total;
+    }
+
+    if (available >= reserve_size) {
+        arena_unlock(&(arena->lock));
+        return 0;
+    }
+
+    size = (reserve_size - available + total - 1) / total * total;
+    if ((reservation = reserve_memory(size, arena->flags)) == NULL) {
+        arena_unlock(&(arena->lock));
+        errprint("dxfarena: dxf_arena_reserve(): Failed to reserve %zu bytes. \n", reserve_size);
+        return -1;
+    }
+
+    reservation->next = arena->reservations;
+    arena->reservations = reservation;
+    arena->bytes_reserved += reservation->size;
+
+    arena_unlock(&(arena->lock));
+    return 0;
+}
+
+void* dxf_arena_alloc(struct dxf_arena* const arena, size_t size)
+{
+    size_t cls;
+    int slot_index;
+    void *ptr;
+
+    size = size == 0 ? DXF_ARENA_GRANULE : ALIGN_UP(size, DXF_ARENA_GRANULE);
+    cls = size <= DXF_ARENA_MAX_CLASS_SIZE ? size / DXF_ARENA_GRANULE - 1 : DXF_ARENA_LARGE_CLASS;
+
+    if ((slot_index = get_thread_slot(arena)) != SHARED_SLOT) {
+        return slot_alloc(arena, &(arena->slots[slot_index]), cls, size, 0);
+    }
+
+    arena_lock(&(arena->lock));
+    ptr = slot_alloc(arena, &(arena->slots[SHARED_SLOT]), cls, size, 1);
+    arena_unlock(&(arena->lock));
+
+    return ptr;
+}
+
+void* dxf_arena_calloc(struct dxf_arena* const arena, size_t n, size_t size)
+{
+    void *ptr = dxf_arena_alloc(arena, n * size);
+
+    if (ptr != NULL) {
+        memset(ptr, 0, n * size);
+    }
+
+    return ptr;
+}
+
+int dxf_arena_get_stats(struct dxf_arena* const arena, struct dxf_arena_stats* const stats)
+{
+    struct arena_reservation *reservation;
+    size_t cls;
+    int i;
+
+    memset(stats, 0, sizeof(struct dxf_arena_stats));
+
+    arena_lock(&(arena->lock));
+
+    stats->bytes_reserved = arena->bytes_reserved;
+    stats->chunks = arena->number_of_chunks;
+    for (reservation = arena->reservations; reservation != NULL; reservation = reservation->next) {
+        stats->huge_pages |= reservation->mapped;
+    }
+
+    for (cls = 0; cls < DXF_ARENA_CLASS_COUNT; ++cls) {
+        stats->classes[cls].class_size = cls != DXF_ARENA_LARGE_CLASS ?
+                                            (cls + 1) * DXF_ARENA_GRANULE : 0;
+        for (i = 0; i <= DXF_ARENA_MAX_THREADS; ++i) {
+            stats->classes[cls].count += arena->slots[i].counts[cls];
+            stats->classes[cls].bytes += arena->slots[i].bytes[cls];
+        }
+        stats->bytes_used += stats->classes[cls].bytes;
+    }
+
+    arena_unlock(&(arena->lock));
+    return 0;
+}
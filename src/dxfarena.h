@@ -0,0 +1,60 @@
+#ifndef __DXF_ARENA_H__
+#define __DXF_ARENA_H__
+
+#include <stddef.h>
+
+/* Allocation granule. Every entity struct is a multiple of it, so each
+ * struct size is a size class of its own and wastes nothing.
+ */
+#define DXF_ARENA_GRANULE 8
+#define DXF_ARENA_MAX_CLASS_SIZE 256
+#define DXF_ARENA_LARGE_CLASS (DXF_ARENA_MAX_CLASS_SIZE / DXF_ARENA_GRANULE)
+#define DXF_ARENA_CLASS_COUNT (DXF_ARENA_LARGE_CLASS + 1)
+
+#define DXF_ARENA_CHUNK_SIZE (64 * 1024)
+
+/* Threads beyond this many in one arena share a locked slot until the
+ * next reset.
+ */
+#define DXF_ARENA_MAX_THREADS 16
+
+/* Arena flags. With DXF_ARENA_HUGE_PAGES reservations are backed by
+ * huge pages where the system has them. Chunks, large blocks included,
+ * are cut from reservations while they last and come from malloc after.
+ */
+#define DXF_ARENA_DEFAULT 0
+#define DXF_ARENA_HUGE_PAGES 1
+
+struct dxf_arena;
+
+struct dxf_arena_class_stats {
+    size_t class_size;      /* 0 for the large class */
+    size_t count;
+    size_t bytes;
+};
+
+struct dxf_arena_stats {
+    size_t bytes_reserved;  /* obtained from the system */
+    size_t bytes_used;      /* handed out since the last reset */
+    size_t chunks;
+    int huge_pages;
+    struct dxf_arena_class_stats classes[DXF_ARENA_CLASS_COUNT];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dxf_arena* dxf_arena_create(size_t reserve_size, int flags);
+void dxf_arena_destroy(struct dxf_arena* const arena);
+int dxf_arena_reset(struct dxf_arena* const arena);
+int dxf_arena_reserve(struct dxf_arena* const arena, size_t reserve_size);
+void* dxf_arena_alloc(struct dxf_arena* const arena, size_t size);
+void* dxf_arena_calloc(struct dxf_arena* const arena, size_t n, size_t size);
+int dxf_arena_get_stats(struct dxf_arena* const arena, struct dxf_arena_stats* const stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_ARENA_H__ */
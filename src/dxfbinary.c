@@ -0,0 +1,71 @@
+#include "dxfbinary.h"
+
+/* Digit values, X for anything else. X has a bit no digit has, so OR-ing
+ * the values of a whole run tells whether it was all digits.
+ */
+#define X 0x10
+
+static const unsigned char hex_values[256] = {
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  X,  X,  X,  X,  X,  X,
+     X, 10, 11, 12, 13, 14, 15,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X, 10, 11, 12, 13, 14, 15,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,
+     X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X
+};
+
+#undef X
+
+/* Four bytes per iteration and one check per call keep the loop free of
+ * branches on the data, which is what makes it fast on long runs.
+ * Returns the number of bytes written, length / 2, or (size_t)-1 if hex
+ * holds anything but hex digits or an odd number of them. out may be hex
+ * itself.
+ */
+size_t dxf_binary_decode_hex(const char *hex, size_t length, unsigned char *out)
+{
+    const unsigned char *in = (const unsigned char*)hex;
+    const size_t size = length / 2;
+    unsigned int bad = 0;
+    unsigned int v[8];
+    size_t i;
+
+    if (length % 2 != 0) {
+        return (size_t)-1;
+    }
+
+    for (i = 0; i + 4 <= size; i += 4, in += 8) {
+        v[0] = hex_values[in[0]];
+        v[1] = hex_values[in[1]];
+        v[2] = hex_values[in[2]];
+        v[3] = hex_values[in[3]];
+        v[4] = hex_values[in[4]];
+        v[5] = hex_values[in[5]];
+        v[6] = hex_values[in[6]];
+        v[7] = hex_values[in[7]];
+        bad |= v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7];
+        out[i] = (unsigned char)((v[0] << 4) | v[1]);
+        out[i + 1] = (unsigned char)((v[2] << 4) | v[3]);
+        out[i + 2] = (unsigned char)((v[4] << 4) | v[5]);
+        out[i + 3] = (unsigned char)((v[6] << 4) | v[7]);
+    }
+
+    for (; i < size; ++i, in += 2) {
+        v[0] = hex_values[in[0]];
+        v[1] = hex_values[in[1]];
+        bad |= v[0] | v[1];
+        out[i] = (unsigned char)((v[0] << 4) | v[1]);
+    }
+
+    return (bad & 0x10) ? (size_t)-1 : size;
+}
@@ -0,0 +1,21 @@
+#ifndef __DXF_BINARY_H__
+#define __DXF_BINARY_H__
+
+#include <stddef.h>
+
+/* Binary groups (310-319, 1004) are written as hex digits, at most 127
+ * bytes per line; longer data such as THUMBNAILIMAGE continues over
+ * several groups of the same code.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t dxf_binary_decode_hex(const char *hex, size_t length, unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_BINARY_H__ */
@@ -0,0 +1,711 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "dxfbounds.h"
+#include "dxfinsert.h"
+#include "dxfocs.h"
+#include "dxfellipse.h"
+
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "dbgprint.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* AutoCAD writes +/-1e20 as the extents of an empty drawing. */
+#define EMPTY_EXTENTS 1e20
+
+static void compute_container(struct dxf* const dxf, struct dxf_container* const container,
+                            int depth, struct dxf_bounds* const bounds);
+
+void dxf_bounds_clear(struct dxf_bounds* const bounds)
+{
+    bounds->min[0] = bounds->min[1] = bounds->min[2] = DBL_MAX;
+    bounds->max[0] = bounds->max[1] = bounds->max[2] = -DBL_MAX;
+}
+
+int dxf_bounds_is_empty(const struct dxf_bounds* const bounds)
+{
+    return bounds->min[0] > bounds->max[0];
+}
+
+/* Written without branches on the comparison so that the compiler can
+ * use min/max instructions.
+ */
+void dxf_bounds_add_point(struct dxf_bounds* const bounds, double x, double y, double z)
+{
+    bounds->min[0] = (x < bounds->min[0]) ? x : bounds->min[0];
+    bounds->min[1] = (y < bounds->min[1]) ? y : bounds->min[1];
+    bounds->min[2] = (z < bounds->min[2]) ? z : bounds->min[2];
+    bounds->max[0] = (x > bounds->max[0]) ? x : bounds->max[0];
+    bounds->max[1] = (y > bounds->max[1]) ? y : bounds->max[1];
+    bounds->max[2] = (z > bounds->max[2]) ? z : bounds->max[2];
+}
+
+void dxf_bounds_merge(struct dxf_bounds* const bounds, const struct dxf_bounds* const other)
+{
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        bounds->min[i] = (other->min[i] < bounds->min[i]) ? other->min[i] : bounds->min[i];
+        bounds->max[i] = (other->max[i] > bounds->max[i]) ? other->max[i] : bounds->max[i];
+    }
+}
+
+/* Entities owned by a block. The INSERT parser stores the inserted block
+ * in header.block, so an INSERT is a member only if that differs.
+ */
+int dxf_is_block_member(const struct dxf_entity* const entity)
+{
+    if (entity->type == DXF_INSERT) {
+        return (entity->block != NULL)
+            && (entity->block != ((const struct dxf_insert*)entity)->block_ref);
+    }
+
+    return entity->block != NULL;
+}
+
+/* Counter-clockwise arc from start to end, angles in degrees. Besides
+ * the end points only the quadrant points inside the sweep count.
+ */
+static void add_arc(struct dxf_bounds* const bounds, double x, double y, double z,
+                    double r, double start, double end)
+{
+    double sweep;
+    double delta;
+    int quadrant;
+
+    start = fmod(start, 360.0);
+    if (start < 0.0) {
+        start += 360.0;
+    }
+    end = fmod(end, 360.0);
+    if (end < 0.0) {
+        end += 360.0;
+    }
+    sweep = end - start;
+    if (sweep <= 0.0) {
+        sweep += 360.0;
+    }
+
+    dxf_bounds_add_point(bounds, x + r * cos(start * M_PI / 180.0),
+                        y + r * sin(start * M_PI / 180.0), z);
+    dxf_bounds_add_point(bounds, x + r * cos(end * M_PI / 180.0),
+                        y + r * sin(end * M_PI / 180.0), z);
+
+    for (quadrant = 0; quadrant < 4; ++quadrant) {
+        delta = quadrant * 90.0 - start;
+        if (delta < 0.0) {
+            delta += 360.0;
+        }
+        if (delta <= sweep) {
+            dxf_bounds_add_point(bounds, x + r * ((quadrant == 0) ? 1.0 : (quadrant == 2) ? -1.0 : 0.0),
+                                y + r * ((quadrant == 1) ? 1.0 : (quadrant == 3) ? -1.0 : 0.0), z);
+        }
+    }
+}
+
+/* Segment from v0 to v1 with the bulge of v0, see struct dxf_lwpolyline_vertex. */
+static void add_bulge_segment(struct dxf_bounds* const bounds,
+                            const struct dxf_lwpolyline_vertex* const v0,
+                            const struct dxf_lwpolyline_vertex* const v1)
+{
+    double dx = v1->x - v0->x;
+    double dy = v1->y - v0->y;
+    double b = v0->bulge;
+    double chord = sqrt(dx * dx + dy * dy);
+    double offset;
+    double cx;
+    double cy;
+    double r;
+    double a0;
+    double a1;
+
+    dxf_bounds_add_point(bounds, v1->x, v1->y, v1->z);
+
+    if ((b == 0.0) || (chord == 0.0)) {
+        return;
+    }
+
+    /* Centre lies off the chord midpoint along its left normal by
+     * chord * (1 - b^2) / (4b); the radius is chord * (1 + b^2) / (4|b|).
+     */
+    offset = (1.0 - b * b) / (4.0 * b);
+    cx = (v0->x + v1->x) * 0.5 - dy * offset;
+    cy = (v0->y + v1->y) * 0.5 + dx * offset;
+    r = fabs(chord * (1.0 + b * b) / (4.0 * b));
+    a0 = atan2(v0->y - cy, v0->x - cx) * 180.0 / M_PI;
+    a1 = atan2(v1->y - cy, v1->x - cx) * 180.0 / M_PI;
+
+    if (b > 0.0) {
+        add_arc(bounds, cx, cy, v0->z, r, a0, a1);
+    }
+    else {
+        add_arc(bounds, cx, cy, v0->z, r, a1, a0);
+    }
+}
+
+static void add_lwpolyline(struct dxf_bounds* const bounds,
+                        const struct dxf_lwpolyline* const lwpolyline)
+{
+    const struct dxf_lwpolyline_vertex *vertex = lwpolyline->vertices;
+
+    if (vertex == NULL) {
+        return;
+    }
+
+    dxf_bounds_add_point(bounds, vertex->x, vertex->y, vertex->z);
+    for (; vertex->next != NULL; vertex = vertex->next) {
+        add_bulge_segment(bounds, vertex, vertex->next);
+    }
+
+    /* Closed: the last vertex carries the bulge back to the first. */
+    if (lwpolyline->flag & 1) {
+        add_bulge_segment(bounds, vertex, lwpolyline->vertices);
+    }
+}
+
+static void copy_polyline_vertex(struct dxf_lwpolyline_vertex* const to,
+                                const struct dxf_polyline_vertex* const from)
+{
+    to->x = from->x;
+    to->y = from->y;
+    to->z = from->z;
+    to->bulge = from->bulge;
+    to->next = NULL;
+}
+
+/* Meshes are bounded by their vertices; polylines get their bulge arcs,
+ * leaving out spline frame points.
+ */
+static void add_polyline(struct dxf_bounds* const bounds, const struct dxf_polyline* const polyline)
+{
+    const struct dxf_polyline_vertex *vertices = polyline->vertices;
+    struct dxf_lwpolyline_vertex v0;
+    struct dxf_lwpolyline_vertex v1;
+    struct dxf_lwpolyline_vertex first;
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < polyline->number_of_vertices; ++i) {
+        if (polyline->flag & (DXF_POLYLINE_FLAG_MESH | DXF_POLYLINE_FLAG_POLYFACE)) {
+            dxf_bounds_add_point(bounds, vertices[i].x, vertices[i].y, vertices[i].z);
+            continue;
+        }
+        if (vertices[i].flag & DXF_VERTEX_FLAG_SPLINE_FRAME) {
+            continue;
+        }
+
+        copy_polyline_vertex(&v1, &vertices[i]);
+        if (count++ == 0) {
+            first = v1;
+            dxf_bounds_add_point(bounds, v1.x, v1.y, v1.z);
+        }
+        else {
+            add_bulge_segment(bounds, &v0, &v1);
+        }
+        v0 = v1;
+    }
+
+    if ((count > 1) && (polyline->flag & DXF_POLYLINE_FLAG_CLOSED)) {
+        add_bulge_segment(bounds, &v0, &first);
+    }
+}
+
+/* The control points' hull holds the curve for positive weights. */
+static void add_spline(struct dxf_bounds* const bounds, const struct dxf_spline* const spline)
+{
+    const double *points = spline->control_points;
+    size_t count = spline->number_of_control_points;
+    size_t i;
+
+    if (count == 0) {
+        points = spline->fit_points;
+        count = spline->number_of_fit_points;
+    }
+
+    for (i = 0; i < count; ++i) {
+        dxf_bounds_add_point(bounds, points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+    }
+}
+
+/* Hatch boundaries lie at the elevation. Counter-clockwise arc edges are
+ * exact; clockwise arcs and elliptic edges, whose angles depend on the
+ * writer, get their whole circle or ellipse, and spline edges their
+ * control points.
+ */
+static void add_hatch(struct dxf_bounds* const bounds, const struct dxf_hatch* const hatch)
+{
+    const double z = hatch->elevation;
+    const struct dxf_hatch_loop *loop;
+    const struct dxf_hatch_edge *edge;
+    struct dxf_ellipse ellipse;
+    struct dxf_lwpolyline_vertex v0;
+    struct dxf_lwpolyline_vertex v1;
+    struct dxf_lwpolyline_vertex first;
+    size_t i;
+    size_t j;
+
+    memset(&ellipse, 0, sizeof(ellipse));
+    ellipse.z = z;
+    ellipse.param_end = 2.0 * M_PI;
+    ellipse.extrusion[2] = 1.0;
+    v1.z = z;
+    v1.next = NULL;
+
+    for (i = 0; i < hatch->number_of_loops; ++i) {
+        loop = &(hatch->loops[i]);
+        if (!(loop->flag & DXF_HATCH_LOOP_FLAG_POLYLINE)) {
+            continue;
+        }
+        for (j = 0; j < loop->count; ++j) {
+            v1.x = hatch->vertices[loop->first + j].x;
+            v1.y = hatch->vertices[loop->first + j].y;
+            v1.bulge = hatch->vertices[loop->first + j].bulge;
+            if (j == 0) {
+                first = v1;
+                dxf_bounds_add_point(bounds, v1.x, v1.y, z);
+            }
+            else {
+                add_bulge_segment(bounds, &v0, &v1);
+            }
+            v0 = v1;
+        }
+        if (loop->count > 1) {
+            add_bulge_segment(bounds, &v0, &first);
+        }
+    }
+
+    for (i = 0; i < hatch->number_of_edges; ++i) {
+        edge = &(hatch->edges[i]);
+        switch (edge->type) {
+            case DXF_HATCH_EDGE_LINE:
+                dxf_bounds_add_point(bounds, edge->x, edge->y, z);
+                dxf_bounds_add_point(bounds, edge->x2, edge->y2, z);
+                break;
+            case DXF_HATCH_EDGE_ARC:
+                if (edge->flag) {
+                    add_arc(bounds, edge->x, edge->y, z, edge->r, edge->angle_start, edge->angle_end);
+                }
+                else {
+                    dxf_bounds_add_point(bounds, edge->x - edge->r, edge->y - edge->r, z);
+                    dxf_bounds_add_point(bounds, edge->x + edge->r, edge->y + edge->r, z);
+                }
+                break;
+            case DXF_HATCH_EDGE_ELLIPSE:
+                ellipse.x = edge->x;
+                ellipse.y = edge->y;
+                ellipse.major[0] = edge->x2;
+                ellipse.major[1] = edge->y2;
+                ellipse.ratio = edge->r;
+                dxf_ellipse_add_bounds(&ellipse, bounds);
+                break;
+            case DXF_HATCH_EDGE_SPLINE:
+                for (j = 0; j < edge->number_of_control_points; ++j) {
+                    dxf_bounds_add_point(bounds, hatch->control_points[3 * (edge->first_control_point + j)],
+                                        hatch->control_points[3 * (edge->first_control_point + j) + 1], z);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void add_insert(struct dxf* const dxf, struct dxf_bounds* const bounds,
+                        const struct dxf_insert* const insert, int depth)
+{
+    struct dxf_bounds block_bounds;
+    struct dxf_transform transform;
+    double corner[3];
+    int columns = (insert->column_count > 1) ? insert->column_count : 1;
+    int rows = (insert->row_count > 1) ? insert->row_count : 1;
+    int cell;
+    int i;
+
+    if (insert->block_ref == NULL) {
+        return;
+    }
+
+    compute_container(dxf, insert->block_ref, depth + 1, &block_bounds);
+    if (dxf_bounds_is_empty(&block_bounds)) {
+        return;
+    }
+
+    /* Cells differ only by translation, so the corner cells span the array. */
+    for (cell = 0; cell < 4; ++cell) {
+        dxf_insert_get_transform(insert, NULL, (cell & 1) ? columns - 1 : 0,
+                                (cell & 2) ? rows - 1 : 0, &transform);
+        for (i = 0; i < 8; ++i) {
+            corner[0] = (i & 1) ? block_bounds.max[0] : block_bounds.min[0];
+            corner[1] = (i & 2) ? block_bounds.max[1] : block_bounds.min[1];
+            corner[2] = (i & 4) ? block_bounds.max[2] : block_bounds.min[2];
+            dxf_transform_apply(&transform, corner, corner);
+            dxf_bounds_add_point(bounds, corner[0], corner[1], corner[2]);
+        }
+    }
+}
+
+/* Box around the corners of an OCS box, in world coordinates. */
+static void ocs_to_wcs(struct dxf_bounds* const bounds, const double extrusion[3])
+{
+    double corners[8][3];
+    int i;
+
+    if (dxf_ocs_is_identity(extrusion) || dxf_bounds_is_empty(bounds)) {
+        return;
+    }
+
+    for (i = 0; i < 8; ++i) {
+        corners[i][0] = (i & 1) ? bounds->max[0] : bounds->min[0];
+        corners[i][1] = (i & 2) ? bounds->max[1] : bounds->min[1];
+        corners[i][2] = (i & 4) ? bounds->max[2] : bounds->min[2];
+    }
+    dxf_ocs_to_wcs(extrusion, corners[0], 8, 3);
+
+    dxf_bounds_clear(bounds);
+    for (i = 0; i < 8; ++i) {
+        dxf_bounds_add_point(bounds, corners[i][0], corners[i][1], corners[i][2]);
+    }
+}
+
+static void compute_entity(struct dxf* const dxf, const struct dxf_entity* const entity,
+                            int depth, struct dxf_bounds* const bounds)
+{
+    struct dxf_bounds_entry *entry = NULL;
+    const struct dxf_circle *circle;
+    const struct dxf_arc *arc;
+    const struct dxf_line *line;
+    const struct dxf_point *point;
+    const struct dxf_solid *solid;
+    const struct dxf_dimension *dimension;
+    const double *extrusion;
+    int i;
+
+    if ((entity->seq != 0) && (entity->seq < dxf->bounds_cache_size)) {
+        entry = &(dxf->bounds_cache[entity->seq]);
+        if (entry->generation == dxf->bounds_generation) {
+            memcpy(bounds, &(entry->bounds), sizeof(struct dxf_bounds));
+            return;
+        }
+    }
+
+    dxf_bounds_clear(bounds);
+
+    switch (entity->type) {
+        case DXF_POINT:
+            point = (const struct dxf_point*)entity;
+            dxf_bounds_add_point(bounds, point->x, point->y, point->z);
+            break;
+        case DXF_LINE:
+            line = (const struct dxf_line*)entity;
+            dxf_bounds_add_point(bounds, line->x1, line->y1, line->z1);
+            dxf_bounds_add_point(bounds, line->x2, line->y2, line->z2);
+            break;
+        case DXF_CIRCLE:
+            circle = (const struct dxf_circle*)entity;
+            dxf_bounds_add_point(bounds, circle->x - circle->r, circle->y - circle->r, circle->z);
+            dxf_bounds_add_point(bounds, circle->x + circle->r, circle->y + circle->r, circle->z);
+            ocs_to_wcs(bounds, circle->extrusion);
+            break;
+        case DXF_ARC:
+            arc = (const struct dxf_arc*)entity;
+            add_arc(bounds, arc->x, arc->y, arc->z, arc->r, arc->angle_start, arc->angle_end);
+            ocs_to_wcs(bounds, arc->extrusion);
+            break;
+        case DXF_LWPOLYLINE:
+            add_lwpolyline(bounds, (const struct dxf_lwpolyline*)entity);
+            ocs_to_wcs(bounds, ((const struct dxf_lwpolyline*)entity)->extrusion);
+            break;
+        case DXF_INSERT:
+            add_insert(dxf, bounds, (const struct dxf_insert*)entity, depth);
+            break;
+        case DXF_SPLINE:
+            add_spline(bounds, (const struct dxf_spline*)entity);
+            break;
+        case DXF_ELLIPSE:
+            dxf_ellipse_add_bounds((const struct dxf_ellipse*)entity, bounds);
+            break;
+        case DXF_POLYLINE:
+            add_polyline(bounds, (const struct dxf_polyline*)entity);
+            if ((extrusion = dxf_ocs_get_extrusion(entity)) != NULL) {
+                ocs_to_wcs(bounds, extrusion);
+            }
+            break;
+        case DXF_SOLID:
+            solid = (const struct dxf_solid*)entity;
+            for (i = 0; i < 4; ++i) {
+                dxf_bounds_add_point(bounds, solid->corners[i][0], solid->corners[i][1], solid->corners[i][2]);
+            }
+            ocs_to_wcs(bounds, solid->extrusion);
+            break;
+        case DXF_DIMENSION:
+            dimension = (const struct dxf_dimension*)entity;
+            if (dimension->insert.block_ref != NULL) {
+                add_insert(dxf, bounds, &(dimension->insert), depth);
+            }
+            else {
+                dxf_bounds_add_point(bounds, dimension->definition[0], dimension->definition[1],
+                                    dimension->definition[2]);
+                for (i = 0; i < 4; ++i) {
+                    dxf_bounds_add_point(bounds, dimension->points[i][0], dimension->points[i][1],
+                                        dimension->points[i][2]);
+                }
+            }
+            break;
+        case DXF_HATCH:
+            add_hatch(bounds, (const struct dxf_hatch*)entity);
+            ocs_to_wcs(bounds, ((const struct dxf_hatch*)entity)->extrusion);
+            break;
+        default:
+            break;
+    }
+
+    if (entry != NULL) {
+        memcpy(&(entry->bounds), bounds, sizeof(struct dxf_bounds));
+        entry->generation = dxf->bounds_generation;
+    }
+}
+
+static void compute_container(struct dxf* const dxf, struct dxf_container* const container,
+                            int depth, struct dxf_bounds* const bounds)
+{
+    struct dxf_bounds entity_bounds;
+    struct dxf_entity *entity;
+    int type;
+
+    if (container->bounds_generation == dxf->bounds_generation) {
+        memcpy(bounds, &(container->bounds), sizeof(struct dxf_bounds));
+        return;
+    }
+
+    dxf_bounds_clear(bounds);
+
+    if (depth > DXF_BOUNDS_MAX_DEPTH) {
+        errprint("dxfbounds: compute_container(): Blocks nested deeper than %d at %s. \n",
+                DXF_BOUNDS_MAX_DEPTH, container->name);
+        return;
+    }
+
+    for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+        if (container->type == DXF_BLOCK) {
+            for (entity = container->entities[type]; entity != NULL; entity = entity->next_in_block) {
+                compute_entity(dxf, entity, depth, &entity_bounds);
+                dxf_bounds_merge(bounds, &entity_bounds);
+            }
+        }
+        else {
+            /* An INSERT can be on two layer lists; it counts where it ended up. */
+            for (entity = container->entities[type]; entity != NULL; entity = entity->next) {
+                if ((entity->layer == container) && !dxf_is_block_member(entity)) {
+                    compute_entity(dxf, entity, depth, &entity_bounds);
+                    dxf_bounds_merge(bounds, &entity_bounds);
+                }
+            }
+        }
+    }
+
+    memcpy(&(container->bounds), bounds, sizeof(struct dxf_bounds));
+    container->bounds_generation = dxf->bounds_generation;
+}
+
+/* Grows the per-entity cache to cover every seq, the last one being the
+ * largest. Must not run while layers are being computed in parallel.
+ */
+static int ensure_cache(struct dxf* const dxf)
+{
+    struct dxf_bounds_entry *cache;
+    size_t size = (dxf->last_entity != NULL ? dxf->last_entity->seq : 0) + 1;
+
+    if (size <= dxf->bounds_cache_size) {
+        return 0;
+    }
+
+    if ((cache = (struct dxf_bounds_entry*)dxf_alloc_binary(dxf,
+                                size * sizeof(struct dxf_bounds_entry))) == NULL) {
+        return -1;
+    }
+
+    if (dxf->bounds_cache != NULL) {
+        memcpy(cache, dxf->bounds_cache, dxf->bounds_cache_size * sizeof(struct dxf_bounds_entry));
+    }
+    memset(cache + dxf->bounds_cache_size, 0,
+            (size - dxf->bounds_cache_size) * sizeof(struct dxf_bounds_entry));
+
+    dxf->bounds_cache = cache;
+    dxf->bounds_cache_size = size;
+    return 0;
+}
+
+#ifdef USE_PTHREAD
+struct layer_job {
+    struct dxf *dxf;
+    size_t index;
+    size_t stride;
+};
+
+/* Every block is already cached, so workers only write their own layers
+ * and the entities on them.
+ */
+static void* layer_worker(void *arg)
+{
+    struct layer_job* const job = (struct layer_job*)arg;
+    struct dxf_layer *layer;
+    struct dxf_bounds bounds;
+    size_t i = 0;
+
+    for (layer = job->dxf->layers; layer != NULL; layer = layer->next, ++i) {
+        if (i % job->stride == job->index) {
+            compute_container(job->dxf, layer, 0, &bounds);
+        }
+    }
+
+    return NULL;
+}
+
+static void compute_layers_parallel(struct dxf* const dxf, size_t number_of_layers)
+{
+    pthread_t threads[DXF_BOUNDS_MAX_THREADS];
+    struct layer_job jobs[DXF_BOUNDS_MAX_THREADS];
+    int started[DXF_BOUNDS_MAX_THREADS];
+    size_t stride = (number_of_layers < DXF_BOUNDS_MAX_THREADS)
+                    ? number_of_layers : DXF_BOUNDS_MAX_THREADS;
+    size_t i;
+
+    for (i = 0; i < stride; ++i) {
+        jobs[i].dxf = dxf;
+        jobs[i].index = i;
+        jobs[i].stride = stride;
+        started[i] = (i > 0) && (pthread_create(&threads[i], NULL, layer_worker, &jobs[i]) == 0);
+    }
+
+    /* Job 0, and any job whose thread did not start, runs here. */
+    for (i = 0; i < stride; ++i) {
+        if (!started[i]) {
+            layer_worker(&jobs[i]);
+        }
+    }
+
+    for (i = 1; i < stride; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+#endif
+
+int dxf_compute_bounds(struct dxf* const dxf, struct dxf_bounds* const bounds)
+{
+    struct dxf_container *container;
+    struct dxf_bounds container_bounds;
+    size_t number_of_layers = 0;
+
+    if (dxf->document_bounds_generation == dxf->bounds_generation) {
+        memcpy(bounds, &(dxf->bounds), sizeof(struct dxf_bounds));
+        return 0;
+    }
+
+    if (ensure_cache(dxf) != 0) {
+        return -1;
+    }
+
+    for (container = dxf->blocks; container != NULL; container = container->next) {
+        compute_container(dxf, container, 0, &container_bounds);
+    }
+
+    for (container = dxf->layers; container != NULL; container = container->next) {
+        ++number_of_layers;
+    }
+
+#ifdef USE_PTHREAD
+    if ((number_of_layers > 1) && (dxf->number_of_entities >= DXF_BOUNDS_PARALLEL_THRESHOLD)) {
+        compute_layers_parallel(dxf, number_of_layers);
+    }
+#endif
+
+    dxf_bounds_clear(bounds);
+    for (container = dxf->layers; container != NULL; container = container->next) {
+        compute_container(dxf, container, 0, &container_bounds);
+        dxf_bounds_merge(bounds, &container_bounds);
+    }
+
+    memcpy(&(dxf->bounds), bounds, sizeof(struct dxf_bounds));
+    dxf->document_bounds_generation = dxf->bounds_generation;
+
+    dbgprint("dxfbounds: dxf_compute_bounds(): (%f, %f, %f) - (%f, %f, %f) over %lu layers. \n",
+            bounds->min[0], bounds->min[1], bounds->min[2],
+            bounds->max[0], bounds->max[1], bounds->max[2], (unsigned long)number_of_layers);
+
+    return 0;
+}
+
+int dxf_get_entity_bounds(struct dxf* const dxf, const struct dxf_entity* const entity,
+                        struct dxf_bounds* const bounds)
+{
+    if (ensure_cache(dxf) != 0) {
+        return -1;
+    }
+
+    compute_entity(dxf, entity, 0, bounds);
+    return 0;
+}
+
+int dxf_get_container_bounds(struct dxf* const dxf, struct dxf_container* const container,
+                        struct dxf_bounds* const bounds)
+{
+    if (ensure_cache(dxf) != 0) {
+        return -1;
+    }
+
+    compute_container(dxf, container, 0, bounds);
+    return 0;
+}
+
+/* NULL, or an entity inside a block, drops everything. */
+void dxf_invalidate_bounds(struct dxf* const dxf, const struct dxf_entity* const entity)
+{
+    if ((entity == NULL) || dxf_is_block_member(entity)) {
+        if (++(dxf->bounds_generation) == 0) {
+            dxf->bounds_generation = 1;
+        }
+        return;
+    }
+
+    if ((entity->seq != 0) && (entity->seq < dxf->bounds_cache_size)) {
+        dxf->bounds_cache[entity->seq].generation = 0;
+    }
+
+    if (entity->layer != NULL) {
+        entity->layer->bounds_generation = 0;
+    }
+
+    dxf->document_bounds_generation = 0;
+}
+
+/* The header's extents, if present and plausible. Files are often saved
+ * with stale extents, so this is never used in place of computed bounds.
+ */
+int dxf_get_bounds_hint(const struct dxf* const dxf, struct dxf_bounds* const bounds)
+{
+    int i;
+
+    if (!dxf->has_extents_hint) {
+        return -1;
+    }
+
+    for (i = 0; i < 3; ++i) {
+        if (!(dxf->extents_hint.min[i] <= dxf->extents_hint.max[i])
+            || (fabs(dxf->extents_hint.min[i]) >= EMPTY_EXTENTS)
+            || (fabs(dxf->extents_hint.max[i]) >= EMPTY_EXTENTS))
+        {
+            return -1;
+        }
+    }
+
+    memcpy(bounds, &(dxf->extents_hint), sizeof(struct dxf_bounds));
+    return 0;
+}
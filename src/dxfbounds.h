@@ -0,0 +1,56 @@
+#ifndef __DXF_BOUNDS_H__
+#define __DXF_BOUNDS_H__
+
+#include "dxf.h"
+
+/* Tight axis aligned bounds of POINT, LINE, CIRCLE, ARC (only the
+ * quadrant points the arc actually passes), LWPOLYLINE and POLYLINE
+ * (bulge arcs included, meshes by their vertices), ELLIPSE (see
+ * dxfellipse.h) and INSERT (the inserted block's bounds, transformed,
+ * over the whole array), in world coordinates (see dxfocs.h). SPLINEs get
+ * the box of their control points, which contains the curve. HATCHes are
+ * bounded by their boundary loops, elliptic edges as whole ellipses.
+ * SOLIDs are bounded by their corners and DIMENSIONs by their block,
+ * or, while it is unresolved, by their definition points. Other entity
+ * types have empty bounds.
+ *
+ * Results are cached per entity, per layer and block, and for the whole
+ * document. Changing an entity requires dxf_invalidate_bounds(); changing
+ * anything inside a block drops every cached value, since any INSERT may
+ * depend on it. Layers are computed in parallel when built with
+ * USE_PTHREAD. Block members do not count towards layer or document
+ * bounds, only through the INSERTs that place them.
+ */
+
+#define DXF_BOUNDS_MAX_THREADS 8
+#define DXF_BOUNDS_PARALLEL_THRESHOLD 4096     /* Entities */
+#define DXF_BOUNDS_MAX_DEPTH 16                 /* Of nested blocks */
+
+struct dxf_bounds_entry {
+    struct dxf_bounds bounds;
+    unsigned int generation;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void dxf_bounds_clear(struct dxf_bounds* const bounds);
+int dxf_bounds_is_empty(const struct dxf_bounds* const bounds);
+void dxf_bounds_add_point(struct dxf_bounds* const bounds, double x, double y, double z);
+void dxf_bounds_merge(struct dxf_bounds* const bounds, const struct dxf_bounds* const other);
+
+int dxf_compute_bounds(struct dxf* const dxf, struct dxf_bounds* const bounds);
+int dxf_get_entity_bounds(struct dxf* const dxf, const struct dxf_entity* const entity,
+                        struct dxf_bounds* const bounds);
+int dxf_get_container_bounds(struct dxf* const dxf, struct dxf_container* const container,
+                        struct dxf_bounds* const bounds);
+void dxf_invalidate_bounds(struct dxf* const dxf, const struct dxf_entity* const entity);
+int dxf_get_bounds_hint(const struct dxf* const dxf, struct dxf_bounds* const bounds);
+int dxf_is_block_member(const struct dxf_entity* const entity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_BOUNDS_H__ */
@@ -0,0 +1,666 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dxfchain.h"
+#include "dxfbounds.h"
+#include "dxfocs.h"
+#include "dxfspline.h"
+#include "dxfellipse.h"
+#include "dxfrtree.h"
+
+#include "dbgprint.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NO_LINK ((size_t)-1)
+
+#define CHAINED_TYPES (DXF_ENTITY_TYPE_BIT(DXF_LINE) | DXF_ENTITY_TYPE_BIT(DXF_ARC) \
+                        | DXF_ENTITY_TYPE_BIT(DXF_LWPOLYLINE) | DXF_ENTITY_TYPE_BIT(DXF_CIRCLE) \
+                        | DXF_ENTITY_TYPE_BIT(DXF_SPLINE) | DXF_ENTITY_TYPE_BIT(DXF_ELLIPSE))
+
+/* End point 2i is the start of piece i, 2i + 1 its end. */
+struct end_points {
+    struct dxf_entity **entities;
+    double *x;
+    double *y;
+    size_t *link;               /* Matched end point or NO_LINK. */
+    size_t count;               /* Pieces */
+};
+
+struct grid {
+    size_t *heads;
+    size_t *next;
+    size_t mask;
+    double cell;
+};
+
+struct loop_order {
+    double area;
+    size_t chain;
+};
+
+/* Finding the parent of loop i of the order; parent is the best so far. */
+struct parent_query {
+    const struct dxf_chains *chains;
+    const struct loop_order *order;
+    size_t i;
+    size_t parent;
+    double x;
+    double y;
+};
+
+static int is_loop(const struct dxf_entity* const entity)
+{
+    return (entity->type == DXF_CIRCLE)
+        || ((entity->type == DXF_LWPOLYLINE) && (((const struct dxf_lwpolyline*)entity)->flag & 1))
+        || ((entity->type == DXF_ELLIPSE) && dxf_ellipse_is_closed((const struct dxf_ellipse*)entity));
+}
+
+static void end_points_to_wcs(const double extrusion[3], double z, double *x, double *y)
+{
+    double points[2][3];
+    int i;
+
+    if (dxf_ocs_is_identity(extrusion)) {
+        return;
+    }
+
+    for (i = 0; i < 2; ++i) {
+        points[i][0] = x[i];
+        points[i][1] = y[i];
+        points[i][2] = z;
+    }
+    dxf_ocs_to_wcs(extrusion, points[0], 2, 3);
+    for (i = 0; i < 2; ++i) {
+        x[i] = points[i][0];
+        y[i] = points[i][1];
+    }
+}
+
+static int get_end_points(const struct dxf_entity* const entity, double *x, double *y)
+{
+    const struct dxf_spline *spline;
+    const struct dxf_ellipse *ellipse;
+    double ends[2];
+    double points[6];
+    const struct dxf_line *line;
+    const struct dxf_arc *arc;
+    const struct dxf_lwpolyline_vertex *vertex;
+
+    switch (entity->type) {
+        case DXF_LINE:
+            line = (const struct dxf_line*)entity;
+            x[0] = line->x1;
+            y[0] = line->y1;
+            x[1] = line->x2;
+            y[1] = line->y2;
+            return 0;
+        case DXF_ARC:
+            arc = (const struct dxf_arc*)entity;
+            x[0] = arc->x + arc->r * cos(arc->angle_start * M_PI / 180.0);
+            y[0] = arc->y + arc->r * sin(arc->angle_start * M_PI / 180.0);
+            x[1] = arc->x + arc->r * cos(arc->angle_end * M_PI / 180.0);
+            y[1] = arc->y + arc->r * sin(arc->angle_end * M_PI / 180.0);
+            end_points_to_wcs(arc->extrusion, arc->z, x, y);
+            return 0;
+        case DXF_LWPOLYLINE:
+            if ((vertex = ((const struct dxf_lwpolyline*)entity)->vertices) == NULL) {
+                return -1;
+            }
+            x[0] = vertex->x;
+            y[0] = vertex->y;
+            for (; vertex->next != NULL; vertex = vertex->next) {
+            }
+            x[1] = vertex->x;
+            y[1] = vertex->y;
+            end_points_to_wcs(((const struct dxf_lwpolyline*)entity)->extrusion, vertex->z, x, y);
+            return 0;
+        case DXF_SPLINE:
+            spline = (const struct dxf_spline*)entity;
+            if (!dxf_spline_is_valid(spline)) {
+                return -1;
+            }
+            ends[0] = spline->knots[spline->degree];
+            ends[1] = spline->knots[spline->number_of_control_points];
+            dxf_spline_evaluate(spline, ends, 2, points);
+            x[0] = points[0];
+            y[0] = points[1];
+            x[1] = points[3];
+            y[1] = points[4];
+            return 0;
+        case DXF_ELLIPSE:
+            ellipse = (const struct dxf_ellipse*)entity;
+            dxf_ellipse_get_sweep(ellipse, &ends[0], &ends[1]);
+            ends[1] += ends[0];
+            dxf_ellipse_evaluate(ellipse, ends, 2, points);
+            x[0] = points[0];
+            y[0] = points[1];
+            x[1] = points[3];
+            y[1] = points[4];
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static size_t cell_hash(const struct grid* const grid, double x, double y)
+{
+    unsigned long ix = (unsigned long)(long)floor(x / grid->cell);
+    unsigned long iy = (unsigned long)(long)floor(y / grid->cell);
+
+    return (size_t)((ix * 73856093UL) ^ (iy * 19349663UL)) & grid->mask;
+}
+
+static int grid_init(struct grid* const grid, const struct end_points* const points, double cell)
+{
+    size_t size = 16;
+    size_t bucket;
+    size_t i;
+
+    while (size < 2 * points->count) {
+        size <<= 1;
+    }
+
+    grid->mask = size - 1;
+    grid->cell = cell;
+    grid->heads = (size_t*)malloc(size * sizeof(size_t));
+    grid->next = (size_t*)malloc((2 * points->count + 1) * sizeof(size_t));
+    if ((grid->heads == NULL) || (grid->next == NULL)) {
+        errprint("dxfchain: grid_init(): Failed to allocate the grid. \n");
+        return -1;
+    }
+
+    for (i = 0; i < size; ++i) {
+        grid->heads[i] = NO_LINK;
+    }
+
+    for (i = 0; i < 2 * points->count; ++i) {
+        bucket = cell_hash(grid, points->x[i], points->y[i]);
+        grid->next[i] = grid->heads[bucket];
+        grid->heads[bucket] = i;
+    }
+
+    return 0;
+}
+
+static void grid_free(struct grid* const grid)
+{
+    free(grid->heads);
+    free(grid->next);
+}
+
+/* Nearest free end point within tolerance of end point e, other than e. */
+static size_t find_partner(const struct grid* const grid, const struct end_points* const points,
+                            size_t e, double tolerance)
+{
+    size_t best = NO_LINK;
+    double best_distance = tolerance * tolerance;
+    double dx;
+    double dy;
+    double d;
+    size_t f;
+    int i;
+    int j;
+
+    for (i = -1; i <= 1; ++i) {
+        for (j = -1; j <= 1; ++j) {
+            f = grid->heads[cell_hash(grid, points->x[e] + i * grid->cell,
+                                            points->y[e] + j * grid->cell)];
+            for (; f != NO_LINK; f = grid->next[f]) {
+                if ((f == e) || (points->link[f] != NO_LINK)) {
+                    continue;
+                }
+                dx = points->x[f] - points->x[e];
+                dy = points->y[f] - points->y[e];
+                d = dx * dx + dy * dy;
+                if ((d < best_distance) || ((d == best_distance) && (best == NO_LINK))) {
+                    best_distance = d;
+                    best = f;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+static int match_end_points(struct end_points* const points, double tolerance)
+{
+    struct grid grid;
+    size_t partner;
+    size_t e;
+
+    if (grid_init(&grid, points, tolerance) != 0) {
+        grid_free(&grid);
+        return -1;
+    }
+
+    for (e = 0; e < 2 * points->count; ++e) {
+        if (points->link[e] != NO_LINK) {
+            continue;
+        }
+        if ((partner = find_partner(&grid, points, e, tolerance)) != NO_LINK) {
+            points->link[e] = partner;
+            points->link[partner] = e;
+        }
+    }
+
+    grid_free(&grid);
+    return 0;
+}
+
+static void add_piece(struct dxf_chains* const chains, struct dxf_entity* const entity,
+                        int reversed)
+{
+    struct dxf_chain_piece* const piece = &(chains->pieces[chains->number_of_pieces++]);
+
+    piece->entity = entity;
+    piece->reversed = reversed;
+}
+
+/* Walks from end point e through its piece and on until the chain ends
+ * or comes back to e.
+ */
+static void walk(struct dxf_chains* const chains, const struct end_points* const points,
+                char *visited, size_t e)
+{
+    struct dxf_chain* const chain = &(chains->chains[chains->number_of_chains++]);
+    size_t start = e;
+    size_t next;
+
+    memset(chain, 0, sizeof(struct dxf_chain));
+    chain->first_piece = chains->number_of_pieces;
+    chain->parent = DXF_CHAIN_NO_PARENT;
+
+    for (;;) {
+        visited[e / 2] = 1;
+        add_piece(chains, points->entities[e / 2], (int)(e & 1));
+
+        if ((next = points->link[e ^ 1]) == NO_LINK) {
+            break;
+        }
+        if (next == start) {
+            chain->closed = 1;
+            break;
+        }
+        if (visited[next / 2]) {
+            break;
+        }
+        e = next;
+    }
+
+    chain->number_of_pieces = chains->number_of_pieces - chain->first_piece;
+}
+
+static int append_vertices(struct dxf_chains* const chains, struct dxf_chain* const chain,
+                            double tolerance)
+{
+    const struct dxf_chain_piece *piece;
+    struct dxf_tess_vertex *out;
+    struct dxf_tess_vertex t;
+    size_t count;
+    size_t i;
+    size_t j;
+
+    chain->first_vertex = chains->number_of_vertices;
+    dxf_bounds_clear(&(chain->bounds));
+
+    for (i = 0; i < chain->number_of_pieces; ++i) {
+        piece = &(chains->pieces[chain->first_piece + i]);
+        out = chains->vertices + chains->number_of_vertices;
+        if (dxf_tess_entity(piece->entity, tolerance, out, (size_t)-1, &count) != 0) {
+            return -1;
+        }
+
+        if (piece->reversed) {
+            for (j = 0; j < count / 2; ++j) {
+                t = out[j];
+                out[j] = out[count - 1 - j];
+                out[count - 1 - j] = t;
+            }
+        }
+
+        /* The first vertex repeats the previous piece's last one. */
+        if ((i > 0) && (count > 0)) {
+            memmove(out, out + 1, (count - 1) * sizeof(struct dxf_tess_vertex));
+            --count;
+        }
+
+        for (j = 0; j < count; ++j) {
+            dxf_bounds_add_point(&(chain->bounds), out[j].x, out[j].y, out[j].z);
+        }
+        chains->number_of_vertices += count;
+    }
+
+    chain->number_of_vertices = chains->number_of_vertices - chain->first_vertex;
+    return 0;
+}
+
+static double signed_area(const struct dxf_tess_vertex *v, size_t n)
+{
+    double area = 0.0;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        area += v[i].x * v[(i + 1) % n].y - v[(i + 1) % n].x * v[i].y;
+    }
+
+    return area * 0.5;
+}
+
+static int contains(const struct dxf_chains* const chains, const struct dxf_chain* const chain,
+                    double x, double y)
+{
+    const struct dxf_tess_vertex *v = chains->vertices + chain->first_vertex;
+    size_t n = chain->number_of_vertices;
+    size_t i;
+    size_t j;
+    int inside = 0;
+
+    if ((x < chain->bounds.min[0]) || (x > chain->bounds.max[0])
+        || (y < chain->bounds.min[1]) || (y > chain->bounds.max[1]))
+    {
+        return 0;
+    }
+
+    for (i = 0, j = n - 1; i < n; j = i++) {
+        if (((v[i].y > y) != (v[j].y > y))
+            && (x < (v[j].x - v[i].x) * (y - v[i].y) / (v[j].y - v[i].y) + v[i].x))
+        {
+            inside = !inside;
+        }
+    }
+
+    return inside;
+}
+
+static int compare_loops(const void *p1, const void *p2)
+{
+    const struct loop_order *l1 = (const struct loop_order*)p1;
+    const struct loop_order *l2 = (const struct loop_order*)p2;
+
+    if (l1->area != l2->area) {
+        return (l1->area > l2->area) ? -1 : 1;
+    }
+    return (l1->chain < l2->chain) ? -1 : (l1->chain > l2->chain);
+}
+
+/* Loops whose box holds the point are candidates; of those sorted
+ * before the loop, the last that contains it is the parent.
+ */
+static int visit_parent(struct dxf_entity *entity, unsigned int position, void *user_data)
+{
+    struct parent_query* const query = (struct parent_query*)user_data;
+
+    (void)entity;
+    if ((position < query->i) && ((query->parent == NO_LINK) || (position > query->parent))
+        && contains(query->chains, &(query->chains->chains[query->order[position].chain]),
+                    query->x, query->y))
+    {
+        query->parent = position;
+    }
+
+    return 0;
+}
+
+/* Larger loops first, so the last earlier loop containing a point of
+ * this one is its smallest enclosing loop. An R-tree over the loop boxes
+ * limits the loops tested to those that can contain the point.
+ */
+static int nest(struct dxf_chains* const chains)
+{
+    struct loop_order *order;
+    struct dxf_chain *chain;
+    struct dxf_rtree tree;
+    struct parent_query query;
+    const struct dxf_tess_vertex *v;
+    double *boxes;
+    unsigned int *positions;
+    size_t number_of_loops = 0;
+    size_t i;
+    int ret = -1;
+
+    order = (struct loop_order*)malloc((chains->number_of_chains + 1) * sizeof(struct loop_order));
+    boxes = (double*)malloc((chains->number_of_chains + 1) * 4 * sizeof(double));
+    positions = (unsigned int*)malloc((chains->number_of_chains + 1) * sizeof(unsigned int));
+    if ((order == NULL) || (boxes == NULL) || (positions == NULL)) {
+        errprint("dxfchain: nest(): Failed to allocate %lu loops. \n",
+                (unsigned long)chains->number_of_chains);
+        goto out;
+    }
+
+    for (i = 0; i < chains->number_of_chains; ++i) {
+        if (chains->chains[i].closed && (chains->chains[i].number_of_vertices > 0)) {
+            order[number_of_loops].area = fabs(chains->chains[i].area);
+            order[number_of_loops++].chain = i;
+        }
+    }
+    qsort(order, number_of_loops, sizeof(struct loop_order), compare_loops);
+
+    for (i = 0; i < number_of_loops; ++i) {
+        chain = &(chains->chains[order[i].chain]);
+        boxes[4 * i] = chain->bounds.min[0];
+        boxes[4 * i + 1] = chain->bounds.min[1];
+        boxes[4 * i + 2] = chain->bounds.max[0];
+        boxes[4 * i + 3] = chain->bounds.max[1];
+        positions[i] = (unsigned int)i;
+    }
+    if (dxf_rtree_build_boxes(&tree, boxes, positions, number_of_loops) != 0) {
+        goto out;
+    }
+
+    query.chains = chains;
+    query.order = order;
+    for (i = 0; i < number_of_loops; ++i) {
+        chain = &(chains->chains[order[i].chain]);
+        v = chains->vertices + chain->first_vertex;
+
+        query.i = i;
+        query.parent = NO_LINK;
+        query.x = v->x;
+        query.y = v->y;
+        dxf_rtree_search(&tree, v->x, v->y, v->x, v->y, visit_parent, &query);
+        if (query.parent != NO_LINK) {
+            chain->parent = order[query.parent].chain;
+            chain->depth = chains->chains[chain->parent].depth + 1;
+        }
+    }
+
+    dxf_rtree_free(&tree);
+    ret = 0;
+
+out:
+    free(order);
+    free(boxes);
+    free(positions);
+    return ret;
+}
+
+static int collect(struct end_points* const points, struct dxf* const dxf,
+                    const char *layer_name, unsigned int type_mask, size_t *vertices,
+                    double tolerance)
+{
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    size_t capacity = 0;
+    size_t total = 0;
+
+    if (dxf_entity_iter_init(&iter, dxf, layer_name, type_mask & CHAINED_TYPES) != 0) {
+        return -1;
+    }
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        capacity += !dxf_is_block_member(entity);
+    }
+
+    points->entities = (struct dxf_entity**)malloc((capacity + 1) * sizeof(struct dxf_entity*));
+    points->x = (double*)malloc((2 * capacity + 1) * sizeof(double));
+    points->y = (double*)malloc((2 * capacity + 1) * sizeof(double));
+    points->link = (size_t*)malloc((2 * capacity + 1) * sizeof(size_t));
+    if ((points->entities == NULL) || (points->x == NULL) || (points->y == NULL)
+        || (points->link == NULL))
+    {
+        errprint("dxfchain: collect(): Failed to allocate %lu pieces. \n", (unsigned long)capacity);
+        return -1;
+    }
+
+    dxf_entity_iter_init(&iter, dxf, layer_name, type_mask & CHAINED_TYPES);
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if (dxf_is_block_member(entity)) {
+            continue;
+        }
+
+        if (is_loop(entity)) {
+            /* Joined to themselves; the grid skips joined end points. */
+            points->x[2 * points->count] = points->y[2 * points->count] = 0.0;
+            points->x[2 * points->count + 1] = points->y[2 * points->count + 1] = 0.0;
+            points->link[2 * points->count] = 2 * points->count + 1;
+            points->link[2 * points->count + 1] = 2 * points->count;
+        }
+        else if (get_end_points(entity, points->x + 2 * points->count,
+                                points->y + 2 * points->count) == 0) {
+            points->link[2 * points->count] = points->link[2 * points->count + 1] = NO_LINK;
+        }
+        else {
+            continue;
+        }
+
+        points->entities[points->count++] = entity;
+        total += dxf_tess_count(entity, tolerance);
+    }
+
+    *vertices = total;
+    return 0;
+}
+
+int dxf_chain_build(struct dxf_chains* const chains, struct dxf* const dxf,
+                    const char *layer_name, unsigned int type_mask, double tolerance)
+{
+    struct end_points points;
+    char *visited = NULL;
+    size_t vertices = 0;
+    size_t e;
+    size_t i;
+    int ret = -1;
+
+    memset(chains, 0, sizeof(struct dxf_chains));
+    memset(&points, 0, sizeof(points));
+
+    if (!(tolerance > 0.0)) {
+        errprint("dxfchain: dxf_chain_build(): Tolerance %g is not positive. \n", tolerance);
+        return -1;
+    }
+
+    if ((collect(&points, dxf, layer_name, type_mask, &vertices, tolerance) != 0)
+        || (match_end_points(&points, tolerance) != 0))
+    {
+        goto out;
+    }
+
+    visited = (char*)calloc(points.count + 1, 1);
+    chains->chains = (struct dxf_chain*)malloc((points.count + 1) * sizeof(struct dxf_chain));
+    chains->pieces = (struct dxf_chain_piece*)malloc((points.count + 1) * sizeof(struct dxf_chain_piece));
+    chains->vertices = (struct dxf_tess_vertex*)malloc((vertices + 1) * sizeof(struct dxf_tess_vertex));
+    if ((visited == NULL) || (chains->chains == NULL) || (chains->pieces == NULL)
+        || (chains->vertices == NULL))
+    {
+        errprint("dxfchain: dxf_chain_build(): Failed to allocate %lu chains. \n",
+                (unsigned long)points.count);
+        goto out;
+    }
+
+    /* Open chains first, from whichever end is free, then loops. */
+    for (e = 0; e < 2 * points.count; ++e) {
+        if (!visited[e / 2] && (points.link[e] == NO_LINK)) {
+            walk(chains, &points, visited, e);
+        }
+    }
+    for (i = 0; i < points.count; ++i) {
+        if (!visited[i]) {
+            walk(chains, &points, visited, 2 * i);
+        }
+    }
+
+    for (i = 0; i < chains->number_of_chains; ++i) {
+        if (append_vertices(chains, &(chains->chains[i]), tolerance) != 0) {
+            goto out;
+        }
+        if (chains->chains[i].closed) {
+            chains->chains[i].area = signed_area(chains->vertices + chains->chains[i].first_vertex,
+                                                chains->chains[i].number_of_vertices);
+        }
+    }
+
+    if (nest(chains) != 0) {
+        goto out;
+    }
+
+    dbgprint("dxfchain: dxf_chain_build(): %lu pieces in %lu chains. \n",
+            (unsigned long)points.count, (unsigned long)chains->number_of_chains);
+    ret = 0;
+
+out:
+    free(points.entities);
+    free(points.x);
+    free(points.y);
+    free(points.link);
+    free(visited);
+    if (ret != 0) {
+        dxf_chain_free(chains);
+    }
+    return ret;
+}
+
+static void reverse_chain(struct dxf_chains* const chains, struct dxf_chain* const chain)
+{
+    struct dxf_chain_piece *pieces = chains->pieces + chain->first_piece;
+    struct dxf_tess_vertex *vertices = chains->vertices + chain->first_vertex;
+    struct dxf_chain_piece piece;
+    struct dxf_tess_vertex vertex;
+    size_t n;
+    size_t i;
+
+    n = chain->number_of_pieces;
+    for (i = 0; i < n / 2; ++i) {
+        piece = pieces[i];
+        pieces[i] = pieces[n - 1 - i];
+        pieces[n - 1 - i] = piece;
+    }
+    for (i = 0; i < n; ++i) {
+        pieces[i].reversed = !pieces[i].reversed;
+    }
+
+    n = chain->number_of_vertices;
+    for (i = 0; i < n / 2; ++i) {
+        vertex = vertices[i];
+        vertices[i] = vertices[n - 1 - i];
+        vertices[n - 1 - i] = vertex;
+    }
+
+    chain->area = -chain->area;
+}
+
+/* Turns outlines counter-clockwise and holes clockwise, as toolpath
+ * generators usually expect.
+ */
+void dxf_chain_orient(struct dxf_chains* const chains)
+{
+    struct dxf_chain *chain;
+    size_t i;
+
+    for (i = 0; i < chains->number_of_chains; ++i) {
+        chain = &(chains->chains[i]);
+        if (chain->closed && ((chain->area < 0.0) == ((chain->depth & 1) == 0))) {
+            reverse_chain(chains, chain);
+        }
+    }
+}
+
+void dxf_chain_free(struct dxf_chains* const chains)
+{
+    free(chains->chains);
+    free(chains->pieces);
+    free(chains->vertices);
+    memset(chains, 0, sizeof(struct dxf_chains));
+}
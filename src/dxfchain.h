@@ -0,0 +1,62 @@
+#ifndef __DXF_CHAIN_H__
+#define __DXF_CHAIN_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxftess.h"
+
+/* Chaining of LINE, ARC, SPLINE, ELLIPSE arc and open LWPOLYLINE pieces
+ * into contours by matching end points within a tolerance. End points go
+ * into a hash grid with cells as wide as the tolerance, so every end point
+ * is compared with the few in its 3 x 3 neighbourhood only. Where more than two end
+ * points meet, each one is joined to its nearest free partner. CIRCLEs,
+ * full ELLIPSEs and closed LWPOLYLINEs are loops of their own.
+ *
+ * Every chain is also tessellated (see dxftess.h) in chain order, which
+ * gives the signed area of closed loops, counter-clockwise positive, and
+ * their nesting: parent is the smallest loop enclosing this one, and
+ * loops at even depth are outlines, at odd depth holes.
+ */
+
+#define DXF_CHAIN_NO_PARENT ((size_t)-1)
+
+struct dxf_chain_piece {
+    struct dxf_entity *entity;
+    int reversed;               /* Walked from its end to its start. */
+};
+
+struct dxf_chain {
+    size_t first_piece;
+    size_t number_of_pieces;
+    size_t first_vertex;
+    size_t number_of_vertices;
+    int closed;
+    double area;                /* 0 for open chains. */
+    struct dxf_bounds bounds;
+    size_t parent;              /* Chain index or DXF_CHAIN_NO_PARENT. */
+    int depth;
+};
+
+struct dxf_chains {
+    struct dxf_chain *chains;
+    size_t number_of_chains;
+    struct dxf_chain_piece *pieces;
+    size_t number_of_pieces;
+    struct dxf_tess_vertex *vertices;
+    size_t number_of_vertices;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_chain_build(struct dxf_chains* const chains, struct dxf* const dxf,
+                    const char *layer_name, unsigned int type_mask, double tolerance);
+void dxf_chain_orient(struct dxf_chains* const chains);
+void dxf_chain_free(struct dxf_chains* const chains);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_CHAIN_H__ */
@@ -0,0 +1,197 @@
+#include <math.h>
+#include "dxfellipse.h"
+#include "dxfbounds.h"
+
+#include "dbgprint.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* The minor axis is the extrusion direction crossed with the major axis,
+ * scaled by the ratio. A zero extrusion is taken as +Z.
+ */
+void dxf_ellipse_get_axes(const struct dxf_ellipse* const ellipse, double major[3], double minor[3])
+{
+    const double *n = ellipse->extrusion;
+    double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    double scale;
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        major[i] = ellipse->major[i];
+    }
+
+    if (length == 0.0) {
+        minor[0] = -major[1] * ellipse->ratio;
+        minor[1] = major[0] * ellipse->ratio;
+        minor[2] = 0.0;
+        return;
+    }
+
+    scale = ellipse->ratio / length;
+    minor[0] = (n[1] * major[2] - n[2] * major[1]) * scale;
+    minor[1] = (n[2] * major[0] - n[0] * major[2]) * scale;
+    minor[2] = (n[0] * major[1] - n[1] * major[0]) * scale;
+}
+
+/* Sweep in (0, 2 pi], counter-clockwise about the extrusion direction. */
+void dxf_ellipse_get_sweep(const struct dxf_ellipse* const ellipse, double *start, double *sweep)
+{
+    *start = ellipse->param_start;
+    *sweep = fmod(ellipse->param_end - ellipse->param_start, 2.0 * M_PI);
+    if (*sweep <= 0.0) {
+        *sweep += 2.0 * M_PI;
+    }
+}
+
+int dxf_ellipse_is_closed(const struct dxf_ellipse* const ellipse)
+{
+    double start;
+    double sweep;
+
+    dxf_ellipse_get_sweep(ellipse, &start, &sweep);
+    return sweep >= 2.0 * M_PI * (1.0 - 1e-12);
+}
+
+static int in_sweep(double t, double start, double sweep)
+{
+    double d = fmod(t - start, 2.0 * M_PI);
+
+    if (d < 0.0) {
+        d += 2.0 * M_PI;
+    }
+    return d <= sweep;
+}
+
+/* Coordinate i is c + a cos(t) + b sin(t), extreme at atan2(b, a) and
+ * half a turn later, where it is c +/- sqrt(a^2 + b^2).
+ */
+void dxf_ellipse_add_bounds(const struct dxf_ellipse* const ellipse, struct dxf_bounds* const bounds)
+{
+    const double centre[3] = { ellipse->x, ellipse->y, ellipse->z };
+    double major[3];
+    double minor[3];
+    double ends[2];
+    double points[6];
+    double amplitude;
+    double start;
+    double sweep;
+    double t;
+    int i;
+
+    dxf_ellipse_get_axes(ellipse, major, minor);
+    dxf_ellipse_get_sweep(ellipse, &start, &sweep);
+
+    ends[0] = start;
+    ends[1] = start + sweep;
+    dxf_ellipse_evaluate(ellipse, ends, 2, points);
+    dxf_bounds_add_point(bounds, points[0], points[1], points[2]);
+    dxf_bounds_add_point(bounds, points[3], points[4], points[5]);
+
+    for (i = 0; i < 3; ++i) {
+        amplitude = sqrt(major[i] * major[i] + minor[i] * minor[i]);
+        t = atan2(minor[i], major[i]);
+        if (in_sweep(t, start, sweep)) {
+            bounds->max[i] = (centre[i] + amplitude > bounds->max[i]) ? centre[i] + amplitude : bounds->max[i];
+        }
+        if (in_sweep(t + M_PI, start, sweep)) {
+            bounds->min[i] = (centre[i] - amplitude < bounds->min[i]) ? centre[i] - amplitude : bounds->min[i];
+        }
+    }
+}
+
+/* count parameters into count x, y, z triples. */
+size_t dxf_ellipse_evaluate(const struct dxf_ellipse* const ellipse, const double *t,
+                        size_t count, double *points)
+{
+    double major[3];
+    double minor[3];
+    double c;
+    double s;
+    size_t i;
+
+    dxf_ellipse_get_axes(ellipse, major, minor);
+
+    for (i = 0; i < count; ++i) {
+        c = cos(t[i]);
+        s = sin(t[i]);
+        points[3 * i] = ellipse->x + major[0] * c + minor[0] * s;
+        points[3 * i + 1] = ellipse->y + major[1] * c + minor[1] * s;
+        points[3 * i + 2] = ellipse->z + major[2] * c + minor[2] * s;
+    }
+
+    return count;
+}
+
+/* A chord over a parameter step h strays at most h^2 / 8 * max |P''|
+ * from the curve, and |P''| never exceeds the longer semi-axis.
+ */
+static size_t ellipse_segments(const double major[3], const double minor[3], double sweep,
+                            double tolerance)
+{
+    double a = sqrt(major[0] * major[0] + major[1] * major[1] + major[2] * major[2]);
+    double b = sqrt(minor[0] * minor[0] + minor[1] * minor[1] + minor[2] * minor[2]);
+    double step = M_PI / 2.0;
+    double n;
+
+    a = (a > b) ? a : b;
+    if (8.0 * tolerance < a * step * step) {
+        step = sqrt(8.0 * tolerance / a);
+    }
+
+    n = ceil(sweep / step);
+    if (n < 1.0) {
+        return 1;
+    }
+    return (n < DXF_TESS_MAX_SEGMENTS) ? (size_t)n : DXF_TESS_MAX_SEGMENTS;
+}
+
+/* Vertices are written only when vertices is not NULL; see dxftess.h. */
+size_t dxf_ellipse_tessellate(const struct dxf_ellipse* const ellipse, double tolerance,
+                        struct dxf_tess_vertex *vertices)
+{
+    double major[3];
+    double minor[3];
+    double start;
+    double sweep;
+    double c;
+    double s;
+    double dc;
+    double ds;
+    double t;
+    size_t segments;
+    size_t i;
+
+    dxf_ellipse_get_axes(ellipse, major, minor);
+    dxf_ellipse_get_sweep(ellipse, &start, &sweep);
+    segments = ellipse_segments(major, minor, sweep, tolerance);
+
+    if (vertices == NULL) {
+        return segments + 1;
+    }
+
+    c = cos(start);
+    s = sin(start);
+    dc = cos(sweep / segments);
+    ds = sin(sweep / segments);
+    for (i = 0; i <= segments; ++i) {
+        if (i == segments) {
+            /* Land exactly on the end, and on the start when closed. */
+            c = cos(start + sweep);
+            s = sin(start + sweep);
+        }
+        vertices[i].x = ellipse->x + major[0] * c + minor[0] * s;
+        vertices[i].y = ellipse->y + major[1] * c + minor[1] * s;
+        vertices[i].z = ellipse->z + major[2] * c + minor[2] * s;
+        t = c * dc - s * ds;
+        s = c * ds + s * dc;
+        c = t;
+    }
+
+    if (dxf_ellipse_is_closed(ellipse)) {
+        vertices[segments] = vertices[0];
+    }
+
+    return segments + 1;
+}
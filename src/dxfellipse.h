@@ -0,0 +1,35 @@
+#ifndef __DXF_ELLIPSE_H__
+#define __DXF_ELLIPSE_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxftess.h"
+
+/* ELLIPSE entities. The point at parameter t is centre + major * cos(t) +
+ * minor * sin(t), each coordinate a sinusoid, so the bounds come in
+ * closed form from the sinusoids' amplitudes and the parameters of their
+ * extremes inside the sweep.
+ *
+ * Sampling uses a fixed parameter step, found from the curvature bound
+ * |P''| <= |major|, and steps cos(t) and sin(t) by a rotation recurrence;
+ * the points are then one multiply-add loop over both axes.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void dxf_ellipse_get_axes(const struct dxf_ellipse* const ellipse, double major[3], double minor[3]);
+void dxf_ellipse_get_sweep(const struct dxf_ellipse* const ellipse, double *start, double *sweep);
+int dxf_ellipse_is_closed(const struct dxf_ellipse* const ellipse);
+void dxf_ellipse_add_bounds(const struct dxf_ellipse* const ellipse, struct dxf_bounds* const bounds);
+size_t dxf_ellipse_evaluate(const struct dxf_ellipse* const ellipse, const double *t,
+                        size_t count, double *points);
+size_t dxf_ellipse_tessellate(const struct dxf_ellipse* const ellipse, double tolerance,
+                        struct dxf_tess_vertex *vertices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_ELLIPSE_H__ */
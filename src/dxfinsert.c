@@ -0,0 +1,265 @@
+#include <math.h>
+#include <string.h>
+#include "dxfinsert.h"
+#include "dxfocs.h"
+
+#include "dbgprint.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void multiply(const struct dxf_transform* const a, const struct dxf_transform* const b,
+                    struct dxf_transform* const out)
+{
+    int i;
+    int j;
+
+    for (i = 0; i < 3; ++i) {
+        for (j = 0; j < 4; ++j) {
+            out->m[i][j] = a->m[i][0] * b->m[0][j] + a->m[i][1] * b->m[1][j]
+                        + a->m[i][2] * b->m[2][j];
+        }
+        out->m[i][3] += a->m[i][3];
+    }
+}
+
+static void apply_linear(const struct dxf_transform* const transform,
+                        const double in[3], double out[3])
+{
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        out[i] = transform->m[i][0] * in[0] + transform->m[i][1] * in[1]
+                + transform->m[i][2] * in[2];
+    }
+}
+
+static int is_empty(const struct dxf_block* const block)
+{
+    int type;
+
+    for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+        if (block->entities[type] != NULL) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+void dxf_transform_identity(struct dxf_transform* const transform)
+{
+    memset(transform, 0, sizeof(struct dxf_transform));
+    transform->m[0][0] = transform->m[1][1] = transform->m[2][2] = 1.0;
+}
+
+/* in and out may be the same array. */
+void dxf_transform_apply(const struct dxf_transform* const transform,
+                        const double in[3], double out[3])
+{
+    double x = in[0];
+    double y = in[1];
+    double z = in[2];
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        out[i] = transform->m[i][0] * x + transform->m[i][1] * y
+                + transform->m[i][2] * z + transform->m[i][3];
+    }
+}
+
+/* parent * OCS * T(insertion point) * R(angle) * S(scale) * T(-base point),
+ * and the world space offsets between neighbouring columns and rows.
+ */
+static void build_origin(const struct dxf_insert* const insert,
+                        const struct dxf_transform *parent,
+                        struct dxf_transform* const origin,
+                        double column_step[3], double row_step[3])
+{
+    const struct dxf_block* const block = insert->block_ref;
+    struct dxf_transform local;
+    struct dxf_transform ocs;
+    struct dxf_transform placed;
+    double c = cos(insert->angle * M_PI / 180.0);
+    double s = sin(insert->angle * M_PI / 180.0);
+    double step[3];
+
+    memset(&local, 0, sizeof(local));
+    local.m[0][0] = c * insert->x_scale;
+    local.m[0][1] = -s * insert->y_scale;
+    local.m[1][0] = s * insert->x_scale;
+    local.m[1][1] = c * insert->y_scale;
+    local.m[2][2] = insert->z_scale;
+    local.m[0][3] = insert->x - (local.m[0][0] * block->x + local.m[0][1] * block->y);
+    local.m[1][3] = insert->y - (local.m[1][0] * block->x + local.m[1][1] * block->y);
+    local.m[2][3] = insert->z - local.m[2][2] * block->z;
+
+    /* Array steps below are taken in the OCS as well. */
+    if (!dxf_ocs_is_identity(insert->extrusion)) {
+        dxf_ocs_get_transform(insert->extrusion, &ocs);
+        if (parent != NULL) {
+            multiply(parent, &ocs, &placed);
+        }
+        else {
+            memcpy(&placed, &ocs, sizeof(placed));
+        }
+        parent = &placed;
+    }
+
+    if (parent != NULL) {
+        multiply(parent, &local, origin);
+    }
+    else {
+        memcpy(origin, &local, sizeof(local));
+    }
+
+    /* Array spacing runs along the rotated but unscaled axes. */
+    step[0] = c * insert->column_spacing;
+    step[1] = s * insert->column_spacing;
+    step[2] = 0.0;
+    if (parent != NULL) {
+        apply_linear(parent, step, column_step);
+    }
+    else {
+        memcpy(column_step, step, sizeof(step));
+    }
+
+    step[0] = -s * insert->row_spacing;
+    step[1] = c * insert->row_spacing;
+    if (parent != NULL) {
+        apply_linear(parent, step, row_step);
+    }
+    else {
+        memcpy(row_step, step, sizeof(step));
+    }
+}
+
+static void set_cell(struct dxf_insert_frame* const frame)
+{
+    int i;
+
+    for (i = 0; i < 3; ++i) {
+        frame->cell.m[i][3] = frame->origin.m[i][3]
+                            + frame->column * frame->column_step[i]
+                            + frame->row * frame->row_step[i];
+    }
+}
+
+int dxf_insert_get_transform(const struct dxf_insert* const insert,
+                        const struct dxf_transform* const parent,
+                        int column, int row,
+                        struct dxf_transform* const transform)
+{
+    double column_step[3];
+    double row_step[3];
+    int i;
+
+    if (insert->block_ref == NULL) {
+        return -1;
+    }
+
+    build_origin(insert, parent, transform, column_step, row_step);
+    for (i = 0; i < 3; ++i) {
+        transform->m[i][3] += column * column_step[i] + row * row_step[i];
+    }
+
+    return 0;
+}
+
+static int push(struct dxf_insert_iter* const iter, const struct dxf_insert* const insert,
+                const struct dxf_transform* const parent)
+{
+    struct dxf_insert_frame *frame;
+
+    if ((insert->block_ref == NULL) || is_empty(insert->block_ref)) {
+        return 0;
+    }
+
+    if (iter->depth == DXF_INSERT_MAX_DEPTH) {
+        errprint("dxfinsert: push(): Blocks nested deeper than %d, skipping %s. \n",
+                DXF_INSERT_MAX_DEPTH, insert->block_ref->name);
+        return -1;
+    }
+
+    frame = &(iter->frames[iter->depth++]);
+    frame->block = insert->block_ref;
+    build_origin(insert, parent, &(frame->origin), frame->column_step, frame->row_step);
+    memcpy(&(frame->cell), &(frame->origin), sizeof(struct dxf_transform));
+    frame->column_count = (insert->column_count > 1) ? insert->column_count : 1;
+    frame->row_count = (insert->row_count > 1) ? insert->row_count : 1;
+    frame->column = 0;
+    frame->row = 0;
+    frame->type = DXF_ENTITY_TYPE_START;
+    frame->next = frame->block->entities[DXF_ENTITY_TYPE_START];
+    return 0;
+}
+
+/* Next entity of the block in the current cell, moving on to the next
+ * cell when the block is exhausted. NULL after the last cell.
+ */
+static struct dxf_entity* next_in_frame(struct dxf_insert_frame* const frame)
+{
+    struct dxf_entity *entity;
+
+    for (;;) {
+        if ((entity = frame->next) != NULL) {
+            frame->next = entity->next_in_block;
+            return entity;
+        }
+
+        if (frame->type < DXF_ENTITY_TYPE_END) {
+            frame->next = frame->block->entities[++(frame->type)];
+            continue;
+        }
+
+        if (++(frame->column) == frame->column_count) {
+            frame->column = 0;
+            if (++(frame->row) == frame->row_count) {
+                return NULL;
+            }
+        }
+
+        set_cell(frame);
+        frame->type = DXF_ENTITY_TYPE_START;
+        frame->next = frame->block->entities[DXF_ENTITY_TYPE_START];
+    }
+}
+
+int dxf_insert_iter_init(struct dxf_insert_iter* const iter,
+                        const struct dxf_insert* const insert)
+{
+    iter->depth = 0;
+    return push(iter, insert, NULL);
+}
+
+/* Returns the next leaf entity in block coordinates; *transform takes it
+ * to world space and stays valid until the next call.
+ */
+struct dxf_entity* dxf_insert_iter_next(struct dxf_insert_iter* const iter,
+                        const struct dxf_transform **transform)
+{
+    struct dxf_insert_frame *frame;
+    struct dxf_entity *entity;
+
+    while (iter->depth > 0) {
+        frame = &(iter->frames[iter->depth - 1]);
+
+        if ((entity = next_in_frame(frame)) == NULL) {
+            --(iter->depth);
+            continue;
+        }
+
+        if ((entity->type == DXF_INSERT) || (entity->type == DXF_DIMENSION)) {
+            push(iter, (const struct dxf_insert*)entity, &(frame->cell));
+            continue;
+        }
+
+        if (transform != NULL) {
+            *transform = &(frame->cell);
+        }
+        return entity;
+    }
+
+    return NULL;
+}
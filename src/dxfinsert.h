@@ -0,0 +1,63 @@
+#ifndef __DXF_INSERT_H__
+#define __DXF_INSERT_H__
+
+#include "dxf.h"
+
+/* Expansion of INSERTs into world space. The iterator walks the entities
+ * of the inserted block once per array cell and recurses into nested
+ * INSERTs and DIMENSIONs, whose insert member can also start an
+ * iteration; block entities are never copied. Each returned entity comes
+ * with the affine transform from its block's coordinates to world
+ * coordinates. The transform of a block instance is built once when the
+ * iterator enters it, and moving to the next array cell only shifts its
+ * translation, so arrays of any size cost no memory.
+ */
+
+#define DXF_INSERT_MAX_DEPTH 16
+
+/* Rows x, y, z of [linear | translation]. */
+struct dxf_transform {
+    double m[3][4];
+};
+
+struct dxf_insert_frame {
+    const struct dxf_block *block;
+    struct dxf_transform origin;    /* Transform of cell (0, 0). */
+    struct dxf_transform cell;      /* Transform of the current cell. */
+    double column_step[3];
+    double row_step[3];
+    int column_count;
+    int row_count;
+    int column;
+    int row;
+    int type;
+    struct dxf_entity *next;
+};
+
+struct dxf_insert_iter {
+    struct dxf_insert_frame frames[DXF_INSERT_MAX_DEPTH];
+    int depth;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void dxf_transform_identity(struct dxf_transform* const transform);
+void dxf_transform_apply(const struct dxf_transform* const transform,
+                        const double in[3], double out[3]);
+int dxf_insert_get_transform(const struct dxf_insert* const insert,
+                        const struct dxf_transform* const parent,
+                        int column, int row,
+                        struct dxf_transform* const transform);
+
+int dxf_insert_iter_init(struct dxf_insert_iter* const iter,
+                        const struct dxf_insert* const insert);
+struct dxf_entity* dxf_insert_iter_next(struct dxf_insert_iter* const iter,
+                        const struct dxf_transform **transform);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_INSERT_H__ */
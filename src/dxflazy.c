@@ -0,0 +1,646 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dxflazy.h"
+
+#include "dbgprint.h"
+
+#define INITIAL_CAPACITY 256
+#define SET_WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
+
+struct group_key {
+    struct dxf_layer *layer;
+    int type;
+    size_t index;
+};
+
+static const char* next_line(const char *p, const char *end)
+{
+    const char *nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    return (nl == NULL) ? end : nl + 1;
+}
+
+static int read_group_code(const char *p, const char *end, int *group_code)
+{
+    int value = 0;
+    int digits = 0;
+
+    while ((p < end) && ((*p == ' ') || (*p == '\t'))) {
+        ++p;
+    }
+
+    while ((p < end) && (*p >= '0') && (*p <= '9')) {
+        value = value * 10 + (*p - '0');
+        ++p;
+        ++digits;
+    }
+
+    *group_code = value;
+    return (digits > 0) ? 0 : -1;
+}
+
+/* Copies the value line without leading blanks and the line ending. */
+static void read_value(const char *p, const char *line_end, char *value)
+{
+    size_t len;
+
+    while ((p < line_end) && ((*p == ' ') || (*p == '\t'))) {
+        ++p;
+    }
+
+    len = (size_t)(line_end - p);
+    while ((len > 0) && ((p[len - 1] == '\n') || (p[len - 1] == '\r'))) {
+        --len;
+    }
+
+    if (len > DXF_LEXER_MAX_LINE_LENGTH) {
+        len = DXF_LEXER_MAX_LINE_LENGTH;
+    }
+
+    memcpy(value, p, len);
+    value[len] = '\0';
+}
+
+static void copy_string(char *dst, size_t size, const char *src)
+{
+    size_t len = strlen(src);
+
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static struct dxf_lazy_entry* add_entry(struct dxf_lazy* const lazy, size_t offset, int type)
+{
+    struct dxf_lazy_entry *entries;
+    struct dxf_lazy_entry *entry;
+    size_t capacity;
+
+    if (lazy->number_of_entries == lazy->capacity) {
+        capacity = (lazy->capacity == 0) ? INITIAL_CAPACITY : lazy->capacity * 2;
+        entries = (struct dxf_lazy_entry*)realloc(lazy->entries, capacity * sizeof(struct dxf_lazy_entry));
+        if (entries == NULL) {
+            errprint("dxflazy: add_entry(): Failed to grow the entity index. \n");
+            return NULL;
+        }
+        lazy->entries = entries;
+        lazy->capacity = capacity;
+    }
+
+    entry = &(lazy->entries[lazy->number_of_entries++]);
+    entry->offset = offset;
+    entry->length = 0;
+    entry->type = type;
+    entry->handle[0] = '\0';
+    entry->layer = NULL;
+    entry->entity = NULL;
+    entry->parsed = 0;
+    return entry;
+}
+
+static void close_entry(struct dxf_lazy* const lazy, size_t *current, size_t offset)
+{
+    if (*current != (size_t)-1) {
+        lazy->entries[*current].length = offset - lazy->entries[*current].offset;
+        *current = (size_t)-1;
+    }
+}
+
+static int set_init(struct dxf_lazy_set* const set, size_t size)
+{
+    size_t total = 0;
+    size_t words;
+
+    set->number_of_levels = 0;
+    do {
+        words = (size + SET_WORD_BITS - 1) / SET_WORD_BITS;
+        if (words == 0) {
+            words = 1;
+        }
+        set->level_offset[set->number_of_levels++] = total;
+        total += words;
+        size = words;
+    } while ((words > 1) && (set->number_of_levels < DXF_LAZY_SET_MAX_LEVELS));
+
+    if ((set->words = (unsigned long*)calloc(total, sizeof(unsigned long))) == NULL) {
+        errprint("dxflazy: set_init(): Failed to allocate %lu words. \n", (unsigned long)total);
+        return -1;
+    }
+    return 0;
+}
+
+static void set_add(struct dxf_lazy_set* const set, size_t position)
+{
+    unsigned long *word;
+    unsigned long was;
+    int level;
+
+    for (level = 0; level < set->number_of_levels; ++level) {
+        word = &(set->words[set->level_offset[level] + position / SET_WORD_BITS]);
+        was = *word;
+        *word |= 1UL << (position % SET_WORD_BITS);
+        if (was != 0) {
+            break;
+        }
+        position /= SET_WORD_BITS;
+    }
+}
+
+static int highest_bit(unsigned long word)
+{
+    int bit = 0;
+    size_t shift;
+
+    for (shift = SET_WORD_BITS / 2; shift > 0; shift /= 2) {
+        if ((word >> shift) != 0) {
+            word >>= shift;
+            bit += (int)shift;
+        }
+    }
+    return bit;
+}
+
+/* The closest member below position, (size_t)-1 if there is none. Goes
+ * up until a word has a member below, then down along the highest bits.
+ */
+static size_t set_previous(const struct dxf_lazy_set* const set, size_t position)
+{
+    unsigned long word;
+    size_t bit;
+    int level;
+
+    for (level = 0; level < set->number_of_levels; ++level) {
+        word = set->words[set->level_offset[level] + position / SET_WORD_BITS];
+        bit = position % SET_WORD_BITS;
+        word &= (bit == 0) ? 0 : (~0UL >> (SET_WORD_BITS - bit));
+        position /= SET_WORD_BITS;
+        if (word != 0) {
+            position = position * SET_WORD_BITS + (size_t)highest_bit(word);
+            break;
+        }
+    }
+    if (level == set->number_of_levels) {
+        return (size_t)-1;
+    }
+
+    while (level-- > 0) {
+        word = set->words[set->level_offset[level] + position];
+        position = position * SET_WORD_BITS + (size_t)highest_bit(word);
+    }
+    return position;
+}
+
+static int compare_group_keys(const void *a, const void *b)
+{
+    const struct group_key *ka = (const struct group_key*)a;
+    const struct group_key *kb = (const struct group_key*)b;
+
+    if (ka->layer != kb->layer) {
+        return ((size_t)(ka->layer) < (size_t)(kb->layer)) ? -1 : 1;
+    }
+    if (ka->type != kb->type) {
+        return (ka->type < kb->type) ? -1 : 1;
+    }
+    return (ka->index < kb->index) ? -1 : (ka->index > kb->index);
+}
+
+/* Sorts the entries that have a layer by layer and type, so those of a
+ * layer list are contiguous in lazy->order, and sets up the parsed sets.
+ */
+static int group_entries(struct dxf_lazy* const lazy)
+{
+    struct group_key *keys;
+    struct dxf_lazy_entry *entry;
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < lazy->number_of_entries; ++i) {
+        entry = &(lazy->entries[i]);
+        entry->group = (size_t)-1;
+        entry->position = (size_t)-1;
+        if ((entry->layer != NULL) && (entry->type >= 0)) {
+            ++count;
+        }
+    }
+
+    keys = (struct group_key*)malloc((count + 1) * sizeof(struct group_key));
+    lazy->order = (size_t*)malloc((count + 1) * sizeof(size_t));
+    lazy->groups = (struct dxf_lazy_group*)malloc((count + 1) * sizeof(struct dxf_lazy_group));
+    if ((keys == NULL) || (lazy->order == NULL) || (lazy->groups == NULL)) {
+        errprint("dxflazy: group_entries(): Failed to allocate groups of %lu entries. \n",
+                (unsigned long)count);
+        free(keys);
+        return -1;
+    }
+
+    count = 0;
+    for (i = 0; i < lazy->number_of_entries; ++i) {
+        entry = &(lazy->entries[i]);
+        if ((entry->layer != NULL) && (entry->type >= 0)) {
+            keys[count].layer = entry->layer;
+            keys[count].type = entry->type;
+            keys[count].index = i;
+            ++count;
+        }
+    }
+    qsort(keys, count, sizeof(struct group_key), compare_group_keys);
+
+    for (i = 0; i < count; ++i) {
+        if ((i == 0) || (keys[i].layer != keys[i - 1].layer) || (keys[i].type != keys[i - 1].type)) {
+            lazy->groups[lazy->number_of_groups].first = i;
+            lazy->groups[lazy->number_of_groups].open_tail = NULL;
+            lazy->groups[lazy->number_of_groups].ready = 0;
+            ++(lazy->number_of_groups);
+        }
+        lazy->order[i] = keys[i].index;
+        lazy->entries[keys[i].index].group = lazy->number_of_groups - 1;
+        lazy->entries[keys[i].index].position = i;
+    }
+    free(keys);
+
+    if ((set_init(&(lazy->parsed), lazy->number_of_entries) != 0)
+        || (set_init(&(lazy->grouped), count) != 0))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int is_sub_entity(const char *name)
+{
+    return (strcmp(name, "VERTEX") == 0) || (strcmp(name, "SEQEND") == 0)
+        || (strcmp(name, "ATTRIB") == 0);
+}
+
+int dxf_lazy_index(struct dxf_lazy* const lazy, struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf* const dxf = parser_desc->dxf;
+    const char *buf = parser_desc->lexer_desc->buf;
+    const char *end;
+    const char *p;
+    const char *code_line;
+    const char *value_line;
+    struct dxf_lazy_section *section = NULL;
+    struct dxf_lazy_entry *entry;
+    struct dxf_layer *layer;
+    char value[DXF_LEXER_LINE_BUFFER_SIZE];
+    size_t current = (size_t)-1;
+    int in_entities = 0;
+    int expect_section_name = 0;
+    int group_code;
+
+    lazy->parser_desc = parser_desc;
+    lazy->entries = NULL;
+    lazy->number_of_entries = 0;
+    lazy->capacity = 0;
+    lazy->number_of_sections = 0;
+    lazy->keep = dxf->last_entity;
+    lazy->order = NULL;
+    lazy->groups = NULL;
+    lazy->number_of_groups = 0;
+    lazy->parsed.words = NULL;
+    lazy->grouped.words = NULL;
+
+    if (buf == NULL) {
+        errprint("dxflazy: dxf_lazy_index(): Lexer has no input. \n");
+        return -1;
+    }
+
+    p = buf;
+    end = buf + dxf_lexer_get_input_length(parser_desc->lexer_desc);
+
+    while (p < end) {
+        code_line = p;
+        value_line = next_line(p, end);
+        if (value_line >= end) {
+            break;
+        }
+        p = next_line(value_line, end);
+
+        if (read_group_code(code_line, value_line, &group_code) != 0) {
+            continue;
+        }
+
+        switch (group_code) {
+            case 0:
+                read_value(value_line, p, value);
+                expect_section_name = 0;
+
+                if (in_entities && is_sub_entity(value)) {
+                    /* Parsed together with their owner. */
+                    break;
+                }
+
+                close_entry(lazy, &current, (size_t)(code_line - buf));
+
+                if (strcmp(value, "SECTION") == 0) {
+                    section = NULL;
+                    if (lazy->number_of_sections < DXF_LAZY_MAX_SECTIONS) {
+                        section = &(lazy->sections[lazy->number_of_sections++]);
+                        section->name[0] = '\0';
+                        section->offset = (size_t)(code_line - buf);
+                        section->name_offset = section->offset;
+                        section->length = 0;
+                    }
+                    expect_section_name = 1;
+                }
+                else if (strcmp(value, "ENDSEC") == 0) {
+                    if (section != NULL) {
+                        section->length = (size_t)(p - buf) - section->offset;
+                        section = NULL;
+                    }
+                    in_entities = 0;
+                }
+                else if (strcmp(value, "EOF") == 0) {
+                    p = end;
+                }
+                else if (in_entities) {
+                    if ((entry = add_entry(lazy, (size_t)(code_line - buf),
+                                dxf_parser_get_entity_type(value))) == NULL) {
+                        dxf_lazy_close(lazy);
+                        return -1;
+                    }
+                    current = lazy->number_of_entries - 1;
+                }
+                break;
+
+            case 2:
+                if (expect_section_name) {
+                    read_value(value_line, p, value);
+                    in_entities = (strcmp(value, "ENTITIES") == 0);
+                    if (section != NULL) {
+                        copy_string(section->name, DXF_LAZY_SECTION_NAME_SIZE, value);
+                        section->name_offset = (size_t)(code_line - buf);
+                    }
+                    expect_section_name = 0;
+                }
+                break;
+
+            case 5:
+                if ((current != (size_t)-1) && (lazy->entries[current].handle[0] == '\0')) {
+                    read_value(value_line, p, value);
+                    copy_string(lazy->entries[current].handle, DXF_LAZY_HANDLE_SIZE, value);
+                }
+                break;
+
+            case 8:
+                if ((current != (size_t)-1) && (lazy->entries[current].layer == NULL)) {
+                    read_value(value_line, p, value);
+                    if (((layer = dxf_get_layer(dxf, value)) == NULL)
+                        && ((layer = dxf_add_layer(dxf, value)) == NULL))
+                    {
+                        dxf_lazy_close(lazy);
+                        return -1;
+                    }
+                    lazy->entries[current].layer = layer;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    close_entry(lazy, &current, (size_t)(p - buf));
+
+    if (group_entries(lazy) != 0) {
+        dxf_lazy_close(lazy);
+        return -1;
+    }
+
+    dbgprint("dxflazy: dxf_lazy_index(): Indexed %lu entities in %lu sections. \n",
+            (unsigned long)(lazy->number_of_entries), (unsigned long)(lazy->number_of_sections));
+
+    return 0;
+}
+
+const struct dxf_lazy_section* dxf_lazy_get_section(const struct dxf_lazy* const lazy,
+                                                    const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < lazy->number_of_sections; ++i) {
+        if (strcmp(lazy->sections[i].name, name) == 0) {
+            return &(lazy->sections[i]);
+        }
+    }
+
+    return NULL;
+}
+
+int dxf_lazy_open(struct dxf_lazy* const lazy, struct dxf_parser_desc* const parser_desc)
+{
+    const struct dxf_lazy_section *tables;
+    const struct dxf_lazy_section *blocks;
+
+    if (dxf_lazy_index(lazy, parser_desc) != 0) {
+        return -1;
+    }
+
+    if (((tables = dxf_lazy_get_section(lazy, "TABLES")) != NULL)
+        && ((dxf_lexer_seek(parser_desc->lexer_desc, tables->name_offset) != 0)
+            || (dxf_parser_parse_object(parser_desc, NULL) != 0)))
+    {
+        errprint("dxflazy: dxf_lazy_open(): Failed to parse the TABLES section. \n");
+        dxf_lazy_close(lazy);
+        return -1;
+    }
+    lazy->keep = parser_desc->dxf->last_entity;
+
+    if ((blocks = dxf_lazy_get_section(lazy, "BLOCKS")) == NULL) {
+        return 0;
+    }
+
+    parser_desc->target_block = NULL;
+    parser_desc->target_layer = NULL;
+
+    if ((dxf_lexer_seek(parser_desc->lexer_desc, blocks->name_offset) != 0)
+        || (dxf_parser_parse_object(parser_desc, NULL) != 0))
+    {
+        errprint("dxflazy: dxf_lazy_open(): Failed to parse the BLOCKS section. \n");
+        dxf_lazy_close(lazy);
+        return -1;
+    }
+
+    lazy->keep = parser_desc->dxf->last_entity;
+    return 0;
+}
+
+int dxf_lazy_close(struct dxf_lazy* const lazy)
+{
+    free(lazy->entries);
+    lazy->entries = NULL;
+    lazy->number_of_entries = 0;
+    lazy->capacity = 0;
+    free(lazy->order);
+    lazy->order = NULL;
+    free(lazy->groups);
+    lazy->groups = NULL;
+    lazy->number_of_groups = 0;
+    free(lazy->parsed.words);
+    lazy->parsed.words = NULL;
+    free(lazy->grouped.words);
+    lazy->grouped.words = NULL;
+    return 0;
+}
+
+/* Last of the layer list that was parsed on open. Looked up once, as
+ * only entities of other groups can come before it later.
+ */
+static struct dxf_entity* get_open_tail(const struct dxf_lazy* const lazy,
+                                        struct dxf_lazy_group* const group,
+                                        struct dxf_layer* const layer, int type)
+{
+    struct dxf_entity *next;
+
+    if (!group->ready) {
+        if (lazy->keep != NULL) {
+            for (next = layer->entities[type]; (next != NULL) && (next->seq <= lazy->keep->seq);
+                    next = next->next)
+            {
+                group->open_tail = next;
+            }
+        }
+        group->ready = 1;
+    }
+    return group->open_tail;
+}
+
+/* dxf_add_entity() appended the entity to the file list and its layer
+ * list. Moves it to where it belongs in both; tail and layer_tail are
+ * what the tails were before it was added.
+ */
+static void put_in_file_order(struct dxf_lazy* const lazy, size_t index, struct dxf_entity* const entity,
+                            struct dxf_entity* const tail, struct dxf_entity* const layer_tail)
+{
+    struct dxf* const dxf = lazy->parser_desc->dxf;
+    struct dxf_layer* const layer = entity->layer;
+    const int type = entity->type;
+    struct dxf_lazy_entry* const entry = &(lazy->entries[index]);
+    struct dxf_lazy_group *group;
+    struct dxf_entity *previous = NULL;
+    struct dxf_entity *next;
+    size_t found;
+
+    entity->seq = (lazy->keep != NULL ? lazy->keep->seq : 0) + index + 1;
+
+    /* Unlink from the tails. */
+    dxf->last_entity = tail;
+    if (tail != NULL) {
+        tail->next_in_file = NULL;
+    }
+    else {
+        dxf->first_entity = NULL;
+    }
+    layer->entities_tail[type] = layer_tail;
+    if (layer_tail != NULL) {
+        layer_tail->next = NULL;
+    }
+    else {
+        layer->entities[type] = NULL;
+    }
+
+    found = set_previous(&(lazy->parsed), index);
+    previous = (found != (size_t)-1) ? lazy->entries[found].entity : lazy->keep;
+    entity->next_in_file = (previous != NULL) ? previous->next_in_file : dxf->first_entity;
+    if (previous != NULL) {
+        previous->next_in_file = entity;
+    }
+    else {
+        dxf->first_entity = entity;
+    }
+    if (entity->next_in_file == NULL) {
+        dxf->last_entity = entity;
+    }
+
+    set_add(&(lazy->parsed), index);
+
+    /* Entities the index put in another group can only be found by
+     * walking, from the head if this one is in the wrong group too.
+     */
+    previous = NULL;
+    if ((entry->group != (size_t)-1) && (entry->layer == layer) && (entry->type == type)) {
+        group = &(lazy->groups[entry->group]);
+        found = set_previous(&(lazy->grouped), entry->position);
+        if ((found != (size_t)-1) && (found >= group->first)) {
+            previous = lazy->entries[lazy->order[found]].entity;
+        }
+        else {
+            previous = get_open_tail(lazy, group, layer, type);
+        }
+        set_add(&(lazy->grouped), entry->position);
+    }
+    next = (previous != NULL) ? previous->next : layer->entities[type];
+    while ((next != NULL) && (next->seq < entity->seq)) {
+        previous = next;
+        next = next->next;
+    }
+    entity->next = (previous != NULL) ? previous->next : layer->entities[type];
+    if (previous != NULL) {
+        previous->next = entity;
+    }
+    else {
+        layer->entities[type] = entity;
+    }
+    if (entity->next == NULL) {
+        layer->entities_tail[type] = entity;
+    }
+}
+
+struct dxf_entity* dxf_lazy_get_entity(struct dxf_lazy* const lazy, size_t index)
+{
+    struct dxf_parser_desc* const parser_desc = lazy->parser_desc;
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_lazy_entry *entry;
+    struct dxf_entity *entity;
+    struct dxf_entity *tail = dxf->last_entity;
+    struct dxf_entity *layer_tail = NULL;
+    struct dxf_entity *previous;
+
+    if (index >= lazy->number_of_entries) {
+        return NULL;
+    }
+
+    entry = &(lazy->entries[index]);
+    if (entry->parsed || (entry->type < 0)) {
+        return entry->entity;
+    }
+
+    if (entry->layer != NULL) {
+        layer_tail = entry->layer->entities_tail[entry->type];
+    }
+
+    parser_desc->target_block = NULL;
+    parser_desc->target_layer = NULL;
+
+    if ((dxf_lexer_seek(parser_desc->lexer_desc, entry->offset) != 0)
+        || (dxf_parser_parse_object(parser_desc, &entity) != 0))
+    {
+        errprint("dxflazy: dxf_lazy_get_entity(): Failed to parse entity %lu. \n",
+                (unsigned long)index);
+        return NULL;
+    }
+
+    /* No group 8, or on a hidden layer that is skipped. */
+    entry->parsed = 1;
+    if (entity == NULL) {
+        return NULL;
+    }
+
+    if ((entity->layer != NULL) && (dxf->last_entity == entity)) {
+        /* The index guessed another layer, e.g. from an attribute. */
+        if ((entity->layer != entry->layer) || (entity->type != entry->type)) {
+            layer_tail = NULL;
+            for (previous = entity->layer->entities[entity->type]; previous != entity; previous = previous->next) {
+                layer_tail = previous;
+            }
+        }
+        entry->entity = entity;
+        put_in_file_order(lazy, index, entity, tail, layer_tail);
+    }
+
+    entry->entity = entity;
+    return entity;
+}
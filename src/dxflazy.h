@@ -0,0 +1,91 @@
+#ifndef __DXF_LAZY_H__
+#define __DXF_LAZY_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxfparser.h"
+
+/* Lazy document. Opening only scans the ENTITIES section for the byte
+ * offset, type and layer of every entity; the TABLES and BLOCKS sections
+ * are parsed up front for layer properties and so that INSERTs can be
+ * resolved. dxf_lazy_index() does the scan alone and parses nothing.
+ * An entity is parsed into the document the first time it is asked for
+ * and cached from then on. Whatever the order of access, the document
+ * lists stay in file order, and seq is the position in the index after
+ * the entities parsed on open, so it has gaps until everything is
+ * parsed. Finding where a parsed entity goes takes time logarithmic in
+ * the number of entries. The lexer must stay open for as long as the lazy document is
+ * used.
+ */
+
+#define DXF_LAZY_HANDLE_SIZE 17
+#define DXF_LAZY_SECTION_NAME_SIZE 16
+#define DXF_LAZY_MAX_SECTIONS 8
+#define DXF_LAZY_SET_MAX_LEVELS 16
+
+struct dxf_lazy_entry {
+    size_t offset;                  /* Of the group 0 line. */
+    size_t length;                  /* Up to the next entity, sub-entities included. */
+    int type;                       /* -1 if there is no parser for it. */
+    char handle[DXF_LAZY_HANDLE_SIZE];  /* Group 5, empty if absent. */
+    struct dxf_layer *layer;
+    struct dxf_entity *entity;      /* NULL until parsed. */
+    int parsed;                     /* Also set when parsing gave no entity. */
+    size_t group;                   /* Of its layer and type, (size_t)-1 without a layer. */
+    size_t position;                /* In the group order. */
+};
+
+/* Entries of one layer and type, which sit together in the group order. */
+struct dxf_lazy_group {
+    size_t first;                   /* Position of the first one. */
+    struct dxf_entity *open_tail;   /* Of the layer list before the lazy ones, */
+    int ready;                      /* once looked up. */
+};
+
+/* Bit set with a summary word per word below it, so the closest member
+ * before a position takes a word scan per level.
+ */
+struct dxf_lazy_set {
+    unsigned long *words;
+    size_t level_offset[DXF_LAZY_SET_MAX_LEVELS];
+    int number_of_levels;
+};
+
+struct dxf_lazy_section {
+    char name[DXF_LAZY_SECTION_NAME_SIZE];
+    size_t offset;                  /* Of the 0/SECTION line. */
+    size_t name_offset;             /* Of the 2/name line. */
+    size_t length;                  /* Through the ENDSEC line. */
+};
+
+struct dxf_lazy {
+    struct dxf_parser_desc *parser_desc;
+    struct dxf_lazy_entry *entries;
+    size_t number_of_entries;
+    size_t capacity;
+    struct dxf_lazy_section sections[DXF_LAZY_MAX_SECTIONS];
+    size_t number_of_sections;
+    struct dxf_entity *keep;        /* Last entity before the lazy ones. */
+    size_t *order;                  /* Entry indices by group, then in file order. */
+    struct dxf_lazy_group *groups;
+    size_t number_of_groups;
+    struct dxf_lazy_set parsed;     /* Entries that hold an entity. */
+    struct dxf_lazy_set grouped;    /* Positions of those in their index group. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_lazy_index(struct dxf_lazy* const lazy, struct dxf_parser_desc* const parser_desc);
+int dxf_lazy_open(struct dxf_lazy* const lazy, struct dxf_parser_desc* const parser_desc);
+const struct dxf_lazy_section* dxf_lazy_get_section(const struct dxf_lazy* const lazy,
+                                                    const char *name);
+int dxf_lazy_close(struct dxf_lazy* const lazy);
+struct dxf_entity* dxf_lazy_get_entity(struct dxf_lazy* const lazy, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_LAZY_H__ */
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "dxflexer.h"
+#include "dxfbinary.h"
+#include "dxftokcache.h"
 #include "memmap.h"
 
 #include "dbgprint.h"
@@ -31,6 +33,7 @@ static int scan_integer(struct dxf_lexer_desc* const desc, int *pi);
 static int scan_float(struct dxf_lexer_desc* const desc, double *pf);
 static int scan_string(struct dxf_lexer_desc* const desc, char **buf);
 static int scan_binary(struct dxf_lexer_desc* const desc, void **buf);
+static int get_value_kind(const struct dxf_group_code_desc* const grp_code_desc);
 
 const struct dxf_group_code_desc dxf_invalid_desc = 
     { DXF_INVALID_TAG, "Invalid", -1, -1, (pfn_scanner_t)scan_string };
@@ -110,7 +113,7 @@ const struct dxf_group_code_desc dxf_group_code_descs[] = {
     { DXF_INVALID_TAG, NULL, -1, -1, (pfn_scanner_t)scan_string }
 };
 
-const struct dxf_token dxf_invalid_token = { DXF_INVALID_TAG, -1, { NULL }};
+const struct dxf_token dxf_invalid_token = { DXF_INVALID_TAG, -1, { NULL }, 0 };
 static int initialized;
 
 static int xlat_tab_init()
@@ -328,15 +331,50 @@ static int scan_string(struct dxf_lexer_desc* const desc, char **buf)
     return 0;
 }
 
+/* Decoded in place in the line buffer, so the bytes last until the next
+ * token. A line that is not hex yields no bytes.
+ */
 static int scan_binary(struct dxf_lexer_desc* const desc, void **buf)
 {
-    if (get_line(desc) == -1) {
+    int len;
+    size_t size;
+
+    if ((len = get_line(desc)) == -1) {
         return -1;
     }
 
+    size = dxf_binary_decode_hex(desc->line_buf, (size_t)len, (unsigned char*)desc->line_buf);
+    if (size == (size_t)-1) {
+        dbgprint("dxflexer: scan_binary(): Not a hex value: %s \n", desc->line_buf);
+        desc->token.value.bin = NULL;
+        desc->token.length = 0;
+        return 0;
+    }
+
+    desc->token.value.bin = desc->line_buf;
+    desc->token.length = size;
+
     return 0;
 }
 
+static int get_value_kind(const struct dxf_group_code_desc* const grp_code_desc)
+{
+    if (grp_code_desc->scanner == (pfn_scanner_t)scan_string) {
+        return DXF_TOKEN_CACHE_STRING;
+    }
+    else if (grp_code_desc->scanner == (pfn_scanner_t)scan_float) {
+        return DXF_TOKEN_CACHE_FLOAT;
+    }
+    else if (grp_code_desc->scanner == (pfn_scanner_t)scan_integer) {
+        return DXF_TOKEN_CACHE_INTEGER;
+    }
+    else if (grp_code_desc->scanner == (pfn_scanner_t)scan_binary) {
+        return DXF_TOKEN_CACHE_BINARY;
+    }
+
+    return DXF_TOKEN_CACHE_NONE;
+}
+
 int dxf_lexer_init()
 {
     if (initialized == 1) {
@@ -360,6 +398,7 @@ int dxf_lexer_init_desc(struct dxf_lexer_desc* const desc, const char *buf,
     desc->prev = buf;
     desc->fd = (memmap_fd_t)(-1);
     desc->pool = pool;
+    desc->cache = NULL;
     memcpy(&(desc->token), &dxf_invalid_token, sizeof(struct dxf_token));
     return 0;
 }
@@ -372,6 +411,7 @@ int dxf_lexer_clear_desc(struct dxf_lexer_desc* const desc)
     desc->prev = NULL;
     desc->fd = (memmap_fd_t)(-1);
     desc->pool = NULL;
+    desc->cache = NULL;
     memcpy(&(desc->token), &dxf_invalid_token, sizeof(struct dxf_token));
     return 0;
 }
@@ -413,6 +453,7 @@ int dxf_lexer_open_desc(struct dxf_lexer_desc* const desc, const char *filename,
     }
 
     memcpy(&(desc->token), &dxf_invalid_token, sizeof(struct dxf_token));
+    desc->cache = dxf_token_cache_open(filename, desc->buf, file_len);
 
     return 0;
 }
@@ -421,6 +462,11 @@ int dxf_lexer_close_desc(struct dxf_lexer_desc* const desc, int destroy_pool)
 {
     size_t file_len;
 
+    if (desc->cache != NULL) {
+        dxf_token_cache_close(desc->cache);
+        desc->cache = NULL;
+    }
+
     if (desc->fd != (memmap_fd_t)(-1)) {
         file_len = memmap_get_file_size(desc->fd);
         memmap_unmap((void*)(desc->buf), file_len, desc->fd2);
@@ -436,15 +482,68 @@ int dxf_lexer_close_desc(struct dxf_lexer_desc* const desc, int destroy_pool)
     return 0;
 }
 
+size_t dxf_lexer_get_input_length(const struct dxf_lexer_desc* const desc)
+{
+    if (desc->buf == NULL) {
+        return 0;
+    }
+
+    return (size_t)(desc->end - desc->buf) + 1;
+}
+
+/* Moves to a byte offset that must be the start of a group code line.
+ * The text stays mapped while a token cache is in use, so seeking just
+ * detaches the cache and reads text from then on; a cache being recorded
+ * is dropped unwritten since the stream is no longer read front to back.
+ */
+int dxf_lexer_seek(struct dxf_lexer_desc* const desc, size_t offset)
+{
+    if ((desc->buf == NULL) || (offset >= dxf_lexer_get_input_length(desc))) {
+        return -1;
+    }
+
+    if (desc->cache != NULL) {
+        desc->cache->complete = 0;
+        dxf_token_cache_close(desc->cache);
+        desc->cache = NULL;
+    }
+
+    desc->cur = desc->buf + offset;
+    desc->prev = desc->cur;
+    desc->token.tag = DXF_INVALID_TAG;
+    return 0;
+}
+
 int dxf_lexer_get_token(struct dxf_lexer_desc* const desc)
 {
     int retval;
     int grp_code;
     const struct dxf_group_code_desc* grp_code_desc;
+    struct dxf_token_cache* const cache = desc->cache;
+
+    if ((cache != NULL) && (cache->mode == DXF_TOKEN_CACHE_REPLAY)) {
+        if (dxf_token_cache_get(cache, &(desc->token)) != 0) {
+            return -1;
+        }
+        /* Binary values land in the line buffer, as when they are lexed. */
+        if ((xlat_tab_get(desc->token.group_code)->scanner == (pfn_scanner_t)scan_binary)
+            && (desc->token.value.bin != NULL))
+        {
+            if (desc->token.length > sizeof(desc->line_buf)) {
+                return -1;
+            }
+            memcpy(desc->line_buf, desc->token.value.bin, desc->token.length);
+            desc->token.value.bin = desc->line_buf;
+        }
+        return 0;
+    }
     
     desc->prev = desc->cur;
     
     if (scan_integer(desc, &grp_code) != 0) {
+        if (cache != NULL) {
+            cache->complete = 1;
+        }
         return -1;
     }
 
@@ -453,6 +552,18 @@ int dxf_lexer_get_token(struct dxf_lexer_desc* const desc)
     desc->token.tag = grp_code_desc->tag;
     desc->token.group_code = grp_code;
     retval = grp_code_desc->scanner(desc, NULL);
+
+    if ((cache != NULL) && (cache->mode == DXF_TOKEN_CACHE_RECORD)) {
+        if (retval != 0) {
+            cache->complete = 1;
+        }
+        else if (dxf_token_cache_record(cache, &(desc->token), get_value_kind(grp_code_desc)) == 0) {
+            /* Nothing after EOF matters, so the stream is complete here. */
+            if ((desc->token.tag == DXF_ENTITY_TYPE) && (strcmp(desc->token.value.str, "EOF") == 0)) {
+                cache->complete = 1;
+            }
+        }
+    }
     
     dbgprint("dxflexer: dxf_lexer_get_token(): Current token tag=%d, " \
             "group_code=%u, value=@0x%lx \n",
@@ -464,9 +575,18 @@ int dxf_lexer_get_token(struct dxf_lexer_desc* const desc)
 
 int dxf_lexer_unget_token(struct dxf_lexer_desc* const desc)
 {
+    if ((desc->cache != NULL) && (desc->cache->mode == DXF_TOKEN_CACHE_REPLAY)) {
+        desc->token.tag = DXF_INVALID_TAG;
+        return dxf_token_cache_unget(desc->cache);
+    }
+
     if (desc->cur == desc->prev) {
         return -1;
     }
+
+    if ((desc->cache != NULL) && (desc->cache->mode == DXF_TOKEN_CACHE_RECORD)) {
+        dxf_token_cache_unget(desc->cache);
+    }
     
     desc->cur = desc->prev;
     desc->token.tag = DXF_INVALID_TAG;
@@ -474,6 +594,125 @@ int dxf_lexer_unget_token(struct dxf_lexer_desc* const desc)
     return 0;
 }
 
+/* The value line of the last token as it stands in the input, without
+ * the 255 character limit of token strings. Tokens replayed from a cache
+ * have no place in the input, so this fails while replaying.
+ */
+int dxf_lexer_get_value_span(const struct dxf_lexer_desc* const desc, const char **str,
+                            size_t *length)
+{
+    const char *p = desc->prev;
+    const char *end = desc->end;
+
+    if (((desc->cache != NULL) && (desc->cache->mode == DXF_TOKEN_CACHE_REPLAY)) || (p == NULL)) {
+        return -1;
+    }
+
+    while ((p <= end) && (*p != '\n')) {
+        ++p;
+    }
+    if (p >= end) {
+        return -1;
+    }
+
+    *str = ++p;
+    while ((p <= end) && (*p != '\r') && (*p != '\n')) {
+        ++p;
+    }
+    *length = p - *str;
+
+    return 0;
+}
+
+static int is_listed(unsigned int group_code, const unsigned int *group_codes, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        if (group_codes[i] == group_code) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Skips groups while their codes are listed (or, with listed 0, while
+ * they are not), stopping before the first other one, which is read
+ * next. Skipped values are stepped over as lines and never converted. A
+ * token cache needs every token, so with one attached the groups are
+ * read as usual. Returns the number of groups skipped.
+ */
+static size_t skip_groups(struct dxf_lexer_desc* const desc, const unsigned int *group_codes,
+                        size_t count, int listed)
+{
+    size_t skipped = 0;
+    int grp_code;
+
+    if (desc->cache != NULL) {
+        while (dxf_lexer_get_token(desc) == 0) {
+            if (is_listed(desc->token.group_code, group_codes, count) != listed) {
+                dxf_lexer_unget_token(desc);
+                break;
+            }
+            ++skipped;
+        }
+        return skipped;
+    }
+
+    for (;;) {
+        desc->prev = desc->cur;
+        if (scan_integer(desc, &grp_code) != 0) {
+            break;
+        }
+        if ((grp_code < 0) || (is_listed((unsigned int)grp_code, group_codes, count) != listed)) {
+            desc->cur = desc->prev;
+            break;
+        }
+        if (next_line(desc) != 0) {
+            break;
+        }
+        ++skipped;
+    }
+
+    desc->prev = desc->cur;
+    desc->token.tag = DXF_INVALID_TAG;
+    return skipped;
+}
+
+size_t dxf_lexer_skip_groups(struct dxf_lexer_desc* const desc, const unsigned int *group_codes,
+                            size_t count)
+{
+    return skip_groups(desc, group_codes, count, 1);
+}
+
+size_t dxf_lexer_skip_other_groups(struct dxf_lexer_desc* const desc, const unsigned int *group_codes,
+                                size_t count)
+{
+    return skip_groups(desc, group_codes, count, 0);
+}
+
+/* Steps over the rest of the entity, from the group just read up to the
+ * next group 0, and returns that stretch of the input. Reads nothing and
+ * fails when a token cache is attached, as there may be no input.
+ */
+int dxf_lexer_skip_to_entity_end(struct dxf_lexer_desc* const desc, const char **str,
+                                size_t *length)
+{
+    static const unsigned int entity_end[] = { 0 };
+    const char *start = desc->prev;
+
+    if ((desc->cache != NULL) || (start == NULL)) {
+        return -1;
+    }
+
+    skip_groups(desc, entity_end, 1, 0);
+    *str = start;
+    *length = desc->cur - start;
+
+    return 0;
+}
+
 int dxf_lexer_skip_to(struct dxf_lexer_desc* const lexer_desc, int tag_expected)
 {
     while (dxf_lexer_get_token(lexer_desc) == 0) {
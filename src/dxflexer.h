@@ -74,6 +74,7 @@
 #define DXF_EXT_DATA_INTEGER32 61
 
 struct dxf_lexer_desc;
+struct dxf_token_cache;
 typedef int (*pfn_scanner_t)(struct dxf_lexer_desc* const, void*);
 
 struct dxf_group_code_desc {
@@ -93,6 +94,7 @@ struct dxf_token {
         double f;
         void *bin;
     } value;
+    size_t length;      /* Bytes at value.bin. */
 };
 
 struct dxf_lexer_desc {
@@ -105,6 +107,7 @@ struct dxf_lexer_desc {
     char line_buf[DXF_LEXER_LINE_BUFFER_SIZE];
     struct crapool_desc *pool;
     struct dxf_token token;
+    struct dxf_token_cache *cache;
 };
 
 extern const struct dxf_group_code_desc dxf_invalid_desc;
@@ -122,9 +125,19 @@ int dxf_lexer_clear_desc(struct dxf_lexer_desc* const desc);
 int dxf_lexer_open_desc(struct dxf_lexer_desc* const desc, const char *filename, 
                         struct crapool_desc* const pool);
 int dxf_lexer_close_desc(struct dxf_lexer_desc* const desc, int destroy_pool);
+size_t dxf_lexer_get_input_length(const struct dxf_lexer_desc* const desc);
+int dxf_lexer_seek(struct dxf_lexer_desc* const desc, size_t offset);
 int dxf_lexer_get_token(struct dxf_lexer_desc* const desc);
 int dxf_lexer_unget_token(struct dxf_lexer_desc* const desc);
 int dxf_lexer_skip_to(struct dxf_lexer_desc* const lexer_desc, int tag_expected);
+int dxf_lexer_get_value_span(const struct dxf_lexer_desc* const desc, const char **str,
+                            size_t *length);
+size_t dxf_lexer_skip_groups(struct dxf_lexer_desc* const desc, const unsigned int *group_codes,
+                            size_t count);
+size_t dxf_lexer_skip_other_groups(struct dxf_lexer_desc* const desc, const unsigned int *group_codes,
+                                size_t count);
+int dxf_lexer_skip_to_entity_end(struct dxf_lexer_desc* const desc, const char **str,
+                                size_t *length);
 
 #ifdef __cplusplus
 }
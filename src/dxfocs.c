@@ -0,0 +1,284 @@
+#include <math.h>
+#include <string.h>
+#include "dxfocs.h"
+
+#include "dbgprint.h"
+
+/* The Arbitrary Axis Algorithm's threshold for a normal near the Z axis. */
+#define ARBITRARY_AXIS_LIMIT (1.0 / 64.0)
+
+/* NULL for entity types without an OCS, 3D polylines and meshes included. */
+const double* dxf_ocs_get_extrusion(const struct dxf_entity* const entity)
+{
+    const struct dxf_polyline *polyline;
+
+    switch (entity->type) {
+        case DXF_CIRCLE:
+            return ((const struct dxf_circle*)entity)->extrusion;
+        case DXF_ARC:
+            return ((const struct dxf_arc*)entity)->extrusion;
+        case DXF_LWPOLYLINE:
+            return ((const struct dxf_lwpolyline*)entity)->extrusion;
+        case DXF_INSERT:
+            return ((const struct dxf_insert*)entity)->extrusion;
+        case DXF_HATCH:
+            return ((const struct dxf_hatch*)entity)->extrusion;
+        case DXF_SOLID:
+            return ((const struct dxf_solid*)entity)->extrusion;
+        case DXF_TEXTSTRING:
+            return ((const struct dxf_text*)entity)->extrusion;
+        case DXF_POLYLINE:
+            polyline = (const struct dxf_polyline*)entity;
+            return (polyline->flag & (DXF_POLYLINE_FLAG_3D | DXF_POLYLINE_FLAG_MESH
+                                    | DXF_POLYLINE_FLAG_POLYFACE)) ? NULL : polyline->extrusion;
+        default:
+            return NULL;
+    }
+}
+
+int dxf_ocs_is_identity(const double extrusion[3])
+{
+    return (extrusion[0] == 0.0) && (extrusion[1] == 0.0) && (extrusion[2] > 0.0);
+}
+
+static void cross(const double a[3], const double b[3], double out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static int normalize(double v[3])
+{
+    double length = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    if (length == 0.0) {
+        return -1;
+    }
+
+    v[0] /= length;
+    v[1] /= length;
+    v[2] /= length;
+    return 0;
+}
+
+/* OCS axes as the columns of the linear part; no translation. */
+void dxf_ocs_get_transform(const double extrusion[3], struct dxf_transform* const transform)
+{
+    static const double world_y[3] = { 0.0, 1.0, 0.0 };
+    static const double world_z[3] = { 0.0, 0.0, 1.0 };
+    double ax[3];
+    double ay[3];
+    double az[3];
+    int i;
+
+    dxf_transform_identity(transform);
+
+    memcpy(az, extrusion, sizeof(az));
+    if (dxf_ocs_is_identity(extrusion) || (normalize(az) != 0)) {
+        return;
+    }
+
+    if ((fabs(az[0]) < ARBITRARY_AXIS_LIMIT) && (fabs(az[1]) < ARBITRARY_AXIS_LIMIT)) {
+        cross(world_y, az, ax);
+    }
+    else {
+        cross(world_z, az, ax);
+    }
+    normalize(ax);
+    cross(az, ax, ay);
+    normalize(ay);
+
+    for (i = 0; i < 3; ++i) {
+        transform->m[i][0] = ax[i];
+        transform->m[i][1] = ay[i];
+        transform->m[i][2] = az[i];
+    }
+}
+
+/* count points, stride doubles apart, converted in place. */
+void dxf_ocs_to_wcs(const double extrusion[3], double *points, size_t count, size_t stride)
+{
+    struct dxf_transform transform;
+    double m00, m01, m02, m10, m11, m12, m20, m21, m22;
+    double x;
+    double y;
+    double z;
+    size_t i;
+
+    if (dxf_ocs_is_identity(extrusion)) {
+        return;
+    }
+
+    dxf_ocs_get_transform(extrusion, &transform);
+
+    /* Locals rather than the matrix, so the loop keeps them in registers
+     * and vectorises.
+     */
+    m00 = transform.m[0][0]; m01 = transform.m[0][1]; m02 = transform.m[0][2];
+    m10 = transform.m[1][0]; m11 = transform.m[1][1]; m12 = transform.m[1][2];
+    m20 = transform.m[2][0]; m21 = transform.m[2][1]; m22 = transform.m[2][2];
+
+    for (i = 0; i < count; ++i, points += stride) {
+        x = points[0];
+        y = points[1];
+        z = points[2];
+        points[0] = m00 * x + m01 * y + m02 * z;
+        points[1] = m10 * x + m11 * y + m12 * z;
+        points[2] = m20 * x + m21 * y + m22 * z;
+    }
+}
+
+/* Reflected edges run the other way. An arc angle a becomes 180 - a, and
+ * an elliptic edge's parameter t becomes -t about the reflected axis.
+ */
+static void mirror_hatch(struct dxf_hatch* const hatch)
+{
+    struct dxf_hatch_edge *edge;
+    double angle;
+    size_t i;
+
+    hatch->elevation = -hatch->elevation;
+    for (i = 0; i < hatch->number_of_vertices; ++i) {
+        hatch->vertices[i].x = -hatch->vertices[i].x;
+        hatch->vertices[i].bulge = -hatch->vertices[i].bulge;
+    }
+    for (i = 0; i < hatch->number_of_edges; ++i) {
+        edge = &(hatch->edges[i]);
+        edge->x = -edge->x;
+        edge->x2 = -edge->x2;
+        angle = edge->angle_start;
+        if (edge->type == DXF_HATCH_EDGE_ARC) {
+            edge->angle_start = 180.0 - angle;
+            edge->angle_end = 180.0 - edge->angle_end;
+            edge->flag = !edge->flag;
+        }
+        else if (edge->type == DXF_HATCH_EDGE_ELLIPSE) {
+            edge->angle_start = -angle;
+            edge->angle_end = -edge->angle_end;
+            edge->flag = !edge->flag;
+        }
+    }
+    for (i = 0; i < hatch->number_of_control_points; ++i) {
+        hatch->control_points[3 * i] = -hatch->control_points[3 * i];
+    }
+    for (i = 0; i < hatch->number_of_seeds; ++i) {
+        hatch->seeds[2 * i] = -hatch->seeds[2 * i];
+    }
+    for (i = 0; i < hatch->number_of_pattern_lines; ++i) {
+        hatch->pattern_lines[i].angle = 180.0 - hatch->pattern_lines[i].angle;
+        hatch->pattern_lines[i].x = -hatch->pattern_lines[i].x;
+        hatch->pattern_lines[i].dx = -hatch->pattern_lines[i].dx;
+    }
+    hatch->pattern_angle = 180.0 - hatch->pattern_angle;
+}
+
+/* A normal along -Z maps (x, y, z) to (-x, y, -z). */
+static void mirror(struct dxf_entity* const entity)
+{
+    struct dxf_circle *circle;
+    struct dxf_arc *arc;
+    struct dxf_lwpolyline_vertex *vertex;
+    struct dxf_polyline *polyline;
+    struct dxf_insert *insert;
+    struct dxf_solid *solid;
+    struct dxf_text *text;
+    double angle;
+    size_t i;
+
+    switch (entity->type) {
+        case DXF_CIRCLE:
+            circle = (struct dxf_circle*)entity;
+            circle->x = -circle->x;
+            circle->z = -circle->z;
+            break;
+        case DXF_ARC:
+            arc = (struct dxf_arc*)entity;
+            arc->x = -arc->x;
+            arc->z = -arc->z;
+            angle = arc->angle_start;
+            arc->angle_start = 180.0 - arc->angle_end;
+            arc->angle_end = 180.0 - angle;
+            break;
+        case DXF_LWPOLYLINE:
+            vertex = ((struct dxf_lwpolyline*)entity)->vertices;
+            for (; vertex != NULL; vertex = vertex->next) {
+                vertex->x = -vertex->x;
+                vertex->z = -vertex->z;
+                vertex->bulge = -vertex->bulge;
+            }
+            break;
+        case DXF_POLYLINE:
+            polyline = (struct dxf_polyline*)entity;
+            polyline->elevation = -polyline->elevation;
+            for (i = 0; i < polyline->number_of_vertices; ++i) {
+                polyline->vertices[i].x = -polyline->vertices[i].x;
+                polyline->vertices[i].z = -polyline->vertices[i].z;
+                polyline->vertices[i].bulge = -polyline->vertices[i].bulge;
+            }
+            break;
+        case DXF_HATCH:
+            mirror_hatch((struct dxf_hatch*)entity);
+            break;
+        case DXF_SOLID:
+            solid = (struct dxf_solid*)entity;
+            for (i = 0; i < 4; ++i) {
+                solid->corners[i][0] = -solid->corners[i][0];
+                solid->corners[i][2] = -solid->corners[i][2];
+            }
+            break;
+        case DXF_TEXTSTRING:
+            /* As for INSERT; generation flag 2 makes the text run backward. */
+            text = (struct dxf_text*)entity;
+            text->x = -text->x;
+            text->z = -text->z;
+            text->x2 = -text->x2;
+            text->z2 = -text->z2;
+            text->angle = -text->angle;
+            text->oblique = -text->oblique;
+            text->generation ^= 2;
+            break;
+        case DXF_INSERT:
+            /* M R(a) S = R(-a) S M, and M flips the column direction. */
+            insert = (struct dxf_insert*)entity;
+            insert->x = -insert->x;
+            insert->z = -insert->z;
+            insert->angle = -insert->angle;
+            insert->x_scale = -insert->x_scale;
+            insert->z_scale = -insert->z_scale;
+            insert->column_spacing = -insert->column_spacing;
+            break;
+        default:
+            break;
+    }
+}
+
+/* Rewrites entities whose normal lies along the Z axis into world
+ * coordinates with a +Z normal; that covers mirrored geometry. Entities
+ * in tilted planes cannot be expressed by these structures and are left
+ * as they are; the return value counts them. Use dxf_ocs_get_transform()
+ * for those.
+ */
+size_t dxf_ocs_entities_to_wcs(struct dxf_entity** const entities, size_t count)
+{
+    double *extrusion;
+    size_t tilted = 0;
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        extrusion = (double*)dxf_ocs_get_extrusion(entities[i]);
+        if ((extrusion == NULL) || dxf_ocs_is_identity(extrusion)) {
+            continue;
+        }
+
+        if ((extrusion[0] != 0.0) || (extrusion[1] != 0.0) || (extrusion[2] == 0.0)) {
+            ++tilted;
+            continue;
+        }
+
+        mirror(entities[i]);
+        extrusion[2] = 1.0;
+    }
+
+    return tilted;
+}
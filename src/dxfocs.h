@@ -0,0 +1,30 @@
+#ifndef __DXF_OCS_H__
+#define __DXF_OCS_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxfinsert.h"
+
+/* Object coordinate systems. CIRCLE, ARC, LWPOLYLINE, 2D POLYLINE, HATCH,
+ * SOLID and INSERT are given in the plane whose normal is their extrusion
+ * direction (groups 210/220/230); the Arbitrary Axis Algorithm derives
+ * the OCS x and y axes from that normal. A normal along +Z is the identity and
+ * every routine here returns straight away for it, without normalising
+ * or touching the data.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const double* dxf_ocs_get_extrusion(const struct dxf_entity* const entity);
+int dxf_ocs_is_identity(const double extrusion[3]);
+void dxf_ocs_get_transform(const double extrusion[3], struct dxf_transform* const transform);
+void dxf_ocs_to_wcs(const double extrusion[3], double *points, size_t count, size_t stride);
+size_t dxf_ocs_entities_to_wcs(struct dxf_entity** const entities, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_OCS_H__ */
@@ -5,6 +5,9 @@
 #include "hashtab.h"
 #include "dbgprint.h"
 
+/* First allocation of arrays whose size is not announced. */
+#define DXF_PARSER_MIN_ARRAY_CAPACITY 16
+
 static int initialized = 0;
 
 static struct hashtable parsers;
@@ -22,7 +25,12 @@ static const char *str_mtext = "MTEXT";
 static const char *str_text = "TEXT";
 static const char *str_solid = "SOLID";
 static const char *str_spline = "SPLINE";
+static const char *str_polyline = "POLYLINE";
+static const char *str_vertex = "VERTEX";
+static const char *str_dimension = "DIMENSION";
 static const char *str_block = "BLOCK";
+static const char *str_table = "TABLE";
+static const char *str_layer = "LAYER";
 static const char *str_section = "SECTION";
 static const char *str_header = "HEADER";
 static const char *str_classes = "CLASSES";
@@ -36,6 +44,31 @@ static const char *str_endsec = "ENDSEC";
 static const char *str_endtab = "ENDTAB";
 static const char *str_seqend = "SEQEND";
 static const char *str_eof = "EOF";
+static const char *str_xdictionary = "{ACAD_XDICTIONARY";
+
+struct entity_type_name {
+    const char **name;
+    int type;
+};
+
+static const struct entity_type_name entity_type_names[] = {
+    { &str_point, DXF_POINT },
+    { &str_line, DXF_LINE },
+    { &str_arc, DXF_ARC },
+    { &str_circle, DXF_CIRCLE },
+    { &str_ellipse, DXF_ELLIPSE },
+    { &str_vertex, DXF_VERTEX },
+    { &str_polyline, DXF_POLYLINE },
+    { &str_lwpolyline, DXF_LWPOLYLINE },
+    { &str_spline, DXF_SPLINE },
+    { &str_dimension, DXF_DIMENSION },
+    { &str_hatch, DXF_HATCH },
+    { &str_insert, DXF_INSERT },
+    { &str_text, DXF_TEXTSTRING },
+    { &str_mtext, DXF_MTEXT },
+    { &str_solid, DXF_SOLID },
+    { NULL, -1 }
+};
 
 static unsigned int str_hash(const char **psz);
 static int str_cmp(const char **psz1, const char **psz2);
@@ -48,9 +81,26 @@ static int parse_circle(struct dxf_parser_desc* const parser_desc);
 static int parse_lwpolyline(struct dxf_parser_desc* const parser_desc);
 static int parse_arc(struct dxf_parser_desc* const parser_desc);
 static int parse_insert(struct dxf_parser_desc* const parser_desc);
+static int parse_spline(struct dxf_parser_desc* const parser_desc);
+static int parse_ellipse(struct dxf_parser_desc* const parser_desc);
+static int parse_polyline(struct dxf_parser_desc* const parser_desc);
+static int parse_hatch(struct dxf_parser_desc* const parser_desc);
+static int parse_text(struct dxf_parser_desc* const parser_desc);
+static int parse_solid(struct dxf_parser_desc* const parser_desc);
+static int parse_dimension(struct dxf_parser_desc* const parser_desc);
+static int parse_mtext(struct dxf_parser_desc* const parser_desc);
 static int parse_block(struct dxf_parser_desc* const parser_desc);
 static int parse_blocks(struct dxf_parser_desc* const parser_desc);
 static int parse_entities(struct dxf_parser_desc* const parser_desc);
+static int parse_header(struct dxf_parser_desc* const parser_desc);
+static int parse_tables(struct dxf_parser_desc* const parser_desc);
+static int parse_thumbnailimage(struct dxf_parser_desc* const parser_desc);
+static int is_hidden_layer(struct dxf* const dxf, const char *name);
+static void skip_entity(struct dxf_lexer_desc* const lexer_desc);
+static int capture_xdata(struct dxf_parser_desc* const parser_desc, struct dxf_entity* const entity);
+static int capture_dictionary(struct dxf_parser_desc* const parser_desc, struct dxf_entity* const entity);
+static void count_vertices(struct dxf* const dxf, size_t old_capacity, size_t capacity,
+                        size_t item_size);
 
 #define DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, entity, entity_type) \
     case DXF_ENTITY_TYPE: \
@@ -69,10 +119,41 @@ static int parse_entities(struct dxf_parser_desc* const parser_desc);
     case DXF_LAYER_NAME: \
         if (parser_desc->target_layer == NULL) { \
             dbgprint("layer=%s \n", token->value.str); \
+            if ((parser_desc->flags & DXF_PARSER_SKIP_HIDDEN_LAYERS) \
+                && (parser_desc->target_block == NULL) && is_hidden_layer(dxf, token->value.str)) { \
+                dbgprint("dxfparser: Dropped " #entity " on a hidden layer. \n"); \
+                skip_entity(lexer_desc); \
+                return 0; \
+            } \
             dxf_add_entity(dxf, token->value.str, (struct dxf_entity*)entity, DXF_ADD_ENTITY_TO_LAYER); \
         } \
         break; \
 
+#define DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, entity) \
+    case DXF_EXTRUSION_DIRECTION_X: \
+        (entity)->extrusion[0] = token->value.f; \
+        break; \
+    case DXF_EXTRUSION_DIRECTION_Y: \
+        (entity)->extrusion[1] = token->value.f; \
+        break; \
+    case DXF_EXTRUSION_DIRECTION_Z: \
+        (entity)->extrusion[2] = token->value.f; \
+        break; \
+
+/* XDATA ends the entity, so the loop goes on with the group 0 after it. */
+#define DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, entity) \
+    case DXF_EXT_DATA_APP_NAME: \
+        if (capture_xdata(parser_desc, (struct dxf_entity*)(entity)) != 0) { \
+            return -1; \
+        } \
+        continue; \
+    case DXF_CONTROL_STRING: \
+        if ((strcmp(token->value.str, str_xdictionary) == 0) \
+            && (capture_dictionary(parser_desc, (struct dxf_entity*)(entity)) != 0)) { \
+            return -1; \
+        } \
+        break; \
+
 static unsigned int str_hash(const char **psz) {
     unsigned int hash = 0;
     const char *sz = *psz;
@@ -126,6 +207,7 @@ static int parse_point(struct dxf_parser_desc* const parser_desc)
         switch (token->tag) {
             DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, point, DXF_POINT);
             DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, point, DXF_POINT);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, point);
             case DXF_X:
                 dbgprint("x=%f \n", token->value.f);
                 point->x = token->value.f;
@@ -163,6 +245,7 @@ static int parse_line(struct dxf_parser_desc* const parser_desc)
         switch (token->tag) {
             DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, line, DXF_LINE);
             DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, line, DXF_LINE);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, line);
             case DXF_X:
                 if (token->group_code == 10) {
                     dbgprint("x1=%f \n", token->value.f);
@@ -218,6 +301,8 @@ static int parse_circle(struct dxf_parser_desc* const parser_desc)
         switch (token->tag) {
             DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, circle, DXF_CIRCLE);
             DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, circle, DXF_CIRCLE);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, circle);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, circle);
             case DXF_X:
                 dbgprint("x=%f \n", token->value.f);
                 circle->x = token->value.f;
@@ -265,6 +350,8 @@ static int parse_lwpolyline(struct dxf_parser_desc* const parser_desc)
         switch (token->tag) {
             DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, lwpolyline, DXF_LWPOLYLINE);
             DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, lwpolyline, DXF_LWPOLYLINE);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, lwpolyline);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, lwpolyline);
             case DXF_INTEGER:
                 if (token->group_code == 70) {
                     dbgprint("flag=%d \n", token->value.i);
@@ -287,6 +374,7 @@ static int parse_lwpolyline(struct dxf_parser_desc* const parser_desc)
                     errprint("dxfparser: parse_lwpolyline(): Failed to allocate space for vertices. \n");
                     return -1;
                 }
+                count_vertices(dxf, 0, 1, sizeof(struct dxf_lwpolyline_vertex));
                 dbgprint("dxfparser: parse_lwpolyline(): Allocated space for lwpolyline vertex @0x%lx \n", 
                         (unsigned long)vertex);
                 vertex->next = NULL;
@@ -352,6 +440,8 @@ static int parse_arc(struct dxf_parser_desc* const parser_desc)
         switch (token->tag) {
             DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, arc, DXF_ARC);
             DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, arc, DXF_ARC);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, arc);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, arc);
             case DXF_X:
                 dbgprint("x=%f \n", token->value.f);
                 arc->x = token->value.f;
@@ -388,190 +478,188 @@ static int parse_arc(struct dxf_parser_desc* const parser_desc)
     return -1;
 }
 
-static int parse_insert(struct dxf_parser_desc* const parser_desc)
+static int parse_ellipse(struct dxf_parser_desc* const parser_desc)
 {
     struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
     struct dxf_token* const token = &(lexer_desc->token);
     struct dxf* const dxf = parser_desc->dxf;
-
-    struct dxf_insert *insert;
-    struct dxf_layer *layer_of_block = NULL;
-
-    dbgprint("dxfparser: Insert entity \n");
-
-    if ((insert = (struct dxf_insert*)dxf_alloc_entity(dxf, DXF_INSERT)) == NULL) {
+    struct dxf_ellipse* ellipse;
+    
+    dbgprint("dxfparser: Ellipse entity \n");
+    
+    if ((ellipse = (struct dxf_ellipse*)dxf_alloc_entity(dxf, DXF_ELLIPSE)) == NULL) {
         return -1;
     }
-
+    
     while (dxf_lexer_get_token(lexer_desc) == 0) {
         switch (token->tag) {
-            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, insert, DXF_INSERT);
-            case DXF_BLOCK_NAME:
-                dbgprint("blockname=%s \n", token->value.str);
-                if ((insert->header.block = dxf_get_block(dxf, token->value.str)) != NULL) {
-                    layer_of_block = insert->header.block->parent;
-                    if (layer_of_block != NULL) {
-                        dxf_add_entity(dxf, layer_of_block->name,
-                            (struct dxf_entity*)insert, DXF_ADD_ENTITY_TO_LAYER);
-                    }
-                    else {
-                        errprint("dxf_parser: WARNING: Block %s did not attached to a layer. \n", token->value.str);
-                    }
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, ellipse, DXF_ELLIPSE);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, ellipse, DXF_ELLIPSE);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, ellipse);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, ellipse);
+            case DXF_X:
+                if (token->group_code == 10) {
+                    ellipse->x = token->value.f;
                 }
-                else {
-                    errprint("dxf_parser: Block %s was not found. \n", token->value.str);
+                else if (token->group_code == 11) {
+                    ellipse->major[0] = token->value.f;
                 }
                 break;
-            case DXF_X:
-                dbgprint("x=%f \n", token->value.f);
-                insert->x = token->value.f;
-                break;
             case DXF_Y:
-                dbgprint("y=%f \n", token->value.f);
-                insert->y = token->value.f;
+                if (token->group_code == 20) {
+                    ellipse->y = token->value.f;
+                }
+                else if (token->group_code == 21) {
+                    ellipse->major[1] = token->value.f;
+                }
                 break;
             case DXF_Z:
-                dbgprint("z=%f \n", token->value.f);
-                insert->z = token->value.f;
+                if (token->group_code == 30) {
+                    ellipse->z = token->value.f;
+                }
+                else if (token->group_code == 31) {
+                    ellipse->major[2] = token->value.f;
+                }
                 break;
             case DXF_FLOAT:
-                switch (token->group_code) {
-                    case 41:
-                        dbgprint("x_scale=%f \n", token->value.f);
-                        insert->x_scale = token->value.f;
-                        break;
-                    case 42:
-                        dbgprint("y_scale=%f \n", token->value.f);
-                        insert->y_scale = token->value.f;
-                        break;
-                    case 43:
-                        dbgprint("z_scale=%f \n", token->value.f);
-                        insert->z_scale = token->value.f;
-                        break;
-                    case 44:
-                        dbgprint("column_spacing=%f \n", token->value.f);
-                        insert->column_spacing = token->value.f;
-                        break;
-                    case 45:
-                        dbgprint("row_spacing=%f \n", token->value.f);
-                        insert->row_spacing = token->value.f;
-                        break;
-                    default:
-                        break;
+                if (token->group_code == 40) {
+                    dbgprint("ratio=%f \n", token->value.f);
+                    ellipse->ratio = token->value.f;
                 }
-                break;
-            case DXF_INTEGER:
-                switch (token->group_code) {
-                    case 70:
-                        dbgprint("column_count=%d \n", token->value.i);
-                        insert->column_count = token->value.i;
-                        break;
-                    case 71:
-                        dbgprint("row_count=%d \n", token->value.i);
-                        insert->row_count = token->value.i;
-                        break;
-                    default:
-                        break;
+                else if (token->group_code == 41) {
+                    dbgprint("param_start=%f \n", token->value.f);
+                    ellipse->param_start = token->value.f;
+                }
+                else if (token->group_code == 42) {
+                    dbgprint("param_end=%f \n", token->value.f);
+                    ellipse->param_end = token->value.f;
                 }
-                break;
-            case DXF_ANGLE:
-                dbgprint("angle=%f \n", token->value.f);
-                insert->angle = token->value.f;
                 break;
             default:
                 break;
         }
     }
+    
+    return -1;
+}
+
+/* Announced counts of groups 72, 73 and 74 size the arrays up front. */
+static double* alloc_spline_array(struct dxf* const dxf, int count, size_t doubles_per_item)
+{
+    double *array;
+
+    if (count <= 0) {
+        return NULL;
+    }
 
-    return 0;
+    if ((array = (double*)dxf_alloc_binary(dxf, count * doubles_per_item * sizeof(double))) == NULL) {
+        errprint("dxfparser: alloc_spline_array(): Failed to allocate %d items. \n", count);
+    }
+
+    return array;
 }
 
-static int parse_block(struct dxf_parser_desc* const parser_desc)
+static int parse_spline(struct dxf_parser_desc* const parser_desc)
 {
     struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
     struct dxf_token* const token = &(lexer_desc->token);
     struct dxf* const dxf = parser_desc->dxf;
-    const pfn_parser_t *pfn_parser;
-    int parser_return_value = -1;
+    struct dxf_spline *spline;
+    double *point = NULL;
+    size_t knots_capacity = 0;
+    size_t control_points_capacity = 0;
+    size_t fit_points_capacity = 0;
+    size_t number_of_weights = 0;
+    size_t i;
 
-    parser_desc->target_layer = NULL;
-    parser_desc->target_block = NULL;
+    dbgprint("dxfparser: Spline entity \n");
 
-    dbgprint("dxfparser: Block \n");
+    if ((spline = (struct dxf_spline*)dxf_alloc_entity(dxf, DXF_SPLINE)) == NULL) {
+        return -1;
+    }
 
     while (dxf_lexer_get_token(lexer_desc) == 0) {
         switch (token->tag) {
-            case DXF_ENTITY_TYPE:
-                if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
-                    if (*pfn_parser != NULL) {
-                        parser_return_value = (*pfn_parser)(parser_desc);
-                    }
-                }
-                else {
-                    dbgprint("dxf_parser: Skipping entity type %s \n", token->value.str);
-                    continue;
-                }
-
-                switch (parser_return_value) {
-                    case 0:
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, spline, DXF_SPLINE);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, spline, DXF_SPLINE);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, spline);
+            case DXF_INTEGER:
+                switch (token->group_code) {
+                    case 70:
+                        dbgprint("flag=%d \n", token->value.i);
+                        spline->flag = token->value.i;
                         break;
-                    case 1:
-                        if (strcmp(token->value.str, str_endblk) == 0) {
-                            parser_desc->target_layer = NULL;
-                            parser_desc->target_block = NULL;
-                            dbgprint("dxfparser: End of block. \n");
-                            return 0;
+                    case 71:
+                        dbgprint("degree=%d \n", token->value.i);
+                        spline->degree = token->value.i;
+                        break;
+                    case 72:
+                        dbgprint("number_of_knots=%d \n", token->value.i);
+                        if ((spline->knots == NULL)
+                            && ((spline->knots = alloc_spline_array(dxf, token->value.i, 1)) != NULL)) {
+                            knots_capacity = token->value.i;
+                        }
+                        break;
+                    case 73:
+                        dbgprint("number_of_control_points=%d \n", token->value.i);
+                        if ((spline->control_points == NULL)
+                            && ((spline->control_points = alloc_spline_array(dxf, token->value.i, 3)) != NULL)) {
+                            control_points_capacity = token->value.i;
+                        }
+                        break;
+                    case 74:
+                        dbgprint("number_of_fit_points=%d \n", token->value.i);
+                        if ((spline->fit_points == NULL)
+                            && ((spline->fit_points = alloc_spline_array(dxf, token->value.i, 3)) != NULL)) {
+                            fit_points_capacity = token->value.i;
                         }
                         break;
                     default:
-                        errprint("dxf_parser: Stopped after an error occured when parsing an entity. \n");
-                        parser_desc->target_layer = NULL;
-                        parser_desc->target_block = NULL;
-                        return -1;
-                }
-                break;
-            case DXF_LAYER_NAME:
-                dbgprint("layer=%s \n", token->value.str);
-                if ((parser_desc->target_layer = dxf_get_layer(dxf, token->value.str)) == NULL) {
-                    if (dxf_add_layer(dxf, token->value.str) == NULL) {
-                        return -1;
-                    }
-                    parser_desc->target_layer = dxf_get_layer(dxf, token->value.str);
+                        break;
                 }
                 break;
-            case DXF_BLOCK_NAME:
-                dbgprint("block=%s \n", token->value.str);
-                if ((parser_desc->target_block = dxf_get_block(dxf, token->value.str)) == NULL) {
-                    if (dxf_add_block(dxf, token->value.str, parser_desc->target_layer) == NULL) {
-                        return -1;
-                    }
-                    parser_desc->target_block = dxf_get_block(dxf, token->value.str);
+            case DXF_X:
+                point = NULL;
+                if ((token->group_code == 10)
+                    && (spline->number_of_control_points < control_points_capacity)) {
+                    point = spline->control_points + 3 * spline->number_of_control_points++;
                 }
-                break;
-            case DXF_INTEGER:
-                if (token->group_code == 70) {
-                    if (parser_desc->target_block != NULL) {
-                        dbgprint("flag=%d \n", token->value.i);
-                        parser_desc->target_block->flag = token->value.i;
-                    }
+                else if ((token->group_code == 11)
+                    && (spline->number_of_fit_points < fit_points_capacity)) {
+                    point = spline->fit_points + 3 * spline->number_of_fit_points++;
                 }
-                break;
-            case DXF_X:
-                dbgprint("x=%f \n", token->value.f);
-                if (parser_desc->target_block != NULL) {
-                    parser_desc->target_block->x = token->value.f;
+                else {
+                    dbgprint("Unexpected or unwanted token, skipping... \n");
+                    break;
                 }
+                point[0] = token->value.f;
+                point[1] = point[2] = 0.0;
                 break;
             case DXF_Y:
-                dbgprint("y=%f \n", token->value.f);
-                if (parser_desc->target_block != NULL) {
-                    parser_desc->target_block->y = token->value.f;
+                if (point != NULL) {
+                    point[1] = token->value.f;
                 }
                 break;
             case DXF_Z:
-                dbgprint("z=%f \n", token->value.f);
-                if (parser_desc->target_block != NULL) {
-                    parser_desc->target_block->z = token->value.f;
+                if (point != NULL) {
+                    point[2] = token->value.f;
+                }
+                break;
+            case DXF_FLOAT:
+                if ((token->group_code == 40) && (spline->number_of_knots < knots_capacity)) {
+                    spline->knots[spline->number_of_knots++] = token->value.f;
+                }
+                else if ((token->group_code == 41) && (number_of_weights < control_points_capacity)) {
+                    /* Weights come in control point order, wherever they stand. */
+                    if (spline->weights == NULL) {
+                        if ((spline->weights = alloc_spline_array(dxf, (int)control_points_capacity, 1)) == NULL) {
+                            return -1;
+                        }
+                        for (i = 0; i < control_points_capacity; ++i) {
+                            spline->weights[i] = 1.0;
+                        }
+                    }
+                    spline->weights[number_of_weights++] = token->value.f;
                 }
                 break;
             default:
@@ -579,79 +667,1644 @@ static int parse_block(struct dxf_parser_desc* const parser_desc)
         }
     }
 
-    return 0;
+    return -1;
 }
 
-static int parse_blocks(struct dxf_parser_desc* const parser_desc)
+static void attach_insert(struct dxf* const dxf, struct dxf_insert* const insert,
+                            struct dxf_block* const block)
 {
-    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
-    struct dxf_token* const token = &(lexer_desc->token);
-    const pfn_parser_t *pfn_parser;
-    int parser_return_value = -1;
-
-    dbgprint("dxfparser: Parsing BLOCKS section. \n");
+    struct dxf_layer* const layer_of_block = block->parent;
 
-    parser_desc->target_layer = NULL;
-    parser_desc->target_block = NULL;
+    insert->block_ref = block;
+    if (layer_of_block != NULL) {
+        dxf_add_entity(dxf, layer_of_block->name,
+            (struct dxf_entity*)insert, DXF_ADD_ENTITY_TO_LAYER);
+    }
+    else {
+        errprint("dxf_parser: WARNING: Block %s did not attached to a layer. \n", block->name);
+    }
+}
 
-    while (dxf_lexer_get_token(lexer_desc) == 0) {
-        if (token->tag == DXF_ENTITY_TYPE) {
-            if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
-                if (*pfn_parser != NULL) {
-                    parser_return_value = (*pfn_parser)(parser_desc);
-                }
-            }
-            else {
-                dbgprint("dxf_parser: Skipping object type %s \n", token->value.str);
-                continue;
-            }
+/* Blocks may be defined after they are first used, or parsed apart from
+ * the entities that use them, so unknown names are resolved later.
+ */
+static int add_fixup(struct dxf_parser_desc* const parser_desc, struct dxf_insert* const insert,
+                    const char *block_name)
+{
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_fixup *fixup;
+    char *name;
+    size_t len = strlen(block_name);
 
-            switch (parser_return_value) {
-                case 0:
-                    break;
-                case 1:
-                    if (strcmp(token->value.str, str_endsec) == 0) {
-                        parser_desc->target_layer = NULL;
-                        parser_desc->target_block = NULL;
-                        dbgprint("dxfparser: End of BLOCKS section. \n");
-                        return 0;
-                    }
-                    break;
-                default:
-                    errprint("dxf_parser: Stopped after an error occured when parsing an object. \n");
-                    parser_desc->target_layer = NULL;
-                    parser_desc->target_block = NULL;
-                    return -1;
-            }
-        }
+    if (((fixup = (struct dxf_fixup*)dxf_alloc_binary(dxf, sizeof(struct dxf_fixup))) == NULL)
+        || ((name = dxf_alloc_string(dxf, len)) == NULL))
+    {
+        return -1;
     }
 
+    memcpy(name, block_name, len + 1);
+    fixup->insert = insert;
+    fixup->block_name = name;
+    fixup->next = parser_desc->fixups;
+    parser_desc->fixups = fixup;
+    ++(parser_desc->number_of_fixups);
+
+    dbgprint("dxfparser: add_fixup(): Deferred reference to block %s. \n", block_name);
     return 0;
 }
 
-static int parse_entities(struct dxf_parser_desc* const parser_desc)
+/* Counts a vertex array that went from old_capacity to capacity items;
+ * a grown array is a new allocation.
+ */
+static void count_vertices(struct dxf* const dxf, size_t old_capacity, size_t capacity,
+                        size_t item_size)
 {
-    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
-    struct dxf_token* const token = &(lexer_desc->token);
-    const pfn_parser_t *pfn_parser;
-    int parser_return_value = -1;
+    if (capacity != old_capacity) {
+        dxf->stats.vertex_bytes += capacity * item_size;
+    }
+}
 
-    dbgprint("dxfparser: Parsing ENTITIES section. \n");
+/* Grows a pool array to twice its capacity. The old array stays in the
+ * pool, so the waste is bounded by the final size, and a polyline of n
+ * vertices costs O(log n) allocations rather than n.
+ */
+static void* grow_array(struct dxf* const dxf, void *array, size_t count,
+                        size_t *capacity, size_t item_size)
+{
+    size_t new_capacity = (*capacity < DXF_PARSER_MIN_ARRAY_CAPACITY) ?
+                            DXF_PARSER_MIN_ARRAY_CAPACITY : 2 * *capacity;
+    void *new_array;
 
-    parser_desc->target_layer = NULL;
-    parser_desc->target_block = NULL;
+    if ((new_array = dxf_alloc_binary(dxf, new_capacity * item_size)) == NULL) {
+        errprint("dxfparser: grow_array(): Failed to grow to %lu items. \n",
+                (unsigned long)new_capacity);
+        return NULL;
+    }
 
-    while (dxf_lexer_get_token(lexer_desc) == 0) {
-        if (token->tag == DXF_ENTITY_TYPE) {
-            if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
-                if (*pfn_parser != NULL) {
-                    parser_return_value = (*pfn_parser)(parser_desc);
-                }
-            }
-            else {
-                dbgprint("dxf_parser: Skipping entity type %s \n", token->value.str);
-                continue;
-            }
+    if (count > 0) {
+        memcpy(new_array, array, count * item_size);
+    }
+    *capacity = new_capacity;
+
+    return new_array;
+}
+
+/* Sizes announced in groups 71 and 72; *capacity stays 0 on failure,
+ * which only means the array will be grown instead.
+ */
+static void* alloc_polyline_array(struct dxf* const dxf, int count, size_t item_size,
+                                size_t *capacity)
+{
+    void *array;
+
+    if ((count <= 0) || ((array = dxf_alloc_binary(dxf, count * item_size)) == NULL)) {
+        return NULL;
+    }
+    *capacity = count;
+
+    return array;
+}
+
+/* Polyface face records carry vertex indices, every other VERTEX a point. */
+static int add_polyline_vertex(struct dxf* const dxf, struct dxf_polyline* const polyline,
+                            const struct dxf_polyline_vertex* const vertex, const int indices[4],
+                            size_t *vertices_capacity, size_t *faces_capacity)
+{
+    struct dxf_polyline_face *face;
+    const size_t old_capacity = *vertices_capacity;
+
+    if ((vertex->flag & DXF_VERTEX_FLAG_POLYFACE) && !(vertex->flag & DXF_VERTEX_FLAG_MESH)) {
+        if ((polyline->number_of_faces == *faces_capacity)
+            && ((polyline->faces = grow_array(dxf, polyline->faces, polyline->number_of_faces,
+                                        faces_capacity, sizeof(struct dxf_polyline_face))) == NULL)) {
+            return -1;
+        }
+        face = &(polyline->faces[polyline->number_of_faces++]);
+        memcpy(face->vertices, indices, sizeof(face->vertices));
+        return 0;
+    }
+
+    if ((polyline->number_of_vertices == *vertices_capacity)
+        && ((polyline->vertices = grow_array(dxf, polyline->vertices, polyline->number_of_vertices,
+                                    vertices_capacity, sizeof(struct dxf_polyline_vertex))) == NULL)) {
+        return -1;
+    }
+    count_vertices(dxf, old_capacity, *vertices_capacity, sizeof(struct dxf_polyline_vertex));
+    memcpy(&(polyline->vertices[polyline->number_of_vertices++]), vertex,
+            sizeof(struct dxf_polyline_vertex));
+
+    return 0;
+}
+
+/* POLYLINE, then its VERTEXes up to SEQEND, as one entity. Meshes and
+ * polyface meshes announce their sizes in groups 71 and 72, so their
+ * arrays are allocated once; other polylines grow theirs by doubling.
+ */
+#define IN_POLYLINE 0
+#define IN_VERTEX 1
+#define IN_SEQEND 2
+
+static int parse_polyline(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_polyline *polyline;
+    struct dxf_polyline_vertex vertex;
+    int indices[4] = { 0, 0, 0, 0 };
+    size_t vertices_capacity = 0;
+    size_t faces_capacity = 0;
+    size_t i;
+    int state = IN_POLYLINE;
+
+    dbgprint("dxfparser: Polyline entity \n");
+
+    if ((polyline = (struct dxf_polyline*)dxf_alloc_entity(dxf, DXF_POLYLINE)) == NULL) {
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        if (token->tag == DXF_ENTITY_TYPE) {
+            if ((state == IN_VERTEX) && (add_polyline_vertex(dxf, polyline, &vertex, indices,
+                                            &vertices_capacity, &faces_capacity) != 0)) {
+                return -1;
+            }
+
+            if ((state != IN_SEQEND) && (strcmp(token->value.str, str_vertex) == 0)) {
+                if ((state == IN_POLYLINE) && (polyline->flag & DXF_POLYLINE_FLAG_POLYFACE)) {
+                    polyline->vertices = alloc_polyline_array(dxf, polyline->m_count,
+                                        sizeof(struct dxf_polyline_vertex), &vertices_capacity);
+                    polyline->faces = alloc_polyline_array(dxf, polyline->n_count,
+                                        sizeof(struct dxf_polyline_face), &faces_capacity);
+                    count_vertices(dxf, 0, vertices_capacity, sizeof(struct dxf_polyline_vertex));
+                }
+                else if ((state == IN_POLYLINE) && (polyline->flag & DXF_POLYLINE_FLAG_MESH)
+                        && (polyline->n_count > 0)) {
+                    polyline->vertices = alloc_polyline_array(dxf, polyline->m_count * polyline->n_count,
+                                        sizeof(struct dxf_polyline_vertex), &vertices_capacity);
+                    count_vertices(dxf, 0, vertices_capacity, sizeof(struct dxf_polyline_vertex));
+                }
+                state = IN_VERTEX;
+                vertex.x = vertex.y = vertex.z = vertex.bulge = 0.0;
+                vertex.flag = 0;
+                indices[0] = indices[1] = indices[2] = indices[3] = 0;
+                continue;
+            }
+            if ((state != IN_SEQEND) && (strcmp(token->value.str, str_seqend) == 0)) {
+                state = IN_SEQEND;
+                continue;
+            }
+
+            dxf_lexer_unget_token(lexer_desc);
+            dbgprint("dxfparser: End of polyline entity, %lu vertices. \n",
+                    (unsigned long)polyline->number_of_vertices);
+            if (!(polyline->flag & (DXF_POLYLINE_FLAG_3D | DXF_POLYLINE_FLAG_MESH
+                                    | DXF_POLYLINE_FLAG_POLYFACE))) {
+                for (i = 0; i < polyline->number_of_vertices; ++i) {
+                    polyline->vertices[i].z = polyline->elevation;
+                }
+            }
+            if (parser_desc->target_layer != NULL) {
+                dxf_add_entity(dxf, parser_desc->target_layer->name, (struct dxf_entity*)polyline,
+                                DXF_ADD_ENTITY_TO_LAYER);
+            }
+            if (parser_desc->target_block != NULL) {
+                dxf_add_entity(dxf, parser_desc->target_block->name, (struct dxf_entity*)polyline,
+                                DXF_ADD_ENTITY_TO_BLOCK);
+            }
+            parser_desc->entity_post_parse_hooks[DXF_POLYLINE]((struct dxf_entity*)polyline);
+            return 0;
+        }
+
+        if (state == IN_SEQEND) {
+            continue;
+        }
+
+        if (state == IN_VERTEX) {
+            switch (token->tag) {
+                case DXF_X:
+                    vertex.x = token->value.f;
+                    break;
+                case DXF_Y:
+                    vertex.y = token->value.f;
+                    break;
+                case DXF_Z:
+                    vertex.z = token->value.f;
+                    break;
+                case DXF_FLOAT:
+                    if (token->group_code == 42) {
+                        vertex.bulge = token->value.f;
+                    }
+                    break;
+                case DXF_INTEGER:
+                    if (token->group_code == 70) {
+                        vertex.flag = token->value.i;
+                    }
+                    else if ((token->group_code >= 71) && (token->group_code <= 74)) {
+                        indices[token->group_code - 71] = token->value.i;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            continue;
+        }
+
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, polyline, DXF_POLYLINE);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, polyline);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, polyline);
+            case DXF_Z:
+                if (token->group_code == 30) {
+                    dbgprint("elevation=%f \n", token->value.f);
+                    polyline->elevation = token->value.f;
+                }
+                break;
+            case DXF_INTEGER:
+                switch (token->group_code) {
+                    case 70:
+                        dbgprint("flag=%d \n", token->value.i);
+                        polyline->flag = token->value.i;
+                        break;
+                    case 71:
+                        polyline->m_count = token->value.i;
+                        break;
+                    case 72:
+                        polyline->n_count = token->value.i;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+/* Appends a zeroed item to a pool array. Loops, edges and the rest are
+ * shared by the whole hatch, so each array grows by doubling however
+ * the boundaries are split.
+ */
+static void* append_item(struct dxf* const dxf, void **array, size_t *count, size_t *capacity,
+                        size_t item_size)
+{
+    void *item;
+
+    if ((*count == *capacity)
+        && ((*array = grow_array(dxf, *array, *count, capacity, item_size)) == NULL)) {
+        return NULL;
+    }
+
+    item = (char*)*array + (*count)++ * item_size;
+    memset(item, 0, item_size);
+
+    return item;
+}
+
+#define IN_HATCH 0
+#define IN_BOUNDARY 1
+#define IN_PATTERN 2
+#define IN_SEEDS 3
+
+struct hatch_state {
+    int section;
+    size_t loops_capacity;
+    size_t vertices_capacity;
+    size_t edges_capacity;
+    size_t knots_capacity;
+    size_t control_points_capacity;
+    size_t pattern_lines_capacity;
+    size_t dashes_capacity;
+    size_t seeds_capacity;
+    size_t number_of_weights;   /* Of the current spline edge. */
+};
+
+/* Groups of spline edges; 10/20 are control points, weights come after. */
+static int parse_hatch_spline_edge(struct dxf* const dxf, const struct dxf_token* const token,
+                                struct dxf_hatch* const hatch, struct hatch_state* const state)
+{
+    struct dxf_hatch_edge* const edge = &(hatch->edges[hatch->number_of_edges - 1]);
+    double *value;
+
+    switch (token->group_code) {
+        case 73:
+            edge->flag = token->value.i;
+            break;
+        case 94:
+            edge->degree = token->value.i;
+            break;
+        case 40:
+            if ((value = (double*)append_item(dxf, (void**)&(hatch->knots), &(hatch->number_of_knots),
+                                        &(state->knots_capacity), sizeof(double))) == NULL) {
+                return -1;
+            }
+            *value = token->value.f;
+            ++edge->number_of_knots;
+            break;
+        case 10:
+            if ((value = (double*)append_item(dxf, (void**)&(hatch->control_points),
+                                        &(hatch->number_of_control_points),
+                                        &(state->control_points_capacity), 3 * sizeof(double))) == NULL) {
+                return -1;
+            }
+            value[0] = token->value.f;
+            value[2] = 1.0;
+            ++edge->number_of_control_points;
+            break;
+        case 20:
+            if (edge->number_of_control_points > 0) {
+                hatch->control_points[3 * (hatch->number_of_control_points - 1) + 1] = token->value.f;
+            }
+            break;
+        case 42:
+            if (state->number_of_weights < edge->number_of_control_points) {
+                hatch->control_points[3 * (edge->first_control_point + state->number_of_weights++) + 2] =
+                    token->value.f;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* Group 92 opens a loop, and in an edge loop group 72 opens an edge. */
+static int parse_hatch_boundary(struct dxf* const dxf, const struct dxf_token* const token,
+                            struct dxf_hatch* const hatch, struct hatch_state* const state)
+{
+    struct dxf_hatch_loop *loop;
+    struct dxf_hatch_vertex *vertex;
+    struct dxf_hatch_edge *edge;
+    size_t capacity;
+
+    if (token->group_code == 92) {
+        if ((loop = (struct dxf_hatch_loop*)append_item(dxf, (void**)&(hatch->loops),
+                                        &(hatch->number_of_loops), &(state->loops_capacity),
+                                        sizeof(struct dxf_hatch_loop))) == NULL) {
+            return -1;
+        }
+        loop->flag = token->value.i;
+        loop->first = (loop->flag & DXF_HATCH_LOOP_FLAG_POLYLINE) ?
+                        hatch->number_of_vertices : hatch->number_of_edges;
+        return 0;
+    }
+
+    if (hatch->number_of_loops == 0) {
+        return 0;
+    }
+    loop = &(hatch->loops[hatch->number_of_loops - 1]);
+
+    if (loop->flag & DXF_HATCH_LOOP_FLAG_POLYLINE) {
+        switch (token->group_code) {
+            case 73:
+                loop->closed = token->value.i;
+                break;
+            case 10:
+                capacity = state->vertices_capacity;
+                if ((vertex = (struct dxf_hatch_vertex*)append_item(dxf, (void**)&(hatch->vertices),
+                                        &(hatch->number_of_vertices), &(state->vertices_capacity),
+                                        sizeof(struct dxf_hatch_vertex))) == NULL) {
+                    return -1;
+                }
+                count_vertices(dxf, capacity, state->vertices_capacity, sizeof(struct dxf_hatch_vertex));
+                vertex->x = token->value.f;
+                ++loop->count;
+                break;
+            case 20:
+                if (loop->count > 0) {
+                    hatch->vertices[hatch->number_of_vertices - 1].y = token->value.f;
+                }
+                break;
+            case 42:
+                if (loop->count > 0) {
+                    hatch->vertices[hatch->number_of_vertices - 1].bulge = token->value.f;
+                }
+                break;
+            default:
+                break;
+        }
+        return 0;
+    }
+
+    if (token->group_code == 72) {
+        if ((edge = (struct dxf_hatch_edge*)append_item(dxf, (void**)&(hatch->edges),
+                                        &(hatch->number_of_edges), &(state->edges_capacity),
+                                        sizeof(struct dxf_hatch_edge))) == NULL) {
+            return -1;
+        }
+        edge->type = token->value.i;
+        edge->first_knot = hatch->number_of_knots;
+        edge->first_control_point = hatch->number_of_control_points;
+        state->number_of_weights = 0;
+        ++loop->count;
+        return 0;
+    }
+
+    if (loop->count == 0) {
+        return 0;
+    }
+    edge = &(hatch->edges[hatch->number_of_edges - 1]);
+
+    if (edge->type == DXF_HATCH_EDGE_SPLINE) {
+        return parse_hatch_spline_edge(dxf, token, hatch, state);
+    }
+
+    switch (token->group_code) {
+        case 10:
+            edge->x = token->value.f;
+            break;
+        case 20:
+            edge->y = token->value.f;
+            break;
+        case 11:
+            edge->x2 = token->value.f;
+            break;
+        case 21:
+            edge->y2 = token->value.f;
+            break;
+        case 40:
+            edge->r = token->value.f;
+            break;
+        case 50:
+            edge->angle_start = token->value.f;
+            break;
+        case 51:
+            edge->angle_end = token->value.f;
+            break;
+        case 73:
+            edge->flag = token->value.i;
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* Pattern definition lines are only read when they are wanted; otherwise
+ * the lexer steps over them without converting a single value.
+ */
+static int parse_hatch_pattern(struct dxf_parser_desc* const parser_desc, const struct dxf_token* const token,
+                            struct dxf_hatch* const hatch, struct hatch_state* const state)
+{
+    static const unsigned int pattern_line_groups[] = { 53, 43, 44, 45, 46, 79, 49 };
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_hatch_pattern_line *line = NULL;
+    double *dash;
+
+    if (hatch->number_of_pattern_lines > 0) {
+        line = &(hatch->pattern_lines[hatch->number_of_pattern_lines - 1]);
+    }
+
+    switch (token->group_code) {
+        case 75:
+            hatch->style = token->value.i;
+            break;
+        case 76:
+            hatch->pattern_type = token->value.i;
+            break;
+        case 52:
+            hatch->pattern_angle = token->value.f;
+            break;
+        case 41:
+            hatch->pattern_scale = token->value.f;
+            break;
+        case 78:
+            if (parser_desc->flags & DXF_PARSER_SKIP_HATCH_PATTERNS) {
+                dxf_lexer_skip_groups(parser_desc->lexer_desc, pattern_line_groups,
+                            sizeof(pattern_line_groups) / sizeof(pattern_line_groups[0]));
+            }
+            break;
+        case 53:
+            if ((line = (struct dxf_hatch_pattern_line*)append_item(dxf, (void**)&(hatch->pattern_lines),
+                                        &(hatch->number_of_pattern_lines), &(state->pattern_lines_capacity),
+                                        sizeof(struct dxf_hatch_pattern_line))) == NULL) {
+                return -1;
+            }
+            line->angle = token->value.f;
+            line->first_dash = hatch->number_of_dashes;
+            break;
+        case 43:
+            if (line != NULL) {
+                line->x = token->value.f;
+            }
+            break;
+        case 44:
+            if (line != NULL) {
+                line->y = token->value.f;
+            }
+            break;
+        case 45:
+            if (line != NULL) {
+                line->dx = token->value.f;
+            }
+            break;
+        case 46:
+            if (line != NULL) {
+                line->dy = token->value.f;
+            }
+            break;
+        case 49:
+            if (line == NULL) {
+                break;
+            }
+            if ((dash = (double*)append_item(dxf, (void**)&(hatch->dashes), &(hatch->number_of_dashes),
+                                        &(state->dashes_capacity), sizeof(double))) == NULL) {
+                return -1;
+            }
+            *dash = token->value.f;
+            ++line->number_of_dashes;
+            break;
+        case 98:
+            state->section = IN_SEEDS;
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* HATCH. Boundaries start at group 91, the pattern at group 75 and the
+ * seed points at group 98, so the section decides what a group means.
+ */
+static int parse_hatch(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_hatch *hatch;
+    struct hatch_state state;
+    char *name;
+    double *seed;
+    size_t len;
+
+    dbgprint("dxfparser: Hatch entity \n");
+
+    if ((hatch = (struct dxf_hatch*)dxf_alloc_entity(dxf, DXF_HATCH)) == NULL) {
+        return -1;
+    }
+    memset(&state, 0, sizeof(state));
+    state.section = IN_HATCH;
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, hatch, DXF_HATCH);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, hatch, DXF_HATCH);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, hatch);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, hatch);
+            default:
+                break;
+        }
+
+        if ((state.section == IN_BOUNDARY) && (token->group_code == 75)) {
+            state.section = IN_PATTERN;
+        }
+
+        switch (state.section) {
+            case IN_HATCH:
+                if (token->group_code == 30) {
+                    hatch->elevation = token->value.f;
+                }
+                else if (token->group_code == 2) {
+                    len = strlen(token->value.str);
+                    if ((name = dxf_alloc_string(dxf, len)) == NULL) {
+                        return -1;
+                    }
+                    memcpy(name, token->value.str, len + 1);
+                    hatch->pattern_name = name;
+                    dbgprint("pattern=%s \n", name);
+                }
+                else if (token->group_code == 70) {
+                    hatch->solid_fill = token->value.i;
+                }
+                else if (token->group_code == 91) {
+                    state.section = IN_BOUNDARY;
+                }
+                break;
+            case IN_BOUNDARY:
+                if (parse_hatch_boundary(dxf, token, hatch, &state) != 0) {
+                    return -1;
+                }
+                break;
+            case IN_PATTERN:
+                if (parse_hatch_pattern(parser_desc, token, hatch, &state) != 0) {
+                    return -1;
+                }
+                break;
+            case IN_SEEDS:
+                if (token->group_code == 10) {
+                    if ((seed = (double*)append_item(dxf, (void**)&(hatch->seeds), &(hatch->number_of_seeds),
+                                        &(state.seeds_capacity), 2 * sizeof(double))) == NULL) {
+                        return -1;
+                    }
+                    seed[0] = token->value.f;
+                }
+                else if ((token->group_code == 20) && (hatch->number_of_seeds > 0)) {
+                    hatch->seeds[2 * (hatch->number_of_seeds - 1) + 1] = token->value.f;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+/* The XDATA of the entity, added on first use. */
+static struct dxf_xdata* get_xdata(struct dxf* const dxf, struct dxf_entity* const entity)
+{
+    struct dxf_xdata *xdata;
+
+    if (entity->xdata != NULL) {
+        return entity->xdata;
+    }
+
+    if ((xdata = (struct dxf_xdata*)dxf_alloc_binary(dxf, sizeof(struct dxf_xdata))) == NULL) {
+        return NULL;
+    }
+    memset(xdata, 0, sizeof(struct dxf_xdata));
+    entity->xdata = xdata;
+
+    return xdata;
+}
+
+/* A token cache leaves no input to point at, so the groups are written
+ * back out as DXF text in the pool, 1004 bytes encoded as hex again.
+ */
+static int copy_xdata(struct dxf_parser_desc* const parser_desc, struct dxf_xdata* const xdata)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    char line[2 * DXF_LEXER_LINE_BUFFER_SIZE + 32];
+    char *buf = NULL;
+    char *p;
+    char *copy;
+    size_t length = 0;
+    size_t capacity = 0;
+    size_t n;
+    size_t i;
+    unsigned int code;
+
+    do {
+        if (token->tag == DXF_ENTITY_TYPE) {
+            dxf_lexer_unget_token(lexer_desc);
+            break;
+        }
+
+        code = token->group_code;
+        if (code == 1004) {
+            n = (size_t)sprintf(line, "%u\n", code);
+            for (i = 0; (token->value.bin != NULL) && (i < token->length); ++i) {
+                n += (size_t)sprintf(line + n, "%02X", ((const unsigned char*)token->value.bin)[i]);
+            }
+            strcpy(line + n, "\n");
+        }
+        else if ((code >= 1010) && (code < 1060)) {
+            sprintf(line, "%u\n%.17g\n", code, token->value.f);
+        }
+        else if (code >= 1060) {
+            sprintf(line, "%u\n%d\n", code, token->value.i);
+        }
+        else {
+            sprintf(line, "%u\n%.*s\n", code, DXF_LEXER_MAX_LINE_LENGTH, token->value.str);
+        }
+
+        n = strlen(line);
+        if (length + n > capacity) {
+            capacity = (capacity == 0) ? 4 * sizeof(line) : 2 * capacity;
+            if ((p = (char*)realloc(buf, capacity)) == NULL) {
+                errprint("dxfparser: copy_xdata(): Out of memory. \n");
+                free(buf);
+                return -1;
+            }
+            buf = p;
+        }
+        memcpy(buf + length, line, n);
+        length += n;
+    } while (dxf_lexer_get_token(lexer_desc) == 0);
+
+    if ((copy = dxf_alloc_string(parser_desc->dxf, length)) == NULL) {
+        free(buf);
+        return -1;
+    }
+    if (length > 0) {
+        memcpy(copy, buf, length);
+    }
+    copy[length] = '\0';
+    free(buf);
+
+    xdata->str = copy;
+    xdata->length = length;
+    xdata->copied = 1;
+
+    return 0;
+}
+
+/* On the first 1001 group. Nothing is converted; see dxfxdata.h. */
+static int capture_xdata(struct dxf_parser_desc* const parser_desc, struct dxf_entity* const entity)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_xdata *xdata;
+
+    if ((xdata = get_xdata(parser_desc->dxf, entity)) == NULL) {
+        return -1;
+    }
+
+    if (dxf_lexer_skip_to_entity_end(lexer_desc, &(xdata->str), &(xdata->length)) != 0) {
+        return copy_xdata(parser_desc, xdata);
+    }
+
+    dbgprint("dxfparser: %lu bytes of XDATA. \n", (unsigned long)xdata->length);
+    return 0;
+}
+
+/* {ACAD_XDICTIONARY 360 } */
+static int capture_dictionary(struct dxf_parser_desc* const parser_desc, struct dxf_entity* const entity)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf_xdata *xdata;
+    char *handle;
+    size_t len;
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            case DXF_ENTITY_TYPE:
+                dxf_lexer_unget_token(lexer_desc);
+                return 0;
+            case DXF_CONTROL_STRING:
+                return 0;
+            case DXF_HARD_OWNER_HANDLE:
+                len = strlen(token->value.str);
+                if (((xdata = get_xdata(parser_desc->dxf, entity)) == NULL)
+                    || ((handle = dxf_alloc_string(parser_desc->dxf, len)) == NULL))
+                {
+                    return -1;
+                }
+                memcpy(handle, token->value.str, len + 1);
+                xdata->dictionary = handle;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/* Records where the value of the current group 1 or 3 lies in the input
+ * and appends it to the body; nothing is copied unless the token came
+ * from a cache. *tail is the last span so far, NULL for none.
+ */
+static int add_text_span(struct dxf_parser_desc* const parser_desc, struct dxf_text_body* const body,
+                        struct dxf_text_span **tail)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_text_span *span;
+    const char *str;
+    char *copy;
+    size_t length;
+
+    if (dxf_lexer_get_value_span(lexer_desc, &str, &length) != 0) {
+        length = strlen(lexer_desc->token.value.str);
+        if ((copy = dxf_alloc_string(dxf, length)) == NULL) {
+            return -1;
+        }
+        memcpy(copy, lexer_desc->token.value.str, length + 1);
+        str = copy;
+    }
+
+    if ((span = (struct dxf_text_span*)dxf_alloc_binary(dxf, sizeof(struct dxf_text_span))) == NULL) {
+        return -1;
+    }
+    span->str = str;
+    span->length = length;
+    span->next = NULL;
+
+    if (*tail == NULL) {
+        body->spans = span;
+    }
+    else {
+        (*tail)->next = span;
+    }
+    *tail = span;
+    body->length += length;
+
+    return 0;
+}
+
+static int parse_text(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_text *text;
+    struct dxf_text_span *tail = NULL;
+
+    dbgprint("dxfparser: Text entity \n");
+
+    if ((text = (struct dxf_text*)dxf_alloc_entity(dxf, DXF_TEXTSTRING)) == NULL) {
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, text, DXF_TEXTSTRING);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, text, DXF_TEXTSTRING);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, text);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, text);
+            case DXF_ENTITY_PRIMARY_TEXT:
+                if (add_text_span(parser_desc, &(text->body), &tail) != 0) {
+                    return -1;
+                }
+                break;
+            case DXF_X:
+                if (token->group_code == 10) {
+                    text->x = token->value.f;
+                }
+                else if (token->group_code == 11) {
+                    text->x2 = token->value.f;
+                }
+                break;
+            case DXF_Y:
+                if (token->group_code == 20) {
+                    text->y = token->value.f;
+                }
+                else if (token->group_code == 21) {
+                    text->y2 = token->value.f;
+                }
+                break;
+            case DXF_Z:
+                if (token->group_code == 30) {
+                    text->z = token->value.f;
+                }
+                else if (token->group_code == 31) {
+                    text->z2 = token->value.f;
+                }
+                break;
+            case DXF_FLOAT:
+                if (token->group_code == 40) {
+                    text->height = token->value.f;
+                }
+                else if (token->group_code == 41) {
+                    text->x_scale = token->value.f;
+                }
+                break;
+            case DXF_ANGLE:
+                if (token->group_code == 50) {
+                    text->angle = token->value.f;
+                }
+                else if (token->group_code == 51) {
+                    text->oblique = token->value.f;
+                }
+                break;
+            case DXF_INTEGER:
+                if (token->group_code == 71) {
+                    text->generation = token->value.i;
+                }
+                else if (token->group_code == 72) {
+                    text->horizontal_justification = token->value.i;
+                }
+                else if (token->group_code == 73) {
+                    text->vertical_justification = token->value.i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+/* MTEXT splits long strings into group 3 chunks ahead of the final
+ * group 1. Groups after 101, an embedded object, are not the entity's.
+ */
+static int parse_mtext(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_mtext *mtext;
+    struct dxf_text_span *tail = NULL;
+    int embedded = 0;
+
+    dbgprint("dxfparser: MText entity \n");
+
+    if ((mtext = (struct dxf_mtext*)dxf_alloc_entity(dxf, DXF_MTEXT)) == NULL) {
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        if (token->group_code == 101) {
+            embedded = 1;
+        }
+        if (embedded && (token->tag != DXF_ENTITY_TYPE) && (token->tag != DXF_EXT_DATA_APP_NAME)) {
+            continue;
+        }
+
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, mtext, DXF_MTEXT);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, mtext, DXF_MTEXT);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, mtext);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, mtext);
+            case DXF_ENTITY_PRIMARY_TEXT:
+            case DXF_OTHER_NAME:
+                if ((token->group_code != 4)
+                    && (add_text_span(parser_desc, &(mtext->body), &tail) != 0)) {
+                    return -1;
+                }
+                break;
+            case DXF_X:
+                if (token->group_code == 10) {
+                    mtext->x = token->value.f;
+                }
+                else if (token->group_code == 11) {
+                    mtext->direction[0] = token->value.f;
+                }
+                break;
+            case DXF_Y:
+                if (token->group_code == 20) {
+                    mtext->y = token->value.f;
+                }
+                else if (token->group_code == 21) {
+                    mtext->direction[1] = token->value.f;
+                }
+                break;
+            case DXF_Z:
+                if (token->group_code == 30) {
+                    mtext->z = token->value.f;
+                }
+                else if (token->group_code == 31) {
+                    mtext->direction[2] = token->value.f;
+                }
+                break;
+            case DXF_FLOAT:
+                if (token->group_code == 40) {
+                    mtext->height = token->value.f;
+                }
+                else if (token->group_code == 41) {
+                    mtext->width = token->value.f;
+                }
+                else if (token->group_code == 44) {
+                    mtext->line_spacing = token->value.f;
+                }
+                break;
+            case DXF_ANGLE:
+                if (token->group_code == 50) {
+                    mtext->angle = token->value.f;
+                }
+                break;
+            case DXF_INTEGER:
+                if (token->group_code == 71) {
+                    mtext->attachment = token->value.i;
+                }
+                else if (token->group_code == 72) {
+                    mtext->drawing_direction = token->value.i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+static int parse_solid(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_solid *solid;
+
+    dbgprint("dxfparser: Solid entity \n");
+
+    if ((solid = (struct dxf_solid*)dxf_alloc_entity(dxf, DXF_SOLID)) == NULL) {
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, solid, DXF_SOLID);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, solid, DXF_SOLID);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, solid);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, solid);
+            case DXF_X:
+                if (token->group_code <= 13) {
+                    solid->corners[token->group_code - 10][0] = token->value.f;
+                }
+                break;
+            case DXF_Y:
+                if (token->group_code <= 23) {
+                    solid->corners[token->group_code - 20][1] = token->value.f;
+                }
+                break;
+            case DXF_Z:
+                if (token->group_code <= 33) {
+                    solid->corners[token->group_code - 30][2] = token->value.f;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+/* With DXF_PARSER_DIMENSION_BLOCKS_ONLY every group but those the block
+ * reference needs is stepped over without being converted.
+ */
+static int parse_dimension(struct dxf_parser_desc* const parser_desc)
+{
+    static const unsigned int block_groups[] = { 0, 2, 8, 210, 220, 230 };
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_dimension *dimension;
+    struct dxf_insert *insert;
+    const int blocks_only = parser_desc->flags & DXF_PARSER_DIMENSION_BLOCKS_ONLY;
+
+    dbgprint("dxfparser: Dimension entity \n");
+
+    if ((dimension = (struct dxf_dimension*)dxf_alloc_entity(dxf, DXF_DIMENSION)) == NULL) {
+        return -1;
+    }
+    insert = &(dimension->insert);
+
+    for (;;) {
+        if (blocks_only) {
+            dxf_lexer_skip_other_groups(lexer_desc, block_groups,
+                                        sizeof(block_groups) / sizeof(block_groups[0]));
+        }
+        if (dxf_lexer_get_token(lexer_desc) != 0) {
+            break;
+        }
+
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, dimension, DXF_DIMENSION);
+            DXF_ENTITY_PARSER_ACTION_ON_LAYER_NAME(parser_desc, lexer_desc, token, dimension, DXF_DIMENSION);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, insert);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, dimension);
+            case DXF_BLOCK_NAME:
+                dbgprint("blockname=%s \n", token->value.str);
+                if (((insert->block_ref = dxf_get_block(dxf, token->value.str)) == NULL)
+                    && (add_fixup(parser_desc, insert, token->value.str) != 0)) {
+                    return -1;
+                }
+                break;
+            case DXF_X:
+                if (token->group_code == 10) {
+                    dimension->definition[0] = token->value.f;
+                }
+                else if (token->group_code == 11) {
+                    dimension->text_midpoint[0] = token->value.f;
+                }
+                else if ((token->group_code >= 13) && (token->group_code <= 16)) {
+                    dimension->points[token->group_code - 13][0] = token->value.f;
+                }
+                break;
+            case DXF_Y:
+                if (token->group_code == 20) {
+                    dimension->definition[1] = token->value.f;
+                }
+                else if (token->group_code == 21) {
+                    dimension->text_midpoint[1] = token->value.f;
+                }
+                else if ((token->group_code >= 23) && (token->group_code <= 26)) {
+                    dimension->points[token->group_code - 23][1] = token->value.f;
+                }
+                break;
+            case DXF_Z:
+                if (token->group_code == 30) {
+                    dimension->definition[2] = token->value.f;
+                }
+                else if (token->group_code == 31) {
+                    dimension->text_midpoint[2] = token->value.f;
+                }
+                else if ((token->group_code >= 33) && (token->group_code <= 36)) {
+                    dimension->points[token->group_code - 33][2] = token->value.f;
+                }
+                break;
+            case DXF_FLOAT:
+                if (token->group_code == 42) {
+                    dimension->measurement = token->value.f;
+                }
+                break;
+            case DXF_ANGLE:
+                if (token->group_code == 50) {
+                    dimension->angle = token->value.f;
+                }
+                break;
+            case DXF_INTEGER:
+                if (token->group_code == 70) {
+                    dimension->type = token->value.i;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return -1;
+}
+
+static int parse_insert(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+
+    struct dxf_insert *insert;
+    int named = 0;
+
+    dbgprint("dxfparser: Insert entity \n");
+
+    if ((insert = (struct dxf_insert*)dxf_alloc_entity(dxf, DXF_INSERT)) == NULL) {
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            DXF_ENTITY_PARSER_ACTION_ON_ENTITY_TYPE(parser_desc, lexer_desc, token, insert, DXF_INSERT);
+            DXF_ENTITY_PARSER_ACTION_ON_EXTRUSION(token, insert);
+            DXF_ENTITY_PARSER_ACTION_ON_XDATA(parser_desc, token, insert);
+            case DXF_LAYER_NAME:
+                /* Filed under the block's layer, so group 8 only decides
+                 * whether it is dropped, as long as group 2 follows it.
+                 */
+                dbgprint("layer=%s \n", token->value.str);
+                if (!named && (parser_desc->flags & DXF_PARSER_SKIP_HIDDEN_LAYERS)
+                    && (parser_desc->target_block == NULL) && is_hidden_layer(dxf, token->value.str)) {
+                    dbgprint("dxfparser: Dropped insert on a hidden layer. \n");
+                    skip_entity(lexer_desc);
+                    return 0;
+                }
+                break;
+            case DXF_BLOCK_NAME:
+                dbgprint("blockname=%s \n", token->value.str);
+                named = 1;
+                if ((insert->header.block = dxf_get_block(dxf, token->value.str)) != NULL) {
+                    attach_insert(dxf, insert, insert->header.block);
+                }
+                else if (add_fixup(parser_desc, insert, token->value.str) != 0) {
+                    return -1;
+                }
+                break;
+            case DXF_X:
+                dbgprint("x=%f \n", token->value.f);
+                insert->x = token->value.f;
+                break;
+            case DXF_Y:
+                dbgprint("y=%f \n", token->value.f);
+                insert->y = token->value.f;
+                break;
+            case DXF_Z:
+                dbgprint("z=%f \n", token->value.f);
+                insert->z = token->value.f;
+                break;
+            case DXF_FLOAT:
+                switch (token->group_code) {
+                    case 41:
+                        dbgprint("x_scale=%f \n", token->value.f);
+                        insert->x_scale = token->value.f;
+                        break;
+                    case 42:
+                        dbgprint("y_scale=%f \n", token->value.f);
+                        insert->y_scale = token->value.f;
+                        break;
+                    case 43:
+                        dbgprint("z_scale=%f \n", token->value.f);
+                        insert->z_scale = token->value.f;
+                        break;
+                    case 44:
+                        dbgprint("column_spacing=%f \n", token->value.f);
+                        insert->column_spacing = token->value.f;
+                        break;
+                    case 45:
+                        dbgprint("row_spacing=%f \n", token->value.f);
+                        insert->row_spacing = token->value.f;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case DXF_INTEGER:
+                switch (token->group_code) {
+                    case 70:
+                        dbgprint("column_count=%d \n", token->value.i);
+                        insert->column_count = token->value.i;
+                        break;
+                    case 71:
+                        dbgprint("row_count=%d \n", token->value.i);
+                        insert->row_count = token->value.i;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case DXF_ANGLE:
+                dbgprint("angle=%f \n", token->value.f);
+                insert->angle = token->value.f;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_block(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    const pfn_parser_t *pfn_parser;
+    int parser_return_value = -1;
+
+    parser_desc->target_layer = NULL;
+    parser_desc->target_block = NULL;
+
+    dbgprint("dxfparser: Block \n");
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            case DXF_ENTITY_TYPE:
+                if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
+                    if (*pfn_parser != NULL) {
+                        parser_return_value = (*pfn_parser)(parser_desc);
+                    }
+                }
+                else {
+                    dbgprint("dxf_parser: Skipping entity type %s \n", token->value.str);
+                    continue;
+                }
+
+                switch (parser_return_value) {
+                    case 0:
+                        break;
+                    case 1:
+                        if (strcmp(token->value.str, str_endblk) == 0) {
+                            parser_desc->target_layer = NULL;
+                            parser_desc->target_block = NULL;
+                            dbgprint("dxfparser: End of block. \n");
+                            return 0;
+                        }
+                        break;
+                    default:
+                        errprint("dxf_parser: Stopped after an error occured when parsing an entity. \n");
+                        parser_desc->target_layer = NULL;
+                        parser_desc->target_block = NULL;
+                        return -1;
+                }
+                break;
+            case DXF_LAYER_NAME:
+                dbgprint("layer=%s \n", token->value.str);
+                if ((parser_desc->target_layer = dxf_get_layer(dxf, token->value.str)) == NULL) {
+                    if (dxf_add_layer(dxf, token->value.str) == NULL) {
+                        return -1;
+                    }
+                    parser_desc->target_layer = dxf_get_layer(dxf, token->value.str);
+                }
+                break;
+            case DXF_BLOCK_NAME:
+                dbgprint("block=%s \n", token->value.str);
+                if ((parser_desc->target_block = dxf_get_block(dxf, token->value.str)) == NULL) {
+                    if (dxf_add_block(dxf, token->value.str, parser_desc->target_layer) == NULL) {
+                        return -1;
+                    }
+                    parser_desc->target_block = dxf_get_block(dxf, token->value.str);
+                }
+                break;
+            case DXF_INTEGER:
+                if (token->group_code == 70) {
+                    if (parser_desc->target_block != NULL) {
+                        dbgprint("flag=%d \n", token->value.i);
+                        parser_desc->target_block->flag = token->value.i;
+                    }
+                }
+                break;
+            case DXF_X:
+                dbgprint("x=%f \n", token->value.f);
+                if (parser_desc->target_block != NULL) {
+                    parser_desc->target_block->x = token->value.f;
+                }
+                break;
+            case DXF_Y:
+                dbgprint("y=%f \n", token->value.f);
+                if (parser_desc->target_block != NULL) {
+                    parser_desc->target_block->y = token->value.f;
+                }
+                break;
+            case DXF_Z:
+                dbgprint("z=%f \n", token->value.f);
+                if (parser_desc->target_block != NULL) {
+                    parser_desc->target_block->z = token->value.f;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_blocks(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    const pfn_parser_t *pfn_parser;
+    int parser_return_value = -1;
+
+    dbgprint("dxfparser: Parsing BLOCKS section. \n");
+
+    parser_desc->target_layer = NULL;
+    parser_desc->target_block = NULL;
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        if (token->tag == DXF_ENTITY_TYPE) {
+            if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
+                if (*pfn_parser != NULL) {
+                    parser_return_value = (*pfn_parser)(parser_desc);
+                }
+            }
+            else {
+                dbgprint("dxf_parser: Skipping object type %s \n", token->value.str);
+                continue;
+            }
+
+            switch (parser_return_value) {
+                case 0:
+                    break;
+                case 1:
+                    if (strcmp(token->value.str, str_endsec) == 0) {
+                        parser_desc->target_layer = NULL;
+                        parser_desc->target_block = NULL;
+                        dbgprint("dxfparser: End of BLOCKS section. \n");
+                        return 0;
+                    }
+                    break;
+                default:
+                    errprint("dxf_parser: Stopped after an error occured when parsing an object. \n");
+                    parser_desc->target_layer = NULL;
+                    parser_desc->target_block = NULL;
+                    return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Only $EXTMIN and $EXTMAX are kept, as an unchecked hint for bounds. */
+static int parse_header(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    double *target = NULL;
+    int found = 0;
+
+    dbgprint("dxfparser: Parsing HEADER section. \n");
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            case DXF_ENTITY_TYPE:
+                if (strcmp(token->value.str, str_endsec) == 0) {
+                    dxf->has_extents_hint = (found == 3);
+                    dbgprint("dxfparser: End of HEADER section. \n");
+                    return 0;
+                }
+                break;
+            case DXF_VARIABLE_NAME:
+                target = NULL;
+                if (strcmp(token->value.str, "$EXTMIN") == 0) {
+                    target = dxf->extents_hint.min;
+                    found |= 1;
+                }
+                else if (strcmp(token->value.str, "$EXTMAX") == 0) {
+                    target = dxf->extents_hint.max;
+                    found |= 2;
+                }
+                break;
+            case DXF_X:
+            case DXF_Y:
+            case DXF_Z:
+                if ((target != NULL) && (token->group_code % 10 == 0)) {
+                    target[token->tag - DXF_X] = token->value.f;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static char* copy_string(struct dxf* const dxf, const char *str)
+{
+    size_t len = strlen(str);
+    char *copy;
+
+    if ((copy = dxf_alloc_string(dxf, len)) != NULL) {
+        memcpy(copy, str, len + 1);
+    }
+
+    return copy;
+}
+
+/* Only the LAYER table is read; the count in its header sizes the layer
+ * index. A record is stored when the group 0 after it closes it, so its
+ * groups may come in any order.
+ */
+static int parse_tables(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_layer *layer = NULL;
+    int in_table_header = 0;
+    int in_layer_table = 0;
+    int in_layer = 0;
+    int flag = 0;
+    int color = DXF_LAYER_DEFAULT_COLOR;
+    const char *linetype = NULL;
+    const char *handle = NULL;
+
+    dbgprint("dxfparser: Parsing TABLES section. \n");
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            case DXF_ENTITY_TYPE:
+                if (layer != NULL) {
+                    layer->flag = flag;
+                    layer->color = color;
+                    layer->linetype = linetype;
+                    layer->handle = handle;
+                    dbgprint("dxfparser: Layer %s, flag=%d, color=%d \n", layer->name, flag, color);
+                }
+                layer = NULL;
+                flag = 0;
+                color = DXF_LAYER_DEFAULT_COLOR;
+                linetype = handle = NULL;
+
+                if (strcmp(token->value.str, str_endsec) == 0) {
+                    dbgprint("dxfparser: End of TABLES section. \n");
+                    return 0;
+                }
+                if ((in_table_header = (strcmp(token->value.str, str_table) == 0)) != 0) {
+                    in_layer_table = 0;
+                }
+                in_layer = in_layer_table && (strcmp(token->value.str, str_layer) == 0);
+                break;
+            case DXF_BLOCK_NAME:
+                if (in_table_header) {
+                    in_layer_table = (strcmp(token->value.str, str_layer) == 0);
+                }
+                else if (in_layer) {
+                    if (((layer = dxf_get_layer(dxf, token->value.str)) == NULL)
+                        && ((layer = dxf_add_layer(dxf, token->value.str)) == NULL))
+                    {
+                        return -1;
+                    }
+                }
+                break;
+            case DXF_INTEGER:
+                if (token->group_code != 70) {
+                    break;
+                }
+                if (in_table_header && in_layer_table && (token->value.i > 0)) {
+                    dxf_reserve_layers(dxf, (size_t)token->value.i);
+                }
+                else if (in_layer) {
+                    flag = token->value.i;
+                }
+                break;
+            case DXF_COLOR_NUMBER:
+                if (in_layer) {
+                    color = token->value.i;
+                }
+                break;
+            case DXF_LINE_TYPE:
+                if (in_layer && ((linetype = copy_string(dxf, token->value.str)) == NULL)) {
+                    return -1;
+                }
+                break;
+            case DXF_ENTITY_HANDLE:
+                if (in_layer && ((handle = copy_string(dxf, token->value.str)) == NULL)) {
+                    return -1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/* Layers that are not in the LAYER table are shown. */
+static int is_hidden_layer(struct dxf* const dxf, const char *name)
+{
+    const struct dxf_layer *layer;
+
+    return ((layer = dxf_get_layer(dxf, name)) != NULL) && dxf_layer_is_hidden(layer);
+}
+
+/* Steps over the rest of an entity, up to the group 0 that ends it. */
+static void skip_entity(struct dxf_lexer_desc* const lexer_desc)
+{
+    static const unsigned int entity_end[] = { 0 };
+
+    dxf_lexer_skip_other_groups(lexer_desc, entity_end, 1);
+}
+
+/* Group 90 announces the size; the 310 groups after it are the image,
+ * 127 bytes a line. The bytes are collected in the pool as they come.
+ */
+static int parse_thumbnailimage(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    unsigned char *data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    dbgprint("dxfparser: Parsing THUMBNAILIMAGE section. \n");
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        switch (token->tag) {
+            case DXF_ENTITY_TYPE:
+                if (strcmp(token->value.str, str_endsec) == 0) {
+                    dxf->thumbnail = data;
+                    dxf->thumbnail_size = size;
+                    dbgprint("dxfparser: End of THUMBNAILIMAGE section, %lu bytes. \n",
+                            (unsigned long)size);
+                    return 0;
+                }
+                break;
+            case DXF_INTEGER32:
+                if ((token->group_code == 90) && (token->value.i > 0) && (data == NULL)) {
+                    capacity = (size_t)token->value.i;
+                    if ((data = (unsigned char*)dxf_alloc_binary(dxf, capacity)) == NULL) {
+                        return -1;
+                    }
+                }
+                break;
+            case DXF_BINARY_CHUNK:
+                while (size + token->length > capacity) {
+                    if ((data = (unsigned char*)grow_array(dxf, data, size, &capacity, 1)) == NULL) {
+                        return -1;
+                    }
+                }
+                if (token->length > 0) {
+                    memcpy(data + size, token->value.bin, token->length);
+                    size += token->length;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_entities(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    const pfn_parser_t *pfn_parser;
+    int parser_return_value = -1;
+
+    dbgprint("dxfparser: Parsing ENTITIES section. \n");
+
+    parser_desc->target_layer = NULL;
+    parser_desc->target_block = NULL;
+
+    while (dxf_lexer_get_token(lexer_desc) == 0) {
+        if (token->tag == DXF_ENTITY_TYPE) {
+            if ((pfn_parser = hashtable_get(&parsers, &(token->value.str))) != NULL) {
+                if (*pfn_parser != NULL) {
+                    parser_return_value = (*pfn_parser)(parser_desc);
+                }
+            }
+            else {
+                dbgprint("dxf_parser: Skipping entity type %s \n", token->value.str);
+                continue;
+            }
 
             switch (parser_return_value) {
                 case 0:
@@ -685,6 +2338,9 @@ int dxf_parser_init()
         return -1;
     }
 
+    register_parser(&str_header, parse_header);
+    register_parser(&str_tables, parse_tables);
+    register_parser(&str_thumbnailimage, parse_thumbnailimage);
     register_parser(&str_entities, parse_entities);
     register_parser(&str_point, parse_point);
     register_parser(&str_line, parse_line);
@@ -692,6 +2348,14 @@ int dxf_parser_init()
     register_parser(&str_lwpolyline, parse_lwpolyline);
     register_parser(&str_arc, parse_arc);
     register_parser(&str_insert, parse_insert);
+    register_parser(&str_spline, parse_spline);
+    register_parser(&str_ellipse, parse_ellipse);
+    register_parser(&str_polyline, parse_polyline);
+    register_parser(&str_hatch, parse_hatch);
+    register_parser(&str_text, parse_text);
+    register_parser(&str_solid, parse_solid);
+    register_parser(&str_dimension, parse_dimension);
+    register_parser(&str_mtext, parse_mtext);
     
     register_parser(&str_blocks, parse_blocks);
     register_parser(&str_block, parse_block);
@@ -716,6 +2380,9 @@ int dxf_parser_init_desc(struct dxf_parser_desc* const parser_desc,
     parser_desc->dxf = dxf;
     parser_desc->target_block = NULL;
     parser_desc->target_layer = NULL;
+    parser_desc->fixups = NULL;
+    parser_desc->number_of_fixups = 0;
+    parser_desc->flags = DXF_PARSER_DEFAULT;
 
     for (i = 0; i < DXF_ENTITY_TYPES_COUNT; ++i) {
         parser_desc->entity_post_parse_hooks[i] = dummy_parser_hook;
@@ -736,6 +2403,110 @@ int dxf_parser_set_entity_post_parse_hook(struct dxf_parser_desc* const parser_d
     return 0;
 }
 
+int dxf_parser_set_flags(struct dxf_parser_desc* const parser_desc, unsigned int flags)
+{
+    parser_desc->flags = flags;
+    return 0;
+}
+
+/* Resolves deferred block references in one pass. References to blocks
+ * that still do not exist are kept for a later call. Returns the number
+ * left unresolved.
+ */
+int dxf_parser_resolve_references(struct dxf_parser_desc* const parser_desc)
+{
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_fixup *fixup = parser_desc->fixups;
+    struct dxf_fixup *next;
+    struct dxf_block *block;
+
+    parser_desc->fixups = NULL;
+    parser_desc->number_of_fixups = 0;
+
+    for (; fixup != NULL; fixup = next) {
+        next = fixup->next;
+
+        if ((block = dxf_get_block(dxf, fixup->block_name)) == NULL) {
+            fixup->next = parser_desc->fixups;
+            parser_desc->fixups = fixup;
+            ++(parser_desc->number_of_fixups);
+        }
+        else if (fixup->insert->header.type == DXF_DIMENSION) {
+            fixup->insert->block_ref = block;
+        }
+        else {
+            if (fixup->insert->header.block == NULL) {
+                fixup->insert->header.block = block;
+            }
+            attach_insert(dxf, fixup->insert, block);
+        }
+    }
+
+    if (parser_desc->number_of_fixups > 0) {
+        errprint("dxf_parser: %lu block references could not be resolved. \n",
+                (unsigned long)(parser_desc->number_of_fixups));
+    }
+
+    return (int)(parser_desc->number_of_fixups);
+}
+
+int dxf_parser_get_entity_type(const char *name)
+{
+    const struct entity_type_name *entry;
+
+    for (entry = &entity_type_names[0]; entry->name != NULL; ++entry) {
+        if (strcmp(*(entry->name), name) == 0) {
+            return entry->type;
+        }
+    }
+
+    return -1;
+}
+
+/* Parses the single object whose group 0 (entity) or group 2 (section)
+ * line the lexer is positioned at. If it produced an entity that was
+ * added to the document, *entity points at it.
+ */
+int dxf_parser_parse_object(struct dxf_parser_desc* const parser_desc,
+                            struct dxf_entity **entity)
+{
+    struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
+    struct dxf_token* const token = &(lexer_desc->token);
+    struct dxf* const dxf = parser_desc->dxf;
+    struct dxf_entity *last_entity = dxf->last_entity;
+    const pfn_parser_t *pfn_parser;
+
+    if (entity != NULL) {
+        *entity = NULL;
+    }
+
+    if ((dxf_lexer_get_token(lexer_desc) != 0)
+        || ((token->tag != DXF_ENTITY_TYPE) && (token->tag != DXF_BLOCK_NAME)))
+    {
+        errprint("dxfparser: dxf_parser_parse_object(): Not at the start of an object. \n");
+        return -1;
+    }
+
+    if (((pfn_parser = hashtable_get(&parsers, &(token->value.str))) == NULL) || (*pfn_parser == NULL)) {
+        dbgprint("dxfparser: dxf_parser_parse_object(): No parser for %s. \n", token->value.str);
+        return -1;
+    }
+
+    if ((*pfn_parser)(parser_desc) < 0) {
+        return -1;
+    }
+
+    if ((entity != NULL) && (dxf->last_entity != last_entity)) {
+        *entity = dxf->last_entity;
+    }
+
+    if (parser_desc->fixups != NULL) {
+        dxf_parser_resolve_references(parser_desc);
+    }
+
+    return 0;
+}
+
 int dxf_parser_parse(struct dxf_parser_desc* const parser_desc)
 {
     struct dxf_lexer_desc* const lexer_desc = parser_desc->lexer_desc;
@@ -762,6 +2533,7 @@ int dxf_parser_parse(struct dxf_parser_desc* const parser_desc)
                 case 1:
                     if (strcmp(token->value.str, str_eof) == 0) {
                         dbgprint("dxfparser: Reached EOF. \n");
+                        dxf_parser_resolve_references(parser_desc);
                         return 0;
                     }
                     break;
@@ -774,5 +2546,6 @@ int dxf_parser_parse(struct dxf_parser_desc* const parser_desc)
         }
     }
 
+    dxf_parser_resolve_references(parser_desc);
     return 0;
 }
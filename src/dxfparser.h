@@ -4,14 +4,35 @@
 #include "dxf.h"
 #include "dxflexer.h"
 
+#define DXF_PARSER_DEFAULT 0
+#define DXF_PARSER_SKIP_HATCH_PATTERNS 1   /* Step over hatch pattern lines unread. */
+#define DXF_PARSER_DIMENSION_BLOCKS_ONLY 2 /* Read DIMENSIONs' block, layer and extrusion only. */
+/* Drop entities on frozen or off layers, see dxf_layer_is_hidden(). An
+ * INSERT goes by its own group 8, which DXF writers put before group 2;
+ * one that names its block first is kept.
+ */
+#define DXF_PARSER_SKIP_HIDDEN_LAYERS 4
+
 typedef int(*pfn_entity_post_parse_hook_t)(struct dxf_entity*);
 
+/* A reference to a block that was not defined yet when it was parsed.
+ * Nodes live in the document pool.
+ */
+struct dxf_fixup {
+    struct dxf_insert *insert;
+    const char *block_name;
+    struct dxf_fixup *next;
+};
+
 struct dxf_parser_desc {
     struct dxf_lexer_desc* lexer_desc;
     struct dxf* dxf;
     struct dxf_block* target_block;
     struct dxf_layer* target_layer;
     pfn_entity_post_parse_hook_t entity_post_parse_hooks[DXF_ENTITY_TYPES_COUNT];
+    struct dxf_fixup *fixups;
+    size_t number_of_fixups;
+    unsigned int flags;
 };
 
 #ifdef __cplusplus
@@ -26,7 +47,12 @@ int dxf_parser_set_entity_post_parse_hook(
                         struct dxf_parser_desc* const parser_desc,
                         int entity_type,
                         pfn_entity_post_parse_hook_t hook);
+int dxf_parser_set_flags(struct dxf_parser_desc* const parser_desc, unsigned int flags);
 int dxf_parser_parse(struct dxf_parser_desc* const parser_desc);
+int dxf_parser_parse_object(struct dxf_parser_desc* const parser_desc,
+                            struct dxf_entity **entity);
+int dxf_parser_get_entity_type(const char *name);
+int dxf_parser_resolve_references(struct dxf_parser_desc* const parser_desc);
     
 #ifdef __cplusplus
 }
@@ -0,0 +1,607 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dxfrtree.h"
+#include "dxfbounds.h"
+
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "dbgprint.h"
+
+#define HILBERT_MAX 0xffff
+
+struct sort_key {
+    unsigned int key;
+    unsigned int item;
+};
+
+struct key_job {
+    const double *boxes;
+    struct sort_key *keys;
+    size_t begin;
+    size_t end;
+    double minx;
+    double miny;
+    double scalex;
+    double scaley;
+};
+
+struct heap_node {
+    double distance;
+    size_t position;
+};
+
+struct heap {
+    struct heap_node *nodes;
+    size_t size;
+    size_t capacity;
+};
+
+/* Distance along the 16 bit Hilbert curve of cell (x, y). */
+static unsigned int hilbert(unsigned int x, unsigned int y)
+{
+    unsigned int d = 0;
+    unsigned int s;
+    unsigned int rx;
+    unsigned int ry;
+    unsigned int t;
+
+    for (s = (HILBERT_MAX + 1) >> 1; s > 0; s >>= 1) {
+        rx = (x & s) != 0;
+        ry = (y & s) != 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = HILBERT_MAX - x;
+                y = HILBERT_MAX - y;
+            }
+            t = x;
+            x = y;
+            y = t;
+        }
+    }
+
+    return d;
+}
+
+static void* compute_keys(void *arg)
+{
+    struct key_job* const job = (struct key_job*)arg;
+    const double *box;
+    size_t i;
+
+    for (i = job->begin; i < job->end; ++i) {
+        box = &(job->boxes[4 * i]);
+        job->keys[i].key = hilbert(
+            (unsigned int)(((box[0] + box[2]) * 0.5 - job->minx) * job->scalex),
+            (unsigned int)(((box[1] + box[3]) * 0.5 - job->miny) * job->scaley));
+        job->keys[i].item = (unsigned int)i;
+    }
+
+    return NULL;
+}
+
+static void compute_keys_parallel(struct key_job* const job, size_t n)
+{
+#ifdef USE_PTHREAD
+    pthread_t threads[DXF_RTREE_MAX_THREADS];
+    struct key_job jobs[DXF_RTREE_MAX_THREADS];
+    int started[DXF_RTREE_MAX_THREADS];
+    size_t slice = (n + DXF_RTREE_MAX_THREADS - 1) / DXF_RTREE_MAX_THREADS;
+    int i;
+
+    if (n < DXF_RTREE_PARALLEL_THRESHOLD) {
+        job->begin = 0;
+        job->end = n;
+        compute_keys(job);
+        return;
+    }
+
+    for (i = 0; i < DXF_RTREE_MAX_THREADS; ++i) {
+        memcpy(&jobs[i], job, sizeof(struct key_job));
+        jobs[i].begin = (i * slice < n) ? i * slice : n;
+        jobs[i].end = (jobs[i].begin + slice < n) ? jobs[i].begin + slice : n;
+        started[i] = (i > 0) && (pthread_create(&threads[i], NULL, compute_keys, &jobs[i]) == 0);
+    }
+
+    /* Slice 0, and any slice whose thread did not start, runs here. */
+    for (i = 0; i < DXF_RTREE_MAX_THREADS; ++i) {
+        if (!started[i]) {
+            compute_keys(&jobs[i]);
+        }
+    }
+
+    for (i = 1; i < DXF_RTREE_MAX_THREADS; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+#else
+    job->begin = 0;
+    job->end = n;
+    compute_keys(job);
+#endif
+}
+
+static int compare_keys(const void *p1, const void *p2)
+{
+    const struct sort_key *k1 = (const struct sort_key*)p1;
+    const struct sort_key *k2 = (const struct sort_key*)p2;
+
+    if (k1->key != k2->key) {
+        return (k1->key < k2->key) ? -1 : 1;
+    }
+    return (k1->item < k2->item) ? -1 : (k1->item > k2->item);
+}
+
+/* Level ends follow from the item count alone; there is always a root. */
+static int init_levels(struct dxf_rtree* const tree)
+{
+    size_t n = tree->number_of_items;
+    size_t position = n;
+
+    tree->number_of_levels = 0;
+    tree->level_bounds[tree->number_of_levels++] = position;
+    if (n == 0) {
+        tree->number_of_boxes = 0;
+        return 0;
+    }
+
+    do {
+        if (tree->number_of_levels == DXF_RTREE_MAX_LEVELS) {
+            errprint("dxfrtree: init_levels(): Too many items (%lu). \n", (unsigned long)tree->number_of_items);
+            return -1;
+        }
+        n = (n + DXF_RTREE_NODE_SIZE - 1) / DXF_RTREE_NODE_SIZE;
+        position += n;
+        tree->level_bounds[tree->number_of_levels++] = position;
+    } while (n != 1);
+
+    tree->number_of_boxes = position;
+    return 0;
+}
+
+/* End of the children of the node at position. */
+static size_t children_end(const struct dxf_rtree* const tree, size_t position)
+{
+    size_t first = tree->indices[position];
+    size_t end = first + DXF_RTREE_NODE_SIZE;
+    int level;
+
+    for (level = 1; position >= tree->level_bounds[level]; ++level) {
+    }
+
+    return (end < tree->level_bounds[level - 1]) ? end : tree->level_bounds[level - 1];
+}
+
+static void build_nodes(struct dxf_rtree* const tree)
+{
+    double *box;
+    const double *child;
+    size_t position = 0;
+    size_t node = tree->number_of_items;
+    size_t end;
+    int level;
+
+    for (level = 0; level < tree->number_of_levels - 1; ++level) {
+        end = tree->level_bounds[level];
+
+        while (position < end) {
+            box = &(tree->boxes[4 * node]);
+            box[0] = box[1] = HUGE_VAL;
+            box[2] = box[3] = -HUGE_VAL;
+            tree->indices[node] = (unsigned int)position;
+
+            for (; (position < end) && (position < tree->indices[node] + DXF_RTREE_NODE_SIZE); ++position) {
+                child = &(tree->boxes[4 * position]);
+                box[0] = (child[0] < box[0]) ? child[0] : box[0];
+                box[1] = (child[1] < box[1]) ? child[1] : box[1];
+                box[2] = (child[2] > box[2]) ? child[2] : box[2];
+                box[3] = (child[3] > box[3]) ? child[3] : box[3];
+            }
+            ++node;
+        }
+    }
+}
+
+static int is_indexed(struct dxf* const dxf, const struct dxf_entity* const entity,
+                    struct dxf_bounds* const bounds)
+{
+    if (dxf_is_block_member(entity)) {
+        return 0;
+    }
+
+    return (dxf_get_entity_bounds(dxf, entity, bounds) == 0) && !dxf_bounds_is_empty(bounds);
+}
+
+/* Either entities or, for a tree without them, indices gives each item's
+ * index.
+ */
+static int sort_items(struct dxf_rtree* const tree, const double *boxes, struct dxf_entity **entities,
+                    const unsigned int *indices)
+{
+    struct sort_key *keys;
+    struct key_job job;
+    size_t n = tree->number_of_items;
+    size_t i;
+    double minx = HUGE_VAL;
+    double miny = HUGE_VAL;
+    double maxx = -HUGE_VAL;
+    double maxy = -HUGE_VAL;
+
+    if ((keys = (struct sort_key*)malloc(n * sizeof(struct sort_key))) == NULL) {
+        errprint("dxfrtree: sort_items(): Failed to allocate sort keys. \n");
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        minx = (boxes[4 * i] < minx) ? boxes[4 * i] : minx;
+        miny = (boxes[4 * i + 1] < miny) ? boxes[4 * i + 1] : miny;
+        maxx = (boxes[4 * i + 2] > maxx) ? boxes[4 * i + 2] : maxx;
+        maxy = (boxes[4 * i + 3] > maxy) ? boxes[4 * i + 3] : maxy;
+    }
+
+    job.boxes = boxes;
+    job.keys = keys;
+    job.minx = minx;
+    job.miny = miny;
+    job.scalex = (maxx > minx) ? HILBERT_MAX / (maxx - minx) : 0.0;
+    job.scaley = (maxy > miny) ? HILBERT_MAX / (maxy - miny) : 0.0;
+    compute_keys_parallel(&job, n);
+
+    qsort(keys, n, sizeof(struct sort_key), compare_keys);
+
+    for (i = 0; i < n; ++i) {
+        memcpy(&(tree->boxes[4 * i]), &(boxes[4 * keys[i].item]), 4 * sizeof(double));
+        if (entities != NULL) {
+            tree->entities[i] = entities[keys[i].item];
+            tree->indices[i] = (unsigned int)tree->entities[i]->seq;
+        }
+        else {
+            tree->indices[i] = indices[keys[i].item];
+        }
+    }
+
+    free(keys);
+    return 0;
+}
+
+/* Indexes the entities dxf_entity_iter_init() would visit with the same
+ * arguments.
+ */
+int dxf_rtree_build(struct dxf_rtree* const tree, struct dxf* const dxf,
+                    const char *layer_name, unsigned int type_mask)
+{
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_entity **entities = NULL;
+    struct dxf_bounds bounds;
+    double *boxes = NULL;
+    size_t count = 0;
+    int ret = -1;
+
+    memset(tree, 0, sizeof(struct dxf_rtree));
+    tree->owns_arrays = 1;
+
+    /* Fills the bounds cache, in parallel where it pays off. */
+    if (dxf_compute_bounds(dxf, &bounds) != 0) {
+        return -1;
+    }
+
+    if (dxf_entity_iter_init(&iter, dxf, layer_name, type_mask) != 0) {
+        return -1;
+    }
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        count += is_indexed(dxf, entity, &bounds);
+    }
+
+    tree->number_of_items = count;
+    if (init_levels(tree) != 0) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    boxes = (double*)malloc(4 * count * sizeof(double));
+    entities = (struct dxf_entity**)malloc(count * sizeof(struct dxf_entity*));
+    tree->boxes = (double*)malloc(4 * tree->number_of_boxes * sizeof(double));
+    tree->indices = (unsigned int*)malloc(tree->number_of_boxes * sizeof(unsigned int));
+    tree->entities = (struct dxf_entity**)malloc(count * sizeof(struct dxf_entity*));
+    if ((boxes == NULL) || (entities == NULL) || (tree->boxes == NULL)
+        || (tree->indices == NULL) || (tree->entities == NULL))
+    {
+        errprint("dxfrtree: dxf_rtree_build(): Failed to allocate %lu items. \n", (unsigned long)count);
+        goto out;
+    }
+
+    count = 0;
+    dxf_entity_iter_init(&iter, dxf, layer_name, type_mask);
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if (is_indexed(dxf, entity, &bounds)) {
+            boxes[4 * count] = bounds.min[0];
+            boxes[4 * count + 1] = bounds.min[1];
+            boxes[4 * count + 2] = bounds.max[0];
+            boxes[4 * count + 3] = bounds.max[1];
+            entities[count++] = entity;
+        }
+    }
+
+    if (sort_items(tree, boxes, entities, NULL) != 0) {
+        goto out;
+    }
+    build_nodes(tree);
+
+    dbgprint("dxfrtree: dxf_rtree_build(): %lu items, %d levels. \n",
+            (unsigned long)count, tree->number_of_levels);
+    ret = 0;
+
+out:
+    free(boxes);
+    free(entities);
+    if (ret != 0) {
+        dxf_rtree_free(tree);
+    }
+    return ret;
+}
+
+/* Indexes boxes that are not entities, four doubles each as in the
+ * layout above; an item is reported with its entry of indices. Neither
+ * array is kept.
+ */
+int dxf_rtree_build_boxes(struct dxf_rtree* const tree, const double *boxes,
+                    const unsigned int *indices, size_t number_of_items)
+{
+    memset(tree, 0, sizeof(struct dxf_rtree));
+    tree->owns_arrays = 1;
+    tree->number_of_items = number_of_items;
+    if (init_levels(tree) != 0) {
+        return -1;
+    }
+    if (number_of_items == 0) {
+        return 0;
+    }
+
+    tree->boxes = (double*)malloc(4 * tree->number_of_boxes * sizeof(double));
+    tree->indices = (unsigned int*)malloc(tree->number_of_boxes * sizeof(unsigned int));
+    if ((tree->boxes == NULL) || (tree->indices == NULL)) {
+        errprint("dxfrtree: dxf_rtree_build_boxes(): Failed to allocate %lu items. \n",
+                (unsigned long)number_of_items);
+        dxf_rtree_free(tree);
+        return -1;
+    }
+
+    if (sort_items(tree, boxes, NULL, indices) != 0) {
+        dxf_rtree_free(tree);
+        return -1;
+    }
+    build_nodes(tree);
+
+    return 0;
+}
+
+/* Uses arrays laid out as described above, e.g. from a mapped file, in
+ * place. They must outlive the tree.
+ */
+int dxf_rtree_init_static(struct dxf_rtree* const tree, const double *boxes,
+                    const unsigned int *indices, size_t number_of_items)
+{
+    memset(tree, 0, sizeof(struct dxf_rtree));
+    tree->number_of_items = number_of_items;
+    if (init_levels(tree) != 0) {
+        return -1;
+    }
+
+    tree->boxes = (double*)boxes;
+    tree->indices = (unsigned int*)indices;
+    return 0;
+}
+
+void dxf_rtree_free(struct dxf_rtree* const tree)
+{
+    if (tree->owns_arrays) {
+        free(tree->boxes);
+        free(tree->indices);
+        free(tree->entities);
+    }
+
+    memset(tree, 0, sizeof(struct dxf_rtree));
+}
+
+static int visit_item(const struct dxf_rtree* const tree, size_t position,
+                    pfn_rtree_visit_t visit, void *user_data)
+{
+    return visit((tree->entities != NULL) ? tree->entities[position] : NULL,
+                tree->indices[position], user_data);
+}
+
+size_t dxf_rtree_search(const struct dxf_rtree* const tree,
+                    double minx, double miny, double maxx, double maxy,
+                    pfn_rtree_visit_t visit, void *user_data)
+{
+    size_t stack[DXF_RTREE_MAX_LEVELS * DXF_RTREE_NODE_SIZE];
+    size_t depth = 0;
+    size_t found = 0;
+    size_t position;
+    size_t end;
+    const double *box;
+
+    if (tree->number_of_boxes == 0) {
+        return 0;
+    }
+
+    stack[depth++] = tree->number_of_boxes - 1;
+    while (depth > 0) {
+        position = stack[--depth];
+        end = children_end(tree, position);
+
+        for (position = tree->indices[position]; position < end; ++position) {
+            box = &(tree->boxes[4 * position]);
+            if ((box[2] < minx) || (box[3] < miny) || (box[0] > maxx) || (box[1] > maxy)) {
+                continue;
+            }
+
+            if (position >= tree->number_of_items) {
+                stack[depth++] = position;
+            }
+            else {
+                ++found;
+                if ((visit != NULL) && visit_item(tree, position, visit, user_data)) {
+                    return found;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+static double box_distance(const double *box, double x, double y)
+{
+    double dx = (x < box[0]) ? box[0] - x : (x > box[2]) ? x - box[2] : 0.0;
+    double dy = (y < box[1]) ? box[1] - y : (y > box[3]) ? y - box[3] : 0.0;
+
+    return sqrt(dx * dx + dy * dy);
+}
+
+/* Items whose box comes within radius of (x, y). */
+size_t dxf_rtree_search_radius(const struct dxf_rtree* const tree,
+                    double x, double y, double radius,
+                    pfn_rtree_visit_t visit, void *user_data)
+{
+    size_t stack[DXF_RTREE_MAX_LEVELS * DXF_RTREE_NODE_SIZE];
+    size_t depth = 0;
+    size_t found = 0;
+    size_t position;
+    size_t end;
+
+    if (tree->number_of_boxes == 0) {
+        return 0;
+    }
+
+    stack[depth++] = tree->number_of_boxes - 1;
+    while (depth > 0) {
+        position = stack[--depth];
+        end = children_end(tree, position);
+
+        for (position = tree->indices[position]; position < end; ++position) {
+            if (box_distance(&(tree->boxes[4 * position]), x, y) > radius) {
+                continue;
+            }
+
+            if (position >= tree->number_of_items) {
+                stack[depth++] = position;
+            }
+            else {
+                ++found;
+                if ((visit != NULL) && visit_item(tree, position, visit, user_data)) {
+                    return found;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+static int heap_push(struct heap* const heap, double distance, size_t position)
+{
+    struct heap_node *nodes;
+    struct heap_node node;
+    size_t i;
+
+    if (heap->size == heap->capacity) {
+        heap->capacity = (heap->capacity == 0) ? 64 : heap->capacity * 2;
+        if ((nodes = (struct heap_node*)realloc(heap->nodes,
+                                    heap->capacity * sizeof(struct heap_node))) == NULL) {
+            errprint("dxfrtree: heap_push(): Failed to grow the queue. \n");
+            return -1;
+        }
+        heap->nodes = nodes;
+    }
+
+    node.distance = distance;
+    node.position = position;
+    for (i = heap->size++; (i > 0) && (heap->nodes[(i - 1) / 2].distance > distance); i = (i - 1) / 2) {
+        heap->nodes[i] = heap->nodes[(i - 1) / 2];
+    }
+    heap->nodes[i] = node;
+    return 0;
+}
+
+static struct heap_node heap_pop(struct heap* const heap)
+{
+    struct heap_node top = heap->nodes[0];
+    struct heap_node last = heap->nodes[--(heap->size)];
+    size_t i = 0;
+    size_t child;
+
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if ((child + 1 < heap->size) && (heap->nodes[child + 1].distance < heap->nodes[child].distance)) {
+            ++child;
+        }
+        if (heap->nodes[child].distance >= last.distance) {
+            break;
+        }
+        heap->nodes[i] = heap->nodes[child];
+        i = child;
+    }
+    if (heap->size > 0) {
+        heap->nodes[i] = last;
+    }
+
+    return top;
+}
+
+/* Up to k items closest to (x, y) by box distance, nearest first. Nodes
+ * and items share one queue, so an item that comes out on top is closer
+ * than anything not yet expanded.
+ */
+size_t dxf_rtree_nearest(const struct dxf_rtree* const tree, double x, double y,
+                    size_t k, struct dxf_rtree_neighbour* const neighbours)
+{
+    struct heap heap;
+    struct heap_node top;
+    size_t found = 0;
+    size_t position;
+    size_t end;
+
+    if ((tree->number_of_boxes == 0) || (k == 0)) {
+        return 0;
+    }
+
+    heap.nodes = NULL;
+    heap.size = heap.capacity = 0;
+    if (heap_push(&heap, 0.0, tree->number_of_boxes - 1) != 0) {
+        return 0;
+    }
+
+    while ((heap.size > 0) && (found < k)) {
+        top = heap_pop(&heap);
+
+        if (top.position < tree->number_of_items) {
+            neighbours[found].entity = (tree->entities != NULL) ? tree->entities[top.position] : NULL;
+            neighbours[found].seq = tree->indices[top.position];
+            neighbours[found].distance = top.distance;
+            ++found;
+            continue;
+        }
+
+        end = children_end(tree, top.position);
+        for (position = tree->indices[top.position]; position < end; ++position) {
+            if (heap_push(&heap, box_distance(&(tree->boxes[4 * position]), x, y), position) != 0) {
+                goto out;
+            }
+        }
+    }
+
+out:
+    free(heap.nodes);
+    return found;
+}
@@ -0,0 +1,75 @@
+#ifndef __DXF_RTREE_H__
+#define __DXF_RTREE_H__
+
+#include <stddef.h>
+#include "dxf.h"
+
+/* Static packed R-tree over the 2D bounds of parsed entities. Items are
+ * sorted along a Hilbert curve and packed bottom up, DXF_RTREE_NODE_SIZE
+ * children per node, so the tree is only two flat arrays:
+ *
+ *   boxes      minx, miny, maxx, maxy for every item, then every node of
+ *              each level up to the root, which comes last;
+ *   indices    for an item its entity's seq, for a node the position of
+ *              its first child in boxes.
+ *
+ * Neither array holds a pointer, so both can be written out and used in
+ * place from a mapping with dxf_rtree_init_static(). A tree built from a
+ * document additionally maps item positions to entities. Block members
+ * are left out; INSERTs are indexed with their whole extent. The tree
+ * does not follow later changes to the document.
+ */
+
+#define DXF_RTREE_NODE_SIZE 16
+#define DXF_RTREE_MAX_LEVELS 16
+#define DXF_RTREE_MAX_THREADS 8
+#define DXF_RTREE_PARALLEL_THRESHOLD 16384     /* Items */
+
+struct dxf_rtree {
+    size_t number_of_items;
+    size_t number_of_boxes;
+    double *boxes;
+    unsigned int *indices;
+    struct dxf_entity **entities;   /* By item position, NULL if static. */
+    size_t level_bounds[DXF_RTREE_MAX_LEVELS];  /* End of each level in boxes. */
+    int number_of_levels;
+    int owns_arrays;
+};
+
+/* Return non-zero to stop the search. entity is NULL unless the tree
+ * was built from a document.
+ */
+typedef int (*pfn_rtree_visit_t)(struct dxf_entity *entity, unsigned int seq, void *user_data);
+
+struct dxf_rtree_neighbour {
+    struct dxf_entity *entity;
+    unsigned int seq;
+    double distance;            /* From the query point to the item's box. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_rtree_build(struct dxf_rtree* const tree, struct dxf* const dxf,
+                    const char *layer_name, unsigned int type_mask);
+int dxf_rtree_build_boxes(struct dxf_rtree* const tree, const double *boxes,
+                    const unsigned int *indices, size_t number_of_items);
+int dxf_rtree_init_static(struct dxf_rtree* const tree, const double *boxes,
+                    const unsigned int *indices, size_t number_of_items);
+void dxf_rtree_free(struct dxf_rtree* const tree);
+
+size_t dxf_rtree_search(const struct dxf_rtree* const tree,
+                    double minx, double miny, double maxx, double maxy,
+                    pfn_rtree_visit_t visit, void *user_data);
+size_t dxf_rtree_search_radius(const struct dxf_rtree* const tree,
+                    double x, double y, double radius,
+                    pfn_rtree_visit_t visit, void *user_data);
+size_t dxf_rtree_nearest(const struct dxf_rtree* const tree, double x, double y,
+                    size_t k, struct dxf_rtree_neighbour* const neighbours);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_RTREE_H__ */
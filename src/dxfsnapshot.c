@@ -0,0 +1,991 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "dxfsnapshot.h"
+#include "dxftext.h"
+#include "hashtab.h"
+
+#include "dbgprint.h"
+
+#define SECTION_ALIGNMENT 8
+#define ALIGN_UP(n, a) (((n) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+struct string_table {
+    char *buf;
+    size_t len;
+    size_t capacity;
+    struct hashtable offsets;
+};
+
+/* 0 for types that are never entities of their own. */
+static const size_t record_sizes[DXF_ENTITY_TYPES_COUNT] = {
+    sizeof(struct dxf_snapshot_point),      /* DXF_POINT */
+    sizeof(struct dxf_snapshot_line),       /* DXF_LINE */
+    sizeof(struct dxf_snapshot_arc),        /* DXF_ARC */
+    sizeof(struct dxf_snapshot_circle),     /* DXF_CIRCLE */
+    sizeof(struct dxf_snapshot_ellipse),    /* DXF_ELLIPSE */
+    0,                                      /* DXF_VERTEX */
+    sizeof(struct dxf_snapshot_polyline),   /* DXF_POLYLINE */
+    0,                                      /* DXF_LWPOLYLINE_VERTEX */
+    sizeof(struct dxf_snapshot_lwpolyline), /* DXF_LWPOLYLINE */
+    sizeof(struct dxf_snapshot_spline),     /* DXF_SPLINE */
+    sizeof(struct dxf_snapshot_dimension),  /* DXF_DIMENSION */
+    sizeof(struct dxf_snapshot_hatch),      /* DXF_HATCH */
+    sizeof(struct dxf_snapshot_insert),     /* DXF_INSERT */
+    sizeof(struct dxf_snapshot_text),       /* DXF_TEXTSTRING */
+    sizeof(struct dxf_snapshot_mtext),      /* DXF_MTEXT */
+    sizeof(struct dxf_snapshot_solid)       /* DXF_SOLID */
+};
+
+static const size_t array_sizes[DXF_SNAPSHOT_ARRAYS_COUNT] = {
+    sizeof(struct dxf_snapshot_lwpolyline_vertex),  /* DXF_SNAPSHOT_LWPOLYLINE_VERTICES */
+    sizeof(struct dxf_snapshot_polyline_vertex),    /* DXF_SNAPSHOT_POLYLINE_VERTICES */
+    sizeof(struct dxf_snapshot_polyline_face),      /* DXF_SNAPSHOT_POLYLINE_FACES */
+    sizeof(double),                                 /* DXF_SNAPSHOT_REALS */
+    sizeof(struct dxf_snapshot_hatch_loop),         /* DXF_SNAPSHOT_HATCH_LOOPS */
+    sizeof(struct dxf_snapshot_hatch_vertex),       /* DXF_SNAPSHOT_HATCH_VERTICES */
+    sizeof(struct dxf_snapshot_hatch_edge),         /* DXF_SNAPSHOT_HATCH_EDGES */
+    sizeof(struct dxf_snapshot_hatch_pattern_line)  /* DXF_SNAPSHOT_HATCH_PATTERN_LINES */
+};
+
+/* Where the next item of each array goes while writing. */
+struct array_cursor {
+    char *buf;
+    const struct dxf_snapshot_header *header;
+    unsigned int written[DXF_SNAPSHOT_ARRAYS_COUNT];
+};
+
+static unsigned int str_hash(const char **psz);
+static int str_cmp(const char **psz1, const char **psz2);
+static unsigned int ptr_hash(const void **pp);
+static int ptr_cmp(const void **pp1, const void **pp2);
+static unsigned int checksum(const char *buf, size_t len);
+static int string_table_init(struct string_table* const tab);
+static void string_table_free(struct string_table* const tab);
+static int string_table_intern(struct string_table* const tab, const char *str,
+                                dxf_snapshot_off_t *offset);
+static int string_table_add_span(struct string_table* const tab, const char *str, size_t len,
+                                dxf_snapshot_off_t *offset);
+static int index_containers(struct dxf_container *head, struct hashtable* const indices,
+                            struct string_table* const strings, unsigned int *count);
+static unsigned int get_container_index(struct hashtable* const indices,
+                                        const struct dxf_container *container);
+static void write_container(struct dxf_snapshot_container* const record,
+                            const struct dxf_container* const container,
+                            struct hashtable* const string_offsets,
+                            struct hashtable* const layer_indices);
+static int count_entity(struct dxf* const dxf, struct dxf_entity* const entity,
+                        struct dxf_snapshot_header* const header, struct string_table* const strings,
+                        struct hashtable* const xdata_offsets);
+static size_t count_vertices(const struct dxf_lwpolyline* const lwpolyline);
+static void* next_items(struct array_cursor* const cursor, int array, size_t count,
+                        unsigned int *first);
+static unsigned int put_reals(struct array_cursor* const cursor, const double *values,
+                            size_t count);
+static void write_polyline(struct dxf_snapshot_polyline* const record,
+                            const struct dxf_polyline* const polyline,
+                            struct array_cursor* const cursor);
+static void write_spline(struct dxf_snapshot_spline* const record,
+                        const struct dxf_spline* const spline, struct array_cursor* const cursor);
+static void write_hatch(struct dxf_snapshot_hatch* const record, const struct dxf_hatch* const hatch,
+                        struct array_cursor* const cursor, struct hashtable* const string_offsets);
+static void write_insert(struct dxf_snapshot_insert* const record,
+                        const struct dxf_insert* const insert, struct hashtable* const block_indices);
+static dxf_snapshot_off_t get_string_offset(struct hashtable* const string_offsets, const char *str);
+static int section_fits(const struct dxf_snapshot_section* const section, size_t item_size,
+                        size_t size);
+static int validate(const struct dxf_snapshot* const snapshot, int flags);
+
+static unsigned int str_hash(const char **psz)
+{
+    unsigned int hash = 0;
+    const char *sz = *psz;
+
+    while (*sz != '\0') {
+        hash = *(sz++) + (hash << 5) - 1;
+    }
+
+    return hash;
+}
+
+static int str_cmp(const char **psz1, const char **psz2)
+{
+    return strcmp(*psz1, *psz2);
+}
+
+static unsigned int ptr_hash(const void **pp)
+{
+    return (unsigned int)(((size_t)(*pp)) >> 3);
+}
+
+static int ptr_cmp(const void **pp1, const void **pp2)
+{
+    return *pp1 == *pp2 ? 0 : 1;
+}
+
+/* FNV-1a over 32-bit words. Section sizes are multiples of 8. */
+static unsigned int checksum(const char *buf, size_t len)
+{
+    const unsigned int *word = (const unsigned int*)buf;
+    const unsigned int *end = word + len / sizeof(unsigned int);
+    unsigned int hash = 2166136261u;
+
+    while (word < end) {
+        hash ^= *(word++);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static int string_table_init(struct string_table* const tab)
+{
+    tab->capacity = 256;
+    if ((tab->buf = (char*)malloc(tab->capacity)) == NULL) {
+        return -1;
+    }
+
+    /* Offset 0 is the empty string. */
+    tab->buf[0] = '\0';
+    tab->len = 1;
+
+    if (hashtable_create(&(tab->offsets), 0, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)str_hash, (pfn_keycmp_t)str_cmp, NULL) != 0)
+    {
+        free(tab->buf);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void string_table_free(struct string_table* const tab)
+{
+    hashtable_destroy(&(tab->offsets));
+    free(tab->buf);
+    tab->buf = NULL;
+}
+
+static int string_table_intern(struct string_table* const tab, const char *str,
+                                dxf_snapshot_off_t *offset)
+{
+    const dxf_snapshot_off_t *known;
+    size_t len = strlen(str) + 1;
+
+    if ((known = hashtable_get(&(tab->offsets), &str)) != NULL) {
+        *offset = *known;
+        return 0;
+    }
+
+    if (string_table_add_span(tab, str, len - 1, offset) != 0) {
+        return -1;
+    }
+
+    /* Key points at the caller's string, which outlives the table. */
+    return hashtable_put(&(tab->offsets), (void*)&str, sizeof(char*),
+                        offset, sizeof(dxf_snapshot_off_t));
+}
+
+/* Copies len bytes and a terminator without interning them. */
+static int string_table_add_span(struct string_table* const tab, const char *str, size_t len,
+                                dxf_snapshot_off_t *offset)
+{
+    char *buf;
+
+    while (tab->len + len + 1 > tab->capacity) {
+        if ((buf = (char*)realloc(tab->buf, tab->capacity * 2)) == NULL) {
+            return -1;
+        }
+        tab->buf = buf;
+        tab->capacity *= 2;
+    }
+
+    *offset = (dxf_snapshot_off_t)(tab->len);
+    memcpy(tab->buf + tab->len, str, len);
+    tab->buf[tab->len + len] = '\0';
+    tab->len += len + 1;
+
+    return 0;
+}
+
+static int index_containers(struct dxf_container *head, struct hashtable* const indices,
+                            struct string_table* const strings, unsigned int *count)
+{
+    struct dxf_container *container;
+    dxf_snapshot_off_t offset;
+    unsigned int index = 0;
+
+    for (container = head; container != NULL; container = container->next) {
+        if ((string_table_intern(strings, container->name, &offset) != 0)
+            || ((container->linetype != NULL)
+                && (string_table_intern(strings, container->linetype, &offset) != 0))
+            || ((container->handle != NULL)
+                && (string_table_intern(strings, container->handle, &offset) != 0))
+            || (hashtable_put(indices, (void*)&container, sizeof(struct dxf_container*),
+                            &index, sizeof(unsigned int)) != 0))
+        {
+            return -1;
+        }
+        ++index;
+    }
+
+    *count = index;
+    return 0;
+}
+
+static unsigned int get_container_index(struct hashtable* const indices,
+                                        const struct dxf_container *container)
+{
+    const unsigned int *index;
+
+    if (container == NULL) {
+        return DXF_SNAPSHOT_NO_CONTAINER;
+    }
+
+    index = hashtable_get(indices, (void*)&container);
+    return index != NULL ? *index : DXF_SNAPSHOT_NO_CONTAINER;
+}
+
+/* Counts the record and array items of an entity and interns its
+ * strings. Text is decoded and XDATA copied here, so the input must still
+ * be open unless dxf_text_materialize() and dxf_xdata_materialize() were
+ * called. XDATA offsets go in xdata_offsets by entity.
+ */
+static int count_entity(struct dxf* const dxf, struct dxf_entity* const entity,
+                        struct dxf_snapshot_header* const header, struct string_table* const strings,
+                        struct hashtable* const xdata_offsets)
+{
+    struct dxf_snapshot_section* const arrays = header->arrays;
+    const struct dxf_polyline *polyline;
+    const struct dxf_spline *spline;
+    const struct dxf_hatch *hatch;
+    const char *str;
+    dxf_snapshot_off_t offset;
+
+    if (record_sizes[entity->type] == 0) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): No record for entity type %d. \n", entity->type);
+        return -1;
+    }
+    ++(header->entities[entity->type].count);
+    ++(header->number_of_entities);
+
+    if ((entity->xdata != NULL) && (entity->xdata->str != NULL)
+        && ((string_table_add_span(strings, entity->xdata->str, entity->xdata->length, &offset) != 0)
+            || (hashtable_put(xdata_offsets, (void*)&entity, sizeof(struct dxf_entity*),
+                            &offset, sizeof(dxf_snapshot_off_t)) != 0)))
+    {
+        return -1;
+    }
+    if ((entity->xdata != NULL) && (entity->xdata->dictionary != NULL)
+        && (string_table_intern(strings, entity->xdata->dictionary, &offset) != 0))
+    {
+        return -1;
+    }
+
+    switch (entity->type) {
+        case DXF_POLYLINE:
+            polyline = (const struct dxf_polyline*)entity;
+            arrays[DXF_SNAPSHOT_POLYLINE_VERTICES].count += (unsigned int)(polyline->number_of_vertices);
+            arrays[DXF_SNAPSHOT_POLYLINE_FACES].count += (unsigned int)(polyline->number_of_faces);
+            break;
+        case DXF_LWPOLYLINE:
+            arrays[DXF_SNAPSHOT_LWPOLYLINE_VERTICES].count +=
+                (unsigned int)count_vertices((const struct dxf_lwpolyline*)entity);
+            break;
+        case DXF_SPLINE:
+            spline = (const struct dxf_spline*)entity;
+            arrays[DXF_SNAPSHOT_REALS].count += (unsigned int)(spline->number_of_knots
+                + 3 * spline->number_of_control_points + 3 * spline->number_of_fit_points
+                + (spline->weights != NULL ? spline->number_of_control_points : 0));
+            break;
+        case DXF_HATCH:
+            hatch = (const struct dxf_hatch*)entity;
+            arrays[DXF_SNAPSHOT_HATCH_LOOPS].count += (unsigned int)(hatch->number_of_loops);
+            arrays[DXF_SNAPSHOT_HATCH_VERTICES].count += (unsigned int)(hatch->number_of_vertices);
+            arrays[DXF_SNAPSHOT_HATCH_EDGES].count += (unsigned int)(hatch->number_of_edges);
+            arrays[DXF_SNAPSHOT_HATCH_PATTERN_LINES].count += (unsigned int)(hatch->number_of_pattern_lines);
+            arrays[DXF_SNAPSHOT_REALS].count += (unsigned int)(hatch->number_of_knots
+                + 3 * hatch->number_of_control_points + hatch->number_of_dashes + 2 * hatch->number_of_seeds);
+            if ((hatch->pattern_name != NULL)
+                && (string_table_intern(strings, hatch->pattern_name, &offset) != 0))
+            {
+                return -1;
+            }
+            break;
+        case DXF_TEXTSTRING:
+        case DXF_MTEXT:
+            if (((str = dxf_text_get_string(dxf, entity)) == NULL)
+                || (string_table_intern(strings, str, &offset) != 0))
+            {
+                errprint("dxfsnapshot: dxf_snapshot_write(): No text for entity %lu. \n",
+                        (unsigned long)(entity->seq));
+                return -1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/* The list, which can hold fewer vertices than group 90 announced. */
+static size_t count_vertices(const struct dxf_lwpolyline* const lwpolyline)
+{
+    const struct dxf_lwpolyline_vertex *vertex;
+    size_t count = 0;
+
+    for (vertex = lwpolyline->vertices; vertex != NULL; vertex = vertex->next) {
+        ++count;
+    }
+
+    return count;
+}
+
+/* Takes count items of an array and returns the first of them. */
+static void* next_items(struct array_cursor* const cursor, int array, size_t count,
+                        unsigned int *first)
+{
+    *first = cursor->written[array];
+    cursor->written[array] += (unsigned int)count;
+
+    return cursor->buf + cursor->header->arrays[array].offset + *first * array_sizes[array];
+}
+
+static unsigned int put_reals(struct array_cursor* const cursor, const double *values,
+                            size_t count)
+{
+    unsigned int first;
+    double *reals = (double*)next_items(cursor, DXF_SNAPSHOT_REALS, count, &first);
+
+    if (count > 0) {
+        memcpy(reals, values, count * sizeof(double));
+    }
+
+    return first;
+}
+
+static void write_polyline(struct dxf_snapshot_polyline* const record,
+                            const struct dxf_polyline* const polyline,
+                            struct array_cursor* const cursor)
+{
+    struct dxf_snapshot_polyline_vertex *vertex;
+    struct dxf_snapshot_polyline_face *face;
+    size_t i;
+
+    record->flag = polyline->flag;
+    record->m_count = polyline->m_count;
+    record->n_count = polyline->n_count;
+    record->elevation = polyline->elevation;
+    memcpy(record->extrusion, polyline->extrusion, 3 * sizeof(double));
+
+    record->number_of_vertices = (unsigned int)(polyline->number_of_vertices);
+    vertex = (struct dxf_snapshot_polyline_vertex*)next_items(cursor, DXF_SNAPSHOT_POLYLINE_VERTICES,
+                polyline->number_of_vertices, &(record->first_vertex));
+    for (i = 0; i < polyline->number_of_vertices; ++i, ++vertex) {
+        vertex->x = polyline->vertices[i].x;
+        vertex->y = polyline->vertices[i].y;
+        vertex->z = polyline->vertices[i].z;
+        vertex->bulge = polyline->vertices[i].bulge;
+        vertex->flag = polyline->vertices[i].flag;
+    }
+
+    record->number_of_faces = (unsigned int)(polyline->number_of_faces);
+    face = (struct dxf_snapshot_polyline_face*)next_items(cursor, DXF_SNAPSHOT_POLYLINE_FACES,
+                polyline->number_of_faces, &(record->first_face));
+    for (i = 0; i < polyline->number_of_faces; ++i) {
+        memcpy(face[i].vertices, polyline->faces[i].vertices, 4 * sizeof(int));
+    }
+}
+
+static void write_spline(struct dxf_snapshot_spline* const record,
+                        const struct dxf_spline* const spline, struct array_cursor* const cursor)
+{
+    record->flag = spline->flag;
+    record->degree = spline->degree;
+    record->number_of_knots = (unsigned int)(spline->number_of_knots);
+    record->knots = put_reals(cursor, spline->knots, spline->number_of_knots);
+    record->number_of_control_points = (unsigned int)(spline->number_of_control_points);
+    record->control_points = put_reals(cursor, spline->control_points,
+                                        3 * spline->number_of_control_points);
+    record->number_of_weights = spline->weights != NULL ? record->number_of_control_points : 0;
+    record->weights = put_reals(cursor, spline->weights, record->number_of_weights);
+    record->number_of_fit_points = (unsigned int)(spline->number_of_fit_points);
+    record->fit_points = put_reals(cursor, spline->fit_points, 3 * spline->number_of_fit_points);
+}
+
+static void write_hatch(struct dxf_snapshot_hatch* const record, const struct dxf_hatch* const hatch,
+                        struct array_cursor* const cursor, struct hashtable* const string_offsets)
+{
+    struct dxf_snapshot_hatch_loop *loop;
+    struct dxf_snapshot_hatch_vertex *vertex;
+    struct dxf_snapshot_hatch_edge *edge;
+    struct dxf_snapshot_hatch_pattern_line *line;
+    size_t i;
+
+    record->pattern_name = get_string_offset(string_offsets, hatch->pattern_name);
+    record->solid_fill = hatch->solid_fill;
+    record->style = hatch->style;
+    record->pattern_type = hatch->pattern_type;
+    record->pattern_angle = hatch->pattern_angle;
+    record->pattern_scale = hatch->pattern_scale;
+    record->elevation = hatch->elevation;
+    memcpy(record->extrusion, hatch->extrusion, 3 * sizeof(double));
+
+    record->number_of_loops = (unsigned int)(hatch->number_of_loops);
+    loop = (struct dxf_snapshot_hatch_loop*)next_items(cursor, DXF_SNAPSHOT_HATCH_LOOPS,
+                hatch->number_of_loops, &(record->first_loop));
+    for (i = 0; i < hatch->number_of_loops; ++i, ++loop) {
+        loop->flag = hatch->loops[i].flag;
+        loop->closed = hatch->loops[i].closed;
+        loop->first = (unsigned int)(hatch->loops[i].first);
+        loop->count = (unsigned int)(hatch->loops[i].count);
+    }
+
+    record->number_of_vertices = (unsigned int)(hatch->number_of_vertices);
+    vertex = (struct dxf_snapshot_hatch_vertex*)next_items(cursor, DXF_SNAPSHOT_HATCH_VERTICES,
+                hatch->number_of_vertices, &(record->first_vertex));
+    for (i = 0; i < hatch->number_of_vertices; ++i, ++vertex) {
+        vertex->x = hatch->vertices[i].x;
+        vertex->y = hatch->vertices[i].y;
+        vertex->bulge = hatch->vertices[i].bulge;
+    }
+
+    record->number_of_edges = (unsigned int)(hatch->number_of_edges);
+    edge = (struct dxf_snapshot_hatch_edge*)next_items(cursor, DXF_SNAPSHOT_HATCH_EDGES,
+                hatch->number_of_edges, &(record->first_edge));
+    for (i = 0; i < hatch->number_of_edges; ++i, ++edge) {
+        edge->type = hatch->edges[i].type;
+        edge->flag = hatch->edges[i].flag;
+        edge->x = hatch->edges[i].x;
+        edge->y = hatch->edges[i].y;
+        edge->x2 = hatch->edges[i].x2;
+        edge->y2 = hatch->edges[i].y2;
+        edge->r = hatch->edges[i].r;
+        edge->angle_start = hatch->edges[i].angle_start;
+        edge->angle_end = hatch->edges[i].angle_end;
+        edge->degree = hatch->edges[i].degree;
+        edge->first_knot = (unsigned int)(hatch->edges[i].first_knot);
+        edge->number_of_knots = (unsigned int)(hatch->edges[i].number_of_knots);
+        edge->first_control_point = (unsigned int)(hatch->edges[i].first_control_point);
+        edge->number_of_control_points = (unsigned int)(hatch->edges[i].number_of_control_points);
+    }
+
+    record->number_of_pattern_lines = (unsigned int)(hatch->number_of_pattern_lines);
+    line = (struct dxf_snapshot_hatch_pattern_line*)next_items(cursor, DXF_SNAPSHOT_HATCH_PATTERN_LINES,
+                hatch->number_of_pattern_lines, &(record->first_pattern_line));
+    for (i = 0; i < hatch->number_of_pattern_lines; ++i, ++line) {
+        line->angle = hatch->pattern_lines[i].angle;
+        line->x = hatch->pattern_lines[i].x;
+        line->y = hatch->pattern_lines[i].y;
+        line->dx = hatch->pattern_lines[i].dx;
+        line->dy = hatch->pattern_lines[i].dy;
+        line->first_dash = (unsigned int)(hatch->pattern_lines[i].first_dash);
+        line->number_of_dashes = (unsigned int)(hatch->pattern_lines[i].number_of_dashes);
+    }
+
+    record->number_of_knots = (unsigned int)(hatch->number_of_knots);
+    record->knots = put_reals(cursor, hatch->knots, hatch->number_of_knots);
+    record->number_of_control_points = (unsigned int)(hatch->number_of_control_points);
+    record->control_points = put_reals(cursor, hatch->control_points, 3 * hatch->number_of_control_points);
+    record->number_of_dashes = (unsigned int)(hatch->number_of_dashes);
+    record->dashes = put_reals(cursor, hatch->dashes, hatch->number_of_dashes);
+    record->number_of_seeds = (unsigned int)(hatch->number_of_seeds);
+    record->seeds = put_reals(cursor, hatch->seeds, 2 * hatch->number_of_seeds);
+}
+
+static void write_insert(struct dxf_snapshot_insert* const record,
+                        const struct dxf_insert* const insert, struct hashtable* const block_indices)
+{
+    memcpy(&(record->x), &(insert->x), 7 * sizeof(double));
+    record->column_count = insert->column_count;
+    record->row_count = insert->row_count;
+    record->block_ref = get_container_index(block_indices, insert->block_ref);
+    record->column_spacing = insert->column_spacing;
+    record->row_spacing = insert->row_spacing;
+    memcpy(record->extrusion, insert->extrusion, 3 * sizeof(double));
+}
+
+/* Strings were interned while counting; 0 is the empty string. */
+static dxf_snapshot_off_t get_string_offset(struct hashtable* const string_offsets, const char *str)
+{
+    const dxf_snapshot_off_t *offset;
+
+    if (str == NULL) {
+        return 0;
+    }
+
+    offset = hashtable_get(string_offsets, (void*)&str);
+    return offset != NULL ? *offset : 0;
+}
+
+/* Fails rather than drops an entity it has no record for, so a snapshot
+ * always holds the whole document.
+ */
+int dxf_snapshot_write(struct dxf* const dxf, const char *filename)
+{
+    struct dxf_snapshot_header header;
+    struct string_table strings;
+    struct hashtable layer_indices;
+    struct hashtable block_indices;
+    struct hashtable xdata_offsets;
+    struct array_cursor cursor;
+    unsigned int number_of_layers;
+    unsigned int number_of_blocks;
+    unsigned int written[DXF_ENTITY_TYPES_COUNT];
+    struct dxf_container *container;
+    struct dxf_entity *entity;
+    struct dxf_lwpolyline_vertex *vertex;
+    struct dxf_dimension *dimension;
+    struct dxf_text *text;
+    struct dxf_mtext *mtext;
+    struct dxf_snapshot_entity *record;
+    struct dxf_snapshot_lwpolyline_vertex *vertex_record;
+    struct dxf_snapshot_dimension *dimension_record;
+    struct dxf_snapshot_text *text_record;
+    struct dxf_snapshot_mtext *mtext_record;
+    const dxf_snapshot_off_t *xdata_offset;
+    dxf_snapshot_off_t offset;
+    char *buf = NULL;
+    size_t size;
+    int type;
+    int i;
+    int retval = -1;
+    FILE *fp;
+
+    memset(&header, 0, sizeof(struct dxf_snapshot_header));
+    memset(written, 0, sizeof(written));
+
+    if (string_table_init(&strings) != 0) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Failed to create string table. \n");
+        return -1;
+    }
+
+    hashtable_create(&layer_indices, 0, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)ptr_hash, (pfn_keycmp_t)ptr_cmp, NULL);
+    hashtable_create(&block_indices, 0, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)ptr_hash, (pfn_keycmp_t)ptr_cmp, NULL);
+    hashtable_create(&xdata_offsets, 0, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)ptr_hash, (pfn_keycmp_t)ptr_cmp, NULL);
+
+    if ((index_containers(dxf->layers, &layer_indices, &strings, &number_of_layers) != 0)
+        || (index_containers(dxf->blocks, &block_indices, &strings, &number_of_blocks) != 0))
+    {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Failed to index containers. \n");
+        goto out;
+    }
+
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        if (count_entity(dxf, entity, &header, &strings, &xdata_offsets) != 0) {
+            goto out;
+        }
+    }
+
+    /* Lay out the sections. */
+    size = ALIGN_UP(sizeof(struct dxf_snapshot_header), SECTION_ALIGNMENT);
+    header.strings.offset = (dxf_snapshot_off_t)size;
+    header.strings.count = (unsigned int)(strings.len);
+    size += ALIGN_UP(strings.len, SECTION_ALIGNMENT);
+    header.layers.offset = (dxf_snapshot_off_t)size;
+    header.layers.count = number_of_layers;
+    size += number_of_layers * sizeof(struct dxf_snapshot_container);
+    header.blocks.offset = (dxf_snapshot_off_t)size;
+    header.blocks.count = number_of_blocks;
+    size += number_of_blocks * sizeof(struct dxf_snapshot_container);
+    for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+        header.entities[type].offset = (dxf_snapshot_off_t)size;
+        size += header.entities[type].count * record_sizes[type];
+    }
+    for (i = 0; i < DXF_SNAPSHOT_ARRAYS_COUNT; ++i) {
+        header.arrays[i].offset = (dxf_snapshot_off_t)size;
+        size += header.arrays[i].count * array_sizes[i];
+    }
+
+    if (size > (dxf_snapshot_off_t)(-1)) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Document too large for a snapshot. \n");
+        goto out;
+    }
+
+    if ((buf = (char*)calloc(1, size)) == NULL) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Failed to allocate %zu bytes. \n", size);
+        goto out;
+    }
+
+    memcpy(buf + header.strings.offset, strings.buf, strings.len);
+    memset(&cursor, 0, sizeof(struct array_cursor));
+    cursor.buf = buf;
+    cursor.header = &header;
+
+    offset = header.layers.offset;
+    for (container = dxf->layers; container != NULL; container = container->next) {
+        write_container((struct dxf_snapshot_container*)(buf + offset), container,
+                        &strings.offsets, &layer_indices);
+        offset += sizeof(struct dxf_snapshot_container);
+    }
+
+    for (container = dxf->blocks; container != NULL; container = container->next) {
+        write_container((struct dxf_snapshot_container*)(buf + offset), container,
+                        &strings.offsets, &layer_indices);
+        offset += sizeof(struct dxf_snapshot_container);
+    }
+
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        type = entity->type;
+        record = (struct dxf_snapshot_entity*)(buf + header.entities[type].offset
+                                                + written[type]++ * record_sizes[type]);
+        record->seq = (unsigned int)(entity->seq);
+        record->layer = get_container_index(&layer_indices, entity->layer);
+        record->block = get_container_index(&block_indices, entity->block);
+        if (entity->xdata != NULL) {
+            xdata_offset = hashtable_get(&xdata_offsets, (void*)&entity);
+            record->xdata = (xdata_offset != NULL) ? *xdata_offset : 0;
+            record->dictionary = get_string_offset(&strings.offsets, entity->xdata->dictionary);
+        }
+
+        switch (type) {
+            case DXF_POINT:
+                memcpy(&(((struct dxf_snapshot_point*)record)->x), &(((struct dxf_point*)entity)->x),
+                        3 * sizeof(double));
+                break;
+            case DXF_LINE:
+                memcpy(&(((struct dxf_snapshot_line*)record)->x1), &(((struct dxf_line*)entity)->x1),
+                        6 * sizeof(double));
+                break;
+            case DXF_CIRCLE:
+                memcpy(&(((struct dxf_snapshot_circle*)record)->x), &(((struct dxf_circle*)entity)->x),
+                        4 * sizeof(double));
+                memcpy(((struct dxf_snapshot_circle*)record)->extrusion,
+                        ((struct dxf_circle*)entity)->extrusion, 3 * sizeof(double));
+                break;
+            case DXF_ARC:
+                memcpy(&(((struct dxf_snapshot_arc*)record)->x), &(((struct dxf_arc*)entity)->x),
+                        6 * sizeof(double));
+                memcpy(((struct dxf_snapshot_arc*)record)->extrusion,
+                        ((struct dxf_arc*)entity)->extrusion, 3 * sizeof(double));
+                break;
+            case DXF_ELLIPSE:
+                memcpy(&(((struct dxf_snapshot_ellipse*)record)->x), &(((struct dxf_ellipse*)entity)->x),
+                        3 * sizeof(double));
+                memcpy(((struct dxf_snapshot_ellipse*)record)->major, ((struct dxf_ellipse*)entity)->major,
+                        3 * sizeof(double));
+                ((struct dxf_snapshot_ellipse*)record)->ratio = ((struct dxf_ellipse*)entity)->ratio;
+                ((struct dxf_snapshot_ellipse*)record)->param_start = ((struct dxf_ellipse*)entity)->param_start;
+                ((struct dxf_snapshot_ellipse*)record)->param_end = ((struct dxf_ellipse*)entity)->param_end;
+                memcpy(((struct dxf_snapshot_ellipse*)record)->extrusion,
+                        ((struct dxf_ellipse*)entity)->extrusion, 3 * sizeof(double));
+                break;
+            case DXF_POLYLINE:
+                write_polyline((struct dxf_snapshot_polyline*)record, (struct dxf_polyline*)entity, &cursor);
+                break;
+            case DXF_LWPOLYLINE:
+                ((struct dxf_snapshot_lwpolyline*)record)->flag = ((struct dxf_lwpolyline*)entity)->flag;
+                memcpy(((struct dxf_snapshot_lwpolyline*)record)->extrusion,
+                        ((struct dxf_lwpolyline*)entity)->extrusion, 3 * sizeof(double));
+                ((struct dxf_snapshot_lwpolyline*)record)->number_of_vertices =
+                    (unsigned int)count_vertices((struct dxf_lwpolyline*)entity);
+                vertex_record = (struct dxf_snapshot_lwpolyline_vertex*)next_items(&cursor,
+                                    DXF_SNAPSHOT_LWPOLYLINE_VERTICES,
+                                    ((struct dxf_snapshot_lwpolyline*)record)->number_of_vertices,
+                                    &(((struct dxf_snapshot_lwpolyline*)record)->first_vertex));
+                for (vertex = ((struct dxf_lwpolyline*)entity)->vertices; vertex != NULL; vertex = vertex->next) {
+                    vertex_record->x = vertex->x;
+                    vertex_record->y = vertex->y;
+                    vertex_record->z = vertex->z;
+                    vertex_record->bulge = vertex->bulge;
+                    ++vertex_record;
+                }
+                break;
+            case DXF_SPLINE:
+                write_spline((struct dxf_snapshot_spline*)record, (struct dxf_spline*)entity, &cursor);
+                break;
+            case DXF_HATCH:
+                write_hatch((struct dxf_snapshot_hatch*)record, (struct dxf_hatch*)entity, &cursor,
+                            &strings.offsets);
+                break;
+            case DXF_INSERT:
+                write_insert((struct dxf_snapshot_insert*)record, (struct dxf_insert*)entity, &block_indices);
+                break;
+            case DXF_DIMENSION:
+                dimension = (struct dxf_dimension*)entity;
+                dimension_record = (struct dxf_snapshot_dimension*)record;
+                write_insert(&(dimension_record->insert), &(dimension->insert), &block_indices);
+                dimension_record->type = dimension->type;
+                memcpy(dimension_record->definition, dimension->definition, 3 * sizeof(double));
+                memcpy(dimension_record->text_midpoint, dimension->text_midpoint, 3 * sizeof(double));
+                memcpy(dimension_record->points, dimension->points, 12 * sizeof(double));
+                dimension_record->measurement = dimension->measurement;
+                dimension_record->angle = dimension->angle;
+                break;
+            case DXF_TEXTSTRING:
+                text = (struct dxf_text*)entity;
+                text_record = (struct dxf_snapshot_text*)record;
+                memcpy(&(text_record->x), &(text->x), 10 * sizeof(double));
+                text_record->generation = text->generation;
+                text_record->horizontal_justification = text->horizontal_justification;
+                text_record->vertical_justification = text->vertical_justification;
+                text_record->string = get_string_offset(&strings.offsets, text->body.string);
+                memcpy(text_record->extrusion, text->extrusion, 3 * sizeof(double));
+                break;
+            case DXF_MTEXT:
+                mtext = (struct dxf_mtext*)entity;
+                mtext_record = (struct dxf_snapshot_mtext*)record;
+                memcpy(&(mtext_record->x), &(mtext->x), 10 * sizeof(double));
+                mtext_record->attachment = mtext->attachment;
+                mtext_record->drawing_direction = mtext->drawing_direction;
+                mtext_record->string = get_string_offset(&strings.offsets, mtext->body.string);
+                memcpy(mtext_record->extrusion, mtext->extrusion, 3 * sizeof(double));
+                break;
+            case DXF_SOLID:
+                memcpy(((struct dxf_snapshot_solid*)record)->corners, ((struct dxf_solid*)entity)->corners,
+                        12 * sizeof(double));
+                memcpy(((struct dxf_snapshot_solid*)record)->extrusion, ((struct dxf_solid*)entity)->extrusion,
+                        3 * sizeof(double));
+                break;
+            default:
+                break;
+        }
+    }
+
+    memcpy(header.magic, DXF_SNAPSHOT_MAGIC, sizeof(DXF_SNAPSHOT_MAGIC));
+    header.version = DXF_SNAPSHOT_VERSION;
+    header.byte_order = DXF_SNAPSHOT_BYTE_ORDER;
+    header.header_size = sizeof(struct dxf_snapshot_header);
+    header.total_size = (dxf_snapshot_off_t)size;
+    header.checksum = checksum(buf + header.strings.offset, size - header.strings.offset);
+    memcpy(buf, &header, sizeof(struct dxf_snapshot_header));
+
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Failed to open %s for writing. \n", filename);
+        goto out;
+    }
+
+    if (fwrite(buf, 1, size, fp) != size) {
+        errprint("dxfsnapshot: dxf_snapshot_write(): Failed to write %s. \n", filename);
+        fclose(fp);
+        remove(filename);
+        goto out;
+    }
+
+    fclose(fp);
+    retval = 0;
+    dbgprint("dxfsnapshot: dxf_snapshot_write(): Wrote %zu bytes to %s. \n", size, filename);
+
+out:
+    free(buf);
+    hashtable_destroy(&xdata_offsets);
+    hashtable_destroy(&block_indices);
+    hashtable_destroy(&layer_indices);
+    string_table_free(&strings);
+    return retval;
+}
+
+static void write_container(struct dxf_snapshot_container* const record,
+                            const struct dxf_container* const container,
+                            struct hashtable* const string_offsets,
+                            struct hashtable* const layer_indices)
+{
+    record->name = get_string_offset(string_offsets, container->name);
+    record->flag = container->flag;
+    record->parent = get_container_index(layer_indices, container->parent);
+    record->color = container->color;
+    record->linetype = get_string_offset(string_offsets, container->linetype);
+    record->handle = get_string_offset(string_offsets, container->handle);
+    record->x = container->x;
+    record->y = container->y;
+    record->z = container->z;
+}
+
+/* In size_t, so that offsets and counts read from the file cannot wrap
+ * around and pass.
+ */
+static int section_fits(const struct dxf_snapshot_section* const section, size_t item_size,
+                        size_t size)
+{
+    size_t offset = section->offset;
+
+    if (offset > size) {
+        return 0;
+    }
+
+    return (item_size == 0) || ((size_t)(section->count) <= (size - offset) / item_size);
+}
+
+static int validate(const struct dxf_snapshot* const snapshot, int flags)
+{
+    const struct dxf_snapshot_header *header = snapshot->header;
+    size_t size = snapshot->size;
+    int type;
+    int i;
+
+    if ((size < sizeof(struct dxf_snapshot_header))
+        || (memcmp(header->magic, DXF_SNAPSHOT_MAGIC, sizeof(DXF_SNAPSHOT_MAGIC)) != 0))
+    {
+        errprint("dxfsnapshot: Not a snapshot. \n");
+        return -1;
+    }
+
+    if ((header->version != DXF_SNAPSHOT_VERSION) || (header->byte_order != DXF_SNAPSHOT_BYTE_ORDER)
+        || (header->header_size != sizeof(struct dxf_snapshot_header)) || (header->total_size != size))
+    {
+        errprint("dxfsnapshot: Snapshot version %u is not supported or the file is truncated. \n",
+                header->version);
+        return -1;
+    }
+
+    if ((header->strings.count == 0) || !section_fits(&(header->strings), 1, size)
+        || (snapshot->base[(size_t)(header->strings.offset) + header->strings.count - 1] != '\0')
+        || !section_fits(&(header->layers), sizeof(struct dxf_snapshot_container), size)
+        || !section_fits(&(header->blocks), sizeof(struct dxf_snapshot_container), size))
+    {
+        errprint("dxfsnapshot: Section out of bounds. \n");
+        return -1;
+    }
+
+    for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+        if (!section_fits(&(header->entities[type]), record_sizes[type], size)
+            || ((record_sizes[type] == 0) && (header->entities[type].count != 0)))
+        {
+            errprint("dxfsnapshot: Entity section %d out of bounds. \n", type);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < DXF_SNAPSHOT_ARRAYS_COUNT; ++i) {
+        if (!section_fits(&(header->arrays[i]), array_sizes[i], size)) {
+            errprint("dxfsnapshot: Array %d out of bounds. \n", i);
+            return -1;
+        }
+    }
+
+    if (((flags & DXF_SNAPSHOT_VERIFY_CHECKSUM) != 0)
+        && (checksum(snapshot->base + header->strings.offset, size - header->strings.offset)
+            != header->checksum))
+    {
+        errprint("dxfsnapshot: Checksum mismatch. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Maps a snapshot read-only. Only the header is inspected unless
+ * DXF_SNAPSHOT_VERIFY_CHECKSUM is given, which reads the whole file.
+ */
+int dxf_snapshot_open(struct dxf_snapshot* const snapshot, const char *filename, int flags)
+{
+    memmap_fd_t fd;
+    memmap_fd_t fd2;
+
+    snapshot->base = NULL;
+    snapshot->header = NULL;
+    snapshot->fd = (memmap_fd_t)(-1);
+
+    if ((fd = memmap_open(filename, O_RDONLY, 0)) == (memmap_fd_t)(-1)) {
+        errprint("dxfsnapshot: dxf_snapshot_open(): Failed to open %s for mapping. \n", filename);
+        return -1;
+    }
+
+    snapshot->size = memmap_get_file_size(fd);
+    if (snapshot->size < sizeof(struct dxf_snapshot_header)) {
+        errprint("dxfsnapshot: dxf_snapshot_open(): %s is too short. \n", filename);
+        memmap_close(fd);
+        return -1;
+    }
+
+    if ((snapshot->base = (const char*)memmap_map(NULL, snapshot->size, MEMMAP_READ,
+        MEMMAP_SHARED, fd, 0, &fd2)) == NULL)
+    {
+        memmap_close(fd);
+        return -1;
+    }
+
+    snapshot->fd = fd;
+    snapshot->fd2 = fd2;
+    snapshot->header = (const struct dxf_snapshot_header*)(snapshot->base);
+
+    if (validate(snapshot, flags) != 0) {
+        errprint("dxfsnapshot: dxf_snapshot_open(): Rejected %s. \n", filename);
+        dxf_snapshot_close(snapshot);
+        return -1;
+    }
+
+    return 0;
+}
+
+int dxf_snapshot_close(struct dxf_snapshot* const snapshot)
+{
+    if (snapshot->fd != (memmap_fd_t)(-1)) {
+        memmap_unmap((void*)(snapshot->base), snapshot->size, snapshot->fd2);
+        memmap_close(snapshot->fd);
+    }
+
+    snapshot->base = NULL;
+    snapshot->header = NULL;
+    snapshot->size = 0;
+    snapshot->fd = (memmap_fd_t)(-1);
+    return 0;
+}
+
+const char* dxf_snapshot_get_string(const struct dxf_snapshot* const snapshot,
+                                    dxf_snapshot_off_t offset)
+{
+    if (offset >= snapshot->header->strings.count) {
+        return NULL;
+    }
+
+    return snapshot->base + snapshot->header->strings.offset + offset;
+}
+
+const struct dxf_snapshot_container* dxf_snapshot_get_layers(
+                                    const struct dxf_snapshot* const snapshot, size_t *count)
+{
+    *count = snapshot->header->layers.count;
+    return (const struct dxf_snapshot_container*)(snapshot->base + snapshot->header->layers.offset);
+}
+
+const struct dxf_snapshot_container* dxf_snapshot_get_blocks(
+                                    const struct dxf_snapshot* const snapshot, size_t *count)
+{
+    *count = snapshot->header->blocks.count;
+    return (const struct dxf_snapshot_container*)(snapshot->base + snapshot->header->blocks.offset);
+}
+
+const void* dxf_snapshot_get_entities(const struct dxf_snapshot* const snapshot,
+                                    int entity_type, size_t *count)
+{
+    if ((entity_type < DXF_ENTITY_TYPE_START) || (entity_type > DXF_ENTITY_TYPE_END)) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = snapshot->header->entities[entity_type].count;
+    return snapshot->base + snapshot->header->entities[entity_type].offset;
+}
+
+const struct dxf_snapshot_lwpolyline_vertex* dxf_snapshot_get_vertices(
+                                    const struct dxf_snapshot* const snapshot,
+                                    const struct dxf_snapshot_lwpolyline* const lwpolyline)
+{
+    return (const struct dxf_snapshot_lwpolyline_vertex*)dxf_snapshot_get_array(snapshot,
+                DXF_SNAPSHOT_LWPOLYLINE_VERTICES, lwpolyline->first_vertex, lwpolyline->number_of_vertices);
+}
+
+/* Items first to first + count of an array, NULL if that runs past its
+ * end. Records come from the file, so check before following them.
+ */
+const void* dxf_snapshot_get_array(const struct dxf_snapshot* const snapshot, int array,
+                                    unsigned int first, unsigned int count)
+{
+    const struct dxf_snapshot_section *section;
+
+    if ((array < 0) || (array >= DXF_SNAPSHOT_ARRAYS_COUNT)) {
+        return NULL;
+    }
+
+    section = &(snapshot->header->arrays[array]);
+    if ((first > section->count) || (count > section->count - first)) {
+        return NULL;
+    }
+
+    return snapshot->base + section->offset + (size_t)first * array_sizes[array];
+}
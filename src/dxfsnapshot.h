@@ -0,0 +1,378 @@
+#ifndef __DXF_SNAPSHOT_H__
+#define __DXF_SNAPSHOT_H__
+
+#include "dxf.h"
+#include "memmap.h"
+
+/* On-disk image of a parsed struct dxf. Every reference is an offset
+ * from the start of the file or an index into a record array, so the
+ * file can be mapped read-only and used in place. Records are laid out
+ * with 4 and 8 byte members only and are stored in host byte order;
+ * the header records the byte order and a snapshot written on another
+ * architecture is rejected.
+ *
+ * Layout: header | string table | layers | blocks |
+ *         one array per entity type | the arrays below
+ *
+ * Every parsed entity type has a record. Variable-length data lives in
+ * shared arrays that records refer to by first element and count; hatch
+ * loops, edges and pattern lines count from the hatch's own first
+ * vertex, edge, knot, control point and dash, as in struct dxf_hatch.
+ * Text is stored decoded, in the string table. XDATA is stored there
+ * too, as the raw DXF text dxfxdata.h decodes, next to the extension
+ * dictionary handle.
+ */
+
+#define DXF_SNAPSHOT_MAGIC "DXFSNAP"
+#define DXF_SNAPSHOT_VERSION 5
+#define DXF_SNAPSHOT_BYTE_ORDER 0x01020304u
+#define DXF_SNAPSHOT_NO_CONTAINER 0xffffffffu
+
+/* Arrays */
+#define DXF_SNAPSHOT_LWPOLYLINE_VERTICES 0
+#define DXF_SNAPSHOT_POLYLINE_VERTICES 1
+#define DXF_SNAPSHOT_POLYLINE_FACES 2
+#define DXF_SNAPSHOT_REALS 3                /* Spline and hatch numbers, doubles. */
+#define DXF_SNAPSHOT_HATCH_LOOPS 4
+#define DXF_SNAPSHOT_HATCH_VERTICES 5
+#define DXF_SNAPSHOT_HATCH_EDGES 6
+#define DXF_SNAPSHOT_HATCH_PATTERN_LINES 7
+#define DXF_SNAPSHOT_ARRAYS_COUNT 8
+
+/* dxf_snapshot_open() flags */
+#define DXF_SNAPSHOT_DEFAULT 0
+#define DXF_SNAPSHOT_VERIFY_CHECKSUM 1
+
+typedef unsigned int dxf_snapshot_off_t;
+
+struct dxf_snapshot_section {
+    dxf_snapshot_off_t offset;
+    unsigned int count;
+};
+
+struct dxf_snapshot_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned int header_size;
+    unsigned int checksum;      /* Over everything after the header. */
+    dxf_snapshot_off_t total_size;
+    unsigned int number_of_entities;
+    struct dxf_snapshot_section strings;    /* count is the size in bytes. */
+    struct dxf_snapshot_section layers;
+    struct dxf_snapshot_section blocks;
+    struct dxf_snapshot_section entities[DXF_ENTITY_TYPES_COUNT];
+    struct dxf_snapshot_section arrays[DXF_SNAPSHOT_ARRAYS_COUNT];
+};
+
+/* color, linetype and handle are the LAYER table properties; a negative
+ * color is a layer that is turned off, as in struct dxf_container.
+ */
+struct dxf_snapshot_container {
+    dxf_snapshot_off_t name;
+    int flag;
+    unsigned int parent;        /* Layer index or DXF_SNAPSHOT_NO_CONTAINER. */
+    int color;
+    dxf_snapshot_off_t linetype;
+    dxf_snapshot_off_t handle;
+    double x;
+    double y;
+    double z;
+};
+
+struct dxf_snapshot_entity {
+    unsigned int seq;
+    unsigned int layer;         /* Layer index or DXF_SNAPSHOT_NO_CONTAINER. */
+    unsigned int block;         /* Block index or DXF_SNAPSHOT_NO_CONTAINER. */
+    dxf_snapshot_off_t xdata;   /* Raw XDATA text, 0 without XDATA. */
+    dxf_snapshot_off_t dictionary;  /* ACAD_XDICTIONARY handle, 0 without one. */
+    unsigned int reserved;
+};
+
+struct dxf_snapshot_point {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+};
+
+struct dxf_snapshot_line {
+    struct dxf_snapshot_entity header;
+    double x1;
+    double y1;
+    double z1;
+    double x2;
+    double y2;
+    double z2;
+};
+
+struct dxf_snapshot_circle {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double r;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_arc {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double r;
+    double angle_start;
+    double angle_end;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_lwpolyline_vertex {
+    double x;
+    double y;
+    double z;
+    double bulge;
+};
+
+struct dxf_snapshot_lwpolyline {
+    struct dxf_snapshot_entity header;
+    unsigned int first_vertex;
+    unsigned int number_of_vertices;
+    int flag;
+    unsigned int reserved;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_ellipse {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double major[3];
+    double ratio;
+    double param_start;
+    double param_end;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_polyline_vertex {
+    double x;
+    double y;
+    double z;
+    double bulge;
+    int flag;
+    unsigned int reserved;
+};
+
+struct dxf_snapshot_polyline_face {
+    int vertices[4];
+};
+
+struct dxf_snapshot_polyline {
+    struct dxf_snapshot_entity header;
+    int flag;
+    int m_count;
+    int n_count;
+    unsigned int reserved;
+    unsigned int first_vertex;
+    unsigned int number_of_vertices;
+    unsigned int first_face;
+    unsigned int number_of_faces;
+    double elevation;
+    double extrusion[3];
+};
+
+/* Knots, control points, weights and fit points are runs of reals; the
+ * points are x, y, z triples. number_of_weights is 0 or the number of
+ * control points.
+ */
+struct dxf_snapshot_spline {
+    struct dxf_snapshot_entity header;
+    int flag;
+    int degree;
+    unsigned int knots;
+    unsigned int number_of_knots;
+    unsigned int control_points;
+    unsigned int number_of_control_points;
+    unsigned int weights;
+    unsigned int number_of_weights;
+    unsigned int fit_points;
+    unsigned int number_of_fit_points;
+};
+
+struct dxf_snapshot_hatch_loop {
+    int flag;
+    int closed;
+    unsigned int first;
+    unsigned int count;
+};
+
+struct dxf_snapshot_hatch_vertex {
+    double x;
+    double y;
+    double bulge;
+};
+
+struct dxf_snapshot_hatch_edge {
+    int type;
+    int flag;
+    double x;
+    double y;
+    double x2;
+    double y2;
+    double r;
+    double angle_start;
+    double angle_end;
+    int degree;
+    unsigned int first_knot;
+    unsigned int number_of_knots;
+    unsigned int first_control_point;
+    unsigned int number_of_control_points;
+    unsigned int reserved;
+};
+
+struct dxf_snapshot_hatch_pattern_line {
+    double angle;
+    double x;
+    double y;
+    double dx;
+    double dy;
+    unsigned int first_dash;
+    unsigned int number_of_dashes;
+};
+
+/* Knots, control points (x, y, weight), dashes and seeds (x, y) are
+ * runs of reals.
+ */
+struct dxf_snapshot_hatch {
+    struct dxf_snapshot_entity header;
+    dxf_snapshot_off_t pattern_name;
+    int solid_fill;
+    int style;
+    int pattern_type;
+    double pattern_angle;
+    double pattern_scale;
+    double elevation;
+    double extrusion[3];
+    unsigned int first_loop;
+    unsigned int number_of_loops;
+    unsigned int first_vertex;
+    unsigned int number_of_vertices;
+    unsigned int first_edge;
+    unsigned int number_of_edges;
+    unsigned int first_pattern_line;
+    unsigned int number_of_pattern_lines;
+    unsigned int knots;
+    unsigned int number_of_knots;
+    unsigned int control_points;
+    unsigned int number_of_control_points;
+    unsigned int dashes;
+    unsigned int number_of_dashes;
+    unsigned int seeds;
+    unsigned int number_of_seeds;
+};
+
+struct dxf_snapshot_text {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double height;
+    double angle;
+    double x_scale;
+    double oblique;
+    double x2;
+    double y2;
+    double z2;
+    int generation;
+    int horizontal_justification;
+    int vertical_justification;
+    dxf_snapshot_off_t string;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_mtext {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double height;
+    double width;
+    double angle;
+    double direction[3];
+    double line_spacing;
+    int attachment;
+    int drawing_direction;
+    dxf_snapshot_off_t string;
+    unsigned int reserved;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_solid {
+    struct dxf_snapshot_entity header;
+    double corners[4][3];
+    double extrusion[3];
+};
+
+struct dxf_snapshot_insert {
+    struct dxf_snapshot_entity header;
+    double x;
+    double y;
+    double z;
+    double x_scale;
+    double y_scale;
+    double z_scale;
+    double angle;
+    int column_count;
+    int row_count;
+    unsigned int block_ref;     /* Block index or DXF_SNAPSHOT_NO_CONTAINER. */
+    unsigned int reserved;
+    double column_spacing;
+    double row_spacing;
+    double extrusion[3];
+};
+
+struct dxf_snapshot_dimension {
+    struct dxf_snapshot_insert insert;
+    int type;
+    unsigned int reserved;
+    double definition[3];
+    double text_midpoint[3];
+    double points[4][3];
+    double measurement;
+    double angle;
+};
+
+struct dxf_snapshot {
+    const char *base;
+    size_t size;
+    memmap_fd_t fd;
+    memmap_fd_t fd2;
+    const struct dxf_snapshot_header *header;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_snapshot_write(struct dxf* const dxf, const char *filename);
+int dxf_snapshot_open(struct dxf_snapshot* const snapshot, const char *filename, int flags);
+int dxf_snapshot_close(struct dxf_snapshot* const snapshot);
+const char* dxf_snapshot_get_string(const struct dxf_snapshot* const snapshot,
+                                    dxf_snapshot_off_t offset);
+const struct dxf_snapshot_container* dxf_snapshot_get_layers(
+                                    const struct dxf_snapshot* const snapshot, size_t *count);
+const struct dxf_snapshot_container* dxf_snapshot_get_blocks(
+                                    const struct dxf_snapshot* const snapshot, size_t *count);
+const void* dxf_snapshot_get_entities(const struct dxf_snapshot* const snapshot,
+                                    int entity_type, size_t *count);
+const struct dxf_snapshot_lwpolyline_vertex* dxf_snapshot_get_vertices(
+                                    const struct dxf_snapshot* const snapshot,
+                                    const struct dxf_snapshot_lwpolyline* const lwpolyline);
+const void* dxf_snapshot_get_array(const struct dxf_snapshot* const snapshot, int array,
+                                    unsigned int first, unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_SNAPSHOT_H__ */
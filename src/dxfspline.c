@@ -0,0 +1,220 @@
+#include <math.h>
+#include "dxfspline.h"
+
+#include "dbgprint.h"
+
+static void put(struct dxf_tess_vertex *out, size_t *n, const double point[3])
+{
+    if (out != NULL) {
+        out[*n].x = point[0];
+        out[*n].y = point[1];
+        out[*n].z = point[2];
+    }
+    ++*n;
+}
+
+/* Degree in range, n + degree + 1 non-decreasing knots for n control
+ * points, and a parameter domain that is not empty.
+ */
+int dxf_spline_is_valid(const struct dxf_spline* const spline)
+{
+    size_t p = (size_t)spline->degree;
+    size_t n = spline->number_of_control_points;
+    size_t i;
+
+    if ((spline->degree < 1) || (spline->degree > DXF_SPLINE_MAX_DEGREE) || (n < p + 1)
+        || (spline->number_of_knots != n + p + 1))
+    {
+        return 0;
+    }
+
+    for (i = 1; i < spline->number_of_knots; ++i) {
+        if (spline->knots[i] < spline->knots[i - 1]) {
+            return 0;
+        }
+    }
+
+    return spline->knots[p] < spline->knots[n];
+}
+
+/* Knot span [knots[span], knots[span + 1]) holding t, clamped to the
+ * domain; the last non-empty span for its end.
+ */
+static size_t find_span(const struct dxf_spline* const spline, double t)
+{
+    const double *knots = spline->knots;
+    size_t low = (size_t)spline->degree;
+    size_t high = spline->number_of_control_points;
+    size_t mid;
+
+    if (t >= knots[high]) {
+        for (mid = high - 1; knots[mid] == knots[high]; --mid) {
+        }
+        return mid;
+    }
+    if (t <= knots[low]) {
+        for (mid = low; knots[mid + 1] == knots[low]; ++mid) {
+        }
+        return mid;
+    }
+
+    while (high - low > 1) {
+        mid = (low + high) / 2;
+        if (t < knots[mid]) {
+            high = mid;
+        }
+        else {
+            low = mid;
+        }
+    }
+
+    return low;
+}
+
+/* The degree + 1 basis functions that are non-zero on span at t. */
+static void basis(const double *knots, size_t span, int degree, double t, double *n)
+{
+    double left[DXF_SPLINE_MAX_DEGREE + 1];
+    double right[DXF_SPLINE_MAX_DEGREE + 1];
+    double saved;
+    double denominator;
+    double temp;
+    int j;
+    int r;
+
+    n[0] = 1.0;
+    for (j = 1; j <= degree; ++j) {
+        left[j] = t - knots[span + 1 - j];
+        right[j] = knots[span + j] - t;
+        saved = 0.0;
+        for (r = 0; r < j; ++r) {
+            denominator = right[r + 1] + left[j - r];
+            temp = (denominator != 0.0) ? n[r] / denominator : 0.0;
+            n[r] = saved + right[r + 1] * temp;
+            saved = left[j - r] * temp;
+        }
+        n[j] = saved;
+    }
+}
+
+static void point_at(const struct dxf_spline* const spline, size_t span, double t, double point[3])
+{
+    double n[DXF_SPLINE_MAX_DEGREE + 1];
+    const double *p = spline->control_points + 3 * (span - spline->degree);
+    const double *w = (spline->weights != NULL) ? spline->weights + (span - spline->degree) : NULL;
+    double sum = 0.0;
+    double x = 0.0;
+    double y = 0.0;
+    double z = 0.0;
+    double b;
+    int j;
+
+    basis(spline->knots, span, spline->degree, t, n);
+
+    for (j = 0; j <= spline->degree; ++j) {
+        b = (w != NULL) ? n[j] * w[j] : n[j];
+        x += b * p[3 * j];
+        y += b * p[3 * j + 1];
+        z += b * p[3 * j + 2];
+        sum += b;
+    }
+
+    if (sum == 0.0) {
+        sum = 1.0;
+    }
+    point[0] = x / sum;
+    point[1] = y / sum;
+    point[2] = z / sum;
+}
+
+/* count parameters into count x, y, z triples. 0 for an invalid spline. */
+size_t dxf_spline_evaluate(const struct dxf_spline* const spline, const double *t,
+                        size_t count, double *points)
+{
+    size_t i;
+
+    if (!dxf_spline_is_valid(spline)) {
+        dbgprint("dxfspline: dxf_spline_evaluate(): Spline %lu is not valid. \n",
+                (unsigned long)spline->header.seq);
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        point_at(spline, find_span(spline, t[i]), t[i], points + 3 * i);
+    }
+
+    return count;
+}
+
+/* A degree p Bezier curve strays at most p (p - 1) / 8 * max |second
+ * difference of control points| / s^2 from its s-segment polyline.
+ */
+static size_t span_segments(const struct dxf_spline* const spline, size_t span, double tolerance)
+{
+    const double *p = spline->control_points;
+    double m = 0.0;
+    double d;
+    double dx;
+    double dy;
+    double dz;
+    double s;
+    size_t j;
+
+    if (spline->degree == 1) {
+        return 1;
+    }
+
+    for (j = span - spline->degree + 1; j < span; ++j) {
+        dx = p[3 * (j + 1)] - 2.0 * p[3 * j] + p[3 * (j - 1)];
+        dy = p[3 * (j + 1) + 1] - 2.0 * p[3 * j + 1] + p[3 * (j - 1) + 1];
+        dz = p[3 * (j + 1) + 2] - 2.0 * p[3 * j + 2] + p[3 * (j - 1) + 2];
+        d = sqrt(dx * dx + dy * dy + dz * dz);
+        m = (d > m) ? d : m;
+    }
+
+    s = ceil(sqrt(spline->degree * (spline->degree - 1) * m / (8.0 * tolerance)));
+    if (s < 1.0) {
+        return 1;
+    }
+    return (s < DXF_TESS_MAX_SEGMENTS) ? (size_t)s : DXF_TESS_MAX_SEGMENTS;
+}
+
+/* Vertices are written only when vertices is not NULL; see dxftess.h. */
+size_t dxf_spline_tessellate(const struct dxf_spline* const spline, double tolerance,
+                        struct dxf_tess_vertex *vertices)
+{
+    const double *knots = spline->knots;
+    double point[3];
+    size_t n = 0;
+    size_t span;
+    size_t segments;
+    size_t k;
+
+    if (!dxf_spline_is_valid(spline)) {
+        for (k = 0; (spline->number_of_fit_points > 1) && (k < spline->number_of_fit_points); ++k) {
+            put(vertices, &n, spline->fit_points + 3 * k);
+        }
+        return n;
+    }
+
+    span = find_span(spline, knots[spline->degree]);
+    point_at(spline, span, knots[span], point);
+    put(vertices, &n, point);
+
+    for (; span < spline->number_of_control_points; ++span) {
+        if (knots[span + 1] == knots[span]) {
+            continue;
+        }
+
+        segments = span_segments(spline, span, tolerance);
+        for (k = 1; k <= segments; ++k) {
+            if (vertices != NULL) {
+                point_at(spline, span, knots[span] + (knots[span + 1] - knots[span]) * k / segments,
+                        point);
+            }
+            put(vertices, &n, point);
+        }
+    }
+
+    return n;
+}
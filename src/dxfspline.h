@@ -0,0 +1,35 @@
+#ifndef __DXF_SPLINE_H__
+#define __DXF_SPLINE_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxftess.h"
+
+/* Evaluation of SPLINE entities as (rational) B-splines. The basis
+ * functions of a knot span are computed once per parameter into a small
+ * array, then blended with the control points in one straight loop.
+ *
+ * Sampling picks a segment count per knot span from the second
+ * differences of the span's control points, the flattening bound of a
+ * Bezier curve, so the count is known before any point is evaluated and
+ * dxf_tess_count() stays exact for splines. Splines that only carry fit
+ * points are sampled as the polyline through them.
+ */
+
+#define DXF_SPLINE_MAX_DEGREE 15
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_spline_is_valid(const struct dxf_spline* const spline);
+size_t dxf_spline_evaluate(const struct dxf_spline* const spline, const double *t,
+                        size_t count, double *points);
+size_t dxf_spline_tessellate(const struct dxf_spline* const spline, double tolerance,
+                        struct dxf_tess_vertex *vertices);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_SPLINE_H__ */
@@ -0,0 +1,430 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dxftess.h"
+#include "dxfbounds.h"
+#include "dxfocs.h"
+#include "dxfspline.h"
+#include "dxfellipse.h"
+
+#ifdef USE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "dbgprint.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Vertices are written only when out is not NULL; the counts are the
+ * same either way, which is what keeps dxf_tess_count() exact.
+ */
+static void put(struct dxf_tess_vertex *out, size_t *n, double x, double y, double z)
+{
+    if (out != NULL) {
+        out[*n].x = x;
+        out[*n].y = y;
+        out[*n].z = z;
+    }
+    ++*n;
+}
+
+/* Segments for a sweep (radians) keeping the sagitta within tolerance,
+ * and never more than a quarter turn each.
+ */
+static size_t arc_segments(double r, double sweep, double tolerance)
+{
+    double step = M_PI / 2.0;
+    double n;
+
+    if (tolerance < r) {
+        step = 2.0 * acos(1.0 - tolerance / r);
+        step = (step < M_PI / 2.0) ? step : M_PI / 2.0;
+    }
+
+    n = ceil(fabs(sweep) / step);
+    if (n < 1.0) {
+        return 1;
+    }
+    return (n < DXF_TESS_MAX_SEGMENTS) ? (size_t)n : DXF_TESS_MAX_SEGMENTS;
+}
+
+/* The points strictly between start and end of an arc around (cx, cy),
+ * starting at offset (dx, dy) from the centre. Each is the previous one
+ * rotated by a fixed angle, so no trigonometry per point.
+ */
+static void put_arc(struct dxf_tess_vertex *out, size_t *n, double cx, double cy, double z,
+                    double dx, double dy, double sweep, size_t segments)
+{
+    double c = cos(sweep / segments);
+    double s = sin(sweep / segments);
+    double t;
+    size_t i;
+
+    for (i = 1; i < segments; ++i) {
+        t = dx * c - dy * s;
+        dy = dx * s + dy * c;
+        dx = t;
+        put(out, n, cx + dx, cy + dy, z);
+    }
+}
+
+/* Segment from v0 to v1 with the bulge of v0, without v0 itself. */
+static void put_bulge_segment(struct dxf_tess_vertex *out, size_t *n, double tolerance,
+                            const struct dxf_lwpolyline_vertex* const v0,
+                            const struct dxf_lwpolyline_vertex* const v1)
+{
+    double dx = v1->x - v0->x;
+    double dy = v1->y - v0->y;
+    double b = v0->bulge;
+    double chord = sqrt(dx * dx + dy * dy);
+    double offset;
+    double cx;
+    double cy;
+    double r;
+    double sweep;
+
+    if ((b != 0.0) && (chord != 0.0)) {
+        /* See add_bulge_segment() in dxfbounds.c. */
+        offset = (1.0 - b * b) / (4.0 * b);
+        cx = (v0->x + v1->x) * 0.5 - dy * offset;
+        cy = (v0->y + v1->y) * 0.5 + dx * offset;
+        r = fabs(chord * (1.0 + b * b) / (4.0 * b));
+        sweep = 4.0 * atan(b);
+        put_arc(out, n, cx, cy, v0->z, v0->x - cx, v0->y - cy, sweep,
+                arc_segments(r, sweep, tolerance));
+    }
+
+    put(out, n, v1->x, v1->y, v1->z);
+}
+
+/* Spline frame points are not on the polyline; meshes are not tessellated. */
+static void put_polyline(struct dxf_tess_vertex *out, size_t *n, double tolerance,
+                        const struct dxf_polyline* const polyline)
+{
+    const struct dxf_polyline_vertex *vertices = polyline->vertices;
+    struct dxf_lwpolyline_vertex v0;
+    struct dxf_lwpolyline_vertex v1;
+    struct dxf_lwpolyline_vertex first;
+    size_t count = 0;
+    size_t i;
+
+    if (polyline->flag & (DXF_POLYLINE_FLAG_MESH | DXF_POLYLINE_FLAG_POLYFACE)) {
+        return;
+    }
+
+    for (i = 0; i < polyline->number_of_vertices; ++i) {
+        if (vertices[i].flag & DXF_VERTEX_FLAG_SPLINE_FRAME) {
+            continue;
+        }
+
+        v1.x = vertices[i].x;
+        v1.y = vertices[i].y;
+        v1.z = vertices[i].z;
+        v1.bulge = vertices[i].bulge;
+        if (count++ == 0) {
+            first = v1;
+            put(out, n, v1.x, v1.y, v1.z);
+        }
+        else {
+            put_bulge_segment(out, n, tolerance, &v0, &v1);
+        }
+        v0 = v1;
+    }
+
+    if ((count > 1) && (polyline->flag & DXF_POLYLINE_FLAG_CLOSED)) {
+        put_bulge_segment(out, n, tolerance, &v0, &first);
+    }
+}
+
+static size_t tessellate(const struct dxf_entity* const entity, double tolerance,
+                        struct dxf_tess_vertex *out)
+{
+    const struct dxf_line *line;
+    const struct dxf_circle *circle;
+    const struct dxf_arc *arc;
+    const struct dxf_lwpolyline *lwpolyline;
+    const struct dxf_lwpolyline_vertex *vertex;
+    const double *extrusion;
+    double start;
+    double sweep;
+    size_t n = 0;
+
+    switch (entity->type) {
+        case DXF_LINE:
+            line = (const struct dxf_line*)entity;
+            put(out, &n, line->x1, line->y1, line->z1);
+            put(out, &n, line->x2, line->y2, line->z2);
+            break;
+        case DXF_CIRCLE:
+            circle = (const struct dxf_circle*)entity;
+            put(out, &n, circle->x + circle->r, circle->y, circle->z);
+            put_arc(out, &n, circle->x, circle->y, circle->z, circle->r, 0.0, 2.0 * M_PI,
+                    arc_segments(circle->r, 2.0 * M_PI, tolerance));
+            put(out, &n, circle->x + circle->r, circle->y, circle->z);
+            break;
+        case DXF_ARC:
+            arc = (const struct dxf_arc*)entity;
+            sweep = fmod(arc->angle_end - arc->angle_start, 360.0);
+            if (sweep <= 0.0) {
+                sweep += 360.0;
+            }
+            start = arc->angle_start * M_PI / 180.0;
+            sweep = sweep * M_PI / 180.0;
+            put(out, &n, arc->x + arc->r * cos(start), arc->y + arc->r * sin(start), arc->z);
+            put_arc(out, &n, arc->x, arc->y, arc->z, arc->r * cos(start), arc->r * sin(start),
+                    sweep, arc_segments(arc->r, sweep, tolerance));
+            put(out, &n, arc->x + arc->r * cos(start + sweep),
+                arc->y + arc->r * sin(start + sweep), arc->z);
+            break;
+        case DXF_LWPOLYLINE:
+            lwpolyline = (const struct dxf_lwpolyline*)entity;
+            if ((vertex = lwpolyline->vertices) == NULL) {
+                break;
+            }
+            put(out, &n, vertex->x, vertex->y, vertex->z);
+            for (; vertex->next != NULL; vertex = vertex->next) {
+                put_bulge_segment(out, &n, tolerance, vertex, vertex->next);
+            }
+            if (lwpolyline->flag & 1) {
+                put_bulge_segment(out, &n, tolerance, vertex, lwpolyline->vertices);
+            }
+            break;
+        case DXF_SPLINE:
+            n = dxf_spline_tessellate((const struct dxf_spline*)entity, tolerance, out);
+            break;
+        case DXF_ELLIPSE:
+            n = dxf_ellipse_tessellate((const struct dxf_ellipse*)entity, tolerance, out);
+            break;
+        case DXF_POLYLINE:
+            put_polyline(out, &n, tolerance, (const struct dxf_polyline*)entity);
+            break;
+        default:
+            break;
+    }
+
+    if ((out != NULL) && ((extrusion = dxf_ocs_get_extrusion(entity)) != NULL)) {
+        dxf_ocs_to_wcs(extrusion, &(out[0].x), n, 3);
+    }
+
+    return n;
+}
+
+/* Vertices dxf_tess_entity() writes for entity; 0 for other types. */
+size_t dxf_tess_count(const struct dxf_entity* const entity, double tolerance)
+{
+    if (!(tolerance > 0.0)) {
+        errprint("dxftess: dxf_tess_count(): Tolerance %g is not positive. \n", tolerance);
+        return 0;
+    }
+
+    return tessellate(entity, tolerance, NULL);
+}
+
+/* Fails, with *count set to the vertices needed, if capacity is short. */
+int dxf_tess_entity(const struct dxf_entity* const entity, double tolerance,
+                    struct dxf_tess_vertex* const vertices, size_t capacity, size_t *count)
+{
+    if ((*count = dxf_tess_count(entity, tolerance)) > capacity) {
+        return -1;
+    }
+
+    tessellate(entity, tolerance, vertices);
+    return 0;
+}
+
+static int is_tessellated(const struct dxf_layer* const layer, const struct dxf_entity* const entity)
+{
+    return (entity->layer == layer) && !dxf_is_block_member(entity);
+}
+
+static const int tessellated_types[] = { DXF_LINE, DXF_CIRCLE, DXF_ARC, DXF_LWPOLYLINE, DXF_SPLINE,
+                                        DXF_ELLIPSE, DXF_POLYLINE };
+
+#define NUMBER_OF_TESSELLATED_TYPES (sizeof(tessellated_types) / sizeof(tessellated_types[0]))
+
+int dxf_tess_layer(struct dxf_layer* const layer, double tolerance,
+                    struct dxf_tess_batch* const batch)
+{
+    struct dxf_entity *entity;
+    size_t polylines = 0;
+    size_t vertices = 0;
+    size_t i;
+
+    memset(batch, 0, sizeof(struct dxf_tess_batch));
+    batch->layer = layer;
+
+    if (!(tolerance > 0.0)) {
+        errprint("dxftess: dxf_tess_layer(): Tolerance %g is not positive. \n", tolerance);
+        return -1;
+    }
+
+    for (i = 0; i < NUMBER_OF_TESSELLATED_TYPES; ++i) {
+        for (entity = layer->entities[tessellated_types[i]]; entity != NULL; entity = entity->next) {
+            if (is_tessellated(layer, entity)) {
+                ++polylines;
+                vertices += tessellate(entity, tolerance, NULL);
+            }
+        }
+    }
+
+    batch->vertices = (struct dxf_tess_vertex*)malloc((vertices + 1) * sizeof(struct dxf_tess_vertex));
+    batch->offsets = (size_t*)malloc((polylines + 1) * sizeof(size_t));
+    batch->entities = (struct dxf_entity**)malloc((polylines + 1) * sizeof(struct dxf_entity*));
+    if ((batch->vertices == NULL) || (batch->offsets == NULL) || (batch->entities == NULL)) {
+        errprint("dxftess: dxf_tess_layer(): Failed to allocate %lu vertices for %s. \n",
+                (unsigned long)vertices, layer->name);
+        dxf_tess_batch_free(batch);
+        return -1;
+    }
+
+    batch->offsets[0] = 0;
+    for (i = 0; i < NUMBER_OF_TESSELLATED_TYPES; ++i) {
+        for (entity = layer->entities[tessellated_types[i]]; entity != NULL; entity = entity->next) {
+            if (is_tessellated(layer, entity)) {
+                batch->entities[batch->number_of_polylines++] = entity;
+                batch->number_of_vertices += tessellate(entity, tolerance,
+                                                batch->vertices + batch->number_of_vertices);
+                batch->offsets[batch->number_of_polylines] = batch->number_of_vertices;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void dxf_tess_batch_free(struct dxf_tess_batch* const batch)
+{
+    free(batch->vertices);
+    free(batch->offsets);
+    free(batch->entities);
+    batch->vertices = NULL;
+    batch->offsets = NULL;
+    batch->entities = NULL;
+    batch->number_of_vertices = batch->number_of_polylines = 0;
+}
+
+void dxf_tess_batches_free(struct dxf_tess_batch *batches, size_t number_of_batches)
+{
+    size_t i;
+
+    if (batches == NULL) {
+        return;
+    }
+
+    for (i = 0; i < number_of_batches; ++i) {
+        dxf_tess_batch_free(&batches[i]);
+    }
+    free(batches);
+}
+
+struct layer_job {
+    struct dxf_tess_batch *batches;
+    size_t number_of_batches;
+    double tolerance;
+    size_t index;
+    size_t stride;
+    int ret;
+};
+
+static void* layer_worker(void *arg)
+{
+    struct layer_job* const job = (struct layer_job*)arg;
+    size_t i;
+
+    job->ret = 0;
+    for (i = job->index; i < job->number_of_batches; i += job->stride) {
+        if (dxf_tess_layer(job->batches[i].layer, job->tolerance, &(job->batches[i])) != 0) {
+            job->ret = -1;
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef USE_PTHREAD
+static int run_parallel(struct layer_job* const job)
+{
+    pthread_t threads[DXF_TESS_MAX_THREADS];
+    struct layer_job jobs[DXF_TESS_MAX_THREADS];
+    int started[DXF_TESS_MAX_THREADS];
+    size_t stride = (job->number_of_batches < DXF_TESS_MAX_THREADS)
+                    ? job->number_of_batches : DXF_TESS_MAX_THREADS;
+    size_t i;
+    int ret = 0;
+
+    for (i = 0; i < stride; ++i) {
+        memcpy(&jobs[i], job, sizeof(struct layer_job));
+        jobs[i].index = i;
+        jobs[i].stride = stride;
+        started[i] = (i > 0) && (pthread_create(&threads[i], NULL, layer_worker, &jobs[i]) == 0);
+    }
+
+    /* Job 0, and any job whose thread did not start, runs here. */
+    for (i = 0; i < stride; ++i) {
+        if (!started[i]) {
+            layer_worker(&jobs[i]);
+        }
+    }
+
+    for (i = 0; i < stride; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        ret |= jobs[i].ret;
+    }
+
+    return ret;
+}
+#endif
+
+/* One batch per layer, in layer order. Free with dxf_tess_batches_free(). */
+int dxf_tess_document(struct dxf* const dxf, double tolerance,
+                    struct dxf_tess_batch **batches, size_t *number_of_batches)
+{
+    struct dxf_layer *layer;
+    struct layer_job job;
+    size_t count = 0;
+    size_t i;
+
+    *batches = NULL;
+    *number_of_batches = 0;
+
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        ++count;
+    }
+
+    if ((job.batches = (struct dxf_tess_batch*)calloc(count + 1, sizeof(struct dxf_tess_batch))) == NULL) {
+        errprint("dxftess: dxf_tess_document(): Failed to allocate %lu batches. \n", (unsigned long)count);
+        return -1;
+    }
+    for (i = 0, layer = dxf->layers; layer != NULL; layer = layer->next, ++i) {
+        job.batches[i].layer = layer;
+    }
+
+    job.number_of_batches = count;
+    job.tolerance = tolerance;
+    job.index = 0;
+    job.stride = 1;
+
+#ifdef USE_PTHREAD
+    if ((count > 1) && (dxf->number_of_entities >= DXF_TESS_PARALLEL_THRESHOLD)) {
+        job.ret = run_parallel(&job);
+    }
+    else {
+        layer_worker(&job);
+    }
+#else
+    layer_worker(&job);
+#endif
+
+    if (job.ret != 0) {
+        dxf_tess_batches_free(job.batches, count);
+        return -1;
+    }
+
+    *batches = job.batches;
+    *number_of_batches = count;
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef __DXF_TESS_H__
+#define __DXF_TESS_H__
+
+#include <stddef.h>
+#include "dxf.h"
+
+/* Tessellation of LINE, CIRCLE, ARC, LWPOLYLINE and 2D/3D POLYLINE
+ * (bulges included), SPLINE (see dxfspline.h) and ELLIPSE (see
+ * dxfellipse.h) into polylines whose distance from the true curve stays
+ * within a chord tolerance. Arcs cost one sin/cos pair each; the points
+ * in between come from a rotation recurrence. Circles, full ellipses and
+ * closed polylines repeat their first vertex at the end.
+ *
+ * dxf_tess_count() tells how many vertices dxf_tess_entity() will write,
+ * so callers can size their own buffers. The batch functions tessellate
+ * whole layers into one contiguous vertex array each, layers in parallel
+ * when built with USE_PTHREAD. Block members are left out of batches.
+ */
+
+#define DXF_TESS_MAX_SEGMENTS 65536            /* Per arc */
+#define DXF_TESS_MAX_THREADS 8
+#define DXF_TESS_PARALLEL_THRESHOLD 4096       /* Entities */
+
+struct dxf_tess_vertex {
+    double x;
+    double y;
+    double z;
+};
+
+/* Polyline i is vertices[offsets[i]] up to vertices[offsets[i + 1]]. */
+struct dxf_tess_batch {
+    struct dxf_layer *layer;
+    struct dxf_tess_vertex *vertices;
+    size_t number_of_vertices;
+    size_t *offsets;
+    struct dxf_entity **entities;
+    size_t number_of_polylines;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t dxf_tess_count(const struct dxf_entity* const entity, double tolerance);
+int dxf_tess_entity(const struct dxf_entity* const entity, double tolerance,
+                    struct dxf_tess_vertex* const vertices, size_t capacity, size_t *count);
+
+int dxf_tess_layer(struct dxf_layer* const layer, double tolerance,
+                    struct dxf_tess_batch* const batch);
+int dxf_tess_document(struct dxf* const dxf, double tolerance,
+                    struct dxf_tess_batch **batches, size_t *number_of_batches);
+void dxf_tess_batch_free(struct dxf_tess_batch* const batch);
+void dxf_tess_batches_free(struct dxf_tess_batch *batches, size_t number_of_batches);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_TESS_H__ */
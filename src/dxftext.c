@@ -0,0 +1,304 @@
+#include <string.h>
+#include "dxftext.h"
+
+#include "dbgprint.h"
+
+#define DIAMETER_SIGN 0x2300
+#define DEGREE_SIGN 0xB0
+#define PLUS_MINUS_SIGN 0xB1
+#define NO_BREAK_SPACE 0xA0
+
+static int scan_hex(const char *s, size_t n, unsigned long *value)
+{
+    size_t i;
+    int digit;
+
+    *value = 0;
+    for (i = 0; i < n; ++i) {
+        if ((s[i] >= '0') && (s[i] <= '9')) {
+            digit = s[i] - '0';
+        }
+        else if ((s[i] >= 'A') && (s[i] <= 'F')) {
+            digit = s[i] - 'A' + 10;
+        }
+        else if ((s[i] >= 'a') && (s[i] <= 'f')) {
+            digit = s[i] - 'a' + 10;
+        }
+        else {
+            return -1;
+        }
+        *value = (*value << 4) | digit;
+    }
+
+    return 0;
+}
+
+static size_t put_utf8(char *out, unsigned long c)
+{
+    if (c < 0x80) {
+        out[0] = (char)c;
+        return 1;
+    }
+    if (c < 0x800) {
+        out[0] = (char)(0xC0 | (c >> 6));
+        out[1] = (char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    if (c < 0x10000) {
+        out[0] = (char)(0xE0 | (c >> 12));
+        out[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (c >> 18));
+    out[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (c & 0x3F));
+    return 4;
+}
+
+/* \U+XXXX, or a surrogate pair of them. Returns the characters taken,
+ * 0 if there is no such escape at s.
+ */
+static size_t scan_unicode(const char *s, size_t n, unsigned long *c)
+{
+    unsigned long low;
+
+    if ((n < 7) || (s[0] != '\\') || ((s[1] != 'U') && (s[1] != 'u')) || (s[2] != '+')
+        || (scan_hex(s + 3, 4, c) != 0))
+    {
+        return 0;
+    }
+
+    if ((*c >= 0xD800) && (*c < 0xDC00) && (n >= 14) && (s[7] == '\\')
+        && ((s[8] == 'U') || (s[8] == 'u')) && (s[9] == '+')
+        && (scan_hex(s + 10, 4, &low) == 0) && (low >= 0xDC00) && (low < 0xE000))
+    {
+        *c = 0x10000 + ((*c - 0xD800) << 10) + (low - 0xDC00);
+        return 14;
+    }
+
+    return 7;
+}
+
+/* %% control codes. *c is 0 for the toggles, which print nothing. */
+static size_t scan_percent(const char *s, size_t n, unsigned long *c)
+{
+    if ((n < 3) || (s[0] != '%') || (s[1] != '%')) {
+        return 0;
+    }
+
+    switch (s[2]) {
+        case 'c':
+        case 'C':
+            *c = DIAMETER_SIGN;
+            return 3;
+        case 'd':
+        case 'D':
+            *c = DEGREE_SIGN;
+            return 3;
+        case 'p':
+        case 'P':
+            *c = PLUS_MINUS_SIGN;
+            return 3;
+        case 'o':
+        case 'O':
+        case 'u':
+        case 'U':
+        case 'k':
+        case 'K':
+            *c = 0;
+            return 3;
+        case '%':
+            *c = '%';
+            return 3;
+        default:
+            break;
+    }
+
+    if ((n >= 5) && (s[2] >= '0') && (s[2] <= '9') && (s[3] >= '0') && (s[3] <= '9')
+        && (s[4] >= '0') && (s[4] <= '9'))
+    {
+        *c = (s[2] - '0') * 100 + (s[3] - '0') * 10 + (s[4] - '0');
+        return 5;
+    }
+
+    return 0;
+}
+
+/* Decodes in place; no code yields more bytes than it is written with.
+ * Returns the new length and terminates the string there.
+ */
+size_t dxf_text_decode(char *str, size_t length, int mtext)
+{
+    size_t r = 0;
+    size_t w = 0;
+    size_t n;
+    unsigned long c;
+    char ch;
+
+    while (r < length) {
+        ch = str[r];
+
+        if (((n = scan_unicode(str + r, length - r, &c)) > 0)
+            || ((n = scan_percent(str + r, length - r, &c)) > 0))
+        {
+            r += n;
+            if (c != 0) {
+                w += put_utf8(str + w, c);
+            }
+            continue;
+        }
+
+        if ((ch == '^') && (r + 1 < length)) {
+            ch = str[r + 1];
+            r += 2;
+            if (ch == 'I') {
+                str[w++] = '\t';
+            }
+            else if (ch == 'J') {
+                str[w++] = '\n';
+            }
+            else {
+                str[w++] = '^';
+                if (ch != ' ') {
+                    str[w++] = ch;
+                }
+            }
+            continue;
+        }
+
+        if (mtext && ((ch == '{') || (ch == '}'))) {
+            ++r;
+            continue;
+        }
+
+        if (!mtext || (ch != '\\') || (r + 1 >= length)) {
+            str[w++] = str[r++];
+            continue;
+        }
+
+        ch = str[r + 1];
+        r += 2;
+        switch (ch) {
+            case 'P':
+            case 'N':
+                str[w++] = '\n';
+                break;
+            case '~':
+                w += put_utf8(str + w, NO_BREAK_SPACE);
+                break;
+            case '\\':
+            case '{':
+            case '}':
+                str[w++] = ch;
+                break;
+            case 'L':
+            case 'l':
+            case 'O':
+            case 'o':
+            case 'K':
+            case 'k':
+                break;
+            case 'M':
+            case 'm':
+                /* +nXXXX */
+                r = (r + 6 < length) ? r + 6 : length;
+                str[w++] = '?';
+                break;
+            case 'S':
+                while ((r < length) && (str[r] != ';')) {
+                    ch = str[r++];
+                    str[w++] = ((ch == '^') || (ch == '#')) ? '/' : ch;
+                }
+                ++r;
+                break;
+            case 'A':
+            case 'C':
+            case 'c':
+            case 'F':
+            case 'f':
+            case 'H':
+            case 'h':
+            case 'Q':
+            case 'q':
+            case 'T':
+            case 't':
+            case 'W':
+            case 'w':
+            case 'p':
+                while ((r < length) && (str[r] != ';')) {
+                    ++r;
+                }
+                ++r;
+                break;
+            default:
+                str[w++] = ch;
+                break;
+        }
+    }
+
+    str[w] = '\0';
+    return w;
+}
+
+static struct dxf_text_body* get_body(struct dxf_entity* const entity)
+{
+    switch (entity->type) {
+        case DXF_TEXTSTRING:
+            return &(((struct dxf_text*)entity)->body);
+        case DXF_MTEXT:
+            return &(((struct dxf_mtext*)entity)->body);
+        default:
+            return NULL;
+    }
+}
+
+/* Joining first lets escapes run across group 3 chunk boundaries. */
+const char* dxf_text_get_string(struct dxf* const dxf, struct dxf_entity* const entity)
+{
+    struct dxf_text_body *body;
+    const struct dxf_text_span *span;
+    char *str;
+    size_t length = 0;
+
+    if ((body = get_body(entity)) == NULL) {
+        return NULL;
+    }
+    if (body->string != NULL) {
+        return body->string;
+    }
+
+    if ((str = dxf_alloc_string(dxf, body->length)) == NULL) {
+        errprint("dxftext: dxf_text_get_string(): Failed to allocate %lu characters. \n",
+                (unsigned long)body->length);
+        return NULL;
+    }
+
+    for (span = body->spans; span != NULL; span = span->next) {
+        memcpy(str + length, span->str, span->length);
+        length += span->length;
+    }
+    dxf_text_decode(str, length, entity->type == DXF_MTEXT);
+    body->string = str;
+
+    return str;
+}
+
+/* Returns the number of strings decoded by this call. */
+size_t dxf_text_materialize(struct dxf* const dxf)
+{
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    size_t count = 0;
+
+    dxf_entity_iter_init(&iter, dxf, NULL,
+                        DXF_ENTITY_TYPE_BIT(DXF_TEXTSTRING) | DXF_ENTITY_TYPE_BIT(DXF_MTEXT));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if ((get_body(entity)->string == NULL) && (dxf_text_get_string(dxf, entity) != NULL)) {
+            ++count;
+        }
+    }
+
+    return count;
+}
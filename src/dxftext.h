@@ -0,0 +1,41 @@
+#ifndef __DXF_TEXT_H__
+#define __DXF_TEXT_H__
+
+#include <stddef.h>
+#include "dxf.h"
+
+/* TEXT and MTEXT strings. Parsing only records where the string lies in
+ * the input, so code that wants geometry never copies or decodes a text
+ * body. dxf_text_get_string() joins the spans into the document pool on
+ * first use, decodes them in place to UTF-8 and keeps the result:
+ *
+ *   \U+XXXX          the code point, surrogate pairs combined
+ *   %%c %%d %%p      diameter, degree and plus/minus signs
+ *   %%nnn            character nnn
+ *   ^I ^J            tab and line feed
+ *   \P \N            line feed (MTEXT)
+ *   \~               no-break space (MTEXT)
+ *   \\ \{ \}         the character itself (MTEXT)
+ *   \S a^b;          a/b, stacked fractions flattened (MTEXT)
+ *
+ * Other MTEXT format codes and braces are dropped, as are the %%o, %%u
+ * and %%k toggles. \M+nXXXX needs the code page and becomes '?'.
+ *
+ * The spans point into the lexer's input, which must still be open when
+ * a string is first asked for. Call dxf_text_materialize() before closing
+ * the lexer to decode whatever is left.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t dxf_text_decode(char *str, size_t length, int mtext);
+const char* dxf_text_get_string(struct dxf* const dxf, struct dxf_entity* const entity);
+size_t dxf_text_materialize(struct dxf* const dxf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_TEXT_H__ */
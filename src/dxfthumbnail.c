@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dxfthumbnail.h"
+#include "dxfbinary.h"
+
+#include "dbgprint.h"
+
+/* Line spans, without line breaks or surrounding spaces. */
+struct line {
+    const char *str;
+    size_t length;
+};
+
+static void trim(struct line* const line)
+{
+    while ((line->length > 0) && ((line->str[0] == ' ') || (line->str[0] == '\t'))) {
+        ++(line->str);
+        --(line->length);
+    }
+    while ((line->length > 0) && ((line->str[line->length - 1] == ' ')
+        || (line->str[line->length - 1] == '\t') || (line->str[line->length - 1] == '\r')))
+    {
+        --(line->length);
+    }
+}
+
+/* The line starting at p; returns where the next one starts. */
+static const char* next_line(const char *p, const char *end, struct line* const line)
+{
+    const char *q;
+
+    if (p >= end) {
+        return NULL;
+    }
+
+    if ((q = (const char*)memchr(p, '\n', end - p)) == NULL) {
+        q = end;
+    }
+    line->str = p;
+    line->length = q - p;
+    trim(line);
+
+    return (q < end) ? q + 1 : end;
+}
+
+/* The line ending right before p; returns where it starts. */
+static const char* prev_line(const char *begin, const char *p, struct line* const line)
+{
+    const char *q;
+
+    if (p <= begin) {
+        return NULL;
+    }
+
+    if (p[-1] == '\n') {
+        --p;
+    }
+    q = p;
+    while ((q > begin) && (q[-1] != '\n')) {
+        --q;
+    }
+    line->str = q;
+    line->length = p - q;
+    trim(line);
+
+    return q;
+}
+
+static int line_is(const struct line* const line, const char *str)
+{
+    size_t length = strlen(str);
+
+    return (line->length == length) && (memcmp(line->str, str, length) == 0);
+}
+
+static long line_to_long(const struct line* const line)
+{
+    char buf[32];
+    size_t length = line->length < sizeof(buf) ? line->length : sizeof(buf) - 1;
+
+    memcpy(buf, line->str, length);
+    buf[length] = '\0';
+
+    return strtol(buf, NULL, 10);
+}
+
+/* Group before p, read backwards; returns where its code line starts. */
+static const char* prev_group(const char *begin, const char *p, struct line* const code,
+                            struct line* const value)
+{
+    if ((p = prev_line(begin, p, value)) == NULL) {
+        return NULL;
+    }
+
+    return prev_line(begin, p, code);
+}
+
+/* Steps back from EOF over the last section, which holds nothing but 90
+ * and 310 groups if it is THUMBNAILIMAGE, and returns where its first
+ * group starts. Any other group ends the search right away, so a drawing
+ * without an image costs a few lines.
+ */
+static const char* find_section(const char *begin, const char *end)
+{
+    struct line code;
+    struct line value;
+    const char *p = end;
+    const char *first;
+
+    while ((p > begin) && ((p[-1] == '\n') || (p[-1] == '\r') || (p[-1] == ' '))) {
+        --p;
+    }
+    if (((p = prev_group(begin, p, &code, &value)) == NULL) || !line_is(&code, "0")
+        || !line_is(&value, "EOF")
+        || ((p = prev_group(begin, p, &code, &value)) == NULL) || !line_is(&code, "0")
+        || !line_is(&value, "ENDSEC"))
+    {
+        return NULL;
+    }
+
+    do {
+        first = p;
+        if ((p = prev_group(begin, p, &code, &value)) == NULL) {
+            return NULL;
+        }
+    } while (line_is(&code, "310") || line_is(&code, "90"));
+
+    if (!line_is(&code, "2") || !line_is(&value, "THUMBNAILIMAGE")
+        || ((p = prev_group(begin, p, &code, &value)) == NULL) || !line_is(&code, "0")
+        || !line_is(&value, "SECTION"))
+    {
+        return NULL;
+    }
+
+    return first;
+}
+
+/* Returns the size of the image, 0 if the input has none or it is not
+ * well formed. The image is written to out only when it fits in out_size
+ * bytes, so out may be NULL to ask for the size first. Group 90 gives
+ * the size when present; otherwise the 310 chunks are counted.
+ */
+size_t dxf_extract_thumbnail(const struct dxf_lexer_desc* const desc, unsigned char *out,
+                            size_t out_size)
+{
+    const char *begin = desc->buf;
+    const char *end;
+    const char *first;
+    const char *p;
+    struct line code;
+    struct line value;
+    size_t size = 0;
+    size_t count = 0;
+    size_t n;
+    long announced = -1;
+
+    if (begin == NULL) {
+        return 0;
+    }
+    end = desc->end + 1;
+
+    if ((first = find_section(begin, end)) == NULL) {
+        return 0;
+    }
+
+    /* Count the chunks unless group 90 says how much there is. */
+    for (p = first; (p = next_line(p, end, &code)) != NULL; ) {
+        if ((p = next_line(p, end, &value)) == NULL) {
+            return 0;
+        }
+        if (line_is(&code, "0")) {
+            break;
+        }
+        if (line_is(&code, "90")) {
+            if ((announced = line_to_long(&value)) <= 0) {
+                return 0;
+            }
+            size = (size_t)announced;
+            break;
+        }
+        if (line_is(&code, "310")) {
+            size += value.length / 2;
+        }
+    }
+
+    if ((size == 0) || (out == NULL) || (out_size < size)) {
+        return size;
+    }
+
+    for (p = first; (p = next_line(p, end, &code)) != NULL; ) {
+        if ((p = next_line(p, end, &value)) == NULL) {
+            return 0;
+        }
+        if (line_is(&code, "0")) {
+            break;
+        }
+        if (!line_is(&code, "310")) {
+            continue;
+        }
+
+        if ((value.length / 2 > size - count)
+            || ((n = dxf_binary_decode_hex(value.str, value.length, out + count)) == (size_t)-1))
+        {
+            errprint("dxfthumbnail: dxf_extract_thumbnail(): Bad chunk after %lu bytes. \n",
+                    (unsigned long)count);
+            return 0;
+        }
+        count += n;
+    }
+
+    if (count != size) {
+        errprint("dxfthumbnail: dxf_extract_thumbnail(): Expected %lu bytes, found %lu. \n",
+                (unsigned long)size, (unsigned long)count);
+        return 0;
+    }
+
+    dbgprint("dxfthumbnail: Extracted %lu bytes. \n", (unsigned long)size);
+    return size;
+}
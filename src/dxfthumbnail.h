@@ -0,0 +1,25 @@
+#ifndef __DXF_THUMBNAIL_H__
+#define __DXF_THUMBNAIL_H__
+
+#include <stddef.h>
+#include "dxflexer.h"
+
+/* The preview image of a drawing, read straight from the input without
+ * parsing it. THUMBNAILIMAGE is the last section of a DXF file, so it is
+ * looked for backwards from the end and only the pages holding it are
+ * read. The lexer's position and token cache are left alone, so this
+ * works on a freshly opened lexer.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t dxf_extract_thumbnail(const struct dxf_lexer_desc* const desc, unsigned char *out,
+                            size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_THUMBNAIL_H__ */
@@ -0,0 +1,477 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "dxftokcache.h"
+#include "dxflexer.h"
+
+#include "dbgprint.h"
+
+#define CACHE_PATH_MAX 1024
+#define INITIAL_RECORD_CAPACITY 4096
+#define INITIAL_STRING_CAPACITY 16384
+#define ALIGN_UP(n, a) (((n) + ((a) - 1)) & ~((size_t)(a) - 1))
+
+static int enabled = 0;
+static char cache_dir[CACHE_PATH_MAX - 16];
+
+static unsigned int hash_bytes(const char *buf, size_t len, unsigned int seed);
+static unsigned int str_hash(const char *sz);
+static char* make_cache_path(const char *filename);
+static int replay_open(struct dxf_token_cache* const cache, const char *filename);
+static int write_cache(struct dxf_token_cache* const cache);
+static void free_record_buffers(struct dxf_token_cache* const cache);
+
+/* FNV-1a style hash over 32-bit words in four independent lanes, so
+ * that hashing a large file runs close to memory bandwidth.
+ */
+static unsigned int hash_bytes(const char *buf, size_t len, unsigned int seed)
+{
+    unsigned int lanes[4];
+    unsigned int word;
+    size_t i = 0;
+
+    lanes[0] = seed ^ 2166136261u;
+    lanes[1] = lanes[0] ^ 0x9e3779b9u;
+    lanes[2] = lanes[0] ^ 0x7f4a7c15u;
+    lanes[3] = lanes[0] ^ 0x85ebca6bu;
+
+    for (; i + 16 <= len; i += 16) {
+        memcpy(&word, buf + i, 4);
+        lanes[0] = (lanes[0] ^ word) * 16777619u;
+        memcpy(&word, buf + i + 4, 4);
+        lanes[1] = (lanes[1] ^ word) * 16777619u;
+        memcpy(&word, buf + i + 8, 4);
+        lanes[2] = (lanes[2] ^ word) * 16777619u;
+        memcpy(&word, buf + i + 12, 4);
+        lanes[3] = (lanes[3] ^ word) * 16777619u;
+    }
+
+    for (; i < len; ++i) {
+        lanes[0] = (lanes[0] ^ (unsigned char)buf[i]) * 16777619u;
+    }
+
+    return lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7) ^ (unsigned int)len;
+}
+
+static unsigned int str_hash(const char *sz)
+{
+    unsigned int hash = 0;
+
+    while (*sz != '\0') {
+        hash = *(sz++) + (hash << 5) - 1;
+    }
+
+    return hash;
+}
+
+static char* make_cache_path(const char *filename)
+{
+    char *path;
+
+    if ((path = (char*)malloc(CACHE_PATH_MAX)) == NULL) {
+        return NULL;
+    }
+
+    if (cache_dir[0] == '\0') {
+        if (strlen(filename) + sizeof(DXF_TOKEN_CACHE_SUFFIX) > CACHE_PATH_MAX) {
+            free(path);
+            return NULL;
+        }
+        sprintf(path, "%s%s", filename, DXF_TOKEN_CACHE_SUFFIX);
+    }
+    else {
+        /* The full path is stored in the cache and compared on open,
+         * so a hash collision only costs a re-lex.
+         */
+        sprintf(path, "%s/%08x%s", cache_dir, str_hash(filename), DXF_TOKEN_CACHE_SUFFIX);
+    }
+
+    return path;
+}
+
+static int replay_open(struct dxf_token_cache* const cache, const char *filename)
+{
+    const struct dxf_token_cache_header *header;
+    const struct dxf_token_cache_header *key = &(cache->key);
+    memmap_fd_t fd;
+    size_t records_offset;
+    size_t size;
+
+    if ((fd = memmap_open(cache->path, O_RDONLY, 0)) == (memmap_fd_t)(-1)) {
+        return -1;
+    }
+
+    if ((size = memmap_get_file_size(fd)) < sizeof(struct dxf_token_cache_header)) {
+        memmap_close(fd);
+        return -1;
+    }
+
+    if ((cache->base = (const char*)memmap_map(NULL, size, MEMMAP_READ,
+        MEMMAP_SHARED, fd, 0, &(cache->fd2))) == NULL)
+    {
+        memmap_close(fd);
+        return -1;
+    }
+
+    cache->fd = fd;
+    cache->size = size;
+    header = (const struct dxf_token_cache_header*)(cache->base);
+    records_offset = sizeof(struct dxf_token_cache_header) + ALIGN_UP(header->path_length + 1, 8);
+
+    if ((memcmp(header->magic, DXF_TOKEN_CACHE_MAGIC, sizeof(DXF_TOKEN_CACHE_MAGIC)) != 0)
+        || (header->version != DXF_TOKEN_CACHE_VERSION)
+        || (header->byte_order != DXF_TOKEN_CACHE_BYTE_ORDER))
+    {
+        dbgprint("dxftokcache: replay_open(): %s is not a token cache. \n", cache->path);
+        return -1;
+    }
+
+    if ((header->source_size_lo != key->source_size_lo) || (header->source_size_hi != key->source_size_hi)
+        || (header->source_mtime_lo != key->source_mtime_lo) || (header->source_mtime_hi != key->source_mtime_hi)
+        || (header->source_hash != key->source_hash) || (header->path_length != key->path_length)
+        || (records_offset > size)
+        || (memcmp(cache->base + sizeof(struct dxf_token_cache_header), filename, key->path_length) != 0))
+    {
+        dbgprint("dxftokcache: replay_open(): %s is stale. \n", cache->path);
+        return -1;
+    }
+
+    if ((records_offset + (size_t)(header->number_of_tokens) * sizeof(struct dxf_token_cache_record)
+            + header->string_bytes != size)
+        || ((header->string_bytes > 0) && (cache->base[size - 1] != '\0'))
+        || (hash_bytes(cache->base + records_offset, size - records_offset, 0) != header->checksum))
+    {
+        errprint("dxftokcache: replay_open(): %s is corrupt, ignored. \n", cache->path);
+        return -1;
+    }
+
+    cache->records = (const struct dxf_token_cache_record*)(cache->base + records_offset);
+    cache->strings = cache->base + size - header->string_bytes;
+    cache->number_of_records = header->number_of_tokens;
+    cache->string_len = header->string_bytes;
+    cache->next = 0;
+
+    dbgprint("dxftokcache: replay_open(): Replaying %u tokens from %s. \n",
+            header->number_of_tokens, cache->path);
+    return 0;
+}
+
+static int write_cache(struct dxf_token_cache* const cache)
+{
+    struct dxf_token_cache_header header;
+    char tmp_path[CACHE_PATH_MAX + 8];
+    const char *filename = (const char*)(cache + 1);
+    static const char padding[8] = { 0 };
+    size_t records_size = cache->number_of_records * sizeof(struct dxf_token_cache_record);
+    size_t path_size = ALIGN_UP(cache->key.path_length + 1, 8);
+    unsigned int checksum;
+    void *buf;
+    FILE *fp;
+    int ok;
+
+    memcpy(&header, &(cache->key), sizeof(struct dxf_token_cache_header));
+    memcpy(header.magic, DXF_TOKEN_CACHE_MAGIC, sizeof(DXF_TOKEN_CACHE_MAGIC));
+    header.version = DXF_TOKEN_CACHE_VERSION;
+    header.byte_order = DXF_TOKEN_CACHE_BYTE_ORDER;
+    header.number_of_tokens = (unsigned int)(cache->number_of_records);
+    header.string_bytes = (unsigned int)(cache->string_len);
+
+    /* Records and strings are hashed as one run, like replay_open() does. */
+    if ((buf = realloc(cache->record_buf, records_size + cache->string_len + 1)) == NULL) {
+        return -1;
+    }
+    cache->record_buf = (struct dxf_token_cache_record*)buf;
+    memcpy((char*)(cache->record_buf) + records_size, cache->string_buf, cache->string_len);
+    checksum = hash_bytes((const char*)(cache->record_buf), records_size + cache->string_len, 0);
+    header.checksum = checksum;
+
+    sprintf(tmp_path, "%s.tmp", cache->path);
+    if ((fp = fopen(tmp_path, "wb")) == NULL) {
+        dbgprint("dxftokcache: write_cache(): Could not create %s. \n", tmp_path);
+        return -1;
+    }
+
+    ok = (fwrite(&header, sizeof(struct dxf_token_cache_header), 1, fp) == 1)
+        && (fwrite(filename, 1, cache->key.path_length, fp) == cache->key.path_length)
+        && (fwrite(padding, 1, path_size - cache->key.path_length, fp) == path_size - cache->key.path_length)
+        && (fwrite(cache->record_buf, 1, records_size + cache->string_len, fp)
+            == records_size + cache->string_len);
+
+    if ((fclose(fp) != 0) || !ok) {
+        remove(tmp_path);
+        return -1;
+    }
+
+    remove(cache->path);
+    if (rename(tmp_path, cache->path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+
+    dbgprint("dxftokcache: write_cache(): Wrote %zu tokens to %s. \n",
+            cache->number_of_records, cache->path);
+    return 0;
+}
+
+static void free_record_buffers(struct dxf_token_cache* const cache)
+{
+    free(cache->record_buf);
+    free(cache->string_buf);
+    cache->record_buf = NULL;
+    cache->string_buf = NULL;
+    cache->number_of_records = cache->record_capacity = 0;
+    cache->string_len = cache->string_capacity = 0;
+}
+
+/* A NULL cache_dir writes caches next to the DXF files. */
+int dxf_token_cache_enable(const char *cache_dir_path)
+{
+    if (cache_dir_path == NULL) {
+        cache_dir[0] = '\0';
+    }
+    else if (strlen(cache_dir_path) < sizeof(cache_dir)) {
+        strcpy(cache_dir, cache_dir_path);
+    }
+    else {
+        errprint("dxftokcache: dxf_token_cache_enable(): Cache directory path too long. \n");
+        return -1;
+    }
+
+    enabled = 1;
+    return 0;
+}
+
+int dxf_token_cache_disable()
+{
+    enabled = 0;
+    return 0;
+}
+
+/* Returns NULL if caching is off or the file cannot be identified, in
+ * which case the lexer just reads the text.
+ */
+struct dxf_token_cache* dxf_token_cache_open(const char *filename, const char *buf, size_t len)
+{
+    struct dxf_token_cache *cache;
+    struct stat st;
+    size_t path_length = strlen(filename);
+
+    if (!enabled || (stat(filename, &st) != 0)) {
+        return NULL;
+    }
+
+    /* The file name is kept right behind the struct for write_cache(). */
+    if ((cache = (struct dxf_token_cache*)calloc(1, sizeof(struct dxf_token_cache) + path_length + 1)) == NULL) {
+        return NULL;
+    }
+    memcpy(cache + 1, filename, path_length + 1);
+
+    if ((cache->path = make_cache_path(filename)) == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->fd = (memmap_fd_t)(-1);
+    cache->key.source_size_lo = (unsigned int)len;
+    cache->key.source_size_hi = (unsigned int)((len >> 16) >> 16);
+    cache->key.source_mtime_lo = (unsigned int)(st.st_mtime);
+    cache->key.source_mtime_hi = (unsigned int)((st.st_mtime >> 16) >> 16);
+    cache->key.source_hash = hash_bytes(buf, len, 0);
+    cache->key.path_length = (unsigned int)path_length;
+
+    if (replay_open(cache, filename) == 0) {
+        cache->mode = DXF_TOKEN_CACHE_REPLAY;
+        return cache;
+    }
+
+    if (cache->fd != (memmap_fd_t)(-1)) {
+        memmap_unmap((void*)(cache->base), cache->size, cache->fd2);
+        memmap_close(cache->fd);
+        cache->fd = (memmap_fd_t)(-1);
+        cache->base = NULL;
+    }
+
+    cache->mode = DXF_TOKEN_CACHE_RECORD;
+    cache->number_of_records = 0;
+    cache->string_len = 0;
+    cache->record_capacity = INITIAL_RECORD_CAPACITY;
+    cache->string_capacity = INITIAL_STRING_CAPACITY;
+    cache->record_buf = (struct dxf_token_cache_record*)malloc(
+                            cache->record_capacity * sizeof(struct dxf_token_cache_record));
+    cache->string_buf = (char*)malloc(cache->string_capacity);
+
+    if ((cache->record_buf == NULL) || (cache->string_buf == NULL)) {
+        free_record_buffers(cache);
+        cache->mode = 0;
+    }
+
+    return cache;
+}
+
+/* Writes the recorded stream if the whole file went through the lexer. */
+int dxf_token_cache_close(struct dxf_token_cache* const cache)
+{
+    if ((cache->mode == DXF_TOKEN_CACHE_RECORD) && cache->complete) {
+        write_cache(cache);
+    }
+
+    if (cache->fd != (memmap_fd_t)(-1)) {
+        memmap_unmap((void*)(cache->base), cache->size, cache->fd2);
+        memmap_close(cache->fd);
+    }
+
+    free_record_buffers(cache);
+    free(cache->path);
+    free(cache);
+    return 0;
+}
+
+int dxf_token_cache_get(struct dxf_token_cache* const cache, struct dxf_token* const token)
+{
+    const struct dxf_token_cache_record *record;
+
+    if (cache->next >= cache->number_of_records) {
+        return -1;
+    }
+
+    record = &(cache->records[cache->next++]);
+    token->tag = record->tag;
+    token->group_code = record->group_code;
+
+    switch (record->kind) {
+        case DXF_TOKEN_CACHE_INTEGER:
+            token->value.i = record->value.i;
+            break;
+        case DXF_TOKEN_CACHE_FLOAT:
+            token->value.f = record->value.f;
+            break;
+        case DXF_TOKEN_CACHE_STRING:
+            if (record->value.str >= cache->string_len) {
+                return -1;
+            }
+            token->value.str = (char*)(cache->strings + record->value.str);
+            break;
+        case DXF_TOKEN_CACHE_BINARY:
+            if ((record->value.bin.offset > cache->string_len)
+                || (record->value.bin.length > cache->string_len - record->value.bin.offset))
+            {
+                return -1;
+            }
+            token->value.bin = (record->value.bin.length > 0)
+                                ? (void*)(cache->strings + record->value.bin.offset) : NULL;
+            token->length = record->value.bin.length;
+            break;
+        default:
+            token->value.bin = NULL;
+            token->length = 0;
+            break;
+    }
+
+    return 0;
+}
+
+int dxf_token_cache_unget(struct dxf_token_cache* const cache)
+{
+    switch (cache->mode) {
+        case DXF_TOKEN_CACHE_REPLAY:
+            if (cache->next == 0) {
+                return -1;
+            }
+            --(cache->next);
+            return 0;
+        case DXF_TOKEN_CACHE_RECORD:
+            if (cache->number_of_records == 0) {
+                return -1;
+            }
+            --(cache->number_of_records);
+            if (cache->record_buf[cache->number_of_records].kind == DXF_TOKEN_CACHE_STRING) {
+                cache->string_len = cache->record_buf[cache->number_of_records].value.str;
+            }
+            else if (cache->record_buf[cache->number_of_records].kind == DXF_TOKEN_CACHE_BINARY) {
+                cache->string_len = cache->record_buf[cache->number_of_records].value.bin.offset;
+            }
+            cache->complete = 0;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+int dxf_token_cache_record(struct dxf_token_cache* const cache,
+                            const struct dxf_token* const token, int kind)
+{
+    struct dxf_token_cache_record *record;
+    size_t len;
+    void *buf;
+
+    if (cache->mode != DXF_TOKEN_CACHE_RECORD) {
+        return -1;
+    }
+
+    if (cache->number_of_records == cache->record_capacity) {
+        if ((buf = realloc(cache->record_buf, 2 * cache->record_capacity
+                            * sizeof(struct dxf_token_cache_record))) == NULL)
+        {
+            goto fail;
+        }
+        cache->record_buf = (struct dxf_token_cache_record*)buf;
+        cache->record_capacity *= 2;
+    }
+
+    record = &(cache->record_buf[cache->number_of_records]);
+    record->tag = (unsigned short)(token->tag);
+    record->kind = (unsigned short)kind;
+    record->group_code = token->group_code;
+
+    switch (kind) {
+        case DXF_TOKEN_CACHE_INTEGER:
+            record->value.f = 0.0;
+            record->value.i = token->value.i;
+            break;
+        case DXF_TOKEN_CACHE_FLOAT:
+            record->value.f = token->value.f;
+            break;
+        case DXF_TOKEN_CACHE_STRING:
+        case DXF_TOKEN_CACHE_BINARY:
+            /* Bytes get a terminator too, so the section still ends in one. */
+            len = (kind == DXF_TOKEN_CACHE_STRING) ? strlen(token->value.str) + 1
+                : (token->value.bin != NULL) ? token->length + 1 : 1;
+            while (cache->string_len + len > cache->string_capacity) {
+                if ((buf = realloc(cache->string_buf, 2 * cache->string_capacity)) == NULL) {
+                    goto fail;
+                }
+                cache->string_buf = (char*)buf;
+                cache->string_capacity *= 2;
+            }
+            record->value.f = 0.0;
+            if (kind == DXF_TOKEN_CACHE_STRING) {
+                record->value.str = (unsigned int)(cache->string_len);
+                memcpy(cache->string_buf + cache->string_len, token->value.str, len);
+            }
+            else {
+                record->value.bin.offset = (unsigned int)(cache->string_len);
+                record->value.bin.length = (unsigned int)(len - 1);
+                if (len > 1) {
+                    memcpy(cache->string_buf + cache->string_len, token->value.bin, len - 1);
+                }
+                cache->string_buf[cache->string_len + len - 1] = '\0';
+            }
+            cache->string_len += len;
+            break;
+        default:
+            record->value.f = 0.0;
+            break;
+    }
+
+    ++(cache->number_of_records);
+    return 0;
+
+fail:
+    /* Give up on this cache but keep lexing. */
+    errprint("dxftokcache: dxf_token_cache_record(): Out of memory, cache disabled for this file. \n");
+    free_record_buffers(cache);
+    cache->mode = 0;
+    return -1;
+}
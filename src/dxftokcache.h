@@ -0,0 +1,105 @@
+#ifndef __DXF_TOKEN_CACHE_H__
+#define __DXF_TOKEN_CACHE_H__
+
+#include <stddef.h>
+#include "memmap.h"
+
+/* Pre-decoded token stream of a DXF file. The first time a file is
+ * opened the lexer records every token it produces; when the whole file
+ * has been read the stream is written next to the file (name.dxf.dxt)
+ * or into the cache directory. Later opens replay it instead of lexing
+ * text. A cache is only used when the path, size, modification time and
+ * content hash of the file all match and its own checksum is intact.
+ */
+
+#define DXF_TOKEN_CACHE_MAGIC "DXFTOKC"
+#define DXF_TOKEN_CACHE_VERSION 2
+#define DXF_TOKEN_CACHE_BYTE_ORDER 0x01020304u
+#define DXF_TOKEN_CACHE_SUFFIX ".dxt"
+
+/* Cache modes */
+#define DXF_TOKEN_CACHE_REPLAY 1
+#define DXF_TOKEN_CACHE_RECORD 2
+
+/* Token value kinds */
+#define DXF_TOKEN_CACHE_NONE 0
+#define DXF_TOKEN_CACHE_INTEGER 1
+#define DXF_TOKEN_CACHE_FLOAT 2
+#define DXF_TOKEN_CACHE_STRING 3
+#define DXF_TOKEN_CACHE_BINARY 4
+
+struct dxf_token;
+
+struct dxf_token_cache_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned int source_size_lo;
+    unsigned int source_size_hi;
+    unsigned int source_mtime_lo;
+    unsigned int source_mtime_hi;
+    unsigned int source_hash;
+    unsigned int path_length;       /* Path follows the header, padded to 8. */
+    unsigned int number_of_tokens;
+    unsigned int string_bytes;
+    unsigned int checksum;          /* Over records and strings. */
+    unsigned int reserved;
+};
+
+struct dxf_token_cache_record {
+    unsigned short tag;
+    unsigned short kind;
+    unsigned int group_code;
+    union {
+        double f;
+        int i;
+        unsigned int str;           /* Offset into the string section. */
+        struct {
+            unsigned int offset;    /* Decoded bytes in the string section. */
+            unsigned int length;
+        } bin;
+    } value;
+};
+
+struct dxf_token_cache {
+    int mode;
+    int complete;
+    char *path;
+    struct dxf_token_cache_header key;
+
+    /* Replay */
+    const char *base;
+    size_t size;
+    memmap_fd_t fd;
+    memmap_fd_t fd2;
+    const struct dxf_token_cache_record *records;
+    const char *strings;
+    size_t next;
+
+    /* Record */
+    struct dxf_token_cache_record *record_buf;
+    size_t number_of_records;
+    size_t record_capacity;
+    char *string_buf;
+    size_t string_len;
+    size_t string_capacity;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_token_cache_enable(const char *cache_dir);
+int dxf_token_cache_disable();
+struct dxf_token_cache* dxf_token_cache_open(const char *filename, const char *buf, size_t len);
+int dxf_token_cache_close(struct dxf_token_cache* const cache);
+int dxf_token_cache_get(struct dxf_token_cache* const cache, struct dxf_token* const token);
+int dxf_token_cache_unget(struct dxf_token_cache* const cache);
+int dxf_token_cache_record(struct dxf_token_cache* const cache,
+                            const struct dxf_token* const token, int kind);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_TOKEN_CACHE_H__ */
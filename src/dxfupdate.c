@@ -0,0 +1,371 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dxfupdate.h"
+#include "dxfparser.h"
+#include "dxftext.h"
+#include "dxfxdata.h"
+#include "hashtab.h"
+
+#include "dbgprint.h"
+
+struct input {
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf_lazy lazy;
+};
+
+static unsigned int str_hash(const char **psz)
+{
+    unsigned int hash = 0;
+    const char *sz = *psz;
+
+    while (*sz != '\0') {
+        hash = *(sz++) + (hash << 5) - 1;
+    }
+
+    return hash;
+}
+
+static int str_cmp(const char **psz1, const char **psz2)
+{
+    return strcmp(*psz1, *psz2);
+}
+
+/* FNV-1a */
+static unsigned int hash_bytes(const char *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char*)buf;
+    const unsigned char *end = p + len;
+    unsigned int hash = 2166136261u;
+
+    while (p < end) {
+        hash ^= *(p++);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static unsigned int hash_section(const struct input* const input, const char *name)
+{
+    const struct dxf_lazy_section *section;
+
+    if ((section = dxf_lazy_get_section(&(input->lazy), name)) == NULL) {
+        return 0;
+    }
+
+    return hash_bytes(input->lexer_desc.buf + section->offset, section->length);
+}
+
+static unsigned int hash_entry(const struct input* const input, const struct dxf_lazy_entry* const entry)
+{
+    return hash_bytes(input->lexer_desc.buf + entry->offset, entry->length);
+}
+
+static int open_input(struct input* const input, struct dxf* const dxf,
+                        const char *filename, int parse_blocks)
+{
+    dxf_lexer_init();
+    dxf_parser_init();
+
+    dxf_lexer_clear_desc(&(input->lexer_desc));
+    if (dxf_lexer_open_desc(&(input->lexer_desc), filename, NULL) != 0) {
+        errprint("dxfupdate: open_input(): Failed to open %s. \n", filename);
+        return -1;
+    }
+
+    dxf_parser_init_desc(&(input->parser_desc), &(input->lexer_desc), dxf);
+
+    if ((parse_blocks ? dxf_lazy_open(&(input->lazy), &(input->parser_desc))
+                    : dxf_lazy_index(&(input->lazy), &(input->parser_desc))) != 0)
+    {
+        dxf_lexer_close_desc(&(input->lexer_desc), 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* The revision outlives the input, so text bodies are decoded and XDATA
+ * copied first.
+ */
+static void close_input(struct input* const input)
+{
+    dxf_text_materialize(input->parser_desc.dxf);
+    dxf_xdata_materialize(input->parser_desc.dxf);
+    dxf_lazy_close(&(input->lazy));
+    dxf_lexer_close_desc(&(input->lexer_desc), 1);
+}
+
+/* Grows the change list to hold count more changes, so that adding them
+ * cannot fail once the document is being changed.
+ */
+static int reserve_changes(struct dxf_update_report* const report, size_t count)
+{
+    struct dxf_entity_change *changes;
+    size_t capacity = (report->capacity == 0) ? 64 : report->capacity;
+
+    while (capacity < report->number_of_changes + count) {
+        capacity *= 2;
+    }
+    if (capacity == report->capacity) {
+        return 0;
+    }
+
+    changes = (struct dxf_entity_change*)realloc(report->changes,
+                                        capacity * sizeof(struct dxf_entity_change));
+    if (changes == NULL) {
+        errprint("dxfupdate: reserve_changes(): Failed to grow the change list. \n");
+        return -1;
+    }
+    report->changes = changes;
+    report->capacity = capacity;
+    return 0;
+}
+
+static void add_change(struct dxf_update_report* const report, int kind,
+                        struct dxf_entity *old_entity, struct dxf_entity *new_entity)
+{
+    struct dxf_entity_change *change = &(report->changes[report->number_of_changes++]);
+
+    change->kind = kind;
+    change->old_entity = old_entity;
+    change->new_entity = new_entity;
+}
+
+/* Layers whose lists dxf_relink_entities() rebuilds; duplicates do no harm. */
+static void add_layer(struct dxf_layer** const layers, size_t *number_of_layers,
+                        const struct dxf_entity* const entity)
+{
+    if ((entity != NULL) && (entity->layer != NULL)) {
+        layers[(*number_of_layers)++] = entity->layer;
+    }
+}
+
+static int has_handles(const struct dxf_lazy* const lazy)
+{
+    size_t i;
+
+    for (i = 0; i < lazy->number_of_entries; ++i) {
+        if (lazy->entries[i].handle[0] == '\0') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int dxf_revision_load(struct dxf_revision* const revision, struct dxf* const dxf,
+                        const char *filename)
+{
+    struct input input;
+    struct dxf_revision_entry *entry;
+    size_t i;
+
+    revision->dxf = dxf;
+    revision->entries = NULL;
+    revision->number_of_entries = 0;
+
+    if (open_input(&input, dxf, filename, 1) != 0) {
+        return -1;
+    }
+
+    revision->last_block_entity = dxf->last_entity;
+    revision->tables_hash = hash_section(&input, "TABLES");
+    revision->blocks_hash = hash_section(&input, "BLOCKS");
+
+    revision->entries = (struct dxf_revision_entry*)malloc(
+                (input.lazy.number_of_entries + 1) * sizeof(struct dxf_revision_entry));
+    if (revision->entries == NULL) {
+        errprint("dxfupdate: dxf_revision_load(): Failed to allocate the revision. \n");
+        close_input(&input);
+        return -1;
+    }
+
+    for (i = 0; i < input.lazy.number_of_entries; ++i) {
+        entry = &(revision->entries[i]);
+        memcpy(entry->handle, input.lazy.entries[i].handle, DXF_LAZY_HANDLE_SIZE);
+        entry->hash = hash_entry(&input, &(input.lazy.entries[i]));
+        entry->entity = dxf_lazy_get_entity(&(input.lazy), i);
+    }
+    revision->number_of_entries = input.lazy.number_of_entries;
+
+    close_input(&input);
+    return 0;
+}
+
+static int reload(struct dxf_revision* const revision, const char *filename,
+                    struct dxf_update_report* const report)
+{
+    struct dxf* const dxf = revision->dxf;
+
+    dbgprint("dxfupdate: reload(): Structure of %s changed, reloading. \n", filename);
+
+    dxf_revision_free(revision);
+    if (dxf_reset(dxf, 0) != 0) {
+        return -1;
+    }
+
+    report->reloaded = 1;
+    return dxf_revision_load(revision, dxf, filename);
+}
+
+int dxf_revision_update(struct dxf_revision* const revision, const char *filename,
+                        struct dxf_update_report* const report)
+{
+    struct dxf* const dxf = revision->dxf;
+    struct input input;
+    struct hashtable old_indices;
+    struct dxf_revision_entry *entries = NULL;
+    struct dxf_revision_entry *entry;
+    struct dxf_revision_entry *old_entry;
+    struct dxf_entity **kept = NULL;
+    struct dxf_layer **layers = NULL;
+    struct dxf_entity *tail;
+    char *used = NULL;
+    const char *key;
+    const size_t *old_index;
+    size_t number_kept = 0;
+    size_t number_of_layers = 0;
+    size_t last_index = 0;
+    size_t count;
+    size_t i;
+    int retval = -1;
+
+    report->reloaded = 0;
+    report->number_unchanged = 0;
+    report->number_of_changes = 0;
+
+    if (open_input(&input, dxf, filename, 0) != 0) {
+        return -1;
+    }
+
+    if ((hash_section(&input, "TABLES") != revision->tables_hash)
+        || (hash_section(&input, "BLOCKS") != revision->blocks_hash)
+        || !has_handles(&(input.lazy)))
+    {
+        close_input(&input);
+        return reload(revision, filename, report);
+    }
+
+    if (hashtable_create(&old_indices, revision->number_of_entries, 0, 0, HASHTABLE_COPY_VALUE,
+        HASHTABLE_COPY_VALUE, (pfn_hash_t)str_hash, (pfn_keycmp_t)str_cmp, NULL) != 0)
+    {
+        close_input(&input);
+        return -1;
+    }
+
+    /* Everything that can fail comes before the first entity is parsed,
+     * since parsing links it into the document.
+     */
+    count = input.lazy.number_of_entries;
+    entries = (struct dxf_revision_entry*)malloc((count + 1) * sizeof(struct dxf_revision_entry));
+    kept = (struct dxf_entity**)malloc((count + 1) * sizeof(struct dxf_entity*));
+    layers = (struct dxf_layer**)malloc((2 * count + revision->number_of_entries + 1)
+                                        * sizeof(struct dxf_layer*));
+    used = (char*)calloc(revision->number_of_entries + 1, 1);
+    if ((entries == NULL) || (kept == NULL) || (layers == NULL) || (used == NULL)
+        || (reserve_changes(report, count + revision->number_of_entries) != 0))
+    {
+        errprint("dxfupdate: dxf_revision_update(): Out of memory. \n");
+        goto out;
+    }
+
+    /* Keys point into the old revision, which outlives the table. */
+    for (i = 0; i < revision->number_of_entries; ++i) {
+        key = revision->entries[i].handle;
+        if (hashtable_put(&old_indices, (void*)&key, sizeof(char*), &i, sizeof(size_t)) != 0) {
+            goto out;
+        }
+    }
+
+    for (i = 0; i < count; ++i) {
+        entry = &(entries[i]);
+        memcpy(entry->handle, input.lazy.entries[i].handle, DXF_LAZY_HANDLE_SIZE);
+        entry->hash = hash_entry(&input, &(input.lazy.entries[i]));
+
+        key = entry->handle;
+        old_entry = NULL;
+        if (((old_index = hashtable_get(&old_indices, (void*)&key)) != NULL) && !used[*old_index]) {
+            old_entry = &(revision->entries[*old_index]);
+            used[*old_index] = 1;
+        }
+
+        if ((old_entry != NULL) && (old_entry->hash == entry->hash)) {
+            entry->entity = old_entry->entity;
+            ++(report->number_unchanged);
+            /* Moved before an entity it used to follow. */
+            if (*old_index < last_index) {
+                add_layer(layers, &number_of_layers, entry->entity);
+            }
+            last_index = (*old_index > last_index) ? *old_index : last_index;
+        }
+        else {
+            tail = dxf->last_entity;
+            entry->entity = dxf_lazy_get_entity(&(input.lazy), i);
+            if ((entry->entity == NULL) && (dxf->last_entity != tail)) {
+                /* Parsed in part; its layer list must drop it again. */
+                add_layer(layers, &number_of_layers, dxf->last_entity);
+            }
+            add_layer(layers, &number_of_layers, entry->entity);
+            if (old_entry != NULL) {
+                add_layer(layers, &number_of_layers, old_entry->entity);
+                if ((old_entry->entity != NULL) || (entry->entity != NULL)) {
+                    add_change(report, DXF_ENTITY_MODIFIED, old_entry->entity, entry->entity);
+                }
+            }
+            else if (entry->entity != NULL) {
+                add_change(report, DXF_ENTITY_ADDED, NULL, entry->entity);
+            }
+        }
+
+        if (entry->entity != NULL) {
+            kept[number_kept++] = entry->entity;
+        }
+    }
+
+    for (i = 0; i < revision->number_of_entries; ++i) {
+        if (!used[i] && (revision->entries[i].entity != NULL)) {
+            add_layer(layers, &number_of_layers, revision->entries[i].entity);
+            add_change(report, DXF_ENTITY_REMOVED, revision->entries[i].entity, NULL);
+        }
+    }
+
+    dxf_relink_entities(dxf, revision->last_block_entity, kept, number_kept, layers, number_of_layers);
+
+    free(revision->entries);
+    revision->entries = entries;
+    revision->number_of_entries = count;
+    entries = NULL;
+    retval = 0;
+
+    dbgprint("dxfupdate: dxf_revision_update(): %lu unchanged, %lu changes, %lu layers relinked. \n",
+            (unsigned long)(report->number_unchanged), (unsigned long)(report->number_of_changes),
+            (unsigned long)number_of_layers);
+
+out:
+    hashtable_destroy(&old_indices);
+    free(entries);
+    free(kept);
+    free(layers);
+    free(used);
+    close_input(&input);
+    return retval;
+}
+
+int dxf_revision_free(struct dxf_revision* const revision)
+{
+    free(revision->entries);
+    revision->entries = NULL;
+    revision->number_of_entries = 0;
+    return 0;
+}
+
+int dxf_update_report_free(struct dxf_update_report* const report)
+{
+    free(report->changes);
+    report->changes = NULL;
+    report->number_of_changes = 0;
+    report->capacity = 0;
+    return 0;
+}
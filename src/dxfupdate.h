@@ -0,0 +1,73 @@
+#ifndef __DXF_UPDATE_H__
+#define __DXF_UPDATE_H__
+
+#include <stddef.h>
+#include "dxf.h"
+#include "dxflazy.h"
+
+/* Incremental re-parse. A revision remembers the handle and a hash of the
+ * source text of every entity in the ENTITIES section, plus hashes of the
+ * TABLES and BLOCKS sections. Updating from a newer version of the file
+ * re-parses only entities whose text changed or that are new, unlinks the
+ * ones that are gone and reports all three. If TABLES or BLOCKS changed,
+ * or an entity has no handle, the document is reloaded from scratch and
+ * the report says so instead of listing changes. Only the lists of layers
+ * that gain, lose or reorder entities are rebuilt.
+ *
+ * Replaced and removed entities stay in the pool of the document until it
+ * is reset, so a document updated again and again keeps growing. Reload
+ * it from time to time (dxf_reset() and dxf_revision_load()) to reclaim
+ * that memory.
+ */
+
+/* Change kinds */
+#define DXF_ENTITY_ADDED 1
+#define DXF_ENTITY_REMOVED 2
+#define DXF_ENTITY_MODIFIED 3
+
+struct dxf_revision_entry {
+    char handle[DXF_LAZY_HANDLE_SIZE];
+    unsigned int hash;
+    struct dxf_entity *entity;      /* NULL for unsupported types. */
+};
+
+struct dxf_revision {
+    struct dxf *dxf;
+    struct dxf_revision_entry *entries;
+    size_t number_of_entries;
+    unsigned int tables_hash;
+    unsigned int blocks_hash;
+    struct dxf_entity *last_block_entity;   /* End of file order before ENTITIES. */
+};
+
+struct dxf_entity_change {
+    int kind;
+    struct dxf_entity *old_entity;  /* NULL when added. Unlinked but still valid. */
+    struct dxf_entity *new_entity;  /* NULL when removed. */
+};
+
+/* Zero before first use; the change list is reused by later updates. */
+struct dxf_update_report {
+    int reloaded;
+    size_t number_unchanged;
+    struct dxf_entity_change *changes;
+    size_t number_of_changes;
+    size_t capacity;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_revision_load(struct dxf_revision* const revision, struct dxf* const dxf,
+                        const char *filename);
+int dxf_revision_update(struct dxf_revision* const revision, const char *filename,
+                        struct dxf_update_report* const report);
+int dxf_revision_free(struct dxf_revision* const revision);
+int dxf_update_report_free(struct dxf_update_report* const report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_UPDATE_H__ */
@@ -0,0 +1,275 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dxfxdata.h"
+#include "dxfbinary.h"
+
+#include "dbgprint.h"
+
+/* Longest number we expect on a value line. */
+#define DXF_XDATA_NUMBER_SIZE 64
+
+struct cursor {
+    const char *p;
+    const char *end;
+};
+
+/* Next line, without its line break. */
+static int next_line(struct cursor* const cur, const char **line, size_t *length)
+{
+    const char *p = cur->p;
+
+    if (p >= cur->end) {
+        return -1;
+    }
+
+    *line = p;
+    while ((p < cur->end) && (*p != '\n')) {
+        ++p;
+    }
+    *length = p - *line;
+    if ((*length > 0) && ((*line)[*length - 1] == '\r')) {
+        --(*length);
+    }
+    cur->p = (p < cur->end) ? p + 1 : p;
+
+    return 0;
+}
+
+static int next_group(struct cursor* const cur, unsigned int *code, const char **value,
+                    size_t *length)
+{
+    const char *line;
+    size_t n;
+    size_t i = 0;
+
+    if ((next_line(cur, &line, &n) != 0) || (next_line(cur, value, length) != 0)) {
+        return -1;
+    }
+
+    while ((i < n) && (line[i] == ' ')) {
+        ++i;
+    }
+    for (*code = 0; (i < n) && (line[i] >= '0') && (line[i] <= '9'); ++i) {
+        *code = *code * 10 + (line[i] - '0');
+    }
+
+    return 0;
+}
+
+static double to_double(const char *value, size_t length)
+{
+    char buf[DXF_XDATA_NUMBER_SIZE];
+
+    if (length >= sizeof(buf)) {
+        length = sizeof(buf) - 1;
+    }
+    memcpy(buf, value, length);
+    buf[length] = '\0';
+
+    return strtod(buf, NULL);
+}
+
+static long to_long(const char *value, size_t length)
+{
+    char buf[DXF_XDATA_NUMBER_SIZE];
+
+    if (length >= sizeof(buf)) {
+        length = sizeof(buf) - 1;
+    }
+    memcpy(buf, value, length);
+    buf[length] = '\0';
+
+    return strtol(buf, NULL, 10);
+}
+
+static const char* copy_value(struct dxf* const dxf, const char *value, size_t length)
+{
+    char *str;
+
+    if ((str = dxf_alloc_string(dxf, length)) == NULL) {
+        return NULL;
+    }
+    memcpy(str, value, length);
+    str[length] = '\0';
+
+    return str;
+}
+
+/* 1004 chunks are hex; anything else leaves the item empty. */
+static int decode_binary(struct dxf* const dxf, struct dxf_xdata_item* const item, const char *value,
+                        size_t length)
+{
+    unsigned char *data;
+
+    item->value.bin.data = NULL;
+    item->value.bin.size = 0;
+    if ((length == 0) || (length % 2 != 0)) {
+        return 0;
+    }
+
+    if ((data = (unsigned char*)dxf_alloc_binary(dxf, length / 2)) == NULL) {
+        return -1;
+    }
+    if (dxf_binary_decode_hex(value, length, data) == length / 2) {
+        item->value.bin.data = data;
+        item->value.bin.size = length / 2;
+    }
+
+    return 0;
+}
+
+/* 1020-1023 and 1030-1033 complete the point item right before them. */
+static int add_to_point(struct dxf_xdata_item* const items, size_t count, unsigned int code,
+                        double f)
+{
+    struct dxf_xdata_item *last;
+    unsigned int axis = (code - 1000) / 10;
+
+    if ((count == 0) || (code % 10 > 3) || ((axis != 2) && (axis != 3))) {
+        return -1;
+    }
+
+    last = &(items[count - 1]);
+    if (last->group_code != code - 10 * (axis - 1)) {
+        return -1;
+    }
+    last->value.point[axis - 1] = f;
+
+    return 0;
+}
+
+/* Returns 0 once decoded, also if there was nothing to decode. */
+int dxf_xdata_decode(struct dxf* const dxf, struct dxf_entity* const entity)
+{
+    struct dxf_xdata* const xdata = entity->xdata;
+    struct dxf_xdata_app *app = NULL;
+    struct dxf_xdata_item *item;
+    struct cursor cur;
+    unsigned int code;
+    const char *value;
+    size_t length;
+    size_t number_of_groups = 0;
+    size_t number_of_apps = 0;
+    double f = 0.0;
+
+    if ((xdata == NULL) || (xdata->apps != NULL) || (xdata->str == NULL)) {
+        return 0;
+    }
+
+    cur.p = xdata->str;
+    cur.end = xdata->str + xdata->length;
+    while (next_group(&cur, &code, &value, &length) == 0) {
+        if (code == 1001) {
+            ++number_of_apps;
+        }
+        ++number_of_groups;
+    }
+    if (number_of_apps == 0) {
+        return 0;
+    }
+
+    xdata->apps = (struct dxf_xdata_app*)dxf_alloc_binary(dxf, number_of_apps * sizeof(struct dxf_xdata_app));
+    xdata->items = (struct dxf_xdata_item*)dxf_alloc_binary(dxf,
+                    (number_of_groups - number_of_apps + 1) * sizeof(struct dxf_xdata_item));
+    if ((xdata->apps == NULL) || (xdata->items == NULL)) {
+        errprint("dxfxdata: dxf_xdata_decode(): Failed to allocate %lu groups. \n",
+                (unsigned long)number_of_groups);
+        xdata->apps = NULL;
+        return -1;
+    }
+    xdata->number_of_apps = 0;
+    xdata->number_of_items = 0;
+
+    cur.p = xdata->str;
+    while (next_group(&cur, &code, &value, &length) == 0) {
+        if (code == 1001) {
+            app = &(xdata->apps[(xdata->number_of_apps)++]);
+            app->first = xdata->number_of_items;
+            app->count = 0;
+            if ((app->name = copy_value(dxf, value, length)) == NULL) {
+                return -1;
+            }
+            continue;
+        }
+        if (app == NULL) {
+            continue;
+        }
+
+        if ((code >= 1010) && (code < 1060)) {
+            f = to_double(value, length);
+            if (add_to_point(xdata->items, xdata->number_of_items, code, f) == 0) {
+                continue;
+            }
+        }
+
+        item = &(xdata->items[(xdata->number_of_items)++]);
+        ++(app->count);
+        item->group_code = code;
+
+        if ((code >= 1010) && (code <= 1013)) {
+            item->value.point[0] = f;
+            item->value.point[1] = item->value.point[2] = 0.0;
+        }
+        else if ((code >= 1010) && (code < 1060)) {
+            item->value.f = f;
+        }
+        else if ((code >= 1060) && (code <= 1071)) {
+            item->value.i = to_long(value, length);
+        }
+        else if (code == 1004) {
+            if (decode_binary(dxf, item, value, length) != 0) {
+                return -1;
+            }
+        }
+        else if ((item->value.str = copy_value(dxf, value, length)) == NULL) {
+            return -1;
+        }
+    }
+
+    dbgprint("dxfxdata: Decoded %lu items of %lu applications. \n",
+            (unsigned long)xdata->number_of_items, (unsigned long)xdata->number_of_apps);
+    return 0;
+}
+
+const struct dxf_xdata_app* dxf_xdata_find_app(struct dxf* const dxf, struct dxf_entity* const entity,
+                                            const char *name)
+{
+    size_t i;
+
+    if ((entity->xdata == NULL) || (dxf_xdata_decode(dxf, entity) != 0)) {
+        return NULL;
+    }
+
+    for (i = 0; i < entity->xdata->number_of_apps; ++i) {
+        if (strcmp(entity->xdata->apps[i].name, name) == 0) {
+            return &(entity->xdata->apps[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns the number of entities whose XDATA this call copied. */
+size_t dxf_xdata_materialize(struct dxf* const dxf)
+{
+    struct dxf_entity *entity;
+    struct dxf_xdata *xdata;
+    const char *str;
+    size_t count = 0;
+
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        if (((xdata = entity->xdata) == NULL) || xdata->copied || (xdata->str == NULL)) {
+            continue;
+        }
+        if ((str = copy_value(dxf, xdata->str, xdata->length)) == NULL) {
+            errprint("dxfxdata: dxf_xdata_materialize(): Failed to copy %lu bytes. \n",
+                    (unsigned long)xdata->length);
+            return count;
+        }
+        xdata->str = str;
+        xdata->copied = 1;
+        ++count;
+    }
+
+    return count;
+}
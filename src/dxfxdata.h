@@ -0,0 +1,34 @@
+#ifndef __DXF_XDATA_H__
+#define __DXF_XDATA_H__
+
+#include <stddef.h>
+#include "dxf.h"
+
+/* Extended entity data. The parser steps over XDATA without converting
+ * it and keeps where it lies in the input (struct dxf_xdata), so parsing
+ * costs about the same with or without it. dxf_xdata_decode() turns it
+ * into items grouped by application, in the pool, on first use. 1004
+ * chunks come out as bytes.
+ *
+ * Like text spans, the raw XDATA points into the lexer's input. Call
+ * dxf_xdata_materialize() before closing the lexer to keep it, which
+ * copies it to the pool undecoded.
+ *
+ * The DXF_PARSER_DIMENSION_BLOCKS_ONLY fast path skips XDATA of
+ * dimensions along with everything else it does not need.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dxf_xdata_decode(struct dxf* const dxf, struct dxf_entity* const entity);
+const struct dxf_xdata_app* dxf_xdata_find_app(struct dxf* const dxf, struct dxf_entity* const entity,
+                                            const char *name);
+size_t dxf_xdata_materialize(struct dxf* const dxf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DXF_XDATA_H__ */
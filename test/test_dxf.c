@@ -6,6 +6,9 @@ int main(int argc, char *argv[])
 {
     struct dxf dxf;
     struct dxf_entity *entity;
+    struct dxf_entity_iter iter;
+    struct dxf_block *block;
+    int i;
 
     if (dxf_init(&dxf, 4096) != 0) {
         printf("Failed to init dxf. \n");
@@ -30,5 +33,57 @@ int main(int argc, char *argv[])
     ((struct dxf_line*)entity)->z2 = 6.0f;
     dxf_add_entity(&dxf, "Layer2", entity, DXF_ADD_ENTITY_TO_LAYER);
 
+    entity = dxf_alloc_entity(&dxf, DXF_POINT);
+    ((struct dxf_point*)entity)->x = 7.0f;
+    dxf_add_entity(&dxf, "Layer1", entity, DXF_ADD_ENTITY_TO_LAYER);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES);
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        printf("seq=%zu type=%d layer=%s \n", entity->seq, entity->type, entity->layer->name);
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, "Layer1", DXF_ENTITY_TYPE_BIT(DXF_POINT));
+    entity = dxf_entity_iter_next(&iter);
+    if ((entity == NULL) || (entity->seq != 1)) {
+        printf("File order was not preserved. \n");
+        return 1;
+    }
+
+    /* Block members sit on a layer list too, between model space
+     * entities of the same layer; the block list must hold only them.
+     */
+    block = dxf_add_block(&dxf, "Block1", dxf_get_layer(&dxf, "Layer1"));
+    for (i = 0; i < 4; ++i) {
+        entity = dxf_alloc_entity(&dxf, DXF_POINT);
+        ((struct dxf_point*)entity)->x = (double)i;
+        if ((i == 1) || (i == 2)) {
+            dxf_add_entity(&dxf, "Block1", entity, DXF_ADD_ENTITY_TO_BLOCK);
+        }
+        dxf_add_entity(&dxf, "Layer1", entity, DXF_ADD_ENTITY_TO_LAYER);
+    }
+
+    i = 0;
+    for (entity = block->entities[DXF_POINT]; entity != NULL; entity = entity->next_in_block) {
+        if ((entity->block != block) || (((struct dxf_point*)entity)->x != (double)(i + 1))) {
+            printf("Block list runs into entities outside the block. \n");
+            return 1;
+        }
+        ++i;
+    }
+    if ((i != 2) || (block->entities_tail[DXF_POINT]->next_in_block != NULL)) {
+        printf("Block list has %d entities, expected 2. \n", i);
+        return 1;
+    }
+
+    i = 0;
+    for (entity = dxf_get_layer(&dxf, "Layer1")->entities[DXF_POINT]; entity != NULL; entity = entity->next) {
+        ++i;
+    }
+    if (i != 6) {
+        printf("Layer list has %d points, expected 6. \n", i);
+        return 1;
+    }
+
+    dxf_free(&dxf);
     return 0;
 }
@@ -8,6 +8,9 @@ int main(int argc, char *argv[])
     struct dxf_lexer_desc lexer_desc;
     struct dxf_parser_desc parser_desc;
     struct dxf dxf;
+    struct dxf_stats stats;
+    int pass;
+    int type;
     
     if (argc < 2) {
         return 1;
@@ -20,16 +23,45 @@ int main(int argc, char *argv[])
         return 1;
     }
     
-    if (dxf_init(&dxf, 0) != 0) {
+    if (dxf_init(&dxf, dxf_estimate_pool_size(dxf_lexer_get_input_length(&lexer_desc))) != 0) {
         printf("Failed to initialize dxf struct.\n");
         return 1;
     }
     
     dxf_parser_init();
-    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
-    dxf_parser_parse(&parser_desc);
+
+    /* Second pass reuses the struct the way a batch job would. */
+    for (pass = 0; pass < 2; ++pass) {
+        if (pass > 0) {
+            dxf_lexer_close_desc(&lexer_desc, 1);
+            dxf_lexer_open_desc(&lexer_desc, argv[1], NULL);
+            dxf_reset(&dxf, 0);
+        }
+
+        dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+        if (dxf_parser_parse(&parser_desc) != 0) {
+            printf("Failed to parse %s. \n", argv[1]);
+            return 1;
+        }
+
+        dxf_get_stats(&dxf, &stats);
+        printf("pass %d: %zu entities, pool reserved=%zu used=%zu peak=%zu \n", pass,
+                dxf.number_of_entities, stats.pool_bytes_reserved,
+                stats.pool_bytes_used, stats.pool_bytes_peak);
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            if (stats.entity_counts[type] != 0) {
+                printf("  type %d: count=%zu bytes=%zu \n", type,
+                        stats.entity_counts[type], stats.entity_bytes[type]);
+            }
+        }
+        printf("  binary=%zu (vertices=%zu) strings=%zu containers=%zu (%zu layers, %zu blocks) \n",
+                stats.binary_bytes, stats.vertex_bytes, stats.string_bytes, stats.container_bytes,
+                stats.number_of_layers, stats.number_of_blocks);
+        printf("  unresolved block references=%zu \n", parser_desc.number_of_fixups);
+    }
     
-    dxf_lexer_close_desc(&lexer_desc, 0);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+    dxf_free(&dxf);
     
     return 0;
 }
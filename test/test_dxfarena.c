@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxfarena.h"
+
+int main()
+{
+    struct dxf_arena *arena;
+    struct dxf_arena_stats stats;
+    size_t reserved;
+    char *sz;
+    int i;
+    
+    if ((arena = dxf_arena_create(1024 * 1024, DXF_ARENA_HUGE_PAGES)) == NULL) {
+        printf("dxf_arena_create() failed.\n");
+        return 1;
+    }
+    
+    for (i = 0; i < 10000; ++i) {
+        dxf_arena_alloc(arena, sizeof(struct dxf_line));
+        dxf_arena_alloc(arena, sizeof(struct dxf_lwpolyline_vertex));
+        sz = dxf_arena_calloc(arena, 1, 9);
+        memcpy(sz, "AAAAAAAA", 9);
+    }
+    
+    printf("\n large block \n");
+    dxf_arena_alloc(arena, 10240000);
+
+    dxf_arena_get_stats(arena, &stats);
+    printf("reserved=%zu used=%zu chunks=%zu huge_pages=%d \n",
+            stats.bytes_reserved, stats.bytes_used, stats.chunks, stats.huge_pages);
+    for (i = 0; i < DXF_ARENA_CLASS_COUNT; ++i) {
+        if (stats.classes[i].count != 0) {
+            printf("class %zu: count=%zu bytes=%zu \n", stats.classes[i].class_size,
+                    stats.classes[i].count, stats.classes[i].bytes);
+        }
+    }
+
+    /* Chunks and the large block survive the reset and are reused. */
+    dxf_arena_reset(arena);
+    reserved = stats.bytes_reserved;
+    for (i = 0; i < 10000; ++i) {
+        dxf_arena_alloc(arena, sizeof(struct dxf_line));
+    }
+    dxf_arena_alloc(arena, 9000000);
+    dxf_arena_get_stats(arena, &stats);
+    if (stats.bytes_reserved != reserved) {
+        printf("Chunks were not reused after reset.\n");
+        return 1;
+    }
+
+    /* Reserving again after a reset finds the space it already has. */
+    for (i = 0; i < 10; ++i) {
+        dxf_arena_reset(arena);
+        if (dxf_arena_reserve(arena, 1024 * 1024) != 0) {
+            printf("dxf_arena_reserve() failed.\n");
+            return 1;
+        }
+        dxf_arena_alloc(arena, 100000);
+        if (i == 0) {
+            dxf_arena_get_stats(arena, &stats);
+            reserved = stats.bytes_reserved;
+        }
+    }
+    dxf_arena_get_stats(arena, &stats);
+    if (stats.bytes_reserved != reserved) {
+        printf("Reserved %zu bytes after resets, %zu before.\n", stats.bytes_reserved, reserved);
+        return 1;
+    }
+    
+    dxf_arena_destroy(arena);
+
+    /* A reservation smaller than a chunk still yields one, and large
+     * blocks are cut from reservations too.
+     */
+    if ((arena = dxf_arena_create(4096, DXF_ARENA_DEFAULT)) == NULL) {
+        printf("dxf_arena_create() failed.\n");
+        return 1;
+    }
+    dxf_arena_get_stats(arena, &stats);
+    reserved = stats.bytes_reserved;
+    dxf_arena_alloc(arena, sizeof(struct dxf_line));
+    dxf_arena_get_stats(arena, &stats);
+    if ((reserved < DXF_ARENA_CHUNK_SIZE) || (stats.bytes_reserved != reserved)) {
+        printf("Small reservation was not used, %zu then %zu bytes.\n", reserved, stats.bytes_reserved);
+        return 1;
+    }
+    dxf_arena_destroy(arena);
+
+    if ((arena = dxf_arena_create(1024 * 1024, DXF_ARENA_DEFAULT)) == NULL) {
+        printf("dxf_arena_create() failed.\n");
+        return 1;
+    }
+    dxf_arena_get_stats(arena, &stats);
+    reserved = stats.bytes_reserved;
+    dxf_arena_alloc(arena, 500000);
+    dxf_arena_reset(arena);
+    dxf_arena_alloc(arena, 400000);
+    dxf_arena_get_stats(arena, &stats);
+    if (stats.bytes_reserved != reserved) {
+        printf("Large block was not cut from the reservation.\n");
+        return 1;
+    }
+    dxf_arena_destroy(arena);
+
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxfbinary.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+
+static const unsigned char bmp_signature[] = { 'B', 'M' };
+static const unsigned char png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static int check_decode()
+{
+    unsigned char out[16];
+    char buf[32];
+
+    if ((dxf_binary_decode_hex("0123456789abcdefABCDEF", 22, out) != 11)
+        || (memcmp(out, "\x01\x23\x45\x67\x89\xab\xcd\xef\xab\xcd\xef", 11) != 0))
+    {
+        printf("Hex digits decode wrong. \n");
+        return -1;
+    }
+
+    /* A trailing half byte makes the value invalid, as in XDATA. */
+    if (dxf_binary_decode_hex("7F0", 3, out) != (size_t)-1) {
+        printf("Odd length was accepted. \n");
+        return -1;
+    }
+
+    if ((dxf_binary_decode_hex("00112233445566G7", 16, out) != (size_t)-1)
+        || (dxf_binary_decode_hex("0 11", 4, out) != (size_t)-1))
+    {
+        printf("Non-hex input was accepted. \n");
+        return -1;
+    }
+
+    strcpy(buf, "DEADBEEF0102030405");
+    if ((dxf_binary_decode_hex(buf, 18, (unsigned char*)buf) != 9)
+        || (memcmp(buf, "\xde\xad\xbe\xef\x01\x02\x03\x04\x05", 9) != 0))
+    {
+        printf("In-place decoding is wrong. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Chunks never exceed the 127 bytes a line may hold. */
+static int lex(const char *path, size_t *number_of_chunks)
+{
+    struct dxf_lexer_desc desc;
+
+    dxf_lexer_clear_desc(&desc);
+    if (dxf_lexer_open_desc(&desc, path, NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", path);
+        return -1;
+    }
+
+    while (dxf_lexer_get_token(&desc) == 0) {
+        if (desc.token.tag != DXF_BINARY_CHUNK) {
+            continue;
+        }
+        if ((desc.token.length > 127) || ((desc.token.length > 0) && (desc.token.value.bin == NULL))) {
+            printf("Binary chunk of %lu bytes in group %d. \n", (unsigned long)desc.token.length,
+                    desc.token.group_code);
+            dxf_lexer_close_desc(&desc, 1);
+            return -1;
+        }
+        ++(*number_of_chunks);
+    }
+
+    dxf_lexer_close_desc(&desc, 1);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    size_t number_of_chunks = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    if (check_decode() != 0) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    if (lex(argv[1], &number_of_chunks) != 0) {
+        return 1;
+    }
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        return 1;
+    }
+    dxf_init(&dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    if ((dxf.thumbnail != NULL)
+        && ((dxf.thumbnail_size < sizeof(png_signature))
+            || ((memcmp(dxf.thumbnail, bmp_signature, sizeof(bmp_signature)) != 0)
+                && (memcmp(dxf.thumbnail, png_signature, sizeof(png_signature)) != 0))))
+    {
+        printf("Thumbnail of %lu bytes is neither BMP nor PNG. \n", (unsigned long)dxf.thumbnail_size);
+        return 1;
+    }
+
+    printf("%lu binary chunks, thumbnail of %lu bytes. \n", (unsigned long)number_of_chunks,
+            (unsigned long)dxf.thumbnail_size);
+
+    dxf_free(&dxf);
+
+    return 0;
+}
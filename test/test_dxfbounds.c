@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfbounds.h"
+#include "dxfocs.h"
+
+#define SAMPLES 7200
+
+/* Bounds by sampling the curve densely, for comparison. */
+static void sample_arc(struct dxf_bounds* const bounds, const struct dxf_arc* const arc,
+                        double sweep)
+{
+    double p[3];
+    double a;
+    int i;
+
+    for (i = 0; i <= SAMPLES; ++i) {
+        a = (arc->angle_start + sweep * i / SAMPLES) * M_PI / 180.0;
+        p[0] = arc->x + arc->r * cos(a);
+        p[1] = arc->y + arc->r * sin(a);
+        p[2] = arc->z;
+        dxf_ocs_to_wcs(arc->extrusion, p, 1, 3);
+        dxf_bounds_add_point(bounds, p[0], p[1], p[2]);
+    }
+}
+
+static int close_to(const struct dxf_bounds* const a, const struct dxf_bounds* const b, double tol)
+{
+    int i;
+
+    for (i = 0; i < 2; ++i) {
+        if ((fabs(a->min[i] - b->min[i]) > tol) || (fabs(a->max[i] - b->max[i]) > tol)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_bounds bounds;
+    struct dxf_bounds expected;
+    struct dxf_bounds hint;
+    struct dxf_line *line = NULL;
+    struct dxf_arc *arc;
+    double sweep;
+    
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+    
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES);
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if ((entity->type == DXF_LINE) && !dxf_is_block_member(entity)) {
+            line = (struct dxf_line*)entity;
+        }
+        if (entity->type != DXF_ARC) {
+            continue;
+        }
+
+        arc = (struct dxf_arc*)entity;
+        sweep = fmod(arc->angle_end - arc->angle_start + 720.0, 360.0);
+        dxf_bounds_clear(&expected);
+        sample_arc(&expected, arc, (sweep == 0.0) ? 360.0 : sweep);
+        dxf_get_entity_bounds(&dxf, entity, &bounds);
+        if (!close_to(&bounds, &expected, arc->r * 1e-6)) {
+            printf("Arc bounds (%g, %g) - (%g, %g) are not tight. \n",
+                    bounds.min[0], bounds.min[1], bounds.max[0], bounds.max[1]);
+            return 1;
+        }
+    }
+
+    if (dxf_compute_bounds(&dxf, &bounds) != 0) {
+        printf("dxf_compute_bounds() failed. \n");
+        return 1;
+    }
+    printf("Document bounds (%g, %g, %g) - (%g, %g, %g) \n", bounds.min[0], bounds.min[1],
+            bounds.min[2], bounds.max[0], bounds.max[1], bounds.max[2]);
+
+    if (dxf_get_bounds_hint(&dxf, &hint) == 0) {
+        printf("Header hint (%g, %g) - (%g, %g) \n", hint.min[0], hint.min[1],
+                hint.max[0], hint.max[1]);
+    }
+
+    /* Moving a line past the extents must show after invalidation only. */
+    if (line != NULL) {
+        line->x2 = bounds.max[0] + 1000.0;
+        dxf_compute_bounds(&dxf, &expected);
+        if (expected.max[0] != bounds.max[0]) {
+            printf("Cached bounds changed without invalidation. \n");
+            return 1;
+        }
+
+        dxf_invalidate_bounds(&dxf, (struct dxf_entity*)line);
+        dxf_compute_bounds(&dxf, &expected);
+        if (expected.max[0] != line->x2) {
+            printf("Invalidated bounds were not recomputed. \n");
+            return 1;
+        }
+    }
+
+    dxf_free(&dxf);
+    
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfchain.h"
+
+#define TOLERANCE 0.001
+
+static double distance(const struct dxf_tess_vertex* const a, const struct dxf_tess_vertex* const b)
+{
+    return sqrt((a->x - b->x) * (a->x - b->x) + (a->y - b->y) * (a->y - b->y));
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_chains chains;
+    const struct dxf_chain *chain;
+    const struct dxf_tess_vertex *v;
+    const struct dxf_tess_vertex *u;
+    const struct dxf_tess_vertex *w;
+    size_t i;
+    size_t j;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    if (dxf_chain_build(&chains, &dxf, NULL, DXF_ALL_ENTITY_TYPES, TOLERANCE) != 0) {
+        printf("dxf_chain_build() failed. \n");
+        return 1;
+    }
+    dxf_chain_orient(&chains);
+
+    for (i = 0; i < chains.number_of_chains; ++i) {
+        chain = &(chains.chains[i]);
+        v = chains.vertices + chain->first_vertex;
+        if (i < 16) {
+            printf("Chain %lu: %lu pieces, %s, area %g, depth %d \n", (unsigned long)i,
+                    (unsigned long)chain->number_of_pieces, chain->closed ? "closed" : "open",
+                    chain->area, chain->depth);
+        }
+
+        if (chain->number_of_vertices == 0) {
+            continue;
+        }
+
+        if (chain->closed && (distance(&v[0], &v[chain->number_of_vertices - 1]) > TOLERANCE)) {
+            printf("Chain %lu does not close. \n", (unsigned long)i);
+            return 1;
+        }
+
+        if (chain->closed && ((chain->area < 0.0) != ((chain->depth & 1) != 0))) {
+            printf("Chain %lu is not oriented by depth. \n", (unsigned long)i);
+            return 1;
+        }
+
+        /* Free ends must have no free partner left within tolerance. */
+        if (!chain->closed) {
+            for (j = 0; j < chains.number_of_chains; ++j) {
+                if ((j == i) || chains.chains[j].closed || (chains.chains[j].number_of_vertices == 0)) {
+                    continue;
+                }
+                u = chains.vertices + chains.chains[j].first_vertex;
+                w = &u[chains.chains[j].number_of_vertices - 1];
+                if ((distance(&v[0], u) <= TOLERANCE) || (distance(&v[0], w) <= TOLERANCE)
+                    || (distance(&v[chain->number_of_vertices - 1], u) <= TOLERANCE)
+                    || (distance(&v[chain->number_of_vertices - 1], w) <= TOLERANCE))
+                {
+                    printf("Chains %lu and %lu should have been joined. \n",
+                            (unsigned long)i, (unsigned long)j);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    dxf_chain_free(&chains);
+    dxf_free(&dxf);
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfbounds.h"
+#include "dxfinsert.h"
+#include "dxfocs.h"
+
+static int parse(const char *path, struct dxf* const dxf, unsigned int flags)
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, path, NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", path);
+        return -1;
+    }
+
+    dxf_init(dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, dxf);
+    dxf_parser_set_flags(&parser_desc, flags);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    return 0;
+}
+
+static int same_bounds(const struct dxf_bounds* const a, const struct dxf_bounds* const b)
+{
+    return dxf_bounds_is_empty(a) ? dxf_bounds_is_empty(b)
+                                : (memcmp(a, b, sizeof(struct dxf_bounds)) == 0);
+}
+
+/* Reading only the block reference must render the same. */
+static int compare_dimensions(struct dxf* const dxf, const struct dxf_dimension* const a,
+                            struct dxf* const fast_dxf, const struct dxf_dimension* const b)
+{
+    struct dxf_bounds bounds;
+    struct dxf_bounds fast_bounds;
+
+    if (((a->insert.block_ref == NULL) != (b->insert.block_ref == NULL))
+        || ((a->insert.block_ref != NULL)
+            && (strcmp(a->insert.block_ref->name, b->insert.block_ref->name) != 0))
+        || (memcmp(a->insert.extrusion, b->insert.extrusion, sizeof(a->insert.extrusion)) != 0))
+    {
+        printf("Dimension %lu has a different block reference. \n", (unsigned long)a->insert.header.seq);
+        return -1;
+    }
+
+    if ((b->definition[0] != 0.0) || (b->type != 0) || (b->measurement != 0.0)) {
+        printf("Dimension %lu was read in full. \n", (unsigned long)b->insert.header.seq);
+        return -1;
+    }
+
+    if (a->insert.block_ref != NULL) {
+        dxf_get_entity_bounds(dxf, (const struct dxf_entity*)a, &bounds);
+        dxf_get_entity_bounds(fast_dxf, (const struct dxf_entity*)b, &fast_bounds);
+        if (!same_bounds(&bounds, &fast_bounds)) {
+            printf("Dimension %lu bounds differ. \n", (unsigned long)a->insert.header.seq);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Everything the block draws lies inside the dimension's bounds. */
+static int check_expansion(struct dxf* const dxf, const struct dxf_dimension* const dimension,
+                        size_t *count)
+{
+    struct dxf_insert_iter iter;
+    struct dxf_bounds bounds;
+    struct dxf_bounds entity_bounds;
+    const struct dxf_transform *transform;
+    struct dxf_entity *entity;
+    double p[3];
+    int i;
+
+    dxf_get_entity_bounds(dxf, (const struct dxf_entity*)dimension, &bounds);
+    dxf_insert_iter_init(&iter, &(dimension->insert));
+    while ((entity = dxf_insert_iter_next(&iter, &transform)) != NULL) {
+        ++(*count);
+        if ((entity->type != DXF_LINE) || (dxf_ocs_get_extrusion(entity) != NULL)) {
+            continue;
+        }
+        dxf_get_entity_bounds(dxf, entity, &entity_bounds);
+        for (i = 0; i < 2; ++i) {
+            p[0] = i ? entity_bounds.max[0] : entity_bounds.min[0];
+            p[1] = i ? entity_bounds.max[1] : entity_bounds.min[1];
+            p[2] = i ? entity_bounds.max[2] : entity_bounds.min[2];
+            dxf_transform_apply(transform, p, p);
+            if ((p[0] < bounds.min[0] - 1e-9) || (p[0] > bounds.max[0] + 1e-9)
+                || (p[1] < bounds.min[1] - 1e-9) || (p[1] > bounds.max[1] + 1e-9))
+            {
+                printf("Dimension %lu draws outside its bounds. \n",
+                        (unsigned long)dimension->insert.header.seq);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf fast_dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity_iter fast_iter;
+    struct dxf_entity *entity;
+    struct dxf_entity *other;
+    struct dxf_solid *solid;
+    struct dxf_bounds bounds;
+    size_t number_of_dimensions = 0;
+    size_t number_of_solids = 0;
+    size_t number_drawn = 0;
+    int i;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    if ((parse(argv[1], &dxf, DXF_PARSER_DEFAULT) != 0)
+        || (parse(argv[1], &fast_dxf, DXF_PARSER_DIMENSION_BLOCKS_ONLY) != 0))
+    {
+        return 1;
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_DIMENSION));
+    dxf_entity_iter_init(&fast_iter, &fast_dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_DIMENSION));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if (((other = dxf_entity_iter_next(&fast_iter)) == NULL)
+            || (compare_dimensions(&dxf, (struct dxf_dimension*)entity, &fast_dxf,
+                                (struct dxf_dimension*)other) != 0)
+            || (check_expansion(&dxf, (struct dxf_dimension*)entity, &number_drawn) != 0))
+        {
+            return 1;
+        }
+        ++number_of_dimensions;
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_SOLID));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        solid = (struct dxf_solid*)entity;
+        ++number_of_solids;
+        if (!dxf_ocs_is_identity(solid->extrusion)) {
+            continue;
+        }
+        dxf_get_entity_bounds(&dxf, entity, &bounds);
+        for (i = 0; i < 4; ++i) {
+            if ((solid->corners[i][0] < bounds.min[0]) || (solid->corners[i][0] > bounds.max[0])
+                || (solid->corners[i][1] < bounds.min[1]) || (solid->corners[i][1] > bounds.max[1]))
+            {
+                printf("Solid %lu corner %d is out of bounds. \n", (unsigned long)entity->seq, i);
+                return 1;
+            }
+        }
+    }
+
+    printf("%lu dimensions drawing %lu entities, %lu solids. \n", (unsigned long)number_of_dimensions,
+            (unsigned long)number_drawn, (unsigned long)number_of_solids);
+
+    dxf_free(&fast_dxf);
+    dxf_free(&dxf);
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfbounds.h"
+#include "dxftess.h"
+#include "dxfellipse.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TOLERANCE 0.01
+#define SAMPLES 4096
+#define MAX_VERTICES 65536
+
+/* Closed-form bounds must hold a dense sampling, and touch it. */
+static int check_bounds(struct dxf* const dxf, const struct dxf_ellipse* const ellipse)
+{
+    static double t[SAMPLES + 1];
+    static double points[3 * (SAMPLES + 1)];
+    struct dxf_bounds bounds;
+    struct dxf_bounds sampled;
+    double start;
+    double sweep;
+    double slack;
+    size_t i;
+    int j;
+
+    dxf_ellipse_get_sweep(ellipse, &start, &sweep);
+    for (i = 0; i <= SAMPLES; ++i) {
+        t[i] = start + sweep * i / SAMPLES;
+    }
+    dxf_ellipse_evaluate(ellipse, t, SAMPLES + 1, points);
+
+    dxf_bounds_clear(&sampled);
+    for (i = 0; i <= SAMPLES; ++i) {
+        dxf_bounds_add_point(&sampled, points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+    }
+
+    dxf_get_entity_bounds(dxf, (const struct dxf_entity*)ellipse, &bounds);
+    slack = sqrt(ellipse->major[0] * ellipse->major[0] + ellipse->major[1] * ellipse->major[1]
+                + ellipse->major[2] * ellipse->major[2]) * 1e-6;
+    for (j = 0; j < 3; ++j) {
+        if ((bounds.min[j] > sampled.min[j] + 1e-9) || (bounds.max[j] < sampled.max[j] - 1e-9)
+            || (sampled.min[j] - bounds.min[j] > slack) || (bounds.max[j] - sampled.max[j] > slack))
+        {
+            printf("Ellipse %lu bounds are not tight on axis %d. \n",
+                    (unsigned long)ellipse->header.seq, j);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* The curve at each segment's middle parameter stays near the chord. */
+static int check_chords(const struct dxf_ellipse* const ellipse)
+{
+    static struct dxf_tess_vertex vertices[MAX_VERTICES];
+    const struct dxf_tess_vertex *a;
+    const struct dxf_tess_vertex *b;
+    double start;
+    double sweep;
+    double t;
+    double p[3];
+    double d[3];
+    double u;
+    size_t n;
+    size_t i;
+
+    if ((dxf_tess_entity((const struct dxf_entity*)ellipse, TOLERANCE, vertices, MAX_VERTICES, &n) != 0)
+        || (n < 2))
+    {
+        printf("Ellipse %lu was not tessellated. \n", (unsigned long)ellipse->header.seq);
+        return -1;
+    }
+
+    dxf_ellipse_get_sweep(ellipse, &start, &sweep);
+    for (i = 1; i < n; ++i) {
+        a = &vertices[i - 1];
+        b = &vertices[i];
+        t = start + sweep * (i - 0.5) / (n - 1);
+        dxf_ellipse_evaluate(ellipse, &t, 1, p);
+
+        d[0] = b->x - a->x;
+        d[1] = b->y - a->y;
+        d[2] = b->z - a->z;
+        u = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+        u = (u > 0.0) ? ((p[0] - a->x) * d[0] + (p[1] - a->y) * d[1] + (p[2] - a->z) * d[2]) / u : 0.0;
+        p[0] -= a->x + u * d[0];
+        p[1] -= a->y + u * d[1];
+        p[2] -= a->z + u * d[2];
+        if (sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) > TOLERANCE * (1.0 + 1e-9)) {
+            printf("Ellipse %lu chord %lu is outside the tolerance. \n",
+                    (unsigned long)ellipse->header.seq, (unsigned long)i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_ellipse *ellipse;
+    double major[3];
+    double minor[3];
+    size_t number_of_ellipses = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_ELLIPSE));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        ++number_of_ellipses;
+        if ((check_bounds(&dxf, (struct dxf_ellipse*)entity) != 0)
+            || (check_chords((struct dxf_ellipse*)entity) != 0))
+        {
+            return 1;
+        }
+    }
+    printf("%lu ellipses. \n", (unsigned long)number_of_ellipses);
+
+    /* Half of a tilted ellipse. */
+    ellipse = (struct dxf_ellipse*)dxf_alloc_entity(&dxf, DXF_ELLIPSE);
+    ellipse->x = 1.0;
+    ellipse->y = -2.0;
+    ellipse->z = 3.0;
+    ellipse->major[0] = 4.0;
+    ellipse->major[1] = -4.0;
+    ellipse->major[2] = 0.0;
+    ellipse->extrusion[0] = ellipse->extrusion[1] = ellipse->extrusion[2] = 1.0;
+    ellipse->ratio = 0.25;
+    ellipse->param_start = 0.3;
+    ellipse->param_end = 0.3 + M_PI;
+
+    dxf_ellipse_get_axes(ellipse, major, minor);
+    if ((fabs(major[0] * minor[0] + major[1] * minor[1] + major[2] * minor[2]) > 1e-12)
+        || (fabs(sqrt(minor[0] * minor[0] + minor[1] * minor[1] + minor[2] * minor[2])
+                - 0.25 * sqrt(32.0)) > 1e-12))
+    {
+        printf("Minor axis is wrong. \n");
+        return 1;
+    }
+
+    if ((check_bounds(&dxf, ellipse) != 0) || (check_chords(ellipse) != 0)) {
+        return 1;
+    }
+
+    dxf_free(&dxf);
+
+    return 0;
+}
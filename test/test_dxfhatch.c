@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfbounds.h"
+
+/* Loops tile the vertex and edge arrays in order; edges and pattern lines
+ * index inside theirs.
+ */
+static int check_hatch(const struct dxf_hatch* const hatch)
+{
+    const struct dxf_hatch_loop *loop;
+    const struct dxf_hatch_edge *edge;
+    const struct dxf_hatch_pattern_line *line;
+    size_t next_vertex = 0;
+    size_t next_edge = 0;
+    size_t i;
+
+    for (i = 0; i < hatch->number_of_loops; ++i) {
+        loop = &(hatch->loops[i]);
+        if (loop->flag & DXF_HATCH_LOOP_FLAG_POLYLINE) {
+            if (loop->first != next_vertex) {
+                break;
+            }
+            next_vertex += loop->count;
+        }
+        else {
+            if (loop->first != next_edge) {
+                break;
+            }
+            next_edge += loop->count;
+        }
+    }
+    if ((i < hatch->number_of_loops) || (next_vertex != hatch->number_of_vertices)
+        || (next_edge != hatch->number_of_edges))
+    {
+        printf("Hatch %lu loops do not cover its boundaries. \n", (unsigned long)hatch->header.seq);
+        return -1;
+    }
+
+    for (i = 0; i < hatch->number_of_edges; ++i) {
+        edge = &(hatch->edges[i]);
+        if ((edge->type == DXF_HATCH_EDGE_SPLINE)
+            && ((edge->first_knot + edge->number_of_knots > hatch->number_of_knots)
+                || (edge->first_control_point + edge->number_of_control_points
+                    > hatch->number_of_control_points)
+                || (edge->number_of_knots != edge->number_of_control_points + edge->degree + 1)))
+        {
+            printf("Hatch %lu spline edge %lu is inconsistent. \n", (unsigned long)hatch->header.seq,
+                    (unsigned long)i);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < hatch->number_of_pattern_lines; ++i) {
+        line = &(hatch->pattern_lines[i]);
+        if (line->first_dash + line->number_of_dashes > hatch->number_of_dashes) {
+            printf("Hatch %lu pattern line %lu is out of range. \n", (unsigned long)hatch->header.seq,
+                    (unsigned long)i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Skipping the pattern must leave everything else as it was. */
+static int compare_hatches(const struct dxf_hatch* const a, const struct dxf_hatch* const b)
+{
+    if ((b->number_of_pattern_lines != 0) || (b->number_of_dashes != 0)) {
+        printf("Hatch %lu pattern was not skipped. \n", (unsigned long)b->header.seq);
+        return -1;
+    }
+
+    if ((a->number_of_loops != b->number_of_loops) || (a->number_of_edges != b->number_of_edges)
+        || (a->number_of_vertices != b->number_of_vertices) || (a->number_of_knots != b->number_of_knots)
+        || (a->number_of_control_points != b->number_of_control_points)
+        || (a->number_of_seeds != b->number_of_seeds) || (a->style != b->style)
+        || (a->pattern_scale != b->pattern_scale)
+        || ((a->number_of_vertices > 0)
+            && (memcmp(a->vertices, b->vertices, a->number_of_vertices * sizeof(struct dxf_hatch_vertex)) != 0))
+        || ((a->number_of_seeds > 0)
+            && (memcmp(a->seeds, b->seeds, 2 * a->number_of_seeds * sizeof(double)) != 0)))
+    {
+        printf("Hatch %lu differs when its pattern is skipped. \n", (unsigned long)a->header.seq);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parse(const char *path, struct dxf* const dxf, unsigned int flags)
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, path, NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", path);
+        return -1;
+    }
+
+    dxf_init(dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, dxf);
+    dxf_parser_set_flags(&parser_desc, flags);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf skipped;
+    struct dxf_entity_iter iter;
+    struct dxf_entity_iter skipped_iter;
+    struct dxf_entity *entity;
+    struct dxf_entity *other;
+    struct dxf_hatch *hatch;
+    struct dxf_bounds bounds;
+    size_t number_of_hatches = 0;
+    size_t number_of_loops = 0;
+    size_t number_of_pattern_lines = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    if ((parse(argv[1], &dxf, DXF_PARSER_DEFAULT) != 0)
+        || (parse(argv[1], &skipped, DXF_PARSER_SKIP_HATCH_PATTERNS) != 0))
+    {
+        return 1;
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_HATCH));
+    dxf_entity_iter_init(&skipped_iter, &skipped, NULL, DXF_ENTITY_TYPE_BIT(DXF_HATCH));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        hatch = (struct dxf_hatch*)entity;
+        if ((check_hatch(hatch) != 0)
+            || ((other = dxf_entity_iter_next(&skipped_iter)) == NULL)
+            || (compare_hatches(hatch, (struct dxf_hatch*)other) != 0))
+        {
+            return 1;
+        }
+
+        dxf_get_entity_bounds(&dxf, entity, &bounds);
+        if ((hatch->number_of_loops > 0) && dxf_bounds_is_empty(&bounds)) {
+            printf("Hatch %lu has empty bounds. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+
+        ++number_of_hatches;
+        number_of_loops += hatch->number_of_loops;
+        number_of_pattern_lines += hatch->number_of_pattern_lines;
+    }
+    if (dxf_entity_iter_next(&skipped_iter) != NULL) {
+        printf("Skipping patterns changed the number of hatches. \n");
+        return 1;
+    }
+
+    printf("%lu hatches, %lu loops, %lu pattern lines. \n", (unsigned long)number_of_hatches,
+            (unsigned long)number_of_loops, (unsigned long)number_of_pattern_lines);
+
+    dxf_free(&skipped);
+    dxf_free(&dxf);
+
+    return 0;
+}
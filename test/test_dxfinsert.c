@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfinsert.h"
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_insert_iter insert_iter;
+    struct dxf_insert *insert;
+    struct dxf_entity *entity;
+    struct dxf_line *line;
+    struct dxf_transform expected;
+    const struct dxf_transform *transform;
+    double p[3];
+    double q[3];
+    size_t expanded = 0;
+    size_t per_instance;
+    int type;
+    
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+    
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_INSERT));
+    while ((insert = (struct dxf_insert*)dxf_entity_iter_next(&iter)) != NULL) {
+        if (insert->block_ref == NULL) {
+            continue;
+        }
+
+        per_instance = 0;
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            for (entity = insert->block_ref->entities[type]; entity != NULL; entity = entity->next_in_block) {
+                ++per_instance;
+            }
+        }
+
+        expanded = 0;
+        dxf_insert_iter_init(&insert_iter, insert);
+        while ((entity = dxf_insert_iter_next(&insert_iter, &transform)) != NULL) {
+            ++expanded;
+            if ((entity->type != DXF_LINE) || (insert_iter.depth != 1)) {
+                continue;
+            }
+
+            /* Checks the streamed transform against one built from scratch. */
+            line = (struct dxf_line*)entity;
+            dxf_insert_get_transform(insert, NULL, insert_iter.frames[0].column,
+                                    insert_iter.frames[0].row, &expected);
+            p[0] = line->x2;
+            p[1] = line->y2;
+            p[2] = line->z2;
+            dxf_transform_apply(transform, p, q);
+            dxf_transform_apply(&expected, p, p);
+            if ((fabs(p[0] - q[0]) > 1e-9) || (fabs(p[1] - q[1]) > 1e-9)) {
+                printf("Cell transform mismatch. \n");
+                return 1;
+            }
+            printf("Line end (%g, %g) \n", q[0], q[1]);
+        }
+
+        if ((insert->block_ref->entities[DXF_INSERT] == NULL)
+            && (expanded != per_instance * insert->column_count * insert->row_count)) {
+            printf("Expanded %lu entities, expected %lu. \n", (unsigned long)expanded,
+                    (unsigned long)(per_instance * insert->column_count * insert->row_count));
+            return 1;
+        }
+        printf("INSERT of %s expanded to %lu entities. \n", insert->block_ref->name,
+                (unsigned long)expanded);
+    }
+
+    dxf_free(&dxf);
+    
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+
+static int parse(const char *path, struct dxf* const dxf, unsigned int flags)
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, path, NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", path);
+        return -1;
+    }
+
+    dxf_init(dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, dxf);
+    dxf_parser_set_flags(&parser_desc, flags);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    return 0;
+}
+
+/* Every layer is found by name, through the index when there is one. */
+static int check_layers(struct dxf* const dxf, size_t *number_hidden)
+{
+    struct dxf_layer *layer;
+    size_t count = 0;
+
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        dxf->last_accessed_layer = dxf->layers;
+        if (dxf_get_layer(dxf, layer->name) != layer) {
+            printf("Layer %s is not found by name. \n", layer->name);
+            return -1;
+        }
+        if (dxf_layer_is_hidden(layer)) {
+            ++(*number_hidden);
+        }
+        ++count;
+    }
+
+    if ((dxf->layer_index != NULL) && (2 * count > dxf->layer_index_size)) {
+        printf("Layer index of %lu holds %lu layers. \n", (unsigned long)dxf->layer_index_size,
+                (unsigned long)count);
+        return -1;
+    }
+
+    return 0;
+}
+
+static size_t count_inserts(struct dxf* const dxf)
+{
+    struct dxf_entity_iter iter;
+    size_t count = 0;
+
+    dxf_entity_iter_init(&iter, dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_INSERT));
+    while (dxf_entity_iter_next(&iter) != NULL) {
+        ++count;
+    }
+    return count;
+}
+
+/* INSERTs are filed under their block's layer, so one on a hidden layer
+ * of its own is checked with a drawing written here.
+ */
+static int check_hidden_insert(const char *path)
+{
+    static const char *lines[] = {
+        "0", "SECTION", "2", "TABLES", "0", "TABLE", "2", "LAYER",
+        "0", "LAYER", "2", "Off", "70", "0", "62", "-1", "6", "CONTINUOUS",
+        "0", "ENDTAB", "0", "ENDSEC",
+        "0", "SECTION", "2", "BLOCKS",
+        "0", "BLOCK", "8", "0", "2", "B", "70", "0", "10", "0", "20", "0", "30", "0",
+        "0", "POINT", "8", "0", "10", "1", "20", "1", "30", "0",
+        "0", "ENDBLK", "8", "0", "0", "ENDSEC",
+        "0", "SECTION", "2", "ENTITIES",
+        "0", "INSERT", "8", "Off", "2", "B", "10", "5", "20", "5", "30", "0",
+        "0", "INSERT", "8", "0", "2", "B", "10", "7", "20", "7", "30", "0",
+        "0", "ENDSEC", "0", "EOF"
+    };
+    struct dxf dxf;
+    struct dxf shown;
+    char insert_path[256];
+    size_t all;
+    size_t kept;
+    size_t i;
+    FILE *fp;
+
+    sprintf(insert_path, "%.200s.insert.dxf", path);
+    if ((fp = fopen(insert_path, "w")) == NULL) {
+        printf("Failed to write %s. \n", insert_path);
+        return -1;
+    }
+    for (i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+        fprintf(fp, "%s\n", lines[i]);
+    }
+    fclose(fp);
+
+    if ((parse(insert_path, &dxf, DXF_PARSER_DEFAULT) != 0)
+        || (parse(insert_path, &shown, DXF_PARSER_SKIP_HIDDEN_LAYERS) != 0))
+    {
+        remove(insert_path);
+        return -1;
+    }
+    remove(insert_path);
+
+    all = count_inserts(&dxf);
+    kept = count_inserts(&shown);
+    dxf_free(&shown);
+    dxf_free(&dxf);
+
+    if ((all != 2) || (kept != 1)) {
+        printf("%lu of %lu INSERTs kept, one is on a hidden layer. \n", (unsigned long)kept,
+                (unsigned long)all);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf shown;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    size_t number_hidden = 0;
+    size_t number_of_entities = 0;
+    size_t number_to_drop = 0;
+    size_t number_shown = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    if ((parse(argv[1], &dxf, DXF_PARSER_DEFAULT) != 0)
+        || (parse(argv[1], &shown, DXF_PARSER_SKIP_HIDDEN_LAYERS) != 0))
+    {
+        return 1;
+    }
+
+    if (check_layers(&dxf, &number_hidden) != 0) {
+        return 1;
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES & ~DXF_ENTITY_TYPE_BIT(DXF_INSERT));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if ((entity->block == NULL) && (entity->layer != NULL) && dxf_layer_is_hidden(entity->layer)) {
+            ++number_to_drop;
+        }
+        ++number_of_entities;
+    }
+
+    /* Block contents are kept whatever their layer. */
+    dxf_entity_iter_init(&iter, &shown, NULL, DXF_ALL_ENTITY_TYPES & ~DXF_ENTITY_TYPE_BIT(DXF_INSERT));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if ((entity->block == NULL) && (entity->layer != NULL) && dxf_layer_is_hidden(entity->layer)) {
+            printf("Entity %lu on hidden layer %s was kept. \n", (unsigned long)entity->seq,
+                    entity->layer->name);
+            return 1;
+        }
+        ++number_shown;
+    }
+    if (number_shown + number_to_drop != number_of_entities) {
+        printf("%lu entities kept of %lu, %lu on hidden layers. \n", (unsigned long)number_shown,
+                (unsigned long)number_of_entities, (unsigned long)number_to_drop);
+        return 1;
+    }
+
+    if (check_hidden_insert(argv[1]) != 0) {
+        return 1;
+    }
+
+    printf("%lu layers hidden, %lu of %lu entities dropped. \n", (unsigned long)number_hidden,
+            (unsigned long)number_to_drop, (unsigned long)number_of_entities);
+
+    dxf_free(&shown);
+    dxf_free(&dxf);
+
+    return 0;
+}
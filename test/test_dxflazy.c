@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxflazy.h"
+#include "dxfbounds.h"
+
+/* Reverse access must still leave the lists in file order, and entries
+ * that gave no entity must not be parsed again.
+ */
+static int check_file_order(struct dxf* const dxf, const struct dxf_lazy* const lazy)
+{
+    struct dxf_layer *layer;
+    struct dxf_entity *entity;
+    size_t seq = 0;
+    size_t i = 0;
+    int type;
+
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        if (entity->seq <= seq) {
+            printf("Entity %lu follows %lu in the file list. \n", (unsigned long)entity->seq,
+                    (unsigned long)seq);
+            return -1;
+        }
+        seq = entity->seq;
+        if (entity->next_in_file == NULL) {
+            break;
+        }
+    }
+    if (entity != dxf->last_entity) {
+        printf("File list does not end at the last entity. \n");
+        return -1;
+    }
+
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            seq = 0;
+            for (entity = layer->entities[type]; entity != NULL; entity = entity->next) {
+                if ((entity->seq <= seq) || ((entity->next == NULL) && (entity != layer->entities_tail[type]))) {
+                    printf("Layer %s is out of file order. \n", layer->name);
+                    return -1;
+                }
+                seq = entity->seq;
+            }
+        }
+    }
+
+    for (i = 0; i < lazy->number_of_entries; ++i) {
+        if ((lazy->entries[i].type >= 0) && !lazy->entries[i].parsed) {
+            printf("Entry %lu is not marked as parsed. \n", (unsigned long)i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf dxf_lazy;
+    struct dxf_lazy lazy;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_entity *lazy_entity;
+    size_t parsed = 0;
+    size_t inserts = 0;
+    size_t i;
+    
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+
+    /* Reference: a full parse. */
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+    dxf_init(&dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        return 1;
+    }
+    dxf_init(&dxf_lazy, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf_lazy);
+    if (dxf_lazy_open(&lazy, &parser_desc) != 0) {
+        printf("dxf_lazy_open() failed. \n");
+        return 1;
+    }
+
+    printf("Indexed %lu entities, %lu parsed on open. \n",
+            (unsigned long)lazy.number_of_entries, (unsigned long)dxf_lazy.number_of_entities);
+
+    /* Every other entity first, so that the rest land between parsed
+     * ones, then in reverse so that every entity needs a seek.
+     */
+    for (i = 1; i < lazy.number_of_entries; i += 2) {
+        if (dxf_lazy_get_entity(&lazy, i) != NULL) {
+            ++parsed;
+        }
+    }
+    for (i = lazy.number_of_entries; i > 0; --i) {
+        if ((i % 2) == 0) {
+            continue;
+        }
+        if (dxf_lazy_get_entity(&lazy, i - 1) != NULL) {
+            ++parsed;
+        }
+    }
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES);
+    i = 0;
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        /* Block members, nested INSERTs included, were parsed on open.
+         * A full parse files INSERTs of blocks defined later only once
+         * the reference is resolved, so INSERTs are counted, not matched.
+         */
+        if (dxf_is_block_member(entity)) {
+            continue;
+        }
+        if (entity->type == DXF_INSERT) {
+            ++inserts;
+            continue;
+        }
+        while ((i < lazy.number_of_entries) && ((lazy.entries[i].entity == NULL)
+                || (lazy.entries[i].entity->type == DXF_INSERT))) {
+            ++i;
+        }
+        if (i == lazy.number_of_entries) {
+            printf("Lazy document is missing entities. \n");
+            return 1;
+        }
+        lazy_entity = lazy.entries[i++].entity;
+        if ((lazy_entity->type != entity->type)
+            || (strcmp(lazy_entity->layer->name, entity->layer->name) != 0)
+            || ((entity->type == DXF_LINE)
+                && (((struct dxf_line*)lazy_entity)->x2 != ((struct dxf_line*)entity)->x2))
+            || ((entity->type == DXF_CIRCLE)
+                && (((struct dxf_circle*)lazy_entity)->r != ((struct dxf_circle*)entity)->r)))
+        {
+            printf("Entity %lu differs from a full parse. \n", (unsigned long)(i - 1));
+            return 1;
+        }
+    }
+
+    for (i = 0; i < lazy.number_of_entries; ++i) {
+        if ((lazy.entries[i].entity != NULL) && (lazy.entries[i].entity->type == DXF_INSERT)
+            && (inserts-- == 0)) {
+            break;
+        }
+    }
+    if ((i < lazy.number_of_entries) || (inserts != 0)) {
+        printf("Lazy document has a different number of INSERTs. \n");
+        return 1;
+    }
+
+    if (check_file_order(&dxf_lazy, &lazy) != 0) {
+        return 1;
+    }
+
+    printf("%lu entities parsed on access and matched. \n", (unsigned long)parsed);
+
+    dxf_lazy_close(&lazy);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+    dxf_free(&dxf_lazy);
+    dxf_free(&dxf);
+    
+    return 0;
+}
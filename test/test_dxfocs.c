@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfinsert.h"
+#include "dxftess.h"
+#include "dxfocs.h"
+
+#define TOLERANCE 0.01
+#define MAX_VERTICES 4096
+
+static int near(double a, double b)
+{
+    return fabs(a - b) < 1e-9;
+}
+
+static int check_axes(const double extrusion[3], const double ax[3], const double ay[3])
+{
+    struct dxf_transform transform;
+    int i;
+
+    dxf_ocs_get_transform(extrusion, &transform);
+    for (i = 0; i < 3; ++i) {
+        if (!near(transform.m[i][0], ax[i]) || !near(transform.m[i][1], ay[i])) {
+            printf("Wrong OCS axes for (%g, %g, %g). \n", extrusion[0], extrusion[1], extrusion[2]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Tessellating through the OCS and after rewriting in place must agree.
+ * Mirroring reverses the direction of arcs, and circles start elsewhere.
+ */
+static int check_rewrite(struct dxf_entity *entity)
+{
+    const struct dxf_circle *circle = (const struct dxf_circle*)entity;
+    const struct dxf_tess_vertex *v;
+    static struct dxf_tess_vertex before[MAX_VERTICES];
+    static struct dxf_tess_vertex after[MAX_VERTICES];
+    size_t n;
+    size_t m;
+    size_t i;
+
+    if ((dxf_tess_entity(entity, TOLERANCE, before, MAX_VERTICES, &n) != 0)
+        || (dxf_ocs_entities_to_wcs(&entity, 1) != 0)
+        || (dxf_tess_entity(entity, TOLERANCE, after, MAX_VERTICES, &m) != 0)
+        || (n != m))
+    {
+        printf("Entity type %d could not be rewritten. \n", entity->type);
+        return -1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        v = (entity->type == DXF_ARC) ? &after[n - 1 - i] : &after[i];
+        if (entity->type == DXF_CIRCLE) {
+            if (!near(sqrt((before[i].x - circle->x) * (before[i].x - circle->x)
+                        + (before[i].y - circle->y) * (before[i].y - circle->y)), circle->r)) {
+                printf("Mirrored circle moved when rewritten. \n");
+                return -1;
+            }
+            continue;
+        }
+
+        if (!near(before[i].x, v->x) || !near(before[i].y, v->y) || !near(before[i].z, v->z)) {
+            printf("Entity type %d moved when rewritten. \n", entity->type);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const double down[3] = { 0.0, 0.0, -1.0 };
+    static const double side[3] = { 2.0, 0.0, 0.0 };
+    static const double minus_x[3] = { -1.0, 0.0, 0.0 };
+    static const double y[3] = { 0.0, 1.0, 0.0 };
+    static const double z[3] = { 0.0, 0.0, 1.0 };
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_circle *circle;
+    struct dxf_arc *arc;
+    struct dxf_lwpolyline *lwpolyline;
+    struct dxf_lwpolyline_vertex *vertices;
+    struct dxf_insert *insert = NULL;
+    struct dxf_text *text;
+    struct dxf_transform before;
+    struct dxf_transform after;
+    const double *extrusion;
+    size_t tilted = 0;
+    int i;
+    int j;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES);
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        if (((extrusion = dxf_ocs_get_extrusion(entity)) != NULL) && !dxf_ocs_is_identity(extrusion)) {
+            ++tilted;
+        }
+        if ((entity->type == DXF_INSERT) && (((struct dxf_insert*)entity)->block_ref != NULL)) {
+            insert = (struct dxf_insert*)entity;
+        }
+    }
+    printf("%lu entities outside the world XY plane. \n", (unsigned long)tilted);
+
+    if ((check_axes(down, minus_x, y) != 0) || (check_axes(side, y, z) != 0)) {
+        return 1;
+    }
+
+    /* Mirrored copies of each kind of entity. */
+    circle = (struct dxf_circle*)dxf_alloc_entity(&dxf, DXF_CIRCLE);
+    circle->x = 3.0;
+    circle->y = 4.0;
+    circle->r = 2.0;
+    circle->extrusion[2] = -1.0;
+
+    arc = (struct dxf_arc*)dxf_alloc_entity(&dxf, DXF_ARC);
+    arc->x = -1.0;
+    arc->y = 2.0;
+    arc->r = 5.0;
+    arc->angle_start = 10.0;
+    arc->angle_end = 100.0;
+    arc->extrusion[2] = -1.0;
+
+    lwpolyline = (struct dxf_lwpolyline*)dxf_alloc_entity(&dxf, DXF_LWPOLYLINE);
+    vertices = (struct dxf_lwpolyline_vertex*)dxf_alloc_binary(&dxf,
+                                        3 * sizeof(struct dxf_lwpolyline_vertex));
+    for (i = 0; i < 3; ++i) {
+        vertices[i].x = i * 4.0;
+        vertices[i].y = (i == 1) ? 3.0 : 0.0;
+        vertices[i].z = 0.0;
+        vertices[i].bulge = (i == 0) ? 0.5 : 0.0;
+        vertices[i].next = (i < 2) ? &vertices[i + 1] : NULL;
+    }
+    lwpolyline->vertices = vertices;
+    lwpolyline->number_of_vertices = 3;
+    lwpolyline->extrusion[2] = -1.0;
+
+    if ((check_rewrite((struct dxf_entity*)circle) != 0)
+        || (check_rewrite((struct dxf_entity*)arc) != 0)
+        || (check_rewrite((struct dxf_entity*)lwpolyline) != 0))
+    {
+        return 1;
+    }
+
+    /* A mirrored TEXT keeps its place and reads backward. */
+    text = (struct dxf_text*)dxf_alloc_entity(&dxf, DXF_TEXTSTRING);
+    text->x = 2.0;
+    text->y = 1.0;
+    text->angle = 30.0;
+    text->extrusion[2] = -1.0;
+    entity = (struct dxf_entity*)text;
+    if ((dxf_ocs_entities_to_wcs(&entity, 1) != 0) || !near(text->x, -2.0) || !near(text->y, 1.0)
+        || !near(text->angle, -30.0) || !(text->generation & 2) || (text->extrusion[2] != 1.0))
+    {
+        printf("Mirrored TEXT was not rewritten. \n");
+        return 1;
+    }
+
+    if (insert != NULL) {
+        insert->extrusion[2] = -1.0;
+        dxf_insert_get_transform(insert, NULL, 1, 1, &before);
+        entity = (struct dxf_entity*)insert;
+        dxf_ocs_entities_to_wcs(&entity, 1);
+        dxf_insert_get_transform(insert, NULL, 1, 1, &after);
+        for (i = 0; i < 3; ++i) {
+            for (j = 0; j < 4; ++j) {
+                if (!near(before.m[i][j], after.m[i][j])) {
+                    printf("Mirrored INSERT moved when rewritten. \n");
+                    return 1;
+                }
+            }
+        }
+    }
+
+    dxf_free(&dxf);
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxftess.h"
+
+#define TOLERANCE 0.01
+
+/* Face indices must name existing vertices; announced sizes must match. */
+static int check_polyline(const struct dxf_polyline* const polyline)
+{
+    const struct dxf_polyline_face *face;
+    size_t i;
+    int j;
+    int index;
+
+    if ((polyline->number_of_vertices > 0) && (polyline->vertices == NULL)) {
+        printf("Polyline %lu has no vertex array. \n", (unsigned long)polyline->header.seq);
+        return -1;
+    }
+
+    if (polyline->flag & DXF_POLYLINE_FLAG_POLYFACE) {
+        if ((polyline->m_count != (int)polyline->number_of_vertices)
+            || (polyline->n_count != (int)polyline->number_of_faces))
+        {
+            printf("Polyface %lu has %lu vertices and %lu faces, %d and %d announced. \n",
+                    (unsigned long)polyline->header.seq, (unsigned long)polyline->number_of_vertices,
+                    (unsigned long)polyline->number_of_faces, polyline->m_count, polyline->n_count);
+            return -1;
+        }
+
+        for (i = 0; i < polyline->number_of_faces; ++i) {
+            face = &(polyline->faces[i]);
+            for (j = 0; j < 4; ++j) {
+                index = abs(face->vertices[j]);
+                if ((index > (int)polyline->number_of_vertices) || ((j < 3) && (index == 0))) {
+                    printf("Polyface %lu face %lu has a bad index. \n",
+                            (unsigned long)polyline->header.seq, (unsigned long)i);
+                    return -1;
+                }
+            }
+        }
+    }
+    else if (polyline->flag & DXF_POLYLINE_FLAG_MESH) {
+        if (polyline->m_count * polyline->n_count != (int)polyline->number_of_vertices) {
+            printf("Mesh %lu is not %d x %d. \n", (unsigned long)polyline->header.seq,
+                    polyline->m_count, polyline->n_count);
+            return -1;
+        }
+    }
+    else if (!(polyline->flag & DXF_POLYLINE_FLAG_3D)) {
+        for (i = 0; i < polyline->number_of_vertices; ++i) {
+            if (polyline->vertices[i].z != polyline->elevation) {
+                printf("2D polyline %lu vertex %lu is off its elevation. \n",
+                        (unsigned long)polyline->header.seq, (unsigned long)i);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_stats stats;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_polyline *polyline;
+    struct dxf_tess_vertex *vertices;
+    size_t number_of_polylines = 0;
+    size_t number_of_vertices = 0;
+    size_t number_of_faces = 0;
+    size_t count;
+    size_t written;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_POLYLINE));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        polyline = (struct dxf_polyline*)entity;
+        if (check_polyline(polyline) != 0) {
+            return 1;
+        }
+
+        count = dxf_tess_count(entity, TOLERANCE);
+        if ((vertices = (struct dxf_tess_vertex*)malloc((count + 1) * sizeof(struct dxf_tess_vertex))) == NULL) {
+            return 1;
+        }
+        if ((dxf_tess_entity(entity, TOLERANCE, vertices, count, &written) != 0) || (written != count)) {
+            printf("Polyline %lu tessellated to a different count. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+        free(vertices);
+
+        ++number_of_polylines;
+        number_of_vertices += polyline->number_of_vertices;
+        number_of_faces += polyline->number_of_faces;
+    }
+
+    dxf_get_stats(&dxf, &stats);
+    printf("%lu polylines, %lu vertices, %lu faces, %lu binary bytes, %lu in vertices. \n",
+            (unsigned long)number_of_polylines, (unsigned long)number_of_vertices,
+            (unsigned long)number_of_faces, (unsigned long)stats.binary_bytes,
+            (unsigned long)stats.vertex_bytes);
+
+    if ((stats.vertex_bytes < number_of_vertices * sizeof(struct dxf_polyline_vertex))
+        || (stats.vertex_bytes > stats.binary_bytes)) {
+        printf("Vertex bytes are not accounted for. \n");
+        return 1;
+    }
+
+    if (stats.entity_counts[DXF_VERTEX] != 0) {
+        printf("Vertices were allocated as entities. \n");
+        return 1;
+    }
+
+    dxf_free(&dxf);
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfbounds.h"
+#include "dxfrtree.h"
+
+#define QUERIES 64
+#define NEIGHBOURS 5
+
+static int count_visit(struct dxf_entity *entity, unsigned int seq, void *user_data)
+{
+    if ((entity == NULL) || (entity->seq != seq)) {
+        ++*(size_t*)user_data;
+    }
+    return 0;
+}
+
+static double box_distance(const struct dxf_bounds* const b, double x, double y)
+{
+    double dx = (x < b->min[0]) ? b->min[0] - x : (x > b->max[0]) ? x - b->max[0] : 0.0;
+    double dy = (y < b->min[1]) ? b->min[1] - y : (y > b->max[1]) ? y - b->max[1] : 0.0;
+
+    return sqrt(dx * dx + dy * dy);
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_rtree tree;
+    struct dxf_rtree mapped;
+    struct dxf_rtree rebuilt;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_bounds bounds;
+    struct dxf_bounds document;
+    struct dxf_rtree_neighbour neighbours[NEIGHBOURS];
+    double x;
+    double y;
+    double w;
+    double kth;
+    size_t closer;
+    size_t nearer;
+    size_t expected;
+    size_t found;
+    size_t bad = 0;
+    int q;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    if (dxf_rtree_build(&tree, &dxf, NULL, DXF_ALL_ENTITY_TYPES) != 0) {
+        printf("dxf_rtree_build() failed. \n");
+        return 1;
+    }
+    printf("%lu items in %d levels. \n", (unsigned long)tree.number_of_items, tree.number_of_levels);
+
+    dxf_rtree_init_static(&mapped, tree.boxes, tree.indices, tree.number_of_items);
+    if (dxf_rtree_build_boxes(&rebuilt, tree.boxes, tree.indices, tree.number_of_items) != 0) {
+        printf("dxf_rtree_build_boxes() failed. \n");
+        return 1;
+    }
+    dxf_compute_bounds(&dxf, &document);
+    srand(1);
+
+    /* Every query must agree with a linear scan. */
+    for (q = 0; q < QUERIES; ++q) {
+        x = document.min[0] + (document.max[0] - document.min[0]) * rand() / RAND_MAX;
+        y = document.min[1] + (document.max[1] - document.min[1]) * rand() / RAND_MAX;
+        w = (document.max[0] - document.min[0]) * 0.1 * rand() / RAND_MAX;
+
+        found = dxf_rtree_nearest(&tree, x, y, NEIGHBOURS, neighbours);
+        kth = (found > 0) ? neighbours[found - 1].distance : 0.0;
+
+        expected = 0;
+        closer = 0;
+        nearer = 0;
+        dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ALL_ENTITY_TYPES);
+        while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+            if (dxf_is_block_member(entity) || (dxf_get_entity_bounds(&dxf, entity, &bounds) != 0)
+                || dxf_bounds_is_empty(&bounds))
+            {
+                continue;
+            }
+            expected += (bounds.max[0] >= x) && (bounds.min[0] <= x + w)
+                        && (bounds.max[1] >= y) && (bounds.min[1] <= y + w);
+            closer += box_distance(&bounds, x, y) <= w;
+            nearer += box_distance(&bounds, x, y) < kth;
+        }
+
+        if (dxf_rtree_search(&tree, x, y, x + w, y + w, count_visit, &bad) != expected) {
+            printf("Rectangle query %d disagrees with a linear scan. \n", q);
+            return 1;
+        }
+        if (dxf_rtree_search(&mapped, x, y, x + w, y + w, NULL, NULL) != expected) {
+            printf("Rectangle query %d disagrees on the static tree. \n", q);
+            return 1;
+        }
+        if (dxf_rtree_search(&rebuilt, x, y, x + w, y + w, NULL, NULL) != expected) {
+            printf("Rectangle query %d disagrees on the tree built from boxes. \n", q);
+            return 1;
+        }
+        if (dxf_rtree_search_radius(&tree, x, y, w, NULL, NULL) != closer) {
+            printf("Radius query %d disagrees with a linear scan. \n", q);
+            return 1;
+        }
+
+        if ((found < NEIGHBOURS) && (found != tree.number_of_items)) {
+            printf("Nearest query %d returned too few items. \n", q);
+            return 1;
+        }
+        if ((found > 0) && (nearer >= found)) {
+            printf("Nearest query %d missed closer items. \n", q);
+            return 1;
+        }
+        for (; found > 1; --found) {
+            if (neighbours[found - 1].distance < neighbours[found - 2].distance) {
+                printf("Nearest query %d is out of order. \n", q);
+                return 1;
+            }
+        }
+    }
+
+    if (bad != 0) {
+        printf("%lu visited items did not match their entity. \n", (unsigned long)bad);
+        return 1;
+    }
+
+    dxf_rtree_free(&rebuilt);
+    dxf_rtree_free(&tree);
+    dxf_free(&dxf);
+
+    return 0;
+}
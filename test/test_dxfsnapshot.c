@@ -0,0 +1,487 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfsnapshot.h"
+#include "dxftext.h"
+#include "dxfxdata.h"
+
+static int same_block(struct dxf_snapshot *snapshot, unsigned int index, const struct dxf_block *block)
+{
+    const struct dxf_snapshot_container *blocks;
+    size_t number_of_blocks;
+
+    blocks = dxf_snapshot_get_blocks(snapshot, &number_of_blocks);
+    if (block == NULL) {
+        return index == DXF_SNAPSHOT_NO_CONTAINER;
+    }
+
+    return (index < number_of_blocks)
+        && (strcmp(dxf_snapshot_get_string(snapshot, blocks[index].name), block->name) == 0);
+}
+
+static int same_reals(struct dxf_snapshot *snapshot, unsigned int first, size_t count,
+                    const double *values)
+{
+    const double *reals = (const double*)dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_REALS, first,
+                                                                (unsigned int)count);
+
+    return (reals != NULL) && ((count == 0) || (memcmp(reals, values, count * sizeof(double)) == 0));
+}
+
+static int compare_polyline(struct dxf_snapshot *snapshot, const struct dxf_snapshot_polyline *record,
+                            const struct dxf_polyline *polyline)
+{
+    const struct dxf_snapshot_polyline_vertex *vertices;
+    const struct dxf_snapshot_polyline_face *faces;
+    size_t i;
+
+    vertices = dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_POLYLINE_VERTICES, record->first_vertex,
+                                    record->number_of_vertices);
+    faces = dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_POLYLINE_FACES, record->first_face,
+                                    record->number_of_faces);
+    if ((vertices == NULL) || (faces == NULL) || (record->flag != polyline->flag)
+        || (record->number_of_vertices != polyline->number_of_vertices)
+        || (record->number_of_faces != polyline->number_of_faces))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < polyline->number_of_vertices; ++i) {
+        if ((vertices[i].x != polyline->vertices[i].x) || (vertices[i].bulge != polyline->vertices[i].bulge)
+            || (vertices[i].flag != polyline->vertices[i].flag))
+        {
+            return -1;
+        }
+    }
+    for (i = 0; i < polyline->number_of_faces; ++i) {
+        if (memcmp(faces[i].vertices, polyline->faces[i].vertices, 4 * sizeof(int)) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int compare_spline(struct dxf_snapshot *snapshot, const struct dxf_snapshot_spline *record,
+                        const struct dxf_spline *spline)
+{
+    if ((record->degree != spline->degree) || (record->number_of_knots != spline->number_of_knots)
+        || (record->number_of_control_points != spline->number_of_control_points)
+        || (record->number_of_fit_points != spline->number_of_fit_points)
+        || ((record->number_of_weights != 0) != (spline->weights != NULL)))
+    {
+        return -1;
+    }
+
+    return (same_reals(snapshot, record->knots, spline->number_of_knots, spline->knots)
+        && same_reals(snapshot, record->control_points, 3 * spline->number_of_control_points,
+                    spline->control_points)
+        && same_reals(snapshot, record->weights, record->number_of_weights, spline->weights)
+        && same_reals(snapshot, record->fit_points, 3 * spline->number_of_fit_points, spline->fit_points))
+        ? 0 : -1;
+}
+
+static int compare_hatch(struct dxf_snapshot *snapshot, const struct dxf_snapshot_hatch *record,
+                        const struct dxf_hatch *hatch)
+{
+    const struct dxf_snapshot_hatch_loop *loops;
+    const struct dxf_snapshot_hatch_edge *edges;
+    const struct dxf_snapshot_hatch_vertex *vertices;
+    size_t i;
+
+    loops = dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_HATCH_LOOPS, record->first_loop,
+                                    record->number_of_loops);
+    edges = dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_HATCH_EDGES, record->first_edge,
+                                    record->number_of_edges);
+    vertices = dxf_snapshot_get_array(snapshot, DXF_SNAPSHOT_HATCH_VERTICES, record->first_vertex,
+                                    record->number_of_vertices);
+    if ((loops == NULL) || (edges == NULL) || (vertices == NULL)
+        || (record->number_of_loops != hatch->number_of_loops)
+        || (record->number_of_edges != hatch->number_of_edges)
+        || (record->number_of_vertices != hatch->number_of_vertices)
+        || (record->number_of_pattern_lines != hatch->number_of_pattern_lines)
+        || (strcmp(dxf_snapshot_get_string(snapshot, record->pattern_name),
+                    hatch->pattern_name != NULL ? hatch->pattern_name : "") != 0))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < hatch->number_of_loops; ++i) {
+        if ((loops[i].first != hatch->loops[i].first) || (loops[i].count != hatch->loops[i].count)) {
+            return -1;
+        }
+    }
+    for (i = 0; i < hatch->number_of_edges; ++i) {
+        if ((edges[i].type != hatch->edges[i].type) || (edges[i].x2 != hatch->edges[i].x2)
+            || (edges[i].number_of_knots != hatch->edges[i].number_of_knots))
+        {
+            return -1;
+        }
+    }
+    for (i = 0; i < hatch->number_of_vertices; ++i) {
+        if ((vertices[i].y != hatch->vertices[i].y) || (vertices[i].bulge != hatch->vertices[i].bulge)) {
+            return -1;
+        }
+    }
+
+    return (same_reals(snapshot, record->knots, hatch->number_of_knots, hatch->knots)
+        && same_reals(snapshot, record->control_points, 3 * hatch->number_of_control_points,
+                    hatch->control_points)
+        && same_reals(snapshot, record->dashes, hatch->number_of_dashes, hatch->dashes)
+        && same_reals(snapshot, record->seeds, 2 * hatch->number_of_seeds, hatch->seeds))
+        ? 0 : -1;
+}
+
+/* A copy of the snapshot with a change, which must then fail to open. */
+static int rejects(const char *filename, size_t keep, size_t offset, const void *bytes,
+                    size_t length, int flags)
+{
+    struct dxf_snapshot snapshot;
+    char damaged[256];
+    static char buf[1 << 20];
+    size_t size;
+    FILE *fp;
+    int rejected;
+
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        return 0;
+    }
+    size = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    if ((size == sizeof(buf)) || (offset + length > size)) {
+        /* Too large for the test buffer, nothing to check. */
+        return 1;
+    }
+
+    memcpy(buf + offset, bytes, length);
+    sprintf(damaged, "%.240s.bad", filename);
+    if ((fp = fopen(damaged, "wb")) == NULL) {
+        return 0;
+    }
+    fwrite(buf, 1, keep < size ? keep : size, fp);
+    fclose(fp);
+
+    rejected = dxf_snapshot_open(&snapshot, damaged, flags) != 0;
+    if (!rejected) {
+        dxf_snapshot_close(&snapshot);
+    }
+    remove(damaged);
+
+    return rejected;
+}
+
+static int check_damaged(const char *filename, const struct dxf_snapshot_header *header)
+{
+    struct dxf_snapshot_section section;
+    size_t total = header->total_size;
+    unsigned char byte;
+
+    /* Truncated */
+    if (!rejects(filename, total / 2, 0, "", 0, DXF_SNAPSHOT_DEFAULT)
+        || !rejects(filename, total - 1, 0, "", 0, DXF_SNAPSHOT_DEFAULT))
+    {
+        printf("A truncated snapshot was accepted. \n");
+        return -1;
+    }
+
+    /* Counts so large that offset + count * size wraps around. */
+    section.offset = header->entities[DXF_LINE].offset;
+    section.count = 0x80000000u;
+    if (!rejects(filename, total, (const char*)&(header->entities[DXF_LINE]) - (const char*)header,
+                &section, sizeof(section), DXF_SNAPSHOT_DEFAULT)
+        || !rejects(filename, total, (const char*)&(header->arrays[DXF_SNAPSHOT_REALS]) - (const char*)header,
+                &section, sizeof(section), DXF_SNAPSHOT_DEFAULT))
+    {
+        printf("A snapshot with an oversized section was accepted. \n");
+        return -1;
+    }
+
+    /* A flipped byte past the header fails the checksum. */
+    byte = (unsigned char)~((const unsigned char*)header)[total - 1];
+    if (!rejects(filename, total, total - 1, &byte, 1, DXF_SNAPSHOT_VERIFY_CHECKSUM)) {
+        printf("A corrupted snapshot passed the checksum. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int same_string(struct dxf_snapshot *snapshot, dxf_snapshot_off_t offset, const char *str)
+{
+    return strcmp(dxf_snapshot_get_string(snapshot, offset), str != NULL ? str : "") == 0;
+}
+
+/* Layers in list order, hidden ones included. */
+static int compare_layers(struct dxf *dxf, struct dxf_snapshot *snapshot)
+{
+    const struct dxf_snapshot_container *layers;
+    const struct dxf_layer *layer;
+    size_t number_of_layers;
+    size_t i = 0;
+    int hidden;
+
+    layers = dxf_snapshot_get_layers(snapshot, &number_of_layers);
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        if (i == number_of_layers) {
+            printf("Snapshot has fewer layers than the document. \n");
+            return -1;
+        }
+        hidden = ((layers[i].flag & DXF_LAYER_FROZEN) != 0) || (layers[i].color < 0);
+        if (!same_string(snapshot, layers[i].name, layer->name) || (layers[i].flag != layer->flag)
+            || (layers[i].color != layer->color) || !same_string(snapshot, layers[i].linetype, layer->linetype)
+            || !same_string(snapshot, layers[i].handle, layer->handle)
+            || (hidden != dxf_layer_is_hidden(layer)))
+        {
+            printf("Layer %s does not match. \n", layer->name);
+            return -1;
+        }
+        ++i;
+    }
+
+    return (i == number_of_layers) ? 0 : -1;
+}
+
+/* Raw XDATA and the dictionary handle, byte for byte. */
+static int same_xdata(struct dxf_snapshot *snapshot, const struct dxf_snapshot_entity *record,
+                    const struct dxf_entity *entity)
+{
+    const struct dxf_xdata *xdata = entity->xdata;
+    const char *str = dxf_snapshot_get_string(snapshot, record->xdata);
+
+    if (xdata == NULL) {
+        return (record->xdata == 0) && (record->dictionary == 0);
+    }
+    if (!same_string(snapshot, record->dictionary, xdata->dictionary)) {
+        return 0;
+    }
+    if (xdata->str == NULL) {
+        return record->xdata == 0;
+    }
+
+    return (str != NULL) && (strlen(str) == xdata->length)
+        && (memcmp(str, xdata->str, xdata->length) == 0);
+}
+
+static int compare(struct dxf *dxf, struct dxf_snapshot *snapshot)
+{
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    const struct dxf_snapshot_entity *record;
+    const struct dxf_snapshot_container *layers;
+    const struct dxf_snapshot_lwpolyline_vertex *vertices;
+    struct dxf_lwpolyline_vertex *vertex;
+    const char *records;
+    size_t number_of_layers;
+    size_t count;
+    size_t i;
+    int type;
+
+    layers = dxf_snapshot_get_layers(snapshot, &number_of_layers);
+
+    for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+        records = dxf_snapshot_get_entities(snapshot, type, &count);
+        dxf_entity_iter_init(&iter, dxf, NULL, DXF_ENTITY_TYPE_BIT(type));
+
+        for (i = 0; i < count; ++i) {
+            if ((entity = dxf_entity_iter_next(&iter)) == NULL) {
+                printf("Type %d: snapshot has more entities than the document. \n", type);
+                return -1;
+            }
+
+            switch (type) {
+                case DXF_POINT:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_point));
+                    if (((const struct dxf_snapshot_point*)record)->x != ((struct dxf_point*)entity)->x) {
+                        return -1;
+                    }
+                    break;
+                case DXF_LINE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_line));
+                    if ((((const struct dxf_snapshot_line*)record)->x1 != ((struct dxf_line*)entity)->x1)
+                        || (((const struct dxf_snapshot_line*)record)->y2 != ((struct dxf_line*)entity)->y2)) {
+                        return -1;
+                    }
+                    break;
+                case DXF_CIRCLE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_circle));
+                    if (((const struct dxf_snapshot_circle*)record)->r != ((struct dxf_circle*)entity)->r) {
+                        return -1;
+                    }
+                    break;
+                case DXF_ARC:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_arc));
+                    if (((const struct dxf_snapshot_arc*)record)->angle_end != ((struct dxf_arc*)entity)->angle_end) {
+                        return -1;
+                    }
+                    break;
+                case DXF_LWPOLYLINE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_lwpolyline));
+                    vertices = dxf_snapshot_get_vertices(snapshot, (const struct dxf_snapshot_lwpolyline*)record);
+                    for (vertex = ((struct dxf_lwpolyline*)entity)->vertices; vertex != NULL; vertex = vertex->next) {
+                        if ((vertices->x != vertex->x) || (vertices->bulge != vertex->bulge)) {
+                            return -1;
+                        }
+                        ++vertices;
+                    }
+                    break;
+                case DXF_INSERT:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_insert));
+                    if ((((const struct dxf_snapshot_insert*)record)->row_count != ((struct dxf_insert*)entity)->row_count)
+                        || !same_block(snapshot, ((const struct dxf_snapshot_insert*)record)->block_ref,
+                                        ((struct dxf_insert*)entity)->block_ref)) {
+                        return -1;
+                    }
+                    break;
+                case DXF_DIMENSION:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_dimension));
+                    if ((((const struct dxf_snapshot_dimension*)record)->measurement
+                            != ((struct dxf_dimension*)entity)->measurement)
+                        || !same_block(snapshot, ((const struct dxf_snapshot_dimension*)record)->insert.block_ref,
+                                        ((struct dxf_dimension*)entity)->insert.block_ref)) {
+                        return -1;
+                    }
+                    break;
+                case DXF_ELLIPSE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_ellipse));
+                    if ((((const struct dxf_snapshot_ellipse*)record)->ratio != ((struct dxf_ellipse*)entity)->ratio)
+                        || (((const struct dxf_snapshot_ellipse*)record)->major[1] != ((struct dxf_ellipse*)entity)->major[1])) {
+                        return -1;
+                    }
+                    break;
+                case DXF_POLYLINE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_polyline));
+                    if (compare_polyline(snapshot, (const struct dxf_snapshot_polyline*)record,
+                                        (struct dxf_polyline*)entity) != 0) {
+                        return -1;
+                    }
+                    break;
+                case DXF_SPLINE:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_spline));
+                    if (compare_spline(snapshot, (const struct dxf_snapshot_spline*)record,
+                                        (struct dxf_spline*)entity) != 0) {
+                        return -1;
+                    }
+                    break;
+                case DXF_HATCH:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_hatch));
+                    if (compare_hatch(snapshot, (const struct dxf_snapshot_hatch*)record,
+                                        (struct dxf_hatch*)entity) != 0) {
+                        return -1;
+                    }
+                    break;
+                case DXF_TEXTSTRING:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_text));
+                    if ((((const struct dxf_snapshot_text*)record)->height != ((struct dxf_text*)entity)->height)
+                        || (strcmp(dxf_snapshot_get_string(snapshot, ((const struct dxf_snapshot_text*)record)->string),
+                                    ((struct dxf_text*)entity)->body.string) != 0)) {
+                        return -1;
+                    }
+                    break;
+                case DXF_MTEXT:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_mtext));
+                    if ((((const struct dxf_snapshot_mtext*)record)->width != ((struct dxf_mtext*)entity)->width)
+                        || (strcmp(dxf_snapshot_get_string(snapshot, ((const struct dxf_snapshot_mtext*)record)->string),
+                                    ((struct dxf_mtext*)entity)->body.string) != 0)) {
+                        return -1;
+                    }
+                    break;
+                case DXF_SOLID:
+                    record = (const struct dxf_snapshot_entity*)(records + i * sizeof(struct dxf_snapshot_solid));
+                    if (memcmp(((const struct dxf_snapshot_solid*)record)->corners, ((struct dxf_solid*)entity)->corners,
+                                12 * sizeof(double)) != 0) {
+                        return -1;
+                    }
+                    break;
+                default:
+                    continue;
+            }
+
+            if ((record->seq != entity->seq) || (record->layer >= number_of_layers)
+                || !same_xdata(snapshot, record, entity)
+                || (strcmp(dxf_snapshot_get_string(snapshot, layers[record->layer].name),
+                            entity->layer->name) != 0)) {
+                printf("Type %d: header mismatch at seq %zu. \n", type, entity->seq);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_snapshot snapshot;
+    struct dxf_layer *layer;
+    char *handle;
+    char filename[256];
+    
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+    
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_text_materialize(&dxf);
+    dxf_xdata_materialize(&dxf);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    /* A layer turned off through a negative color. */
+    if (((layer = dxf_add_layer(&dxf, "SnapshotOff")) == NULL)
+        || ((handle = dxf_alloc_string(&dxf, 4)) == NULL))
+    {
+        printf("Failed to add a layer. \n");
+        return 1;
+    }
+    strcpy(handle, "FFFE");
+    layer->color = -5;
+    layer->linetype = "DASHED";
+    layer->handle = handle;
+
+    sprintf(filename, "%.240s.snap", argv[1]);
+    if (dxf_snapshot_write(&dxf, filename) != 0) {
+        printf("Failed to write %s. \n", filename);
+        return 1;
+    }
+
+    if (dxf_snapshot_open(&snapshot, filename, DXF_SNAPSHOT_VERIFY_CHECKSUM) != 0) {
+        printf("Failed to open %s. \n", filename);
+        return 1;
+    }
+
+    if ((compare(&dxf, &snapshot) != 0) || (compare_layers(&dxf, &snapshot) != 0)) {
+        printf("Snapshot does not match a fresh parse. \n");
+        return 1;
+    }
+
+    if (snapshot.header->number_of_entities != dxf.number_of_entities) {
+        printf("Snapshot holds %u of %lu entities. \n", snapshot.header->number_of_entities,
+                (unsigned long)dxf.number_of_entities);
+        return 1;
+    }
+
+    if (check_damaged(filename, snapshot.header) != 0) {
+        return 1;
+    }
+
+    printf("%u entities round-tripped. \n", snapshot.header->number_of_entities);
+
+    dxf_snapshot_close(&snapshot);
+    dxf_free(&dxf);
+    
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxftess.h"
+#include "dxfspline.h"
+
+#define TOLERANCE 0.001
+#define MAX_VERTICES 65536
+
+/* Vertices on the unit circle, chord midpoints within tolerance of it. */
+static int check_quarter_circle(const struct dxf_tess_vertex *v, size_t n)
+{
+    double mx;
+    double my;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        if (fabs(sqrt(v[i].x * v[i].x + v[i].y * v[i].y) - 1.0) > 1e-9) {
+            printf("Vertex %lu is off the circle. \n", (unsigned long)i);
+            return -1;
+        }
+        if (i > 0) {
+            mx = (v[i].x + v[i - 1].x) * 0.5;
+            my = (v[i].y + v[i - 1].y) * 0.5;
+            if (1.0 - sqrt(mx * mx + my * my) > TOLERANCE * (1.0 + 1e-9)) {
+                printf("Chord %lu is outside the tolerance. \n", (unsigned long)i);
+                return -1;
+            }
+        }
+    }
+
+    if ((fabs(v[0].x - 1.0) > 1e-12) || (fabs(v[n - 1].y - 1.0) > 1e-12)) {
+        printf("Quarter circle does not span its end points. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const double control_points[9] = { 1.0, 0.0, 0.0, 1.0, 1.0, 0.0, 0.0, 1.0, 0.0 };
+    static const double knots[6] = { 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 };
+    static struct dxf_tess_vertex vertices[MAX_VERTICES];
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    struct dxf_spline *spline;
+    double t[5];
+    double points[15];
+    size_t number_of_splines = 0;
+    size_t n;
+    size_t i;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL, DXF_ENTITY_TYPE_BIT(DXF_SPLINE));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        spline = (struct dxf_spline*)entity;
+        ++number_of_splines;
+        if (!dxf_spline_is_valid(spline) && (spline->number_of_fit_points < 2)) {
+            printf("Spline %lu is neither valid nor fitted. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+
+        n = dxf_tess_count(entity, TOLERANCE);
+        if ((n > MAX_VERTICES) || (dxf_tess_entity(entity, TOLERANCE, vertices, MAX_VERTICES, &i) != 0)
+            || (i != n))
+        {
+            printf("Spline %lu tessellated to a different count. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+    }
+    printf("%lu splines. \n", (unsigned long)number_of_splines);
+
+    /* Rational quadratic quarter of the unit circle. */
+    spline = (struct dxf_spline*)dxf_alloc_entity(&dxf, DXF_SPLINE);
+    spline->flag = DXF_SPLINE_FLAG_RATIONAL | DXF_SPLINE_FLAG_PLANAR;
+    spline->degree = 2;
+    spline->number_of_knots = 6;
+    spline->number_of_control_points = 3;
+    spline->knots = (double*)dxf_alloc_binary(&dxf, sizeof(knots));
+    spline->control_points = (double*)dxf_alloc_binary(&dxf, sizeof(control_points));
+    spline->weights = (double*)dxf_alloc_binary(&dxf, 3 * sizeof(double));
+    for (i = 0; i < 9; ++i) {
+        spline->control_points[i] = control_points[i];
+    }
+    for (i = 0; i < 6; ++i) {
+        spline->knots[i] = knots[i];
+    }
+    spline->weights[0] = 1.0;
+    spline->weights[1] = sqrt(0.5);
+    spline->weights[2] = 1.0;
+
+    for (i = 0; i < 5; ++i) {
+        t[i] = i / 4.0;
+    }
+    if (dxf_spline_evaluate(spline, t, 5, points) != 5) {
+        printf("Quarter circle is not a valid spline. \n");
+        return 1;
+    }
+    for (i = 0; i < 5; ++i) {
+        if (fabs(sqrt(points[3 * i] * points[3 * i] + points[3 * i + 1] * points[3 * i + 1]) - 1.0)
+            > 1e-12)
+        {
+            printf("Point at t = %g is off the circle. \n", t[i]);
+            return 1;
+        }
+    }
+
+    n = dxf_tess_count((struct dxf_entity*)spline, TOLERANCE);
+    if ((dxf_tess_entity((struct dxf_entity*)spline, TOLERANCE, vertices, MAX_VERTICES, &i) != 0)
+        || (i != n) || (check_quarter_circle(vertices, n) != 0))
+    {
+        return 1;
+    }
+    printf("Quarter circle in %lu vertices. \n", (unsigned long)n);
+
+    dxf_free(&dxf);
+
+    return 0;
+}
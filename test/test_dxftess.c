@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxftess.h"
+#include "dxfocs.h"
+
+#define TOLERANCE 0.01
+#define BENCHMARK_SECONDS 1.0
+
+/* Vertices on the circle, chord midpoints within tolerance of it. */
+static int check_circle(const struct dxf_tess_vertex *v, size_t n, double x, double y, double r)
+{
+    double d;
+    double mx;
+    double my;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        d = sqrt((v[i].x - x) * (v[i].x - x) + (v[i].y - y) * (v[i].y - y));
+        if (fabs(d - r) > r * 1e-9) {
+            printf("Vertex %lu is %g off the circle. \n", (unsigned long)i, d - r);
+            return -1;
+        }
+        if (i > 0) {
+            mx = (v[i].x + v[i - 1].x) * 0.5 - x;
+            my = (v[i].y + v[i - 1].y) * 0.5 - y;
+            if (r - sqrt(mx * mx + my * my) > TOLERANCE * (1.0 + 1e-9)) {
+                printf("Chord %lu is outside the tolerance. \n", (unsigned long)i);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_tess_batch *batches;
+    struct dxf_tess_batch *batch;
+    struct dxf_entity *entity;
+    const struct dxf_tess_vertex *v;
+    const struct dxf_circle *circle;
+    const struct dxf_arc *arc;
+    double centre[3];
+    size_t number_of_batches;
+    size_t segments = 0;
+    size_t i;
+    size_t j;
+    int rounds = 0;
+    clock_t start;
+    double elapsed;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    if (dxf_tess_document(&dxf, TOLERANCE, &batches, &number_of_batches) != 0) {
+        printf("dxf_tess_document() failed. \n");
+        return 1;
+    }
+
+    for (i = 0; i < number_of_batches; ++i) {
+        batch = &batches[i];
+        for (j = 0; j < batch->number_of_polylines; ++j) {
+            entity = batch->entities[j];
+            v = batch->vertices + batch->offsets[j];
+            if (dxf_tess_count(entity, TOLERANCE) != batch->offsets[j + 1] - batch->offsets[j]) {
+                printf("Vertex count of entity %lu disagrees. \n", (unsigned long)entity->seq);
+                return 1;
+            }
+
+            /* Only normals along Z keep circles in the XY plane. */
+            if (entity->type == DXF_CIRCLE) {
+                circle = (const struct dxf_circle*)entity;
+                centre[0] = circle->x;
+                centre[1] = circle->y;
+                centre[2] = circle->z;
+                dxf_ocs_to_wcs(circle->extrusion, centre, 1, 3);
+                if ((circle->extrusion[0] == 0.0) && (circle->extrusion[1] == 0.0)
+                    && (check_circle(v, batch->offsets[j + 1] - batch->offsets[j],
+                                    centre[0], centre[1], circle->r) != 0)) {
+                    return 1;
+                }
+            }
+            else if (entity->type == DXF_ARC) {
+                arc = (const struct dxf_arc*)entity;
+                centre[0] = arc->x;
+                centre[1] = arc->y;
+                centre[2] = arc->z;
+                dxf_ocs_to_wcs(arc->extrusion, centre, 1, 3);
+                if ((arc->extrusion[0] == 0.0) && (arc->extrusion[1] == 0.0)
+                    && (check_circle(v, batch->offsets[j + 1] - batch->offsets[j],
+                                    centre[0], centre[1], arc->r) != 0)) {
+                    return 1;
+                }
+            }
+        }
+    }
+    dxf_tess_batches_free(batches, number_of_batches);
+
+    /* Throughput */
+    start = clock();
+    do {
+        if (dxf_tess_document(&dxf, TOLERANCE, &batches, &number_of_batches) != 0) {
+            return 1;
+        }
+        for (i = 0; i < number_of_batches; ++i) {
+            segments += batches[i].number_of_vertices - batches[i].number_of_polylines;
+        }
+        dxf_tess_batches_free(batches, number_of_batches);
+        ++rounds;
+        elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    } while (elapsed < BENCHMARK_SECONDS);
+
+    printf("%lu segments in %d rounds, %.0f segments/s (CPU time). \n",
+            (unsigned long)segments, rounds, segments / elapsed);
+
+    dxf_free(&dxf);
+
+    return 0;
+}
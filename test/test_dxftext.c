@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxftext.h"
+
+struct decode_case {
+    const char *in;
+    int mtext;
+    const char *out;
+};
+
+static const struct decode_case cases[] = {
+    { "25%%d %%p0.1 %%c10", 0, "25\xc2\xb0 \xc2\xb1" "0.1 \xe2\x8c\x80" "10" },
+    { "%%uunder%%u 100%%% %%065", 0, "under 100% A" },
+    { "a\\Pb", 0, "a\\Pb" },
+    { "\\U+00E9t\\U+00E9 \\U+D83D\\U+DE00", 0, "\xc3\xa9t\xc3\xa9 \xf0\x9f\x98\x80" },
+    { "one\\Ptwo\\Nthree", 1, "one\ntwo\nthree" },
+    { "{\\fArial|b1|i0;bold} \\H2.5x;big\\A1; \\C3;red", 1, "bold big red" },
+    { "\\\\ \\{x\\} \\Lline\\l\\~", 1, "\\ {x} line\xc2\xa0" },
+    { "\\S1^2; and \\S3#4;", 1, "1/2 and 3/4" },
+    { "tab^Iend ^ caret", 1, "tab\tend ^caret" },
+    { "\\M+1A1A2?", 1, "??" }
+};
+
+static int check_decode()
+{
+    char buf[256];
+    size_t length;
+    size_t i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        strcpy(buf, cases[i].in);
+        length = dxf_text_decode(buf, strlen(buf), cases[i].mtext);
+        if ((length != strlen(cases[i].out)) || (strcmp(buf, cases[i].out) != 0)) {
+            printf("Case %lu decoded to \"%s\". \n", (unsigned long)i, buf);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Escapes split over group 3 chunks decode as if the string were whole. */
+static int check_spans(struct dxf* const dxf)
+{
+    static const char *chunks[3] = { "50\\U+0", "0B0 \\P{\\C1", ";x}" };
+    struct dxf_text_span spans[3];
+    struct dxf_mtext *mtext;
+    const char *str;
+    int i;
+
+    mtext = (struct dxf_mtext*)dxf_alloc_entity(dxf, DXF_MTEXT);
+    for (i = 0; i < 3; ++i) {
+        spans[i].str = chunks[i];
+        spans[i].length = strlen(chunks[i]);
+        spans[i].next = (i < 2) ? &spans[i + 1] : NULL;
+        mtext->body.length += spans[i].length;
+    }
+    mtext->body.spans = spans;
+
+    if (((str = dxf_text_get_string(dxf, (struct dxf_entity*)mtext)) == NULL)
+        || (strcmp(str, "50\xc2\xb0 \nx") != 0)
+        || (dxf_text_get_string(dxf, (struct dxf_entity*)mtext) != str))
+    {
+        printf("Chunked MTEXT decoded wrongly. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    struct dxf_entity_iter iter;
+    struct dxf_entity *entity;
+    const struct dxf_text_body *body;
+    const char *str;
+    size_t number_of_texts = 0;
+    size_t number_of_characters = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    if (check_decode() != 0) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    dxf_init(&dxf, 0);
+    dxf_parser_init();
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+
+    /* Nothing is decoded by parsing. */
+    dxf_entity_iter_init(&iter, &dxf, NULL,
+                        DXF_ENTITY_TYPE_BIT(DXF_TEXTSTRING) | DXF_ENTITY_TYPE_BIT(DXF_MTEXT));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        body = (entity->type == DXF_MTEXT) ? &(((struct dxf_mtext*)entity)->body)
+                                            : &(((struct dxf_text*)entity)->body);
+        if (body->string != NULL) {
+            printf("Text %lu was decoded while parsing. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+        ++number_of_texts;
+    }
+
+    if (dxf_text_materialize(&dxf) != number_of_texts) {
+        printf("Not every text was materialized. \n");
+        return 1;
+    }
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    dxf_entity_iter_init(&iter, &dxf, NULL,
+                        DXF_ENTITY_TYPE_BIT(DXF_TEXTSTRING) | DXF_ENTITY_TYPE_BIT(DXF_MTEXT));
+    while ((entity = dxf_entity_iter_next(&iter)) != NULL) {
+        body = (entity->type == DXF_MTEXT) ? &(((struct dxf_mtext*)entity)->body)
+                                            : &(((struct dxf_text*)entity)->body);
+        if (((str = dxf_text_get_string(&dxf, entity)) != body->string) || (strlen(str) > body->length)) {
+            printf("Text %lu string is not the materialized one. \n", (unsigned long)entity->seq);
+            return 1;
+        }
+        number_of_characters += strlen(str);
+    }
+    printf("%lu texts, %lu bytes decoded. \n", (unsigned long)number_of_texts,
+            (unsigned long)number_of_characters);
+
+    if (check_spans(&dxf) != 0) {
+        return 1;
+    }
+
+    dxf_free(&dxf);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxfthumbnail.h"
+
+#define ROUNDS 1000
+
+int main(int argc, char *argv[])
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf dxf;
+    unsigned char *image;
+    size_t size;
+    clock_t start;
+    double elapsed;
+    int i;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, argv[1], NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", argv[1]);
+        return 1;
+    }
+
+    size = dxf_extract_thumbnail(&lexer_desc, NULL, 0);
+    if ((image = (unsigned char*)malloc(size + 1)) == NULL) {
+        return 1;
+    }
+    if ((size > 0) && (dxf_extract_thumbnail(&lexer_desc, image, size - 1) != size)) {
+        printf("Size differs when the buffer is too small. \n");
+        return 1;
+    }
+    if (dxf_extract_thumbnail(&lexer_desc, image, size + 1) != size) {
+        printf("Thumbnail failed to extract. \n");
+        return 1;
+    }
+
+    /* The same bytes as a full parse, and the lexer is still at the start. */
+    dxf_init(&dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+    dxf_parser_parse(&parser_desc);
+    if ((dxf.thumbnail_size != size)
+        || ((size > 0) && (memcmp(dxf.thumbnail, image, size) != 0)))
+    {
+        printf("Extracted %lu bytes, parsed %lu. \n", (unsigned long)size,
+                (unsigned long)dxf.thumbnail_size);
+        return 1;
+    }
+
+    start = clock();
+    for (i = 0; i < ROUNDS; ++i) {
+        dxf_extract_thumbnail(&lexer_desc, image, size);
+    }
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("Thumbnail of %lu bytes, %.3f ms per extraction (CPU time). \n", (unsigned long)size,
+            1000.0 * elapsed / ROUNDS);
+
+    dxf_lexer_close_desc(&lexer_desc, 1);
+    dxf_free(&dxf);
+    free(image);
+
+    return 0;
+}
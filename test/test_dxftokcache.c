@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "dxflexer.h"
+#include "dxftokcache.h"
+
+/* Folds a token stream into one number so that two runs can be compared. */
+static unsigned int lex_file(const char *filename, int *mode)
+{
+    struct dxf_lexer_desc desc;
+    unsigned int hash = 0;
+    const char *sz;
+
+    dxf_lexer_clear_desc(&desc);
+    if (dxf_lexer_open_desc(&desc, filename, NULL) != 0) {
+        return 0;
+    }
+
+    *mode = desc.cache != NULL ? desc.cache->mode : 0;
+
+    while (dxf_lexer_get_token(&desc) == 0) {
+        hash = hash * 31 + desc.token.group_code;
+        switch (desc.token.tag) {
+            case DXF_X:
+            case DXF_Y:
+            case DXF_FLOAT:
+                hash = hash * 31 + (unsigned int)(desc.token.value.f * 1000.0);
+                break;
+            case DXF_ENTITY_TYPE:
+            case DXF_LAYER_NAME:
+            case DXF_BLOCK_NAME:
+                for (sz = desc.token.value.str; *sz != '\0'; ++sz) {
+                    hash = hash * 31 + *sz;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    dxf_lexer_close_desc(&desc, 1);
+    return hash;
+}
+
+/* Binary groups must come back with their bytes on replay. */
+static int check_binary(const char *filename, int *mode)
+{
+    static const unsigned char thumbnail[] = { 0x42, 0x4d, 0x00, 0xff };
+    static const unsigned char xdata[] = { 0x01, 0x02, 0xab };
+    struct dxf_lexer_desc desc;
+    int found = 0;
+
+    dxf_lexer_clear_desc(&desc);
+    if (dxf_lexer_open_desc(&desc, filename, NULL) != 0) {
+        return -1;
+    }
+
+    *mode = desc.cache != NULL ? desc.cache->mode : 0;
+
+    while (dxf_lexer_get_token(&desc) == 0) {
+        if ((desc.token.group_code == 310)
+            && (desc.token.length == sizeof(thumbnail))
+            && (memcmp(desc.token.value.bin, thumbnail, sizeof(thumbnail)) == 0))
+        {
+            found |= 1;
+        }
+        else if ((desc.token.group_code == 1004)
+            && (desc.token.length == sizeof(xdata))
+            && (memcmp(desc.token.value.bin, xdata, sizeof(xdata)) == 0))
+        {
+            found |= 2;
+        }
+    }
+
+    dxf_lexer_close_desc(&desc, 1);
+    return (found == 3) ? 0 : -1;
+}
+
+static int write_binary_sample(const char *filename)
+{
+    FILE *fp;
+
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        return -1;
+    }
+
+    fputs("0\nSECTION\n2\nENTITIES\n0\nPOINT\n8\n0\n10\n1.0\n20\n2.0\n30\n0.0\n"
+        "1001\nAPP\n1004\n0102AB\n0\nENDSEC\n"
+        "0\nSECTION\n2\nTHUMBNAILIMAGE\n90\n4\n310\n424D00FF\n0\nENDSEC\n0\nEOF\n", fp);
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    char cache_path[256];
+    char sample_path[256];
+    unsigned int first;
+    unsigned int second;
+    int mode;
+    FILE *fp;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_token_cache_enable(NULL);
+    sprintf(cache_path, "%.240s%s", argv[1], DXF_TOKEN_CACHE_SUFFIX);
+    remove(cache_path);
+
+    first = lex_file(argv[1], &mode);
+    printf("first open: mode=%d hash=%08x \n", mode, first);
+
+    second = lex_file(argv[1], &mode);
+    printf("second open: mode=%d hash=%08x \n", mode, second);
+    if ((mode != DXF_TOKEN_CACHE_REPLAY) || (first != second)) {
+        printf("Replayed stream differs from the lexed one. \n");
+        return 1;
+    }
+
+    /* Damage the cache, it must be ignored and rewritten. */
+    if ((fp = fopen(cache_path, "r+b")) != NULL) {
+        fseek(fp, -4, SEEK_END);
+        fputc('#', fp);
+        fclose(fp);
+    }
+
+    second = lex_file(argv[1], &mode);
+    printf("corrupt cache: mode=%d hash=%08x \n", mode, second);
+    if ((mode != DXF_TOKEN_CACHE_RECORD) || (first != second)) {
+        printf("Corrupt cache was not rejected. \n");
+        return 1;
+    }
+
+    remove(cache_path);
+
+    sprintf(sample_path, "%.200s.bin.dxf", argv[1]);
+    sprintf(cache_path, "%.220s%s", sample_path, DXF_TOKEN_CACHE_SUFFIX);
+    remove(cache_path);
+    if (write_binary_sample(sample_path) != 0) {
+        printf("Could not write %s. \n", sample_path);
+        return 1;
+    }
+    if ((check_binary(sample_path, &mode) != 0) || (mode != DXF_TOKEN_CACHE_RECORD)
+        || (check_binary(sample_path, &mode) != 0) || (mode != DXF_TOKEN_CACHE_REPLAY))
+    {
+        printf("Binary groups were lost on replay (mode=%d). \n", mode);
+        return 1;
+    }
+    printf("binary groups replayed \n");
+
+    remove(cache_path);
+    remove(sample_path);
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxflazy.h"
+#include "dxfupdate.h"
+
+/* Writes the input without the first indexed entity. */
+static int write_without_first_entity(const char *filename, const char *out_filename)
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf_lazy lazy;
+    struct dxf dxf;
+    FILE *fp;
+    size_t len;
+    int retval = -1;
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, filename, NULL) != 0) {
+        return -1;
+    }
+    dxf_init(&dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, &dxf);
+
+    if ((dxf_lazy_index(&lazy, &parser_desc) == 0) && (lazy.number_of_entries > 0)
+        && ((fp = fopen(out_filename, "wb")) != NULL))
+    {
+        len = dxf_lexer_get_input_length(&lexer_desc);
+        fwrite(lexer_desc.buf, 1, lazy.entries[0].offset, fp);
+        fwrite(lexer_desc.buf + lazy.entries[0].offset + lazy.entries[0].length, 1,
+                len - lazy.entries[0].offset - lazy.entries[0].length, fp);
+        fclose(fp);
+        retval = 0;
+    }
+
+    dxf_lazy_close(&lazy);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+    dxf_free(&dxf);
+    return retval;
+}
+
+static size_t count_kind(const struct dxf_update_report* const report, int kind)
+{
+    size_t n = 0;
+    size_t i;
+
+    for (i = 0; i < report->number_of_changes; ++i) {
+        if (report->changes[i].kind == kind) {
+            ++n;
+        }
+    }
+
+    return n;
+}
+
+/* Layer lists must hold exactly the entities in file order, in order. */
+static int check_lists(struct dxf* const dxf)
+{
+    struct dxf_entity **by_seq;
+    struct dxf_entity *entity;
+    struct dxf_layer *layer;
+    size_t in_file = 0;
+    size_t listed = 0;
+    size_t seq;
+    int type;
+    int retval = 0;
+
+    if ((by_seq = (struct dxf_entity**)calloc(dxf->number_of_entities + 1, sizeof(struct dxf_entity*))) == NULL) {
+        return -1;
+    }
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        if ((entity->seq == 0) || (entity->seq > dxf->number_of_entities)) {
+            free(by_seq);
+            return -1;
+        }
+        by_seq[entity->seq] = entity;
+        in_file += (entity->layer != NULL);
+    }
+
+    for (layer = dxf->layers; layer != NULL; layer = layer->next) {
+        for (type = DXF_ENTITY_TYPE_START; type <= DXF_ENTITY_TYPE_END; ++type) {
+            seq = 0;
+            for (entity = layer->entities[type]; entity != NULL; entity = entity->next) {
+                if ((entity->seq <= seq) || (entity->seq > dxf->number_of_entities)
+                    || (by_seq[entity->seq] != entity) || (entity->layer != layer))
+                {
+                    retval = -1;
+                    break;
+                }
+                seq = entity->seq;
+                ++listed;
+                if ((entity->next == NULL) && (layer->entities_tail[type] != entity)) {
+                    retval = -1;
+                }
+            }
+        }
+    }
+
+    free(by_seq);
+    return ((retval == 0) && (listed == in_file)) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf_revision revision;
+    struct dxf_update_report report;
+    char filename[256];
+    size_t number_of_entities;
+    
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    memset(&report, 0, sizeof(report));
+
+    dxf_init(&dxf, 0);
+    if (dxf_revision_load(&revision, &dxf, argv[1]) != 0) {
+        printf("dxf_revision_load() failed. \n");
+        return 1;
+    }
+    number_of_entities = dxf.number_of_entities;
+
+    /* Same file: nothing changes. */
+    if ((dxf_revision_update(&revision, argv[1], &report) != 0)
+        || report.reloaded || (report.number_of_changes != 0)
+        || (dxf.number_of_entities != number_of_entities))
+    {
+        printf("Update from an identical file reported changes. \n");
+        return 1;
+    }
+    printf("Identical: %lu unchanged. \n", (unsigned long)report.number_unchanged);
+
+    sprintf(filename, "%.240s.v2", argv[1]);
+    if (write_without_first_entity(argv[1], filename) != 0) {
+        printf("Failed to write %s. \n", filename);
+        return 1;
+    }
+
+    if ((dxf_revision_update(&revision, filename, &report) != 0)
+        || (count_kind(&report, DXF_ENTITY_REMOVED) != 1)
+        || (dxf.number_of_entities != number_of_entities - 1)
+        || (check_lists(&dxf) != 0))
+    {
+        printf("Removing an entity was not picked up. \n");
+        return 1;
+    }
+    printf("Removed: %lu unchanged, %lu changes. \n",
+            (unsigned long)report.number_unchanged, (unsigned long)report.number_of_changes);
+
+    if ((dxf_revision_update(&revision, argv[1], &report) != 0)
+        || (count_kind(&report, DXF_ENTITY_ADDED) != 1)
+        || (dxf.number_of_entities != number_of_entities)
+        || (check_lists(&dxf) != 0))
+    {
+        printf("Adding an entity back was not picked up. \n");
+        return 1;
+    }
+    printf("Added: %lu unchanged, %lu changes. \n",
+            (unsigned long)report.number_unchanged, (unsigned long)report.number_of_changes);
+
+    remove(filename);
+    dxf_update_report_free(&report);
+    dxf_revision_free(&revision);
+    dxf_free(&dxf);
+    
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "dxf.h"
+#include "dxflexer.h"
+#include "dxfparser.h"
+#include "dxftokcache.h"
+#include "dxfxdata.h"
+
+/* Leaves the XDATA raw until the lexer is about to close. */
+static int parse(const char *path, struct dxf* const dxf)
+{
+    struct dxf_lexer_desc lexer_desc;
+    struct dxf_parser_desc parser_desc;
+    struct dxf_entity *entity;
+
+    dxf_lexer_clear_desc(&lexer_desc);
+    if (dxf_lexer_open_desc(&lexer_desc, path, NULL) == -1) {
+        printf("Failed to open %s for mapping. \n", path);
+        return -1;
+    }
+
+    dxf_init(dxf, 0);
+    dxf_parser_init_desc(&parser_desc, &lexer_desc, dxf);
+    dxf_parser_parse(&parser_desc);
+
+    for (entity = dxf->first_entity; entity != NULL; entity = entity->next_in_file) {
+        if ((entity->xdata != NULL) && (entity->xdata->apps != NULL)) {
+            printf("Entity %lu XDATA was decoded while parsing. \n", (unsigned long)entity->seq);
+            return -1;
+        }
+    }
+
+    dxf_xdata_materialize(dxf);
+    dxf_lexer_close_desc(&lexer_desc, 1);
+
+    return 0;
+}
+
+/* Applications tile the items in order. */
+static int check_xdata(struct dxf* const dxf, struct dxf_entity* const entity)
+{
+    const struct dxf_xdata *xdata = entity->xdata;
+    size_t next = 0;
+    size_t i;
+
+    if (dxf_xdata_decode(dxf, entity) != 0) {
+        printf("Entity %lu XDATA failed to decode. \n", (unsigned long)entity->seq);
+        return -1;
+    }
+    if (!xdata->copied) {
+        printf("Entity %lu XDATA still points into the input. \n", (unsigned long)entity->seq);
+        return -1;
+    }
+
+    for (i = 0; i < xdata->number_of_apps; ++i) {
+        if ((xdata->apps[i].first != next) || (xdata->apps[i].name[0] == '\0')
+            || (dxf_xdata_find_app(dxf, entity, xdata->apps[i].name) == NULL))
+        {
+            break;
+        }
+        next += xdata->apps[i].count;
+    }
+    if ((i < xdata->number_of_apps) || (next != xdata->number_of_items)) {
+        printf("Entity %lu XDATA applications do not cover its items. \n", (unsigned long)entity->seq);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int same_item(const struct dxf_xdata_item* const a, const struct dxf_xdata_item* const b)
+{
+    int i;
+
+    if (a->group_code != b->group_code) {
+        return 0;
+    }
+
+    if ((a->group_code >= 1010) && (a->group_code <= 1013)) {
+        for (i = 0; i < 3; ++i) {
+            if (fabs(a->value.point[i] - b->value.point[i]) > 1e-9 * (1.0 + fabs(a->value.point[i]))) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    if ((a->group_code >= 1010) && (a->group_code < 1060)) {
+        return fabs(a->value.f - b->value.f) <= 1e-9 * (1.0 + fabs(a->value.f));
+    }
+    if ((a->group_code >= 1060) && (a->group_code <= 1071)) {
+        return a->value.i == b->value.i;
+    }
+
+    if (a->group_code == 1004) {
+        return (a->value.bin.size == b->value.bin.size)
+                && (memcmp(a->value.bin.data, b->value.bin.data, a->value.bin.size) == 0);
+    }
+    return strcmp(a->value.str, b->value.str) == 0;
+}
+
+/* Read through a token cache, XDATA must decode to the same items. */
+static int compare_documents(struct dxf* const dxf, struct dxf* const cached)
+{
+    struct dxf_entity *a;
+    struct dxf_entity *b;
+    size_t i;
+
+    for (a = dxf->first_entity, b = cached->first_entity; (a != NULL) && (b != NULL);
+        a = a->next_in_file, b = b->next_in_file)
+    {
+        if ((a->xdata == NULL) != (b->xdata == NULL)) {
+            break;
+        }
+        if (a->xdata == NULL) {
+            continue;
+        }
+
+        dxf_xdata_decode(dxf, a);
+        dxf_xdata_decode(cached, b);
+        if ((a->xdata->number_of_apps != b->xdata->number_of_apps)
+            || (a->xdata->number_of_items != b->xdata->number_of_items)
+            || ((a->xdata->dictionary == NULL) != (b->xdata->dictionary == NULL))
+            || ((a->xdata->dictionary != NULL) && (strcmp(a->xdata->dictionary, b->xdata->dictionary) != 0)))
+        {
+            break;
+        }
+        for (i = 0; i < a->xdata->number_of_items; ++i) {
+            if (!same_item(&(a->xdata->items[i]), &(b->xdata->items[i]))) {
+                break;
+            }
+        }
+        if (i < a->xdata->number_of_items) {
+            break;
+        }
+    }
+
+    if ((a != NULL) || (b != NULL)) {
+        printf("Entity %lu XDATA differs when read through the token cache. \n",
+                (unsigned long)(a != NULL ? a->seq : b->seq));
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dxf dxf;
+    struct dxf recorded;
+    struct dxf replayed;
+    struct dxf_entity *entity;
+    char cache_path[256];
+    size_t number_of_entities = 0;
+    size_t number_of_apps = 0;
+    size_t number_of_items = 0;
+
+    if (argc < 2) {
+        return 1;
+    }
+
+    dxf_lexer_init();
+    dxf_parser_init();
+    if (parse(argv[1], &dxf) != 0) {
+        return 1;
+    }
+
+    for (entity = dxf.first_entity; entity != NULL; entity = entity->next_in_file) {
+        if (entity->xdata == NULL) {
+            continue;
+        }
+        if (check_xdata(&dxf, entity) != 0) {
+            return 1;
+        }
+        ++number_of_entities;
+        number_of_apps += entity->xdata->number_of_apps;
+        number_of_items += entity->xdata->number_of_items;
+    }
+
+    dxf_token_cache_enable(NULL);
+    sprintf(cache_path, "%.240s%s", argv[1], DXF_TOKEN_CACHE_SUFFIX);
+    remove(cache_path);
+    if ((parse(argv[1], &recorded) != 0) || (parse(argv[1], &replayed) != 0)
+        || (compare_documents(&dxf, &recorded) != 0) || (compare_documents(&dxf, &replayed) != 0))
+    {
+        remove(cache_path);
+        return 1;
+    }
+    remove(cache_path);
+
+    printf("%lu entities with XDATA, %lu applications, %lu items. \n", (unsigned long)number_of_entities,
+            (unsigned long)number_of_apps, (unsigned long)number_of_items);
+
+    dxf_free(&replayed);
+    dxf_free(&recorded);
+    dxf_free(&dxf);
+
+    return 0;
+}
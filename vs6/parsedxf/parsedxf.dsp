@@ -89,12 +89,80 @@ SOURCE=..\..\src\dxf.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\dxfarena.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\dxflexer.c
 # End Source File
 # Begin Source File
 
 SOURCE=..\..\src\dxfparser.c
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfsnapshot.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftokcache.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxflazy.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfupdate.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfinsert.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfbounds.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfrtree.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftess.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfchain.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfocs.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfspline.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfellipse.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftext.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfxdata.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfbinary.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfthumbnail.c
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -105,12 +173,80 @@ SOURCE=..\..\src\dxf.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\..\src\dxfarena.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\..\src\dxflexer.h
 # End Source File
 # Begin Source File
 
 SOURCE=..\..\src\dxfparser.h
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfsnapshot.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftokcache.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxflazy.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfupdate.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfinsert.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfbounds.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfrtree.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftess.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfchain.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfocs.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfspline.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfellipse.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxftext.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfxdata.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfbinary.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\..\src\dxfthumbnail.h
+# End Source File
 # End Group
 # End Target
 # End Project